@@ -4,8 +4,8 @@
 #include <kernel/types.h>
 #include <drivers/terminal.h>
 
-// bool tanımı
-#ifndef __bool_true_false_are_defined
+// bool tanımı; types.h zaten tanımladıysa yeniden tanımlama
+#if !defined(__bool_true_false_are_defined) && !defined(_KERNEL_TYPES_H)
 typedef enum { false = 0, true = 1 } bool;
 #define __bool_true_false_are_defined 1
 #endif
@@ -93,6 +93,7 @@ void keyboard_set_layout(keyboard_layout_t layout);
 
 // Karakter oku (bloke edici)
 char keyboard_getchar(void);
+void keyboard_wait_keypress(void);
 
 // Tampondan karakter al (bloke edici değil)
 char keyboard_read(void);
@@ -100,6 +101,11 @@ char keyboard_read(void);
 // Tampon durumu
 bool keyboard_data_available(void);
 
+// Okunacak karakter varsa EPOLLIN; tablo verilirse giriş kuyruğunu da
+// kaydeder, bkz. kernel/epoll.h
+struct poll_table;
+uint32_t keyboard_poll(struct poll_table* table);
+
 // Terminal okuma fonksiyonlarını bağla
 void keyboard_connect_terminal(void);
 
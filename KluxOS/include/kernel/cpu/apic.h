@@ -0,0 +1,94 @@
+#ifndef APIC_H
+#define APIC_H
+
+#include <kernel/types.h>
+
+// Local APIC and I/O APIC.
+//
+// Each CPU has a local APIC for its timer, inter-processor interrupts
+// and EOI. The I/O APIC replaces the 8259 PICs once the machine runs
+// more than one CPU: ISA interrupts keep their vectors (32 + irq) and
+// are delivered to the boot CPU.
+
+#define MSR_IA32_APIC_BASE      0x1B
+#define APIC_BASE_ENABLE        (1 << 11)
+#define APIC_BASE_BSP           (1 << 8)
+
+#define LAPIC_DEFAULT_BASE      0xFEE00000
+#define IOAPIC_DEFAULT_BASE     0xFEC00000
+
+// local APIC registers (byte offsets)
+#define LAPIC_ID                0x020
+#define LAPIC_VERSION           0x030
+#define LAPIC_TPR               0x080
+#define LAPIC_EOI               0x0B0
+#define LAPIC_SVR               0x0F0
+#define LAPIC_ESR               0x280
+#define LAPIC_ICR_LOW           0x300
+#define LAPIC_ICR_HIGH          0x310
+#define LAPIC_LVT_TIMER         0x320
+#define LAPIC_LVT_LINT0         0x350
+#define LAPIC_LVT_LINT1         0x360
+#define LAPIC_LVT_ERROR         0x370
+#define LAPIC_TIMER_INIT        0x380
+#define LAPIC_TIMER_CURRENT     0x390
+#define LAPIC_TIMER_DIVIDE      0x3E0
+
+#define LAPIC_SVR_ENABLE        0x100
+#define LAPIC_LVT_MASKED        0x10000
+#define LAPIC_TIMER_PERIODIC    0x20000
+#define LAPIC_TIMER_DIV_16      0x3
+
+// interrupt command register
+#define ICR_INIT                0x00000500
+#define ICR_STARTUP             0x00000600
+#define ICR_LEVEL_ASSERT        0x00004000
+#define ICR_DELIVERY_PENDING    0x00001000
+
+// vectors
+#define LAPIC_TIMER_VECTOR      0xEF
+#define RESCHED_VECTOR          0xF0
+#define TLB_FLUSH_VECTOR        0xF1
+#define SPURIOUS_VECTOR         0xFF
+
+// I/O APIC redirection entry bits
+#define IOAPIC_REG_ID           0x00
+#define IOAPIC_REG_VERSION      0x01
+#define IOAPIC_REDTBL(n)        (0x10 + 2 * (n))
+#define IOAPIC_ACTIVE_LOW       (1 << 13)
+#define IOAPIC_LEVEL            (1 << 15)
+#define IOAPIC_MASKED           (1 << 16)
+
+#define ISA_IRQS                16
+
+// local APIC of the calling CPU
+bool lapic_present(void);
+void lapic_init(uint32_t base);
+void lapic_init_cpu(void);
+uint32_t lapic_id(void);
+void lapic_eoi(void);
+
+// inter-processor interrupts
+void lapic_send_ipi(uint32_t apic_id, uint32_t vector);
+void lapic_send_init(uint32_t apic_id);
+void lapic_send_startup(uint32_t apic_id, uint32_t page);
+
+// periodic local timer at 'hz', calibrated against the TSC
+void lapic_timer_start(uint32_t hz);
+
+// busy wait, usable before the timer runs
+void apic_udelay(uint32_t us);
+
+// route ISA interrupts through the I/O APIC and turn the PICs off
+void ioapic_init(uint32_t base);
+void ioapic_set_override(uint32_t irq, uint32_t gsi, uint32_t flags);
+void ioapic_mask_irq(uint32_t irq);
+void ioapic_unmask_irq(uint32_t irq);
+
+// true once ISA interrupts arrive through the I/O APIC
+bool apic_irqs_routed(void);
+
+// C side of the local APIC stubs in interrupt_asm.asm
+void lapic_interrupt(uint32_t vector);
+
+#endif // APIC_H
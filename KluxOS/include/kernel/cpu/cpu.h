@@ -0,0 +1,76 @@
+#ifndef CPU_H
+#define CPU_H
+
+#include <kernel/types.h>
+
+// CPUID leaf 1 feature bits
+#define CPUID_EDX_TSC       (1 << 4)
+#define CPUID_EDX_MSR       (1 << 5)
+#define CPUID_EDX_APIC      (1 << 9)
+#define CPUID_EDX_SEP       (1 << 11)   // SYSENTER/SYSEXIT
+#define CPUID_ECX_MONITOR   (1 << 3)    // MONITOR/MWAIT
+
+// model specific registers
+#define MSR_IA32_SYSENTER_CS    0x174
+#define MSR_IA32_SYSENTER_ESP   0x175
+#define MSR_IA32_SYSENTER_EIP   0x176
+
+// CPUID leaf 0x80000007 (advanced power management)
+#define CPUID_EDX_INVARIANT_TSC (1 << 8)
+
+static inline void cpuid(uint32_t leaf, uint32_t* eax, uint32_t* ebx,
+                         uint32_t* ecx, uint32_t* edx) {
+    __asm__ volatile("cpuid"
+                     : "=a"(*eax), "=b"(*ebx), "=c"(*ecx), "=d"(*edx)
+                     : "a"(leaf), "c"(0));
+}
+
+static inline uint32_t cpuid_edx(uint32_t leaf) {
+    uint32_t eax, ebx, ecx, edx;
+    cpuid(leaf, &eax, &ebx, &ecx, &edx);
+    return edx;
+}
+
+static inline uint32_t cpuid_ecx(uint32_t leaf) {
+    uint32_t eax, ebx, ecx, edx;
+    cpuid(leaf, &eax, &ebx, &ecx, &edx);
+    return ecx;
+}
+
+static inline uint32_t cpuid_max_extended(void) {
+    uint32_t eax, ebx, ecx, edx;
+    cpuid(0x80000000, &eax, &ebx, &ecx, &edx);
+    return eax;
+}
+
+static inline uint64_t rdtsc(void) {
+    uint32_t lo, hi;
+    __asm__ volatile("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static inline uint64_t rdmsr(uint32_t msr) {
+    uint32_t lo, hi;
+    __asm__ volatile("rdmsr" : "=a"(lo), "=d"(hi) : "c"(msr));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static inline void wrmsr(uint32_t msr, uint64_t value) {
+    __asm__ volatile("wrmsr" : : "c"(msr), "a"((uint32_t)value), "d"((uint32_t)(value >> 32)));
+}
+
+static inline void cpu_relax(void) {
+    __asm__ volatile("pause" : : : "memory");
+}
+
+// full barrier, also orders a store before a later load (no SSE2 needed)
+static inline void smp_mb(void) {
+    __asm__ volatile("lock addl $0, (%%esp)" : : : "memory", "cc");
+}
+
+// arm the monitor on the cache line holding addr, see irq_enable_and_mwait
+static inline void cpu_monitor(const volatile void* addr) {
+    __asm__ volatile("monitor" : : "a"(addr), "c"(0), "d"(0));
+}
+
+#endif // CPU_H
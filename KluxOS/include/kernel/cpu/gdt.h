@@ -0,0 +1,89 @@
+#ifndef GDT_H
+#define GDT_H
+
+#include <kernel/types.h>
+#include <compat.h>
+
+// Segment selectors. The order is fixed by SYSENTER/SYSEXIT: user code
+// must sit 16 bytes and user data 24 bytes above the kernel code entry.
+#define GDT_KERNEL_CODE   0x08
+#define GDT_KERNEL_DATA   0x10
+#define GDT_USER_CODE     0x18
+#define GDT_USER_DATA     0x20
+#define GDT_TSS           0x28
+#define GDT_PERCPU        0x30      // %fs, based at this CPU's cpu_t
+#define GDT_DF_TSS        0x38      // double fault task, see tss_set_double_fault_cr3
+
+#define GDT_RPL_USER      0x03
+
+#define GDT_ENTRIES       8
+
+// access byte
+#define GDT_ACCESS_PRESENT   0x80
+#define GDT_ACCESS_RING3     0x60
+#define GDT_ACCESS_SEGMENT   0x10   // code/data (not system)
+#define GDT_ACCESS_CODE      0x0A   // executable, readable
+#define GDT_ACCESS_DATA      0x02   // writable
+#define GDT_ACCESS_TSS       0x09   // 32-bit available TSS
+
+// flags nibble
+#define GDT_FLAG_4K          0x80   // limit in 4 KB pages
+#define GDT_FLAG_32BIT       0x40
+
+typedef struct {
+    uint16_t limit_low;
+    uint16_t base_low;
+    uint8_t  base_middle;
+    uint8_t  access;
+    uint8_t  granularity;   // flags + limit bits 16-19
+    uint8_t  base_high;
+} PACKED gdt_entry_t;
+
+typedef struct {
+    uint16_t limit;
+    uint32_t base;
+} PACKED gdt_ptr_t;
+
+// 32-bit task state segment. The CPU's own TSS only uses esp0/ss0 (stack
+// for ring 3 -> 0); the double fault TSS is a full task the CPU switches
+// to, with its own stack.
+typedef struct {
+    uint32_t prev_tss;
+    uint32_t esp0;
+    uint32_t ss0;
+    uint32_t esp1, ss1, esp2, ss2;
+    uint32_t cr3, eip, eflags;
+    uint32_t eax, ecx, edx, ebx, esp, ebp, esi, edi;
+    uint32_t es, cs, ss, ds, fs, gs;
+    uint32_t ldt;
+    uint16_t trap;
+    uint16_t iomap_base;
+} PACKED tss_entry_t;
+
+struct cpu;
+
+// Every CPU has its own GDT and TSS (both live in its cpu_t); only the
+// TSS and per-CPU descriptors differ between them.
+
+// set up and load the boot CPU's tables
+void gdt_init(void);
+
+// set up and load the tables of the calling CPU
+void gdt_init_cpu(struct cpu* cpu);
+
+void gdt_set_gate(gdt_entry_t* gdt, int num, uint32_t base, uint32_t limit,
+                  uint8_t access, uint8_t flags);
+
+// kernel stack used when an interrupt or sysenter arrives from user mode
+// on the calling CPU
+void tss_set_kernel_stack(uint32_t esp0);
+uint32_t tss_get_kernel_stack(void);
+
+// the sysenter entry loads its stack from tss.esp0 through this pointer
+tss_entry_t* gdt_get_tss(void);
+
+// directory the calling CPU's double fault task runs under; the boot
+// CPU sets up its tables before paging and calls this once it is on
+void tss_set_double_fault_cr3(uint32_t cr3);
+
+#endif // GDT_H
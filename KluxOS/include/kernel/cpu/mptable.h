@@ -0,0 +1,99 @@
+#ifndef MPTABLE_H
+#define MPTABLE_H
+
+#include <kernel/types.h>
+#include <compat.h>
+#include <kernel/cpu/percpu.h>
+
+// Intel MultiProcessor Specification tables.
+//
+// The BIOS leaves a floating pointer ("_MP_") in the EBDA, the last KiB
+// of base memory or the BIOS ROM. It points at a configuration table
+// listing the processors, buses, I/O APICs and how ISA interrupts are
+// wired to I/O APIC inputs.
+
+#define MP_ENTRY_PROCESSOR   0
+#define MP_ENTRY_BUS         1
+#define MP_ENTRY_IOAPIC      2
+#define MP_ENTRY_IOINT       3
+#define MP_ENTRY_LOCALINT    4
+
+#define MP_CPU_ENABLED       0x01
+#define MP_CPU_BSP           0x02
+
+typedef struct {
+    char signature[4];           // "_MP_"
+    uint32_t config;             // physical address of the configuration table
+    uint8_t length;              // in 16 byte units
+    uint8_t revision;
+    uint8_t checksum;
+    uint8_t feature1;            // nonzero: default configuration, no table
+    uint8_t feature2;            // bit 7: IMCR present (PIC mode)
+    uint8_t feature3[3];
+} PACKED mp_floating_t;
+
+typedef struct {
+    char signature[4];           // "PCMP"
+    uint16_t length;             // base table, header included
+    uint8_t revision;
+    uint8_t checksum;
+    char oem_id[8];
+    char product_id[12];
+    uint32_t oem_table;
+    uint16_t oem_table_size;
+    uint16_t entry_count;
+    uint32_t lapic_base;
+    uint16_t ext_length;
+    uint8_t ext_checksum;
+    uint8_t reserved;
+} PACKED mp_config_t;
+
+typedef struct {
+    uint8_t type;
+    uint8_t apic_id;
+    uint8_t apic_version;
+    uint8_t flags;
+    uint32_t signature;
+    uint32_t features;
+    uint32_t reserved[2];
+} PACKED mp_processor_t;
+
+typedef struct {
+    uint8_t type;
+    uint8_t bus_id;
+    char bus_type[6];
+} PACKED mp_bus_t;
+
+typedef struct {
+    uint8_t type;
+    uint8_t apic_id;
+    uint8_t version;
+    uint8_t flags;
+    uint32_t address;
+} PACKED mp_ioapic_t;
+
+typedef struct {
+    uint8_t type;
+    uint8_t int_type;            // 0 = vectored, 3 = ExtINT
+    uint16_t flags;              // polarity and trigger mode
+    uint8_t src_bus;
+    uint8_t src_irq;
+    uint8_t dst_apic;
+    uint8_t dst_intin;
+} PACKED mp_ioint_t;
+
+// what the kernel needs from the tables
+typedef struct {
+    uint32_t lapic_base;
+    uint32_t ioapic_base;        // first I/O APIC, 0 if none
+    bool imcr;                   // PIC mode, IMCR must be switched
+    uint32_t cpu_count;
+    uint32_t apic_ids[MAX_CPUS];
+    uint32_t bsp_apic_id;
+} mp_info_t;
+
+// find and parse the tables; ISA overrides are handed to the I/O APIC
+// code. Returns -1 if there are none (a uniprocessor machine).
+int mptable_parse(mp_info_t* info);
+
+#endif // MPTABLE_H
@@ -0,0 +1,115 @@
+#ifndef PERCPU_H
+#define PERCPU_H
+
+#include <kernel/types.h>
+#include <kernel/list.h>
+#include <kernel/cpu/gdt.h>
+#include <kernel/sync/spinlock.h>
+
+// Per-CPU data.
+//
+// Each CPU owns one cpu_t. Its GDT has a data segment based at that
+// cpu_t which stays loaded in %fs while in the kernel, so this_cpu() is
+// a single load of %fs:0 (the self pointer) and needs no CPU lookup.
+
+#define MAX_CPUS  16
+#define PERCPU_KSTACK_CACHE  4       // freed kernel stacks kept per CPU
+#define PERCPU_USER_RETURN_ESP  12   // offsetof(cpu_t, user_return_esp), syscall_entry.asm
+
+struct process;
+struct mm;
+
+// ready processes of one CPU, FIFO
+typedef struct {
+    spinlock_t lock;                 // also held across a context switch
+    list_node_t queue;               // process_t.run_node
+    volatile uint32_t nr_running;    // queued, the running process excluded
+} runqueue_t;
+
+typedef struct cpu {
+    struct cpu* self;                // must stay first, read through %fs:0
+    volatile uint32_t preempt_count; // locks and RCU readers held, see preempt.h
+    volatile int need_resched;       // at the offset preempt.h expects
+    uint32_t user_return_esp;        // user_enter frame while a benchmark runs here, else 0
+    uint32_t id;                     // index in cpus[], 0 is the boot CPU
+    uint32_t apic_id;
+    volatile uint32_t online;
+
+    // descriptor tables
+    gdt_entry_t gdt[GDT_ENTRIES];
+    gdt_ptr_t gdt_ptr;
+    tss_entry_t tss;
+    tss_entry_t df_tss;              // double fault task
+
+    // scheduling
+    runqueue_t rq;
+    struct process* current;         // running on this CPU
+    struct process* idle;            // runs when nothing else can
+    struct process* dead;            // exited on its own stack, freed after the switch
+    struct mm* active_mm;            // user directory loaded, kept while kernel threads run
+    volatile int need_balance;       // pull work from a busier CPU on irq exit
+    uint32_t sched_ticks;            // scheduler ticks seen by this CPU
+
+    // scheduler statistics
+    uint32_t busy_ticks;             // ticks that found a process running
+    uint32_t idle_ticks;             // ticks that found the idle process
+    uint32_t switches;
+    uint32_t migrations;             // processes moved onto this CPU
+    uint32_t steals;                 // ... of them taken while idle
+    uint32_t wake_local;             // wakeups placed on the waking CPU
+    uint32_t handoffs;               // direct switches to a blocked process, no run queue
+    uint32_t preemptions;            // switches forced on a running process
+    uint32_t preempt_deferred;       // ... postponed by a non-zero preempt count
+
+    // idle residency
+    volatile uint32_t idle_polling;  // in MWAIT on need_resched, setting it wakes us
+    uint64_t idle_ns;                // time spent halted
+    uint32_t idle_wakeups;           // halts ended by an interrupt or a kick
+
+    // recently freed kernel stacks, still mapped
+    void* kstack_cache[PERCPU_KSTACK_CACHE];
+    uint32_t kstack_cached;
+    uint32_t kstack_cache_hits;
+
+    // read-copy-update
+    volatile uint32_t rcu_nesting;   // rcu_read_lock depth, also counted in preempt_count
+
+    // interrupt state
+    uint32_t hardirq_depth;
+    uint32_t lapic_ticks;            // local timer interrupts
+
+    void* boot_stack;
+} cpu_t;
+
+extern cpu_t cpus[MAX_CPUS];
+
+_Static_assert(offsetof(cpu_t, preempt_count) == PERCPU_PREEMPT_COUNT, "preempt.h offset");
+_Static_assert(offsetof(cpu_t, need_resched) == PERCPU_NEED_RESCHED, "preempt.h offset");
+_Static_assert(offsetof(cpu_t, user_return_esp) == PERCPU_USER_RETURN_ESP, "syscall_entry.asm offset");
+
+static inline cpu_t* this_cpu(void) {
+    cpu_t* cpu;
+    __asm__ volatile("movl %%fs:0, %0" : "=r"(cpu));
+    return cpu;
+}
+
+// Update a field of the running CPU's record in one instruction, so an
+// interrupt or a migration cannot split the read from the write.
+#define this_cpu_inc(field) \
+    __asm__ volatile("incl %%fs:%c0" : : "i"(offsetof(cpu_t, field)) : "memory")
+#define this_cpu_dec(field) \
+    __asm__ volatile("decl %%fs:%c0" : : "i"(offsetof(cpu_t, field)) : "memory")
+
+// the boot CPU's record, valid before %fs is set up
+static inline cpu_t* boot_cpu(void) {
+    return &cpus[0];
+}
+
+// register a CPU found in the MP table, returns its record or NULL
+cpu_t* percpu_add(uint32_t apic_id);
+
+// CPUs registered / brought online
+uint32_t cpu_count(void);
+uint32_t cpu_online_count(void);
+
+#endif // PERCPU_H
@@ -0,0 +1,36 @@
+#ifndef SMP_H
+#define SMP_H
+
+#include <kernel/types.h>
+#include <kernel/cpu/percpu.h>
+
+// Multiprocessor start-up.
+//
+// The boot CPU finds the other processors in the MP tables, moves ISA
+// interrupts to the I/O APIC and starts each AP with INIT and two
+// startup IPIs pointing at a real-mode trampoline. Every AP loads its
+// own GDT and TSS, the shared IDT, enables its local APIC and timer and
+// then idles until the scheduler gives it work. Without MP tables the
+// kernel keeps running on the boot CPU with the PICs.
+
+#define AP_TRAMPOLINE_ADDR   0x8000     // below 1 MiB, page aligned
+#define AP_BOOT_TIMEOUT_MS   100
+
+void smp_init(void);
+
+// ask another CPU to run the scheduler
+void smp_send_reschedule(cpu_t* cpu);
+
+// Drop [start, start + size) from the TLB of every online CPU and wait
+// until they all have. Interrupts must be on and no spinlock held: the
+// other CPUs may be spinning on one with interrupts enabled, but one
+// waiting on us with them off would never answer.
+void smp_flush_tlb_range(uint32_t start, uint32_t size);
+
+// TLB_FLUSH_VECTOR handler
+void smp_flush_tlb_interrupt(void);
+
+// print one line per CPU
+void smp_dump(void);
+
+#endif // SMP_H
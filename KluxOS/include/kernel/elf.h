@@ -0,0 +1,58 @@
+#ifndef ELF_H
+#define ELF_H
+
+#include <kernel/types.h>
+
+// ELF32 executable format, the parts the program loader needs.
+
+#define ELF_MAGIC        0x464C457F     // "\x7FELF" read as a little-endian word
+
+#define ELF_CLASS_32     1
+#define ELF_DATA_LSB     1
+#define ELF_VERSION      1
+
+#define ELF_TYPE_EXEC    2
+#define ELF_MACHINE_386  3
+
+#define ELF_PT_NULL      0
+#define ELF_PT_LOAD      1
+
+#define ELF_PF_X         0x1
+#define ELF_PF_W         0x2
+#define ELF_PF_R         0x4
+
+#define ELF_MAX_PHDRS    16             // program headers accepted per image
+
+typedef struct {
+    uint32_t magic;
+    uint8_t class;
+    uint8_t data;
+    uint8_t ident_version;
+    uint8_t ident_pad[9];
+    uint16_t type;
+    uint16_t machine;
+    uint32_t version;
+    uint32_t entry;
+    uint32_t phoff;
+    uint32_t shoff;
+    uint32_t flags;
+    uint16_t ehsize;
+    uint16_t phentsize;
+    uint16_t phnum;
+    uint16_t shentsize;
+    uint16_t shnum;
+    uint16_t shstrndx;
+} __attribute__((packed)) elf32_ehdr_t;
+
+typedef struct {
+    uint32_t type;
+    uint32_t offset;
+    uint32_t vaddr;
+    uint32_t paddr;
+    uint32_t filesz;
+    uint32_t memsz;
+    uint32_t flags;
+    uint32_t align;
+} __attribute__((packed)) elf32_phdr_t;
+
+#endif // ELF_H
@@ -0,0 +1,110 @@
+#ifndef EPOLL_H
+#define EPOLL_H
+
+#include <kernel/types.h>
+#include <kernel/list.h>
+#include <kernel/fs.h>
+#include <kernel/fdtable.h>
+#include <kernel/sync/spinlock.h>
+#include <kernel/sync/mutex.h>
+#include <kernel/sync/wait.h>
+
+// Readiness notification over many descriptors, after Linux epoll.
+//
+// An epoll instance is itself a descriptor. Descriptors are added to
+// its interest list once with epoll_ctl. Adding one asks the file for
+// its readiness (fs_node_t.poll) with a poll table. The file hands
+// every wait queue that signals a change to poll_wait, and the instance
+// hooks a callback entry (wait_entry_t.keep) into each one. From then
+// on, a wakeup on the pipe, the keyboard or any other hooked queue puts
+// the item on the instance's ready list without waking anyone up.
+//
+// epoll_wait only looks at the ready list. It polls each item again for
+// its current mask and reports the items that really are ready, so the
+// cost follows the number of ready descriptors, not the watched ones.
+// A level-triggered item that is still ready stays on the list for the
+// next call. An EPOLLET item leaves the list until its next wakeup.
+//
+// An item does not keep its file open. When the last descriptor of a
+// watched file is closed, file_put calls epoll_file_release, which
+// drops the file from every interest list, as Linux's eventpoll does.
+//
+// A file without a poll method is always readable and writable, like a
+// regular file. The console (node NULL) is readable when a key is
+// waiting.
+
+#define EPOLLIN           0x001
+#define EPOLLOUT          0x004
+#define EPOLLERR          0x008         // reported whether asked for or not
+#define EPOLLHUP          0x010         // likewise
+#define EPOLLET           0x80000000    // report changes, not state
+
+#define EPOLL_CTL_ADD     1
+#define EPOLL_CTL_DEL     2
+#define EPOLL_CTL_MOD     3
+
+#define EPOLL_MAX_QUEUES  2             // wait queues one file may hook
+
+typedef struct epoll_event {
+    uint32_t events;              // EPOLL* mask
+    uint32_t data;                // the caller's, returned with the event
+} epoll_event_t;
+
+// how a poll method names its wait queues; NULL when only the mask is wanted
+typedef struct poll_table {
+    void (*queue)(struct poll_table* table, wait_queue_t* wq);
+    void* data;
+} poll_table_t;
+
+static inline void poll_wait(poll_table_t* table, wait_queue_t* wq) {
+    if (table) {
+        table->queue(table, wq);
+    }
+}
+
+struct epoll;
+
+typedef struct epoll_item {
+    list_node_t node;             // in the instance's items
+    list_node_t ready_node;       // in its ready list
+    list_node_t file_node;        // in file->epoll_items
+    struct epoll* ep;
+    int fd;
+    file_t* file;                 // no reference, see epoll_file_release
+    uint32_t events;              // interest, EPOLL* and EPOLLET
+    uint32_t data;
+    wait_entry_t waits[EPOLL_MAX_QUEUES];
+    uint32_t nwaits;
+    bool ready;                   // on the ready list or being reported
+    volatile uint32_t wakeups;    // callbacks so far, ep->lock
+} epoll_item_t;
+
+typedef struct epoll {
+    fs_node_t node;               // what the descriptor points at
+    mutex_t mutex;                // interest list, and one report at a time
+    spinlock_t lock;              // ready list, taken by wakeup callbacks
+    list_node_t items;
+    list_node_t ready;
+    wait_queue_t wq;              // epoll_wait callers with nothing to report
+    uint32_t nitems;
+    uint32_t waits;               // epoll_wait calls
+    uint32_t reported;            // events returned
+    list_node_t list_node;        // all instances, for epoll_dump
+} epoll_t;
+
+// new instance, returns its descriptor
+int epoll_create(void);
+
+// add, change or remove fd on the interest list; event is unused for DEL
+int epoll_ctl(int epfd, int op, int fd, const epoll_event_t* event);
+
+// up to max ready events; waits up to timeout_ms, forever if negative.
+// Returns the count, 0 on timeout, -1 on error.
+int epoll_wait(int epfd, epoll_event_t* events, uint32_t max, int timeout_ms);
+
+// the last reference to file is gone: take it off every interest list
+void epoll_file_release(file_t* file);
+
+void epoll_dump(void);
+
+#endif // EPOLL_H
@@ -0,0 +1,30 @@
+#ifndef EXEC_H
+#define EXEC_H
+
+#include <kernel/types.h>
+#include <kernel/process.h>
+
+// Program loader.
+//
+// exec reads the ELF headers of an executable and records each PT_LOAD
+// segment as an area of a new address space; no page is read or mapped
+// up front. The program's pages come in through page faults as it
+// touches them, file pages shared with every other process running the
+// same executable (see mm/vm.h). The arguments are copied to the top of
+// a demand-zero stack in the System V i386 layout: argc, argv[], NULL,
+// an empty environment and an empty auxiliary vector.
+//
+// A program ends with SYS_EXIT; its address space is freed with the
+// process.
+
+#define EXEC_MAX_ARGS   16
+#define EXEC_PATH_MAX   128
+
+// Replace the running process' program with the executable at path.
+// Returns -1 if it cannot be loaded, and does not return otherwise.
+int process_exec(const char* path, char* const argv[]);
+
+// start the executable at path in a new process
+process_t* exec_spawn(const char* path, char* const argv[]);
+
+#endif // EXEC_H
@@ -0,0 +1,84 @@
+#ifndef FDTABLE_H
+#define FDTABLE_H
+
+#include <kernel/types.h>
+#include <kernel/fs.h>
+#include <kernel/list.h>
+#include <kernel/sync/ticketlock.h>
+
+// Per-process file descriptor tables.
+//
+// A descriptor points at a reference counted open file, so dup'ed
+// descriptors share the offset. The table grows on demand; a bitmap of
+// used slots gives the lowest free descriptor with a find-first-zero
+// scan that starts at a hint below which every slot is known to be used.
+// The table lock covers the slots and the bitmap; the last file_put of
+// a closed descriptor runs after it is dropped.
+
+#define FDTABLE_INITIAL   32        // first size, a multiple of 32
+#define FDTABLE_MAX       4096      // hard limit per process
+
+#define FD_STDIN   0
+#define FD_STDOUT  1
+#define FD_STDERR  2
+
+// open flags
+#define O_RDONLY    0x0001
+#define O_WRONLY    0x0002
+#define O_RDWR      0x0003
+#define O_CREAT     0x0100
+#define O_TRUNC     0x0200
+#define O_APPEND    0x0400
+#define O_NONBLOCK  0x0800      // pipes: fail instead of sleeping
+
+// an open file; node == NULL is the console (keyboard in, terminal out)
+typedef struct file {
+    fs_node_t* node;
+    uint32_t offset;
+    uint32_t flags;          // open flags
+    volatile uint32_t refcount; // descriptors pointing here, atomic
+    list_node_t epoll_items; // epoll_item_t.file_node, interest lists watching it
+} file_t;
+
+typedef struct fdtable {
+    file_t** files;          // max_fds entries
+    uint32_t* open_map;      // bit set = slot in use
+    uint32_t max_fds;        // current capacity
+    uint32_t next_fd;        // no free slot below this
+    uint32_t count;          // slots in use
+    ticketlock_t lock;
+} fdtable_t;
+
+// open file objects
+file_t* file_alloc(fs_node_t* node, uint32_t flags);
+file_t* file_get(file_t* file);
+void file_put(file_t* file);
+
+// write at the file's offset and move it, growing the file as needed;
+// the caller checked the permission. Bytes written or -1.
+int file_write(file_t* file, const void* buf, uint32_t count);
+
+// table with stdin/stdout/stderr on the console
+fdtable_t* fdtable_create(void);
+
+// close every descriptor and free the table
+void fdtable_destroy(fdtable_t* table);
+
+// table of the running process (the boot table before processes exist)
+fdtable_t* fdtable_current(void);
+
+// install the file at the lowest free descriptor, takes the reference
+int fd_alloc(fdtable_t* table, file_t* file);
+
+// file behind a descriptor, NULL if it is not open
+file_t* fd_get(fdtable_t* table, int fd);
+
+int fd_close(fdtable_t* table, int fd);
+
+// new descriptor for the same open file, lowest free number
+int fd_dup(fdtable_t* table, int oldfd);
+
+// make newfd refer to oldfd's file, closing newfd first
+int fd_dup2(fdtable_t* table, int oldfd, int newfd);
+
+#endif // FDTABLE_H
@@ -19,6 +19,7 @@ typedef enum {
 } fs_permission_t;
 
 struct fs_node;
+struct poll_table;
 
 typedef uint32_t (*read_type_t)(struct fs_node*, uint32_t, uint32_t, uint8_t*);
 typedef uint32_t (*write_type_t)(struct fs_node*, uint32_t, uint32_t, uint8_t*);
@@ -31,6 +32,10 @@ typedef struct fs_node* (*readlink_type_t)(struct fs_node*);
 
 typedef void (*truncate_type_t)(struct fs_node*);
 
+// Hazır olma maskesi (EPOLL*); tablo verilirse maske değişince
+// uyandırılan bekleme kuyruklarını da kaydeder, bkz. kernel/epoll.h
+typedef uint32_t (*poll_type_t)(struct fs_node*, struct poll_table*);
+
 typedef struct fs_node {
     char name[128];               
     uint32_t mask;                
@@ -54,6 +59,7 @@ typedef struct fs_node {
     finddir_type_t finddir;       
     readlink_type_t readlink;     
     truncate_type_t truncate;     
+    poll_type_t poll;             
     
     struct fs_node* parent;       
     struct fs_node* next;         
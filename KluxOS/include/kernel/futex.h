@@ -0,0 +1,44 @@
+#ifndef FUTEX_H
+#define FUTEX_H
+
+#include <kernel/types.h>
+
+// Fast user-space mutexes.
+//
+// A lock is a 32-bit word in memory the caller owns. Taking and
+// releasing a free lock is an atomic instruction in user space; only
+// when a thread has to wait does it enter the kernel with futex_wait,
+// and only a release that saw waiters calls futex_wake. Waiters are
+// kept in a fixed hash table of wait queues keyed by the physical
+// address of the word, so threads that map the same page at different
+// addresses still meet on the same queue.
+
+#define FUTEX_HASH_BITS   6
+#define FUTEX_HASH_SIZE   (1 << FUTEX_HASH_BITS)
+
+typedef struct {
+    uint32_t waits;          // futex_wait calls that slept
+    uint32_t wait_retries;   // futex_wait returned at once, the word had changed
+    uint32_t wakes;          // waiters woken
+    uint64_t wake_cycles;    // futex_wake until the waiter runs again
+    uint32_t max_wake_cycles;
+} futex_stats_t;
+
+void futex_init(void);
+
+// sleep while *uaddr == val; returns 0 after a wake, -1 if the value
+// differed or the address is invalid
+int futex_wait(volatile uint32_t* uaddr, uint32_t val);
+
+// wake up to count waiters on uaddr, returns the number woken
+int futex_wake(volatile uint32_t* uaddr, uint32_t count);
+
+// the same for system calls: uaddr must be a user page, and below
+// USER_SPACE_END when the caller has its own address space
+int futex_wait_user(volatile uint32_t* uaddr, uint32_t val);
+int futex_wake_user(volatile uint32_t* uaddr, uint32_t count);
+
+void futex_stats_get(futex_stats_t* stats);
+void futex_stats_reset(void);
+
+#endif // FUTEX_H
@@ -0,0 +1,29 @@
+#ifndef FUTEX_BENCH_H
+#define FUTEX_BENCH_H
+
+#include <kernel/types.h>
+
+// Contended mutex benchmark: several kernel threads take and release
+// one futex-based lock in a loop and the run reports throughput and how
+// long woken waiters took to run again.
+
+#define FUTEX_BENCH_MAX_THREADS   16
+#define FUTEX_BENCH_DEFAULT       10000     // lock/unlock pairs per thread
+
+typedef struct {
+    uint32_t threads;
+    uint32_t iterations;         // per thread
+    uint64_t cycles;             // first thread start to last thread done
+    uint32_t sleeps;             // futex_wait calls that slept
+    uint32_t wakes;
+    uint32_t avg_wake_cycles;
+    uint32_t max_wake_cycles;
+    bool consistent;             // the protected counter came out right
+} futex_bench_result_t;
+
+int futex_bench_run(uint32_t threads, uint32_t iterations, futex_bench_result_t* result);
+
+// run with the given thread count, or 2, 4, 8 and 16 threads if 0, and print
+void futex_bench(uint32_t threads, uint32_t iterations);
+
+#endif // FUTEX_BENCH_H
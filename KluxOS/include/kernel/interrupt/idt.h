@@ -32,6 +32,7 @@
 #define IDT_FLAG_RING3       0x60   // user mode (ring 3)
 #define IDT_FLAG_32BIT       0x0E   // 32-bit interrupt gate
 #define IDT_FLAG_TRAP        0x0F   // trap gate
+#define IDT_FLAG_TASK        0x05   // task gate, the selector names a TSS
 
 typedef struct {
     uint16_t base_low;      // interrupt handler address low 16 bits
@@ -51,7 +52,9 @@ typedef void (*isr_t)(uint32_t error_code);
 void idt_init(void);
 void idt_set_gate(uint8_t num, uint32_t base, uint16_t selector, uint8_t flags);
 void idt_load(idt_ptr_t* ptr);
+void idt_init_cpu(void);
 void register_interrupt_handler(uint8_t num, isr_t handler);
+bool interrupt_handler_registered(uint8_t num);
 
 // code will continue but im so bored.
 
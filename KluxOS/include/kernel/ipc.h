@@ -0,0 +1,86 @@
+#ifndef IPC_H
+#define IPC_H
+
+#include <kernel/types.h>
+#include <kernel/list.h>
+#include <kernel/sync/spinlock.h>
+
+struct process;
+
+// Synchronous message passing, in the style of L4.
+//
+// A server waits on an endpoint with ipc_recv and answers each call
+// with ipc_reply_recv, which replies and waits for the next call in one
+// step. A client's ipc_call sends a small fixed-size message and sleeps
+// until the reply arrives. Nothing is buffered: a message goes straight
+// from the sender's waiter to the receiver's, and the payload is only a
+// few words, so it travels the way registers would.
+//
+// When the other side is already blocked on this CPU the sender does
+// not go through the run queue at all: it blocks and switches straight
+// to the receiver (process_handoff), which therefore runs on the
+// sender's time slice and warm cache. A call and its reply are then two
+// direct switches. A receiver on another CPU is woken normally.
+
+#define IPC_MAX_ENDPOINTS   32
+#define IPC_MSG_WORDS       4
+
+typedef struct ipc_msg {
+    uint32_t label;                   // operation, or the reply status
+    uint32_t words[IPC_MSG_WORDS];
+} ipc_msg_t;
+
+// one blocked party, on its kernel stack
+typedef struct ipc_waiter {
+    list_node_t node;                 // in the endpoint's callers or receivers
+    struct process* process;
+    ipc_msg_t msg;                    // call or reply in flight, kernel copy
+    struct ipc_waiter* caller;        // receiver: the call it was given
+    volatile int done;                // message or reply delivered
+    int status;                       // -1 when the endpoint went away
+} ipc_waiter_t;
+
+typedef struct ipc_endpoint {
+    bool used;
+    uint32_t gen;                     // bumped on destroy, part of the id
+    spinlock_t lock;
+    list_node_t callers;              // calls no receiver has taken yet
+    list_node_t receivers;            // servers waiting for a call
+    uint32_t calls;
+    uint32_t handoffs;                // calls and replies that switched directly
+    uint32_t queued;                  // calls that found no receiver waiting
+} ipc_endpoint_t;
+
+typedef struct {
+    uint32_t calls;
+    uint32_t handoffs;
+    uint32_t queued;
+} ipc_stats_t;
+
+// new endpoint id, -1 if none is free
+int ipc_endpoint_create(void);
+
+// fail every blocked call and receive on the endpoint
+int ipc_endpoint_destroy(int id);
+
+// send msg and wait for the reply, which replaces it; 0 or -1
+int ipc_call(int id, ipc_msg_t* msg);
+
+// wait for a call, which is copied to msg; 0 or -1
+int ipc_recv(int id, ipc_msg_t* msg);
+
+// answer the call taken by the last receive
+int ipc_reply(const ipc_msg_t* msg);
+
+// answer the pending call with msg, then wait for the next one into msg
+int ipc_reply_recv(int id, ipc_msg_t* msg);
+
+// fail the call the exiting process took but never answered
+void ipc_release_process(struct process* process);
+
+// sums over all endpoints
+void ipc_stats_get(ipc_stats_t* stats);
+
+void ipc_dump(void);
+
+#endif // IPC_H
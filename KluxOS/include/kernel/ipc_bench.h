@@ -0,0 +1,30 @@
+#ifndef IPC_BENCH_H
+#define IPC_BENCH_H
+
+#include <kernel/types.h>
+
+// IPC round trip benchmark: an echo server thread answers ipc_call
+// from the calling thread, and each call is timed from send to reply.
+// The same ping-pong over two semaphores, where every wakeup goes
+// through a run queue, is timed as the baseline.
+
+#define IPC_BENCH_DEFAULT       10000     // round trips
+#define IPC_BENCH_WARMUP        100       // untimed calls first
+
+typedef struct {
+    uint32_t iterations;
+    uint32_t min_cycles;          // ipc_call round trip
+    uint32_t avg_cycles;
+    uint32_t max_cycles;
+    uint32_t sema_avg_cycles;     // semaphore round trip
+    uint32_t handoffs;            // of 2 per timed call at best
+    uint32_t queued;              // calls that found the server busy
+    bool consistent;              // every reply echoed its call
+} ipc_bench_result_t;
+
+int ipc_bench_run(uint32_t iterations, ipc_bench_result_t* result);
+
+// run and print
+void ipc_bench(uint32_t iterations);
+
+#endif // IPC_BENCH_H
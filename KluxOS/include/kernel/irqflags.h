@@ -0,0 +1,49 @@
+#ifndef IRQFLAGS_H
+#define IRQFLAGS_H
+
+#include <kernel/types.h>
+
+#define EFLAGS_IF 0x200    // interrupt enable flag
+
+// disable interrupts and return the previous EFLAGS
+static inline uint32_t irq_save(void) {
+    uint32_t flags;
+    __asm__ volatile("pushf\n\tpop %0\n\tcli" : "=r"(flags) : : "memory");
+    return flags;
+}
+
+// re-enable interrupts only if they were enabled in 'flags'
+static inline void irq_restore(uint32_t flags) {
+    if (flags & EFLAGS_IF) {
+        __asm__ volatile("sti" : : : "memory");
+    }
+}
+
+static inline void irq_disable(void) {
+    __asm__ volatile("cli" : : : "memory");
+}
+
+static inline void irq_enable(void) {
+    __asm__ volatile("sti" : : : "memory");
+}
+
+static inline bool irqs_enabled(void) {
+    uint32_t flags;
+    __asm__ volatile("pushf\n\tpop %0" : "=r"(flags));
+    return (flags & EFLAGS_IF) != 0;
+}
+
+// enable interrupts and halt until the next one arrives.
+// sti delays interrupt delivery by one instruction, so no wakeup
+// can slip in between the two.
+static inline void irq_enable_and_halt(void) {
+    __asm__ volatile("sti\n\thlt" : : : "memory");
+}
+
+// same for a monitor armed with cpu_monitor: sleep until an interrupt
+// or a write to the monitored line
+static inline void irq_enable_and_mwait(void) {
+    __asm__ volatile("sti\n\tmwait" : : "a"(0), "c"(0) : "memory");
+}
+
+#endif // IRQFLAGS_H
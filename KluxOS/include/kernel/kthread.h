@@ -0,0 +1,18 @@
+#ifndef KTHREAD_H
+#define KTHREAD_H
+
+#include <kernel/types.h>
+#include <kernel/process.h>
+
+// Kernel threads are processes that never leave ring 0. They share the
+// kernel address space and are scheduled like any other process.
+
+typedef void (*kthread_fn_t)(void* arg);
+
+// start fn(arg) in a new thread; returning from fn ends the thread
+process_t* kthread_create(const char* name, kthread_fn_t fn, void* arg);
+
+// end the calling thread
+void kthread_exit(void) __attribute__((noreturn));
+
+#endif // KTHREAD_H
@@ -0,0 +1,37 @@
+#ifndef LATBENCH_H
+#define LATBENCH_H
+
+#include <kernel/types.h>
+
+// Wakeup latency benchmark, in the spirit of cyclictest.
+//
+// A measuring thread sleeps on a one-tick timer over and over; the
+// timer callback stamps the time and wakes it, and the thread records
+// how long it took to run again. Meanwhile load threads keep every CPU
+// busy with long stretches of kernel work that only offer to reschedule
+// every LATBENCH_LOAD_CHUNK_US. The run is repeated with kernel
+// preemption off and on so the two maxima can be compared.
+
+#define LATBENCH_DEFAULT          200       // samples
+#define LATBENCH_MAX_LOAD         16        // load threads
+#define LATBENCH_LOAD_CHUNK_US    5000      // busy time between cond_resched calls
+#define LATBENCH_HIST_BUCKETS     8         // <1us, <10us, ... , >=1s
+
+typedef struct {
+    uint32_t samples;
+    uint32_t load_threads;
+    bool full_preempt;
+    uint32_t min_ns;
+    uint32_t avg_ns;
+    uint32_t max_ns;
+    uint32_t hist[LATBENCH_HIST_BUCKETS];   // by decade, starting below 1 us
+} latbench_result_t;
+
+int latbench_run(uint32_t samples, uint32_t load_threads, bool full_preempt,
+                 latbench_result_t* result);
+
+// measure with preemption off and on and print both; load 0 means two
+// load threads per online CPU
+void latbench(uint32_t samples, uint32_t load_threads);
+
+#endif // LATBENCH_H
@@ -0,0 +1,77 @@
+#ifndef LIST_H
+#define LIST_H
+
+#include <kernel/types.h>
+#include <libc/stddef.h>
+
+// Intrusive circular doubly linked list. The head is a sentinel node,
+// so insert and remove never need to walk the list.
+typedef struct list_node {
+    struct list_node* next;
+    struct list_node* prev;
+} list_node_t;
+
+#define LIST_HEAD_INIT(name) { &(name), &(name) }
+
+#define list_entry(ptr, type, member) \
+    ((type*)((char*)(ptr) - offsetof(type, member)))
+
+#define list_for_each(pos, head) \
+    for ((pos) = (head)->next; (pos) != (head); (pos) = (pos)->next)
+
+#define list_for_each_safe(pos, tmp, head) \
+    for ((pos) = (head)->next, (tmp) = (pos)->next; (pos) != (head); \
+         (pos) = (tmp), (tmp) = (pos)->next)
+
+static inline void list_init(list_node_t* head) {
+    head->next = head;
+    head->prev = head;
+}
+
+static inline bool list_empty(const list_node_t* head) {
+    return head->next == head;
+}
+
+static inline void list_insert_between(list_node_t* node, list_node_t* prev, list_node_t* next) {
+    next->prev = node;
+    node->next = next;
+    node->prev = prev;
+    prev->next = node;
+}
+
+// insert right after the head (stack order)
+static inline void list_add(list_node_t* head, list_node_t* node) {
+    list_insert_between(node, head, head->next);
+}
+
+// insert right before the head (queue order)
+static inline void list_add_tail(list_node_t* head, list_node_t* node) {
+    list_insert_between(node, head->prev, head);
+}
+
+// unlink the node and leave it pointing to itself, so a second
+// list_del or list_empty on the node is harmless
+static inline void list_del(list_node_t* node) {
+    node->prev->next = node->next;
+    node->next->prev = node->prev;
+    list_init(node);
+}
+
+// move every node of 'from' to the tail of 'to', leaving 'from' empty
+static inline void list_splice_tail_init(list_node_t* from, list_node_t* to) {
+    if (list_empty(from)) {
+        return;
+    }
+
+    list_node_t* first = from->next;
+    list_node_t* last = from->prev;
+
+    first->prev = to->prev;
+    to->prev->next = first;
+    last->next = to;
+    to->prev = last;
+
+    list_init(from);
+}
+
+#endif // LIST_H
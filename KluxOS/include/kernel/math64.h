@@ -0,0 +1,52 @@
+#ifndef MATH64_H
+#define MATH64_H
+
+#include <kernel/types.h>
+
+// 64-bit helpers for i386. The kernel is linked without libgcc, so
+// plain 64-bit '/' and '%' (which call __udivdi3/__umoddi3) must not
+// be used; go through these instead.
+
+// 64 / 32 division using two 32-bit divl steps
+static inline uint64_t div_u64_u32(uint64_t dividend, uint32_t divisor, uint32_t* remainder) {
+    uint32_t high = (uint32_t)(dividend >> 32);
+    uint32_t low = (uint32_t)dividend;
+    uint32_t quot_high = high / divisor;
+    uint32_t quot_low, rem;
+
+    high %= divisor;
+    __asm__("divl %4" : "=a"(quot_low), "=d"(rem) : "a"(low), "d"(high), "rm"(divisor));
+
+    if (remainder) {
+        *remainder = rem;
+    }
+    return ((uint64_t)quot_high << 32) | quot_low;
+}
+
+// (a * mul) >> shift without losing the upper bits, shift <= 32
+static inline uint64_t mul_u64_u32_shr(uint64_t a, uint32_t mul, uint32_t shift) {
+    uint32_t a_high = (uint32_t)(a >> 32);
+    uint32_t a_low = (uint32_t)a;
+    uint64_t result = ((uint64_t)a_low * mul) >> shift;
+
+    if (a_high) {
+        result += ((uint64_t)a_high * mul) << (32 - shift);
+    }
+    return result;
+}
+
+// index of the highest set bit, value must be non-zero
+static inline uint32_t fls32(uint32_t value) {
+    uint32_t index;
+    __asm__("bsrl %1, %0" : "=r"(index) : "rm"(value));
+    return index;
+}
+
+// index of the lowest clear bit, value must not be all ones
+static inline uint32_t ffz32(uint32_t value) {
+    uint32_t index;
+    __asm__("bsfl %1, %0" : "=r"(index) : "rm"(~value));
+    return index;
+}
+
+#endif // MATH64_H
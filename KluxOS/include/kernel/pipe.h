@@ -0,0 +1,107 @@
+#ifndef PIPE_H
+#define PIPE_H
+
+#include <kernel/types.h>
+#include <kernel/fs.h>
+#include <kernel/fdtable.h>
+#include <kernel/sync/mutex.h>
+#include <kernel/sync/wait.h>
+
+// Pipes.
+//
+// A pipe is a ring of page-sized buffers. Each buffer slot names a
+// reference counted frame (frame_ref) and the bytes of it that are
+// data, so a page can be handed from one pipe to another, or from the
+// page cache into a pipe, by taking a reference instead of copying.
+//
+// The ring has one producer and one consumer end. Readers serialize on
+// read_lock and own head and the offsets of the slots; writers serialize
+// on write_lock and own tail and the lengths. Neither end takes the
+// other's lock: a writer fills a slot and then publishes it by moving
+// tail, and keeps appending to the last slot it published while its
+// page has room. The reader never retires the last slot, so the page
+// the writer appends to cannot go away underneath it.
+//
+// Sleeping follows shm.h: a side that is about to sleep counts itself
+// in its sleepers field and checks again under the wait queue lock,
+// and the other side only takes that lock when sleepers is non-zero or
+// an epoll instance has hooked the queue (see kernel/epoll.h).
+//
+// Anonymous pipes come from pipe_create and are freed with their last
+// open end. Named pipes (mkfifo) are filesystem nodes of type FS_PIPE;
+// opening one blocks until the other end has been opened too, unless
+// O_NONBLOCK is given.
+
+#define PIPE_SLOTS        16            // pages of buffer per pipe, a power of two
+#define PIPE_BUF          4096          // a page; non-blocking writes up to this size are all or nothing
+
+#define PIPE_SLOT_MERGE   0x1           // page is the pipe's own, writers may append
+
+#define SPLICE_F_NONBLOCK 0x1           // splice/tee: do not sleep
+
+#define PIPE_PATH_MAX     256           // mkfifo path, with the terminator
+
+typedef struct pipe_slot {
+    uint32_t page;                // frame, seen at phys_to_virt(page)
+    volatile uint32_t offset;     // first unread byte, reader side
+    volatile uint32_t len;        // end of the data, writer side
+    uint32_t flags;               // PIPE_SLOT_*
+} pipe_slot_t;
+
+typedef struct pipe {
+    pipe_slot_t slots[PIPE_SLOTS];
+    volatile uint32_t head;       // oldest slot, free running
+    volatile uint32_t tail;       // next slot to publish, free running
+
+    mutex_t read_lock;
+    mutex_t write_lock;
+    wait_queue_t read_wait;       // readers waiting for data or the last writer
+    wait_queue_t write_wait;      // writers waiting for room or the last reader
+    volatile uint32_t read_sleepers;
+    volatile uint32_t write_sleepers;
+
+    spinlock_t lock;              // open counts
+    uint32_t readers;             // open read ends
+    uint32_t writers;             // open write ends
+    uint32_t reader_opens;        // ever, for fifo opens waiting on the other end
+    uint32_t writer_opens;
+
+    fs_node_t read_end;           // what descriptors point at
+    fs_node_t write_end;
+    fs_node_t* fifo;              // named pipe node, NULL if anonymous
+
+    uint32_t bytes;               // written into the pipe
+    uint32_t spliced;             // moved in or out by splice and tee
+    list_node_t node;             // all pipes, for pipe_dump
+} pipe_t;
+
+// new anonymous pipe, fds[0] reads and fds[1] writes; 0 on success
+int pipe_create(int fds[2]);
+
+// named pipe at path
+int pipe_mkfifo(const char* path);
+
+// open a named pipe node with O_RDONLY or O_WRONLY, returns the descriptor
+int pipe_open(fs_node_t* node, uint32_t flags);
+
+// read and write on a descriptor whose node is FS_PIPE
+int pipe_read(file_t* file, void* buf, uint32_t count);
+int pipe_write(file_t* file, const void* buf, uint32_t count);
+
+// move up to len bytes from fd_in to fd_out, one of them a pipe.
+// Pipe to pipe and file to pipe move page references; pipe to file
+// writes the pipe's pages into the file without a user buffer.
+int pipe_splice(int fd_in, int fd_out, uint32_t len, uint32_t flags);
+
+// like splice between two pipes, but the data also stays in fd_in
+int pipe_tee(int fd_in, int fd_out, uint32_t len, uint32_t flags);
+
+// there is data, or no writer is left to send any
+bool pipe_readable(pipe_t* pipe);
+
+// there is room, or no reader is left to take it
+bool pipe_writable(pipe_t* pipe);
+
+void pipe_dump(void);
+
+#endif // PIPE_H
@@ -2,6 +2,20 @@
 #define PROCESS_H
 
 #include <kernel/types.h>
+#include <kernel/list.h>
+#include <kernel/cpu/percpu.h>
+#include <kernel/sync/rwlock.h>
+
+struct fdtable;
+struct mm;
+struct ipc_waiter;
+
+#define PROCESS_KERNEL_STACK_SIZE 8192
+
+// PID 0 çekirdeğindir; boşa çıkan kimlikler bit haritasından yeniden verilir
+#define PID_MAX         4096
+#define PID_HASH_BITS   8
+#define PID_HASH_SIZE   (1 << PID_HASH_BITS)
 
 // İşlem durumları
 typedef enum {
@@ -26,27 +40,110 @@ typedef struct process {
     char name[32];                // İşlem adı
     process_state_t state;        // İşlem durumu
     process_context_t context;    // İşlem bağlamı
+    void* start_arg;              // Giriş fonksiyonunun argümanı
     void* kernel_stack;           // Çekirdek yığını
     uint32_t kernel_stack_size;   // Çekirdek yığını boyutu
     void* user_stack;             // Kullanıcı yığını
     uint32_t user_stack_size;     // Kullanıcı yığını boyutu
-    struct process* next;         // Sonraki işlem
+    struct fdtable* files;        // Açık dosya tanımlayıcıları
+    struct mm* mm;                // exec ile yüklenen programın adres alanı, çekirdek işlemlerinde NULL
+    uint32_t syscalls;            // Sistem çağrısı sayısı
+    uint32_t syscall_errors;      // Hata dönen çağrılar
+    uint64_t syscall_cycles;      // Çağrılarda geçen TSC döngüsü
+    uint32_t cpu;                 // En son çalıştığı / kuyruğunda beklediği işlemci
+    list_node_t run_node;         // İşlemci çalışma kuyruğundaki bağ
+    uint32_t last_ran;            // CPU'dan son ayrıldığı tick, önbellek sıcaklığı için
+    uint32_t migrations;          // İşlemciler arası taşınma sayısı
+    uint64_t exec_start_ns;       // CPU'ya son geçtiği an
+    uint64_t user_start_ns;       // Ring 3'e son girdiği an, in_user iken geçerli
+    uint64_t runtime_ns;          // Toplam CPU süresi
+    uint64_t user_ns;             // Bunun ring 3'te geçen kısmı
+    uint32_t in_user;             // user_enter içinde, sistem çağrısı dışında
+    uint32_t nvcsw;               // Gönüllü geçişler (bloke oldu, çıktı)
+    uint32_t nivcsw;              // Zorunlu geçişler (kesildi, yield)
+    uint32_t page_faults;         // Sayfa hataları
+    struct ipc_waiter* ipc_caller; // ipc_recv ile alınıp henüz yanıtlanmamış çağrı
+    volatile uint32_t killed;     // Bloke iken öldürüldü, sistem çağrısından dönerken çıkar
+    list_node_t task_node;        // Tüm işlemler listesindeki bağ
+    list_node_t pid_node;         // PID karma tablosundaki bağ
 } process_t;
 
-// Aktif işlemler listesi
-extern process_t* current_process;
-extern process_t* process_list;
+// Bu işlemcide çalışan işlem
+#define current_process (this_cpu()->current)
+
+// Aktif işlemler listesi, okurken tasklist_lock okuma kilidi alınır
+extern list_node_t task_list;
+extern rwlock_t tasklist_lock;
 
 // İşlem yönetim fonksiyonları
 void process_init(void);
 process_t* process_create(const char* name, void* entry_point);
+process_t* process_create_arg(const char* name, void* entry_point, void* arg);
 void process_terminate(process_t* process);
+void process_exit(void) __attribute__((noreturn));
 void process_switch(process_t* next);
 void process_schedule(void);
 process_t* process_get_current(void);
 
+// Şimdiye kadarki CPU süresi, çalışmakta olan dilim dahil (ns)
+void process_cputime(process_t* process, uint64_t* runtime_ns, uint64_t* user_ns);
+
+// Çalışan işlem ring 3'e giriyor / ring 3'ten çekirdeğe döndü
+void process_account_user_enter(void);
+void process_account_user_exit(void);
+
+// PID ile işlem bul; çağıran tasklist_lock okuma kilidini tutmalı
+process_t* process_find(uint32_t pid);
+
+// PID ile işlemi sonlandır, başarıda 0 döner. Bloke işlemin yığınını
+// bekleme kayıtları gösterir; o işaretlenip uyandırılır. Öldürülebilir
+// bir beklemedeyse bekleme -1 ile döner, işlem kayıtlarını çözer ve
+// sistem çağrısı dönüşünde kendi çıkar. Öldürülemez beklemeler
+// (mutex, semafor) uyanana kadar sürer.
+int process_kill(uint32_t pid);
+
+// Bekleme kuyrukları için: işlemi bloke et / tekrar hazır yap
+void process_block(process_t* process);
+void process_wake(process_t* process);
+
+// *done sıfırsa çalışan işlemi bloke et. Kontrol zamanlayıcı kilidi
+// altında yapılır; başka işlemcide *done'ı ayarlayıp process_wake
+// çağıran uyandırma kaybolmaz.
+void process_wait_event(volatile int* done);
+
+// Aynısı, ama işlem öldürülünce de döner. *done ayarlanmadan
+// öldürüldüyse -1, yoksa 0 döner; 0'da çağıran *done'a yeniden bakar.
+int process_wait_event_killable(volatile int* done);
+
+// Doğrudan geçiş (eşzamanlı IPC): çalışan işlem bloke olur ve bu
+// işlemcide bloke bekleyen next, çalışma kuyruğuna uğramadan hemen
+// çalışır. next başka işlemcideyse ya da bloke değilse hiçbir şey
+// yapılmaz ve false döner; çağıran o zaman process_wake'e düşer.
+// Çalışan işlem, process_wait_event'teki gibi, *done ayarlanıp
+// process_wake çağrılınca ya da kendisine yapılan bir geçişle yeniden
+// çalışır; *done zaten ayarlıysa bloke olmaz ve false döner.
+bool process_handoff(process_t* next, volatile int* done);
+
+// Uygulama işlemcisi: açılış yığınını boşta işlemine çevir ve çalıştır
+void process_idle_enter(cpu_t* cpu) __attribute__((noreturn));
+
+// Kesme çıkışında, EOI'den sonra çağrılır: gerekiyorsa işlem değiştir
+void process_preempt(void);
+
+// Çekirdek kodunun kesme çıkışında kesilmesini aç/kapat (varsayılan açık)
+void preempt_set_full(bool full);
+bool preempt_is_full(void);
+
 // Basit bir zamanlayıcı
 void scheduler_init(void);
+void scheduler_init_cpu(cpu_t* cpu);
 void scheduler_tick(void);
 
+// İşlemci başına kuyruk uzunluğu, kullanım ve taşınma sayıları
+void scheduler_stats_dump(void);
+
+// 1, 5 ve 15 dakikalık yük ortalamaları, LOADAVG_SHIFT bit kesirli
+#define LOADAVG_SHIFT 11
+void scheduler_loadavg(uint32_t loads[3]);
+
 #endif
@@ -0,0 +1,82 @@
+#ifndef SHM_H
+#define SHM_H
+
+#include <kernel/types.h>
+#include <kernel/sync/wait.h>
+
+// Shared memory objects.
+//
+// An object is a named set of page frames. Every process that maps it
+// sees the same frames, so a producer and a consumer exchange data by
+// writing and reading it in place, without the kernel copying a byte.
+// Programs loaded by exec get a private mapping in their own address
+// space; kernel threads use the object's kernel view, which is mapped
+// once when the object is created and is the same in every thread.
+//
+// Each mapping holds a reference on every frame (frame_ref). Removing
+// an object takes its name away and drops the object's own references;
+// the frames go back to the allocator when the last mapping is gone.
+// Every slot has its own fixed kernel view window, which the next object
+// in the slot reuses. Removing unmaps the view and shoots it down on
+// every CPU before the frames or the window can be handed out again.
+//
+// Notification is an event counter per object. shm_notify bumps the
+// counter and wakes sleepers, and costs one atomic increment when
+// nobody sleeps. shm_wait sleeps until the counter differs from the
+// value the caller last saw, so a notify between looking at the data
+// and going to sleep is never lost.
+
+#define SHM_MAX_OBJECTS   32
+#define SHM_NAME_MAX      32
+#define SHM_MAX_PAGES     64            // per object, frames come from page_alloc
+
+#define SHM_KERNEL_BASE   0xC0000000    // kernel views, one window per slot
+#define SHM_KERNEL_END    0xD0000000    // kernel stacks start here
+#define SHM_KERNEL_WINDOW (SHM_MAX_PAGES * 4096)
+
+#define SHM_CREATE        0x1           // shm_get: create if it does not exist
+#define SHM_EXCL          0x2           // ... and fail if it does
+
+typedef struct shm_object {
+    bool used;
+    bool removed;                 // no new lookups, waiters told to go
+    char name[SHM_NAME_MAX];
+    uint32_t size;                // bytes, whole pages
+    uint32_t pages;
+    uint32_t frames[SHM_MAX_PAGES];   // physical addresses
+    uint32_t gen;                 // bumped when the slot is reused, part of the id
+    void* kaddr;                  // kernel view
+    volatile uint32_t seq;        // notifications so far
+    volatile uint32_t sleepers;   // in shm_wait, notify skips the lock without them
+    uint32_t notifies;
+    uint32_t wakeups;             // shm_wait calls that had to sleep
+    wait_queue_t wq;
+} shm_object_t;
+
+// id of the object called name, created with size bytes under SHM_CREATE;
+// -1 on failure. The name must fit in SHM_NAME_MAX with its terminator.
+int shm_get(const char* name, uint32_t size, uint32_t flags);
+
+// map the object into the running process, returns its address there
+// (the kernel view for kernel threads) or NULL
+void* shm_map(int id);
+
+// undo shm_map; the kernel view cannot be unmapped
+int shm_unmap(void* addr);
+
+// take the name away; frames live on until the last unmap
+int shm_remove(int id);
+
+// bump the event counter and wake every waiter, returns the new count
+uint32_t shm_notify(int id);
+
+// current count, for the first shm_wait
+uint32_t shm_seq(int id);
+
+// sleep until the count is no longer seen; 0 then, -1 if the object
+// is removed
+int shm_wait(int id, uint32_t seen);
+
+void shm_dump(void);
+
+#endif // SHM_H
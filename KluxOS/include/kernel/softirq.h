@@ -0,0 +1,62 @@
+#ifndef SOFTIRQ_H
+#define SOFTIRQ_H
+
+#include <kernel/types.h>
+
+// Two-stage interrupt handling.
+//
+// A hardware handler (top half) only acknowledges the device, grabs
+// what it must and raises a softirq. Pending softirqs run on the way out
+// of the outermost interrupt, after EOI and with interrupts enabled, so
+// they never hold back other IRQs. If they keep getting raised, the rest
+// is handed to the ksoftirqd thread instead of starving processes.
+
+enum {
+    SOFTIRQ_TIMER = 0,       // timer wheel and tick callbacks
+    SOFTIRQ_INPUT,           // keyboard decoding
+    SOFTIRQ_NET_TX,
+    SOFTIRQ_NET_RX,
+    SOFTIRQ_RCU,             // callbacks whose grace period ended
+    NR_SOFTIRQS
+};
+
+#define SOFTIRQ_MAX_RESTART  10      // rounds on irq exit before deferring to ksoftirqd
+
+typedef void (*softirq_action_t)(void);
+
+typedef struct {
+    uint32_t raised;         // raise_softirq calls
+    uint32_t runs;           // action invocations
+    uint64_t cycles;         // total time in the action
+    uint32_t max_cycles;     // longest single run
+} softirq_stat_t;
+
+void softirq_init(void);
+
+// start the ksoftirqd thread, needs the process subsystem
+void softirq_start_thread(void);
+
+void open_softirq(uint32_t nr, softirq_action_t action);
+
+// mark a softirq pending; safe from any context
+void raise_softirq(uint32_t nr);
+
+// bracket a hardware interrupt; irq_exit runs pending softirqs
+void irq_enter(void);
+void irq_exit(void);
+
+// in a hardware handler or a softirq
+bool in_interrupt(void);
+bool in_softirq(void);
+
+// run pending softirqs now (interrupts get enabled while they run)
+void do_softirq(void);
+
+const softirq_stat_t* softirq_get_stat(uint32_t nr);
+const char* softirq_name(uint32_t nr);
+uint32_t softirq_deferred_count(void);
+
+// print the counters of every softirq
+void softirq_stats_dump(void);
+
+#endif // SOFTIRQ_H
@@ -0,0 +1,55 @@
+#ifndef LOCKSTAT_H
+#define LOCKSTAT_H
+
+#include <kernel/types.h>
+#include <kernel/cpu/cpu.h>
+
+// Lock contention profiling.
+//
+// A lock may name a class shared by every lock that protects the same
+// kind of data (all file descriptor tables, all run queues). While
+// profiling is switched on, each acquisition of a lock with a class
+// counts towards it: how often it was taken, how often the first
+// attempt failed, the cycles spent spinning and how long writers held
+// it. Locks without a class, and all locks while profiling is off, pay
+// one extra test on the fast path.
+//
+// A class registers itself on its first profiled acquisition.
+
+typedef struct lock_class {
+    const char* name;
+    volatile uint32_t busy;      // guards the counters below
+    bool registered;
+    uint32_t acquisitions;
+    uint32_t contended;          // first attempt found the lock taken
+    uint64_t spin_cycles;
+    uint32_t max_spin;
+    uint64_t hold_cycles;        // exclusive holders only
+    uint32_t holds;
+    uint32_t max_hold;
+    struct lock_class* next;
+} lock_class_t;
+
+#define LOCK_CLASS_INIT(class_name) { .name = (class_name) }
+
+extern volatile bool lockstat_enabled;
+
+static inline bool lockstat_active(const lock_class_t* cls) {
+    return cls && lockstat_enabled;
+}
+
+// cycle counter for spin and hold times, never 0 so it can mark "not timed"
+static inline uint32_t lockstat_now(void) {
+    return (uint32_t)rdtsc() | 1;
+}
+
+void lockstat_acquired(lock_class_t* cls, uint32_t spin_cycles, bool contended);
+void lockstat_released(lock_class_t* cls, uint32_t hold_cycles);
+
+void lockstat_enable(bool enable);
+void lockstat_reset(void);
+
+// print one line per registered class
+void lockstat_dump(void);
+
+#endif // LOCKSTAT_H
@@ -0,0 +1,49 @@
+#ifndef MUTEX_H
+#define MUTEX_H
+
+#include <kernel/types.h>
+#include <kernel/sync/wait.h>
+
+struct process;
+
+// Sleeping lock for process context.
+//
+// An uncontended lock and unlock are one atomic instruction each. A
+// contender first spins for a bounded time while the owner is running
+// on another CPU, since the owner is then likely to release it soon;
+// otherwise it sleeps on the wait queue and leaves the run queue.
+// Unlock hands the mutex directly to the oldest sleeper, so sleepers
+// get it in FIFO order and cannot be overtaken by a later arrival.
+//
+// Must not be taken from interrupt handlers or with a spinlock held.
+
+#define MUTEX_UNLOCKED     0
+#define MUTEX_LOCKED       1
+#define MUTEX_CONTENDED    2     // locked, and waiters may be queued
+
+#define MUTEX_SPIN_LIMIT   10000 // optimistic spin iterations before sleeping
+
+typedef struct mutex {
+    volatile uint32_t state;
+    struct process* volatile owner;
+    wait_queue_t waiters;
+    uint32_t spins;              // acquired while spinning on the owner
+    uint32_t sleeps;             // acquired after sleeping
+} mutex_t;
+
+#define MUTEX_INIT(name) { MUTEX_UNLOCKED, NULL, WAIT_QUEUE_INIT((name).waiters), 0, 0 }
+
+void mutex_init(mutex_t* mutex);
+
+void mutex_lock(mutex_t* mutex);
+
+// returns 1 if the mutex was taken
+int mutex_trylock(mutex_t* mutex);
+
+void mutex_unlock(mutex_t* mutex);
+
+static inline bool mutex_is_locked(const mutex_t* mutex) {
+    return mutex->state != MUTEX_UNLOCKED;
+}
+
+#endif // MUTEX_H
@@ -0,0 +1,64 @@
+#ifndef PREEMPT_H
+#define PREEMPT_H
+
+#include <kernel/types.h>
+
+// Kernel preemption control.
+//
+// A process can be switched out on interrupt exit wherever it is in the
+// kernel, except while the running CPU's preempt count is non-zero.
+// Every spinlock, ticket lock, reader-writer lock and RCU read-side
+// section raises the count, so a holder is never switched out while
+// another process could spin on its lock. A switch that was asked for
+// meanwhile happens when the count drops back to zero, or at the next
+// cond_resched() in code that runs long without holding locks.
+//
+// The count and the need_resched flag sit at fixed offsets in cpu_t so
+// this header does not need percpu.h, which itself needs spinlocks.
+
+#define PERCPU_PREEMPT_COUNT   4    // offsetof(cpu_t, preempt_count)
+#define PERCPU_NEED_RESCHED    8    // offsetof(cpu_t, need_resched)
+
+#define preempt_barrier() __asm__ volatile("" : : : "memory")
+
+// switch now if a reschedule is pending and it is safe to; out of line
+void preempt_schedule(void);
+
+static inline uint32_t preempt_count(void) {
+    uint32_t count;
+    __asm__ volatile("movl %%fs:%c1, %0" : "=r"(count) : "i"(PERCPU_PREEMPT_COUNT));
+    return count;
+}
+
+static inline bool preempt_resched_pending(void) {
+    uint32_t pending;
+    __asm__ volatile("movl %%fs:%c1, %0" : "=r"(pending) : "i"(PERCPU_NEED_RESCHED));
+    return pending != 0;
+}
+
+static inline void preempt_disable(void) {
+    __asm__ volatile("incl %%fs:%c0" : : "i"(PERCPU_PREEMPT_COUNT) : "memory", "cc");
+}
+
+// drop the count without looking for a pending switch, for paths that
+// still have interrupts off or are about to switch anyway
+static inline void preempt_enable_no_resched(void) {
+    __asm__ volatile("decl %%fs:%c0" : : "i"(PERCPU_PREEMPT_COUNT) : "memory", "cc");
+}
+
+static inline void preempt_enable(void) {
+    preempt_enable_no_resched();
+    if (preempt_resched_pending() && preempt_count() == 0) {
+        preempt_schedule();
+    }
+}
+
+// explicit preemption point for long loops outside any lock
+static inline void cond_resched(void) {
+    preempt_barrier();
+    if (preempt_resched_pending() && preempt_count() == 0) {
+        preempt_schedule();
+    }
+}
+
+#endif // PREEMPT_H
@@ -0,0 +1,70 @@
+#ifndef RCU_H
+#define RCU_H
+
+#include <kernel/types.h>
+#include <kernel/cpu/percpu.h>
+#include <kernel/sync/preempt.h>
+
+// Read-copy-update for read-mostly data.
+//
+// Readers bracket their access with rcu_read_lock/rcu_read_unlock,
+// which only bump a counter in the running CPU's record and keep the
+// CPU from being preempted; they take no lock and write no shared cache
+// line. Writers serialize among themselves, publish a new version with
+// rcu_assign_pointer and free the old one only after a grace period,
+// once every CPU has passed a quiescent state: a context switch, or a
+// scheduler tick that found no read-side section open on that CPU.
+//
+// Readers must not sleep. Callbacks queued with call_rcu run from the
+// RCU softirq.
+
+struct rcu_head;
+typedef void (*rcu_callback_t)(struct rcu_head* head);
+
+typedef struct rcu_head {
+    struct rcu_head* next;
+    rcu_callback_t func;
+} rcu_head_t;
+
+#define rcu_barrier_compiler() __asm__ volatile("" : : : "memory")
+
+static inline void rcu_read_lock(void) {
+    preempt_disable();
+    this_cpu_inc(rcu_nesting);
+    rcu_barrier_compiler();
+}
+
+static inline void rcu_read_unlock(void) {
+    rcu_barrier_compiler();
+    this_cpu_dec(rcu_nesting);
+    preempt_enable();
+}
+
+static inline bool rcu_read_lock_held(void) {
+    return this_cpu()->rcu_nesting != 0;
+}
+
+// x86 keeps stores in order and loads in order, so publishing and
+// reading a pointer only has to stop the compiler from reordering
+#define rcu_dereference(p) \
+    ({ __typeof__(p) _p = *(__typeof__(p) volatile*)&(p); rcu_barrier_compiler(); _p; })
+
+#define rcu_assign_pointer(p, v) \
+    do { rcu_barrier_compiler(); *(__typeof__(p) volatile*)&(p) = (v); } while (0)
+
+void rcu_init(void);
+
+// run func(head) after a grace period
+void call_rcu(rcu_head_t* head, rcu_callback_t func);
+
+// wait for a grace period; process context, outside any read-side section
+void synchronize_rcu(void);
+
+// quiescent state hooks, called by the scheduler
+void rcu_note_context_switch(cpu_t* cpu);
+void rcu_check_tick(cpu_t* cpu);
+
+// grace periods completed so far
+uint32_t rcu_completed(void);
+
+#endif // RCU_H
@@ -0,0 +1,134 @@
+#ifndef RWLOCK_H
+#define RWLOCK_H
+
+#include <kernel/types.h>
+#include <kernel/sync/spinlock.h>
+
+// Reader-writer spinlock for data that is read far more often than it
+// is changed.
+//
+// The low bits count the readers inside; RW_WRITER marks a writer
+// inside and RW_WAITING a writer waiting for the readers to drain. New
+// readers hold back while a writer waits, so a steady stream of readers
+// cannot starve writers. Readers must not take the lock recursively
+// when a writer may be waiting, and as with spinlock_t, locks also
+// taken from interrupt handlers need the _irqsave variants.
+
+#define RW_WRITER    0x80000000
+#define RW_WAITING   0x40000000
+
+typedef struct {
+    volatile uint32_t value;
+    lock_class_t* cls;
+    uint32_t held_since;         // writer only
+} rwlock_t;
+
+#define RWLOCK_INIT { .value = 0 }
+#define RWLOCK_INIT_CLASS(class_ptr) { .value = 0, .cls = (class_ptr) }
+
+static inline void rwlock_init(rwlock_t* lock) {
+    lock->value = 0;
+    lock->cls = NULL;
+    lock->held_since = 0;
+}
+
+static inline void rwlock_init_class(rwlock_t* lock, lock_class_t* cls) {
+    rwlock_init(lock);
+    lock->cls = cls;
+}
+
+static inline void read_lock(rwlock_t* lock) {
+    uint32_t start = lockstat_active(lock->cls) ? lockstat_now() : 0;
+    bool contended = false;
+
+    preempt_disable();
+
+    while (1) {
+        uint32_t value = lock->value;
+
+        if (!(value & (RW_WRITER | RW_WAITING)) &&
+            spin_cmpxchg(&lock->value, value, value + 1) == value) {
+            break;
+        }
+        contended = true;
+        cpu_relax();
+    }
+
+    if (start) {
+        lockstat_acquired(lock->cls, contended ? lockstat_now() - start : 0, contended);
+    }
+}
+
+static inline void read_unlock(rwlock_t* lock) {
+    __asm__ volatile("lock decl %0" : "+m"(lock->value) : : "memory");
+    preempt_enable();
+}
+
+static inline void write_lock(rwlock_t* lock) {
+    uint32_t start = lockstat_active(lock->cls) ? lockstat_now() : 0;
+    bool contended = false;
+
+    preempt_disable();
+
+    while (1) {
+        uint32_t value = lock->value;
+
+        // free apart from other waiting writers: take it, clearing the mark
+        if ((value & ~RW_WAITING) == 0) {
+            if (spin_cmpxchg(&lock->value, value, RW_WRITER) == value) {
+                break;
+            }
+            continue;
+        }
+
+        if (!(value & RW_WAITING)) {
+            __asm__ volatile("lock orl %1, %0" : "+m"(lock->value) : "i"(RW_WAITING) : "memory");
+        }
+        contended = true;
+        cpu_relax();
+    }
+
+    if (start) {
+        lock->held_since = lockstat_now();
+        lockstat_acquired(lock->cls, contended ? lock->held_since - start : 0, contended);
+    }
+}
+
+static inline void write_unlock(rwlock_t* lock) {
+    uint32_t since = lock->held_since;
+
+    if (since) {
+        lock->held_since = 0;
+        lockstat_released(lock->cls, lockstat_now() - since);
+    }
+
+    // keep RW_WAITING set by writers that queued up meanwhile
+    __asm__ volatile("lock andl %1, %0" : "+m"(lock->value) : "i"(~RW_WRITER) : "memory");
+    preempt_enable();
+}
+
+static inline uint32_t read_lock_irqsave(rwlock_t* lock) {
+    uint32_t flags = irq_save();
+    read_lock(lock);
+    return flags;
+}
+
+static inline void read_unlock_irqrestore(rwlock_t* lock, uint32_t flags) {
+    read_unlock(lock);
+    irq_restore(flags);
+    cond_resched();
+}
+
+static inline uint32_t write_lock_irqsave(rwlock_t* lock) {
+    uint32_t flags = irq_save();
+    write_lock(lock);
+    return flags;
+}
+
+static inline void write_unlock_irqrestore(rwlock_t* lock, uint32_t flags) {
+    write_unlock(lock);
+    irq_restore(flags);
+    cond_resched();
+}
+
+#endif // RWLOCK_H
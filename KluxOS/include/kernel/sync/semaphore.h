@@ -0,0 +1,33 @@
+#ifndef SEMAPHORE_H
+#define SEMAPHORE_H
+
+#include <kernel/types.h>
+#include <kernel/sync/wait.h>
+
+// Counting semaphore.
+//
+// down takes a unit or sleeps until one is available; up passes its
+// unit straight to the oldest sleeper, if any, so sleepers are served
+// in FIFO order. up may be called from interrupt handlers, down and
+// down_timeout only from process context.
+
+typedef struct semaphore {
+    int32_t count;               // units available, guarded by waiters.lock
+    wait_queue_t waiters;
+} semaphore_t;
+
+#define SEMAPHORE_INIT(name, n) { (n), WAIT_QUEUE_INIT((name).waiters) }
+
+void sema_init(semaphore_t* sem, int32_t count);
+
+void down(semaphore_t* sem);
+
+// returns 1 if a unit was taken without sleeping
+int down_trylock(semaphore_t* sem);
+
+// returns 0 once a unit was taken, -1 if ms milliseconds passed first
+int down_timeout(semaphore_t* sem, uint32_t ms);
+
+void up(semaphore_t* sem);
+
+#endif // SEMAPHORE_H
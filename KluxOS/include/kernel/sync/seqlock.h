@@ -0,0 +1,47 @@
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#include <kernel/types.h>
+
+// Sequence counter for data that is written rarely and read often.
+// The writer makes the count odd while it updates; readers retry when
+// they saw an odd count or the count changed under them. Readers never
+// block the writer and never see a torn 64-bit value.
+//
+// Writers must be serialized by the caller (interrupts off or a lock).
+
+typedef struct {
+    volatile uint32_t sequence;
+} seqcount_t;
+
+#define SEQCOUNT_INIT { 0 }
+
+#define seq_barrier() __asm__ volatile("" : : : "memory")
+
+static inline uint32_t read_seqbegin(const seqcount_t* s) {
+    uint32_t seq;
+
+    do {
+        seq = s->sequence;
+    } while (seq & 1);
+
+    seq_barrier();
+    return seq;
+}
+
+static inline bool read_seqretry(const seqcount_t* s, uint32_t start) {
+    seq_barrier();
+    return s->sequence != start;
+}
+
+static inline void write_seqbegin(seqcount_t* s) {
+    s->sequence++;
+    seq_barrier();
+}
+
+static inline void write_seqend(seqcount_t* s) {
+    seq_barrier();
+    s->sequence++;
+}
+
+#endif // SEQLOCK_H
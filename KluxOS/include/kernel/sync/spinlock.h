@@ -0,0 +1,131 @@
+#ifndef SPINLOCK_H
+#define SPINLOCK_H
+
+#include <kernel/types.h>
+#include <kernel/irqflags.h>
+#include <kernel/cpu/cpu.h>
+#include <kernel/sync/lockstat.h>
+#include <kernel/sync/preempt.h>
+
+// Busy-waiting lock for short critical sections shared between CPUs.
+//
+// Waiters spin on a plain read and only retry the atomic exchange once
+// the lock looks free, so the cache line is not bounced while it is
+// held. Code that can also run from an interrupt handler must use the
+// _irqsave variants, otherwise the handler can spin on a lock held by
+// the code it interrupted. Holding any lock disables preemption.
+
+typedef struct {
+    volatile uint32_t locked;
+    lock_class_t* cls;           // contention profiling, may be NULL
+    uint32_t held_since;         // lockstat_now() when profiled, else 0
+} spinlock_t;
+
+#define SPINLOCK_INIT { 0 }
+#define SPINLOCK_INIT_CLASS(class_ptr) { .locked = 0, .cls = (class_ptr) }
+
+static inline void spin_lock_init(spinlock_t* lock) {
+    lock->locked = 0;
+    lock->cls = NULL;
+    lock->held_since = 0;
+}
+
+static inline void spin_lock_init_class(spinlock_t* lock, lock_class_t* cls) {
+    spin_lock_init(lock);
+    lock->cls = cls;
+}
+
+static inline uint32_t spin_xchg(volatile uint32_t* addr, uint32_t value) {
+    __asm__ volatile("xchgl %0, %1" : "+r"(value), "+m"(*addr) : : "memory");
+    return value;
+}
+
+// returns the value found at addr; the swap happened if it equals old
+static inline uint32_t spin_cmpxchg(volatile uint32_t* addr, uint32_t old, uint32_t value) {
+    uint32_t prev;
+    __asm__ volatile("lock cmpxchgl %2, %1"
+                     : "=a"(prev), "+m"(*addr)
+                     : "r"(value), "0"(old)
+                     : "memory");
+    return prev;
+}
+
+static inline void spin_lock_raw(spinlock_t* lock) {
+    while (spin_xchg(&lock->locked, 1)) {
+        while (lock->locked) {
+            cpu_relax();
+        }
+    }
+}
+
+static inline void spin_lock(spinlock_t* lock) {
+    preempt_disable();
+
+    if (!lockstat_active(lock->cls)) {
+        spin_lock_raw(lock);
+        return;
+    }
+
+    uint32_t start = lockstat_now();
+    bool contended = spin_xchg(&lock->locked, 1) != 0;
+    if (contended) {
+        spin_lock_raw(lock);
+    }
+
+    lock->held_since = lockstat_now();
+    lockstat_acquired(lock->cls, contended ? lock->held_since - start : 0, contended);
+}
+
+static inline int spin_trylock(spinlock_t* lock) {
+    preempt_disable();
+
+    if (spin_xchg(&lock->locked, 1) != 0) {
+        preempt_enable_no_resched();
+        return 0;
+    }
+
+    if (lockstat_active(lock->cls)) {
+        lock->held_since = lockstat_now();
+        lockstat_acquired(lock->cls, 0, false);
+    }
+    return 1;
+}
+
+// release without the preemption check, for spin_unlock_irqrestore
+static inline void spin_unlock_no_resched(spinlock_t* lock) {
+    uint32_t since = lock->held_since;
+
+    if (since) {
+        lock->held_since = 0;
+        lockstat_released(lock->cls, lockstat_now() - since);
+    }
+
+    // x86 does not reorder stores with older loads or stores
+    __asm__ volatile("" : : : "memory");
+    lock->locked = 0;
+    preempt_enable_no_resched();
+}
+
+static inline void spin_unlock(spinlock_t* lock) {
+    spin_unlock_no_resched(lock);
+    cond_resched();
+}
+
+static inline int spin_is_locked(const spinlock_t* lock) {
+    return lock->locked != 0;
+}
+
+static inline uint32_t spin_lock_irqsave(spinlock_t* lock) {
+    uint32_t flags = irq_save();
+    spin_lock(lock);
+    return flags;
+}
+
+// the pending switch is only possible once interrupts are back on
+static inline void spin_unlock_irqrestore(spinlock_t* lock, uint32_t flags) {
+    spin_unlock_no_resched(lock);
+    irq_restore(flags);
+    cond_resched();
+}
+
+#endif // SPINLOCK_H
@@ -0,0 +1,116 @@
+#ifndef TICKETLOCK_H
+#define TICKETLOCK_H
+
+#include <kernel/types.h>
+#include <kernel/sync/spinlock.h>
+
+// Fair spinlock: each waiter draws a ticket and is served in order.
+//
+// The high half of the word is the next ticket to hand out, the low
+// half the ticket being served. Drawing a ticket is one locked xadd;
+// only the holder writes the low half, so the release is a plain
+// increment. Unlike spinlock_t a waiter cannot be overtaken forever by
+// a CPU that keeps retaking the lock, at the cost of every waiter
+// watching the same word.
+
+typedef struct {
+    union {
+        volatile uint32_t value;
+        struct {
+            volatile uint16_t owner;     // ticket being served
+            volatile uint16_t next;      // next ticket to hand out
+        } tickets;
+    };
+    lock_class_t* cls;
+    uint32_t held_since;
+} ticketlock_t;
+
+#define TICKETLOCK_INIT { .value = 0 }
+#define TICKETLOCK_INIT_CLASS(class_ptr) { .value = 0, .cls = (class_ptr) }
+
+static inline void ticket_lock_init(ticketlock_t* lock) {
+    lock->value = 0;
+    lock->cls = NULL;
+    lock->held_since = 0;
+}
+
+static inline void ticket_lock_init_class(ticketlock_t* lock, lock_class_t* cls) {
+    ticket_lock_init(lock);
+    lock->cls = cls;
+}
+
+static inline void ticket_lock(ticketlock_t* lock) {
+    uint32_t value = 1 << 16;
+    uint32_t start = 0;
+
+    preempt_disable();
+
+    if (lockstat_active(lock->cls)) {
+        start = lockstat_now();
+    }
+
+    __asm__ volatile("lock xaddl %0, %1" : "+r"(value), "+m"(lock->value) : : "memory");
+
+    uint16_t ticket = (uint16_t)(value >> 16);
+    bool contended = (uint16_t)value != ticket;
+
+    while (lock->tickets.owner != ticket) {
+        cpu_relax();
+    }
+
+    if (start) {
+        lock->held_since = lockstat_now();
+        lockstat_acquired(lock->cls, contended ? lock->held_since - start : 0, contended);
+    }
+}
+
+static inline int ticket_trylock(ticketlock_t* lock) {
+    uint32_t value = lock->value;
+
+    if ((uint16_t)value != (uint16_t)(value >> 16)) {
+        return 0;
+    }
+    preempt_disable();
+    if (spin_cmpxchg(&lock->value, value, value + (1 << 16)) != value) {
+        preempt_enable_no_resched();
+        return 0;
+    }
+
+    if (lockstat_active(lock->cls)) {
+        lock->held_since = lockstat_now();
+        lockstat_acquired(lock->cls, 0, false);
+    }
+    return 1;
+}
+
+static inline void ticket_unlock(ticketlock_t* lock) {
+    uint32_t since = lock->held_since;
+
+    if (since) {
+        lock->held_since = 0;
+        lockstat_released(lock->cls, lockstat_now() - since);
+    }
+
+    __asm__ volatile("" : : : "memory");
+    lock->tickets.owner++;
+    preempt_enable();
+}
+
+static inline int ticket_is_locked(const ticketlock_t* lock) {
+    uint32_t value = lock->value;
+    return (uint16_t)value != (uint16_t)(value >> 16);
+}
+
+static inline uint32_t ticket_lock_irqsave(ticketlock_t* lock) {
+    uint32_t flags = irq_save();
+    ticket_lock(lock);
+    return flags;
+}
+
+static inline void ticket_unlock_irqrestore(ticketlock_t* lock, uint32_t flags) {
+    ticket_unlock(lock);
+    irq_restore(flags);
+    cond_resched();
+}
+
+#endif // TICKETLOCK_H
@@ -0,0 +1,73 @@
+#ifndef WAIT_H
+#define WAIT_H
+
+#include <kernel/types.h>
+#include <kernel/list.h>
+#include <kernel/sync/spinlock.h>
+
+struct process;
+struct wait_entry;
+struct wait_queue;
+
+// optional wake callback; when set it runs instead of waking the process
+typedef void (*wait_func_t)(struct wait_entry* entry);
+
+// one waiter, usually on the waiting process's stack
+typedef struct wait_entry {
+    list_node_t node;             // link in wait_queue_t.waiters
+    struct wait_queue* queue;     // queue the entry was added to
+    struct process* process;      // process to wake (NULL before process_init)
+    wait_func_t func;             // custom wake callback
+    void* data;                   // callback data
+    bool keep;                    // callback entry that stays queued when woken
+    volatile int woken;           // set once the entry has been woken
+} wait_entry_t;
+
+typedef struct wait_queue {
+    spinlock_t lock;
+    list_node_t waiters;          // FIFO list of wait_entry_t
+} wait_queue_t;
+
+#define WAIT_QUEUE_INIT(name) { SPINLOCK_INIT, LIST_HEAD_INIT((name).waiters) }
+
+void wait_queue_init(wait_queue_t* wq);
+void wait_entry_init(wait_entry_t* entry);
+
+void wait_queue_add(wait_queue_t* wq, wait_entry_t* entry);
+void wait_queue_remove(wait_queue_t* wq, wait_entry_t* entry);
+
+// block the current process until the entry is woken
+void wait_entry_block(wait_entry_t* entry);
+
+// the same, but give up when the process is killed: 0 once woken, -1
+// if killed first. The entry may then still be queued; take it off
+// before it goes out of scope.
+int wait_entry_block_killable(wait_entry_t* entry);
+
+// enqueue the current process and block until woken
+void wait_queue_sleep(wait_queue_t* wq);
+
+// wake a single entry (it is removed from its queue unless keep is set)
+void wait_entry_wake(wait_entry_t* entry);
+
+// wake the oldest waiter / every waiter, return the number woken. Kept
+// callback entries are run on the way but not counted, so a wake_one
+// still reaches one sleeping process.
+int wait_queue_wake_one(wait_queue_t* wq);
+int wait_queue_wake_all(wait_queue_t* wq);
+
+// anyone queued; unlocked, pair with a barrier after the state change
+static inline bool wait_queue_active(wait_queue_t* wq) {
+    return !list_empty(&wq->waiters);
+}
+
+// variants for callers that hold wq->lock with interrupts off, so the
+// check that decides to sleep or wake is atomic with the queue change
+void wait_queue_add_locked(wait_queue_t* wq, wait_entry_t* entry);
+int wait_queue_wake_one_locked(wait_queue_t* wq);
+void wait_entry_wake_locked(wait_entry_t* entry);
+
+// oldest waiter without removing it, NULL if none; lock held
+wait_entry_t* wait_queue_first_locked(wait_queue_t* wq);
+
+#endif // WAIT_H
@@ -2,6 +2,8 @@
 #define SYSCALL_H
 
 #include <kernel/types.h>
+#include <kernel/ipc.h>
+#include <kernel/epoll.h>
 
 // Sistem çağrı numaraları
 enum {
@@ -16,12 +18,64 @@ enum {
     SYS_GETPID = 9,
     SYS_SLEEP = 10,
     SYS_MALLOC = 11,
-    SYS_FREE = 12
+    SYS_FREE = 12,
+    SYS_CLOCK_GETTIME = 13,
+    SYS_NOP = 14,
+    SYS_URING_SETUP = 15,
+    SYS_URING_ENTER = 16,
+    SYS_DUP = 17,
+    SYS_DUP2 = 18,
+    SYS_FUTEX_WAIT = 19,
+    SYS_FUTEX_WAKE = 20,
+    SYS_SHM_GET = 21,
+    SYS_SHM_MAP = 22,
+    SYS_SHM_UNMAP = 23,
+    SYS_SHM_REMOVE = 24,
+    SYS_SHM_NOTIFY = 25,
+    SYS_SHM_WAIT = 26,
+    SYS_PIPE = 27,
+    SYS_MKFIFO = 28,
+    SYS_SPLICE = 29,
+    SYS_TEE = 30,
+
+    // ring 3'ten user_enter çağıranına dönüş, giriş kodunda işlenir
+    SYS_USER_RETURN = 31,
+
+    SYS_IPC_CREATE = 32,
+    SYS_IPC_DESTROY = 33,
+    SYS_IPC_CALL = 34,
+    SYS_IPC_RECV = 35,
+    SYS_IPC_REPLY = 36,
+    SYS_IPC_REPLY_RECV = 37,
+    SYS_EPOLL_CREATE = 38,
+    SYS_EPOLL_CTL = 39,
+    SYS_EPOLL_WAIT = 40,
+    SYS_URING_DESTROY = 41
 };
 
-// Sistem çağrı işleyicisi
+#define SYSCALL_MAX 48
+
+// Çağrı numarası eax, argümanlar ebx, ecx, edx, esi, edi, ebp
+// yazmaçlarında gelir; dönüş değeri eax'e yazılır.
+typedef uint32_t (*syscall_fn_t)(uint32_t, uint32_t, uint32_t,
+                                 uint32_t, uint32_t, uint32_t);
+
+// int 0x80 ve sysenter girişlerinin ortak dağıtıcısı
+uint32_t syscall_dispatch(uint32_t num, uint32_t arg1, uint32_t arg2, uint32_t arg3,
+                          uint32_t arg4, uint32_t arg5, uint32_t arg6);
+
+// Çağrı adı, izleme çıktısı için
+const char* syscall_name(uint32_t num);
+
+// Sistem çağrı işleyicisi (eski üç argümanlı arayüz)
 void syscall_handler(uint32_t syscall_num, uint32_t arg1, uint32_t arg2, uint32_t arg3);
 
+// İşlem değişiminde ring 0 yığınını ayarla (TSS esp0, sysenter de kullanır)
+void syscall_set_kernel_stack(uint32_t esp);
+
+// sysenter/sysexit kullanılabiliyor mu
+bool syscall_sysenter_enabled(void);
+
 // Sistem çağrı fonksiyonları
 void syscall_exit(int status);
 int syscall_fork(void);
@@ -29,14 +83,60 @@ size_t syscall_read(int fd, void* buf, size_t count);
 size_t syscall_write(int fd, const void* buf, size_t count);
 int syscall_open(const char* pathname, int flags);
 int syscall_close(int fd);
+int syscall_dup(int oldfd);
+int syscall_dup2(int oldfd, int newfd);
 int syscall_exec(const char* path, char* const argv[]);
 uint32_t syscall_time(void);
+int syscall_clock_gettime(uint64_t* ns);
 uint32_t syscall_getpid(void);
 void syscall_sleep(uint32_t ms);
 void* syscall_malloc(size_t size);
 void syscall_free(void* ptr);
+int syscall_nop(void);
+
+// Toplu çağrılar için gönderim/tamamlama halkaları, bkz. kernel/uring.h
+int syscall_uring_setup(uint32_t entries, void** ring);
+int syscall_uring_enter(int id, uint32_t to_submit, uint32_t min_complete);
+int syscall_uring_destroy(int id);
+
+// Kullanıcı alanı kilitleri için bekleme/uyandırma, bkz. kernel/futex.h
+int syscall_futex_wait(uint32_t* uaddr, uint32_t val);
+int syscall_futex_wake(uint32_t* uaddr, uint32_t count);
+
+// Kopyasız paylaşımlı bellek ve olay sayacı, bkz. kernel/shm.h
+int syscall_shm_get(const char* name, uint32_t size, uint32_t flags);
+void* syscall_shm_map(int id);
+int syscall_shm_unmap(void* addr);
+int syscall_shm_remove(int id);
+uint32_t syscall_shm_notify(int id);
+int syscall_shm_wait(int id, uint32_t seen);
+
+// Boru ve adlandırılmış borular; splice/tee sayfaları kopyalamadan
+// taşır, bkz. kernel/pipe.h
+int syscall_pipe(int fds[2]);
+int syscall_mkfifo(const char* path);
+int syscall_splice(int fd_in, int fd_out, uint32_t len, uint32_t flags);
+int syscall_tee(int fd_in, int fd_out, uint32_t len, uint32_t flags);
+
+// Eşzamanlı mesajlaşma; alıcı bekliyorsa çalıştırma kuyruğuna
+// uğramadan doğrudan ona geçilir, bkz. kernel/ipc.h
+int syscall_ipc_create(void);
+int syscall_ipc_destroy(int id);
+int syscall_ipc_call(int id, ipc_msg_t* msg);
+int syscall_ipc_recv(int id, ipc_msg_t* msg);
+int syscall_ipc_reply(const ipc_msg_t* msg);
+int syscall_ipc_reply_recv(int id, ipc_msg_t* msg);
+
+// Birden çok tanımlayıcıyı bekleme; yalnızca hazır olanlar döner,
+// bkz. kernel/epoll.h
+int syscall_epoll_create(void);
+int syscall_epoll_ctl(int epfd, int op, int fd, const epoll_event_t* event);
+int syscall_epoll_wait(int epfd, epoll_event_t* events, uint32_t max, int timeout_ms);
 
 // Sistem çağrıları başlatma
 void init_syscalls(void);
 
+// Uygulama işlemcisinde sysenter MSR'larını ayarla
+void syscall_init_cpu(void);
+
 #endif
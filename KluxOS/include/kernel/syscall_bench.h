@@ -0,0 +1,25 @@
+#ifndef SYSCALL_BENCH_H
+#define SYSCALL_BENCH_H
+
+#include <kernel/types.h>
+
+// Null system call benchmark: runs SYS_NOP from ring 3 through int 0x80
+// and through the vDSO entry (sysenter) and prints cycles per call.
+
+#define SYSCALL_BENCH_CODE_ADDR   0xBFFFD000   // user copy of the loops
+#define SYSCALL_BENCH_STACK_ADDR  0xBFFFC000   // user stack page
+#define SYSCALL_BENCH_DEFAULT     100000
+
+typedef struct {
+    uint64_t int80_cycles;      // total for all iterations
+    uint64_t vdso_cycles;
+    uint32_t iterations;
+    bool sysenter;              // vDSO entry used sysenter
+} syscall_bench_result_t;
+
+int syscall_bench_run(uint32_t iterations, syscall_bench_result_t* result);
+
+// run and print the result
+void syscall_bench(uint32_t iterations);
+
+#endif // SYSCALL_BENCH_H
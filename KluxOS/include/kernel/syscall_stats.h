@@ -0,0 +1,65 @@
+#ifndef SYSCALL_STATS_H
+#define SYSCALL_STATS_H
+
+#include <kernel/types.h>
+#include <kernel/syscall.h>
+
+// System call instrumentation.
+//
+// Every dispatched call updates a per-number record: call and error
+// counts and a log2 histogram of its duration in TSC cycles (bucket n
+// holds durations in [2^n, 2^(n+1))). Per-process totals live in
+// process_t. Optionally each call is also logged to a ring buffer of
+// events that overwrites the oldest entries when full.
+
+#define SYSCALL_HIST_BUCKETS   32
+#define SYSCALL_TRACE_SIZE     256      // events, power of two
+
+typedef struct {
+    uint32_t calls;
+    uint32_t errors;         // calls that returned -1
+    uint64_t cycles;         // total time spent
+    uint32_t max_cycles;
+    uint32_t hist[SYSCALL_HIST_BUCKETS];
+} syscall_stat_t;
+
+typedef struct {
+    uint64_t tsc;            // entry time
+    uint32_t pid;
+    uint32_t nr;
+    uint32_t args[6];
+    uint32_t ret;
+    uint32_t cycles;
+} syscall_event_t;
+
+void syscall_stats_init(void);
+
+// account one call, done by syscall_dispatch
+void syscall_stats_record(uint32_t nr, const uint32_t* args, uint32_t ret,
+                          uint64_t start, uint64_t cycles);
+
+// call of an unknown number
+void syscall_stats_invalid(void);
+
+const syscall_stat_t* syscall_stats_get(uint32_t nr);
+uint32_t syscall_stats_invalid_count(void);
+void syscall_stats_reset(void);
+
+// event ring buffer
+void syscall_trace_enable(bool enable);
+bool syscall_trace_enabled(void);
+
+// copy up to max events, oldest first; returns the number copied and
+// the number overwritten before they could be read in *lost
+uint32_t syscall_trace_read(syscall_event_t* events, uint32_t max, uint32_t* lost);
+
+// print one line per call that was used
+void syscall_stats_dump(void);
+
+// print the latency histogram of one call
+void syscall_stats_dump_hist(uint32_t nr);
+
+// print the buffered events and consume them
+void syscall_trace_dump(void);
+
+#endif // SYSCALL_STATS_H
@@ -0,0 +1,44 @@
+#ifndef TASKSTATS_H
+#define TASKSTATS_H
+
+#include <kernel/types.h>
+#include <kernel/process.h>
+
+// Per-process resource usage.
+//
+// The scheduler charges CPU time at every context switch from the
+// monotonic clock, so a process is billed for exactly the time it held
+// a CPU rather than for whole ticks. Time between user_enter and the
+// return to the kernel is user time, everything else (including system
+// calls made from ring 3) is system time. A snapshot copies the counters
+// of every process on the task list; top compares two snapshots taken
+// an interval apart to get each process' share of a CPU.
+
+#define TASKSTATS_MAX   128     // processes shown per snapshot
+
+typedef struct {
+    uint32_t pid;
+    char name[32];
+    process_state_t state;
+    uint32_t cpu;
+    uint64_t runtime_ns;
+    uint64_t user_ns;
+    uint32_t nvcsw;
+    uint32_t nivcsw;
+    uint32_t page_faults;
+    uint32_t syscalls;
+} task_usage_t;
+
+// copy the usage of up to max processes, returns how many were copied
+uint32_t taskstats_snapshot(task_usage_t* out, uint32_t max);
+
+// cumulative usage of every process (ps)
+void taskstats_dump(void);
+
+// take the baseline sample for top
+void taskstats_top_begin(void);
+
+// sample again and draw one screen sorted by CPU share since the last call
+void taskstats_top_frame(void);
+
+#endif // TASKSTATS_H
@@ -0,0 +1,49 @@
+#ifndef CLOCKSOURCE_H
+#define CLOCKSOURCE_H
+
+#include <kernel/types.h>
+#include <kernel/sync/seqlock.h>
+
+#define NSEC_PER_SEC   1000000000u
+#define NSEC_PER_MSEC  1000000u
+#define NSEC_PER_USEC  1000u
+
+#define CLOCKSOURCE_CALIBRATE_MS   10   // length of one PIT calibration window
+#define CLOCKSOURCE_CALIBRATE_RUNS 3    // best of N windows
+
+typedef enum {
+    CLOCKSOURCE_TICK,        // PIT ticks only
+    CLOCKSOURCE_TSC          // TSC calibrated against the PIT
+} clocksource_type_t;
+
+// Everything a reader needs to turn a TSC value into monotonic time.
+// Guarded by 'seq'; the writer is the timer interrupt.
+typedef struct {
+    seqcount_t seq;
+    uint32_t type;           // clocksource_type_t
+    uint32_t mult;           // ns = (cycles * mult) >> shift
+    uint32_t shift;
+    uint32_t tsc_khz;        // calibrated TSC frequency
+    uint64_t base_cycles;    // TSC value at base_ns
+    uint64_t base_ns;        // monotonic time at base_cycles
+    uint64_t tick_ns;        // monotonic time of the last tick
+    uint32_t ticks;          // PIT ticks since boot
+    uint32_t tick_hz;        // PIT frequency
+} clock_data_t;
+
+// calibrate the TSC against PIT channel 2, called by pit_init
+void clocksource_init(uint32_t tick_hz);
+
+// advance tick time, called from the PIT interrupt
+void clocksource_tick(void);
+
+// nanoseconds since boot, TSC resolution when available
+uint64_t clock_monotonic_ns(void);
+
+// convert a TSC cycle delta to nanoseconds
+uint64_t clocksource_cycles_to_ns(uint64_t cycles);
+
+clocksource_type_t clocksource_type(void);
+uint32_t clocksource_tsc_khz(void);
+
+#endif // CLOCKSOURCE_H
@@ -51,13 +51,17 @@ uint32_t get_ticks(void);
 
 
 uint64_t get_uptime_ms(void);
+uint32_t ms_to_ticks(uint32_t ms);
+
+// blocks the calling process on the timer wheel, no busy waiting
 void sleep_ms(uint32_t ms);
 
 
 typedef void (*timer_callback_t)(void);
 
+#define MAX_TIMER_CALLBACKS 16   // per-tick callbacks, use ktimer_t for one-shot work
 
-void register_timer_callback(timer_callback_t callback);
+int register_timer_callback(timer_callback_t callback);
 
 timer_info_t* get_timer_info(void);
 
@@ -0,0 +1,59 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <kernel/types.h>
+#include <kernel/list.h>
+
+// Hierarchical timer wheel.
+//
+// Level 0 has 256 slots of one tick each, levels 1-4 have 64 slots that
+// each cover 64 times the span of a slot one level down, so any 32-bit
+// expiry fits without a sorted list. Timers are cascaded one level down
+// when level 0 wraps. Insert and cancel are O(1).
+
+#define TIMER_WHEEL_ROOT_BITS   8
+#define TIMER_WHEEL_LEVEL_BITS  6
+#define TIMER_WHEEL_ROOT_SIZE   (1 << TIMER_WHEEL_ROOT_BITS)
+#define TIMER_WHEEL_LEVEL_SIZE  (1 << TIMER_WHEEL_LEVEL_BITS)
+#define TIMER_WHEEL_LEVELS      4     // levels above the root
+
+typedef void (*ktimer_func_t)(void* data);
+
+typedef struct ktimer {
+    list_node_t node;        // link in a wheel slot
+    uint32_t expires;        // absolute expiry (ticks)
+    ktimer_func_t func;      // called from the timer interrupt
+    void* data;              // argument for func
+    uint8_t pending;         // queued on the wheel
+} ktimer_t;
+
+void timer_wheel_init(uint32_t now);
+
+// run every timer that expired at or before 'now' (called once per tick)
+void timer_wheel_run(uint32_t now);
+
+// number of queued timers
+uint32_t timer_wheel_active(void);
+
+void ktimer_init(ktimer_t* timer, ktimer_func_t func, void* data);
+
+// queue the timer to fire at absolute tick 'expires'
+void ktimer_add(ktimer_t* timer, uint32_t expires);
+
+// change the expiry of a queued or idle timer
+void ktimer_mod(ktimer_t* timer, uint32_t expires);
+
+// dequeue the timer, returns 1 if it was pending
+int ktimer_cancel(ktimer_t* timer);
+
+static inline int ktimer_pending(const ktimer_t* timer) {
+    return timer->pending;
+}
+
+// block the current process for the given number of ticks
+void ktimer_sleep(uint32_t ticks);
+
+// the same, but return -1 early when the process is killed
+int ktimer_sleep_killable(uint32_t ticks);
+
+#endif // TIMER_H
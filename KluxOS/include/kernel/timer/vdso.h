@@ -0,0 +1,75 @@
+#ifndef VDSO_H
+#define VDSO_H
+
+#include <kernel/types.h>
+#include <kernel/cpu/cpu.h>
+#include <kernel/math64.h>
+#include <kernel/timer/clocksource.h>
+
+// Read-only time page shared with every process.
+//
+// The kernel keeps its clocksource state in this page and the page is
+// mapped read-only at VDSO_DATA_ADDR in user space, so user code can
+// compute the current time with rdtsc and a seqcount retry loop
+// instead of a system call. Everything below the kernel-only section
+// is usable from user programs.
+//
+// The page after it holds the system call entry stub: calling
+// VDSO_TEXT_ADDR with the number in eax and arguments in ebx, ecx, edx,
+// esi, edi, ebp enters the kernel through sysenter, or int 0x80 on CPUs
+// without it.
+
+#define VDSO_DATA_ADDR   0xBFFFE000       // fixed user address of the page
+#define VDSO_TEXT_ADDR   0xBFFFF000       // system call entry stub
+#define VDSO_MAGIC       0x4F53444B       // "KDSO"
+#define VDSO_VERSION     1
+
+typedef struct {
+    uint32_t magic;          // VDSO_MAGIC
+    uint32_t version;        // VDSO_VERSION
+    clock_data_t clock;      // clocksource parameters, see clocksource.h
+} vdso_page_t;
+
+static inline const vdso_page_t* vdso_page(void) {
+    return (const vdso_page_t*)VDSO_DATA_ADDR;
+}
+
+// monotonic nanoseconds since boot, computed without entering the kernel
+static inline uint64_t vdso_clock_monotonic_ns(const vdso_page_t* page) {
+    const clock_data_t* clock = &page->clock;
+    uint32_t seq;
+    uint64_t ns;
+
+    do {
+        seq = read_seqbegin(&clock->seq);
+
+        if (clock->type == CLOCKSOURCE_TSC) {
+            ns = clock->base_ns +
+                 mul_u64_u32_shr(rdtsc() - clock->base_cycles, clock->mult, clock->shift);
+        } else {
+            ns = clock->tick_ns;
+        }
+    } while (read_seqretry(&clock->seq, seq));
+
+    return ns;
+}
+
+// PIT ticks since boot
+static inline uint32_t vdso_ticks(const vdso_page_t* page) {
+    return page->clock.ticks;
+}
+
+// ========= kernel only =========
+
+struct page_directory;
+
+// allocate the page, returns the kernel view of it
+vdso_page_t* vdso_init(void);
+
+// map the pages read-only for user mode into an address space
+void vdso_map(struct page_directory* dir);
+
+// install the system call stub that user code finds at VDSO_TEXT_ADDR
+void vdso_set_entry(const void* code, uint32_t size);
+
+#endif // VDSO_H
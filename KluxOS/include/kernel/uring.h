@@ -0,0 +1,144 @@
+#ifndef URING_H
+#define URING_H
+
+#include <kernel/types.h>
+
+// Submission/completion rings for batched system calls.
+//
+// A ring pair lives in memory shared between the kernel and the caller.
+// The caller fills submission entries and advances sq.tail, then makes
+// one SYS_URING_ENTER call to have the kernel consume them. Results are
+// posted to the completion ring, which the caller reaps by advancing
+// cq.head without entering the kernel. Each side only writes its own
+// index: the caller owns sq.tail and cq.head, the kernel sq.head and
+// cq.tail.
+//
+// A ring belongs to the process that set it up. Only that process can
+// enter or destroy it, and whatever it still holds is released when it
+// exits.
+
+#define URING_MAX_RINGS     8
+#define URING_MAX_ENTRIES   256      // per ring, rounded up to a power of two
+
+// operations
+enum {
+    URING_OP_NOP = 0,
+    URING_OP_READ,           // fd, addr = buffer, len
+    URING_OP_WRITE,          // fd, addr = buffer, len
+    URING_OP_OPEN,           // addr = path, len = open flags, res = fd
+    URING_OP_CLOSE,          // fd
+    URING_OP_SLEEP,          // len = milliseconds, completes asynchronously
+    URING_OP_MAX
+};
+
+typedef struct {
+    uint8_t opcode;
+    uint8_t flags;           // reserved, must be 0
+    uint16_t reserved;
+    int32_t fd;
+    uint32_t addr;
+    uint32_t len;
+    uint64_t user_data;      // copied to the completion untouched
+} uring_sqe_t;
+
+typedef struct {
+    uint64_t user_data;
+    int32_t res;             // result of the operation, -1 on error
+    uint32_t flags;
+} uring_cqe_t;
+
+typedef struct {
+    volatile uint32_t head;  // next entry to consume
+    volatile uint32_t tail;  // next entry to fill
+    uint32_t mask;           // entries - 1
+    uint32_t entries;
+    volatile uint32_t overflow;  // completions dropped because the ring was full
+} uring_ring_t;
+
+// shared area; sqes and cqes follow at the given offsets
+typedef struct {
+    uring_ring_t sq;
+    uring_ring_t cq;
+    uint32_t sqe_offset;
+    uint32_t cqe_offset;
+} uring_t;
+
+#define uring_barrier() __asm__ volatile("" : : : "memory")
+
+static inline uring_sqe_t* uring_sqes(uring_t* ring) {
+    return (uring_sqe_t*)((uint8_t*)ring + ring->sqe_offset);
+}
+
+static inline uring_cqe_t* uring_cqes(uring_t* ring) {
+    return (uring_cqe_t*)((uint8_t*)ring + ring->cqe_offset);
+}
+
+// next free submission slot, NULL when the ring is full
+static inline uring_sqe_t* uring_get_sqe(uring_t* ring) {
+    uint32_t tail = ring->sq.tail;
+
+    if (tail - ring->sq.head >= ring->sq.entries) {
+        return NULL;
+    }
+
+    uring_sqe_t* sqe = &uring_sqes(ring)[tail & ring->sq.mask];
+    sqe->flags = 0;
+    sqe->reserved = 0;
+    sqe->fd = -1;
+    sqe->addr = 0;
+    sqe->len = 0;
+    sqe->user_data = 0;
+    return sqe;
+}
+
+// publish the slot returned by uring_get_sqe
+static inline void uring_sqe_push(uring_t* ring) {
+    uring_barrier();
+    ring->sq.tail++;
+}
+
+// number of queued but not yet submitted entries
+static inline uint32_t uring_sq_pending(const uring_t* ring) {
+    return ring->sq.tail - ring->sq.head;
+}
+
+// oldest completion, NULL when there is none
+static inline uring_cqe_t* uring_peek_cqe(uring_t* ring) {
+    uint32_t head = ring->cq.head;
+
+    if (head == ring->cq.tail) {
+        return NULL;
+    }
+
+    uring_barrier();
+    return &uring_cqes(ring)[head & ring->cq.mask];
+}
+
+static inline void uring_cqe_seen(uring_t* ring) {
+    uring_barrier();
+    ring->cq.head++;
+}
+
+static inline uint32_t uring_cq_ready(const uring_t* ring) {
+    return ring->cq.tail - ring->cq.head;
+}
+
+// ========= kernel only =========
+
+void uring_init(void);
+
+// create a ring with at least 'entries' slots, returns its id or -1
+int uring_setup(uint32_t entries, uring_t** ring);
+
+// consume up to to_submit entries, then wait until min_complete
+// completions are ready; returns the number of entries consumed
+int uring_enter(int id, uint32_t to_submit, uint32_t min_complete);
+
+// cancel pending operations and free the ring; the caller must own it
+int uring_destroy(int id);
+
+// destroy every ring the exiting process still owns
+struct process;
+void uring_release_process(struct process* process);
+
+#endif // URING_H
@@ -0,0 +1,74 @@
+#ifndef WORKQUEUE_H
+#define WORKQUEUE_H
+
+#include <kernel/types.h>
+#include <kernel/list.h>
+#include <kernel/process.h>
+#include <kernel/sync/wait.h>
+#include <kernel/timer/timer.h>
+
+// Deferred work run by kernel worker threads.
+//
+// Interrupt handlers queue a work item and return; a worker thread of
+// the queue runs the function later in process context with interrupts
+// enabled, where it may sleep. A work item is queued at most once at a
+// time; queueing an already pending item does nothing.
+
+#define WORKQUEUE_MAX_WORKERS   4
+
+struct work;
+typedef void (*work_func_t)(struct work* work);
+
+typedef struct work {
+    list_node_t node;        // link in the queue's pending list
+    work_func_t func;
+    void* data;              // free for the owner
+    volatile uint8_t pending;
+} work_t;
+
+typedef struct workqueue {
+    const char* name;
+    spinlock_t lock;         // pending list and work_t.pending
+    list_node_t pending;     // queued work, oldest first
+    wait_queue_t more_work;  // idle workers
+    uint32_t nr_workers;
+    process_t* workers[WORKQUEUE_MAX_WORKERS];
+    uint32_t processed;      // work items run
+} workqueue_t;
+
+typedef struct delayed_work {
+    work_t work;
+    ktimer_t timer;          // queues 'work' on 'wq' when it fires
+    workqueue_t* wq;
+} delayed_work_t;
+
+// shared queue for small jobs, one worker
+extern workqueue_t* system_wq;
+
+void workqueue_init(void);
+
+// queue with its own pool of worker threads
+workqueue_t* workqueue_create(const char* name, uint32_t workers);
+
+void work_init(work_t* work, work_func_t func, void* data);
+void delayed_work_init(delayed_work_t* dwork, work_func_t func, void* data);
+
+// returns 1 if queued, 0 if it was already pending; safe from irq context
+int queue_work(workqueue_t* wq, work_t* work);
+
+// queue after 'delay' ticks; 0 if the work or its timer is already pending
+int queue_delayed_work(workqueue_t* wq, delayed_work_t* dwork, uint32_t delay);
+
+// stop a pending timer or dequeue a work item not yet started; 1 if cancelled
+int cancel_work(workqueue_t* wq, work_t* work);
+int cancel_delayed_work(delayed_work_t* dwork);
+
+// queue on system_wq
+int schedule_work(work_t* work);
+int schedule_delayed_work(delayed_work_t* dwork, uint32_t delay);
+
+static inline delayed_work_t* to_delayed_work(work_t* work) {
+    return list_entry(work, delayed_work_t, work);
+}
+
+#endif // WORKQUEUE_H
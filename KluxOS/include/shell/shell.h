@@ -76,8 +76,24 @@ shell_status_t cmd_cat(int argc, char** argv);
 shell_status_t cmd_mkdir(int argc, char** argv);
 shell_status_t cmd_rm(int argc, char** argv);
 shell_status_t cmd_ps(int argc, char** argv);
+shell_status_t cmd_top(int argc, char** argv);
 shell_status_t cmd_kill(int argc, char** argv);
+shell_status_t cmd_exec(int argc, char** argv);
 shell_status_t cmd_uptime(int argc, char** argv);
+shell_status_t cmd_sysbench(int argc, char** argv);
+shell_status_t cmd_sysstat(int argc, char** argv);
+shell_status_t cmd_softirqs(int argc, char** argv);
+shell_status_t cmd_cpus(int argc, char** argv);
+shell_status_t cmd_cpustat(int argc, char** argv);
+shell_status_t cmd_lockstat(int argc, char** argv);
+shell_status_t cmd_futexbench(int argc, char** argv);
+shell_status_t cmd_latbench(int argc, char** argv);
+shell_status_t cmd_shm(int argc, char** argv);
+shell_status_t cmd_mkfifo(int argc, char** argv);
+shell_status_t cmd_pipes(int argc, char** argv);
+shell_status_t cmd_ipc(int argc, char** argv);
+shell_status_t cmd_ipcbench(int argc, char** argv);
+shell_status_t cmd_epoll(int argc, char** argv);
 shell_status_t cmd_date(int argc, char** argv);
 shell_status_t cmd_shutdown(int argc, char** argv);
 shell_status_t cmd_reboot(int argc, char** argv);
@@ -3,6 +3,10 @@
 #include <kernel/types.h>
 #include <kernel/interrupt.h>
 #include <kernel/interrupt/idt.h>
+#include <kernel/softirq.h>
+#include <kernel/irqflags.h>
+#include <kernel/sync/wait.h>
+#include <kernel/epoll.h>
 #include <compat.h>  // Assembly uyumluluğu için eklendi
 
 // Klavye tamponu
@@ -11,6 +15,15 @@ static uint32_t buffer_start = 0;
 static uint32_t buffer_end = 0;
 static uint32_t buffer_count = 0;
 
+// Karakter bekleyen işlemler, tampona karakter girince uyandırılır
+static wait_queue_t input_wait;
+
+// Kesmeden alınan, henüz çözülmemiş ham tuş kodları
+#define SCANCODE_QUEUE_SIZE 32
+static uint8_t scancode_queue[SCANCODE_QUEUE_SIZE];
+static volatile uint32_t scancode_head = 0;
+static volatile uint32_t scancode_tail = 0;
+
 // Klavye durumu
 static key_state_t key_state = {
     .shift_pressed = false,
@@ -77,6 +90,7 @@ static void buffer_push(char c) {
         keyboard_buffer[buffer_end] = c;
         buffer_end = (buffer_end + 1) % KEYBOARD_BUFFER_SIZE;
         buffer_count++;
+        wait_queue_wake_all(&input_wait);
     }
 }
 
@@ -186,14 +200,8 @@ static char keycode_to_ascii(uint8_t keycode) {
     }
 }
 
-// Klavye kesme işleyicisi
-void keyboard_handler(void) {
-    // Kesmeyi onayla
-    ack_irq(1); // IRQ1 - klavye kesmesi
-    
-    // Tuş kodu oku
-    uint8_t scancode = keyboard_read_scancode();
-    
+// Bir tuş kodunu çöz ve tampona ekle
+static void keyboard_process_scancode(uint8_t scancode) {
     // Çalışma moduna göre işle
     if (current_mode == KEYBOARD_MODE_RAW) {
         // Ham tuş kodu için
@@ -214,8 +222,44 @@ void keyboard_handler(void) {
     }
 }
 
+// Alt yarı: biriken tuş kodlarını kesmeler açıkken çöz
+static void keyboard_softirq(void) {
+    while (1) {
+        uint32_t flags = irq_save();
+        if (scancode_tail == scancode_head) {
+            irq_restore(flags);
+            break;
+        }
+        uint8_t scancode = scancode_queue[scancode_tail % SCANCODE_QUEUE_SIZE];
+        scancode_tail++;
+        irq_restore(flags);
+        
+        keyboard_process_scancode(scancode);
+    }
+}
+
+// Klavye kesme işleyicisi (üst yarı): sadece tuş kodunu al ve kuyruğa koy
+void keyboard_handler(void) {
+    // Kesmeyi onayla
+    ack_irq(1); // IRQ1 - klavye kesmesi
+    
+    // Tuş kodu oku
+    uint8_t scancode = keyboard_read_scancode();
+    
+    // Kuyruk doluysa tuş kaybolur
+    if (scancode_head - scancode_tail < SCANCODE_QUEUE_SIZE) {
+        scancode_queue[scancode_head % SCANCODE_QUEUE_SIZE] = scancode;
+        scancode_head++;
+    }
+    
+    raise_softirq(SOFTIRQ_INPUT);
+}
+
 // Klavyeyi başlat
 void keyboard_init(void) {
+    scancode_head = 0;
+    scancode_tail = 0;
+    open_softirq(SOFTIRQ_INPUT, keyboard_softirq);
     register_interrupt_handler(IRQ1, keyboard_handler);
     
     key_state.capslock_on = false;
@@ -225,6 +269,7 @@ void keyboard_init(void) {
     buffer_start = 0;
     buffer_end = 0;
     buffer_count = 0;
+    wait_queue_init(&input_wait);
     
     current_mode = KEYBOARD_MODE_ASCII;
     current_layout = KEYBOARD_LAYOUT_US;
@@ -247,27 +292,45 @@ bool keyboard_data_available(void) {
     return buffer_count > 0;
 }
 
+// Tampona karakter girince input_wait uyandırılır
+uint32_t keyboard_poll(struct poll_table* table) {
+    poll_wait(table, &input_wait);
+    return keyboard_data_available() ? EPOLLIN : 0;
+}
+
 // Tampondan karakter al (bloke edici değil)
 char keyboard_read(void) {
-    if (buffer_count > 0) {
-        return buffer_pop();
-    }
-    return 0;
+    // Tampon softirq içinde doldurulur
+    uint32_t flags = irq_save();
+    char c = buffer_pop();
+    irq_restore(flags);
+    return c;
 }
 
 // Karakter oku (bloke edici)
 char keyboard_getchar(void) {
-    char c;
+    uint32_t flags = irq_save();
     
-    // Tampon dolana kadar bekle
+    // Tuş gelene kadar işlem çalışma kuyruğundan çıkar
     while (!keyboard_data_available()) {
-        ASM_INLINE("hlt");
+        wait_entry_t wait;
+        
+        wait_entry_init(&wait);
+        wait_queue_add(&input_wait, &wait);
+        wait_entry_block(&wait);
+        wait_queue_remove(&input_wait, &wait);
     }
     
-    c = buffer_pop();
+    char c = buffer_pop();
+    irq_restore(flags);
     return c;
 }
 
+// Herhangi bir tuşa basılmasını bekle
+void keyboard_wait_keypress(void) {
+    keyboard_getchar();
+}
+
 // Terminal okuma fonksiyonlarını bağla
 void keyboard_connect_terminal(void) {
     // Terminal'in getchar fonksiyonunu bizim getchar'a bağla
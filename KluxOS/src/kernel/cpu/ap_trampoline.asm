@@ -0,0 +1,79 @@
+; Application processor start-up code
+;
+; smp_init copies everything between ap_trampoline_start and
+; ap_trampoline_end to AP_TRAMPOLINE_ADDR and fills in the data fields
+; of the copy. A startup IPI starts the AP there in real mode; it
+; switches to protected mode with a temporary GDT, takes over the boot
+; CPU's paging setup and calls entry(arg) on its own stack.
+
+%define AP_TRAMPOLINE_ADDR  0x8000     ; must match kernel/cpu/smp.h
+%define KERNEL_CS           0x08
+%define KERNEL_DS           0x10
+
+; address of a label in the copy
+%define T(x) (AP_TRAMPOLINE_ADDR + ((x) - ap_trampoline_start))
+
+global ap_trampoline_start
+global ap_trampoline_end
+global ap_trampoline_cr3
+global ap_trampoline_cr0
+global ap_trampoline_stack
+global ap_trampoline_entry
+global ap_trampoline_arg
+
+section .text
+
+[bits 16]
+ap_trampoline_start:
+    cli
+    cld
+    xor ax, ax
+    mov ds, ax
+
+    lgdt [T(tramp_gdt_ptr)]
+    mov eax, cr0
+    or eax, 1               ; PE
+    mov cr0, eax
+    jmp dword KERNEL_CS:T(ap_protected)
+
+[bits 32]
+ap_protected:
+    mov ax, KERNEL_DS
+    mov ds, ax
+    mov es, ax
+    mov fs, ax
+    mov gs, ax
+    mov ss, ax
+
+    ; same address space and CR0 bits as the boot CPU
+    mov eax, [T(ap_trampoline_cr3)]
+    mov cr3, eax
+    mov eax, [T(ap_trampoline_cr0)]
+    mov cr0, eax
+
+    mov esp, [T(ap_trampoline_stack)]
+    push dword [T(ap_trampoline_arg)]
+    mov eax, [T(ap_trampoline_entry)]
+    call eax
+
+.halt:
+    cli
+    hlt
+    jmp .halt
+
+align 8
+tramp_gdt:
+    dq 0
+    dq 0x00CF9A000000FFFF   ; flat code
+    dq 0x00CF92000000FFFF   ; flat data
+tramp_gdt_ptr:
+    dw tramp_gdt_ptr - tramp_gdt - 1
+    dd T(tramp_gdt)
+
+align 4
+ap_trampoline_cr3:   dd 0
+ap_trampoline_cr0:   dd 0
+ap_trampoline_stack: dd 0
+ap_trampoline_entry: dd 0
+ap_trampoline_arg:   dd 0
+ap_trampoline_end:
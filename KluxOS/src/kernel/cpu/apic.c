@@ -0,0 +1,299 @@
+#include <kernel/cpu/apic.h>
+#include <kernel/cpu/cpu.h>
+#include <kernel/cpu/percpu.h>
+#include <kernel/cpu/smp.h>
+#include <kernel/interrupt/idt.h>
+#include <kernel/io.h>
+#include <kernel/irqflags.h>
+#include <kernel/math64.h>
+#include <kernel/process.h>
+#include <kernel/softirq.h>
+#include <kernel/timer/clocksource.h>
+#include <drivers/terminal.h>
+#include "../interrupt/pic.h"
+#include "../mm/memory.h"
+
+// interrupt_asm.asm
+extern void lapic_timer_entry(void);
+extern void lapic_resched_entry(void);
+extern void lapic_tlb_flush_entry(void);
+extern void lapic_spurious_entry(void);
+
+static volatile uint32_t* lapic = NULL;
+static volatile uint32_t* ioapic = NULL;
+static bool irqs_routed = false;
+
+// ISA irq -> I/O APIC input and MP table polarity/trigger flags
+static uint32_t isa_gsi[ISA_IRQS];
+static uint32_t isa_flags[ISA_IRQS];
+static bool overrides_set = false;
+
+// local timer count for the configured rate, the same on every CPU
+static uint32_t timer_count = 0;
+
+// MMIO registers must not be cached
+static void apic_map(uint32_t base) {
+    page_directory_t* dir = get_kernel_directory();
+    if (dir) {
+        map_page_dir(dir, base, base, MEMORY_PRESENT | MEMORY_READWRITE | MEMORY_NOCACHE);
+    }
+}
+
+static inline uint32_t lapic_read(uint32_t reg) {
+    return lapic[reg / 4];
+}
+
+static inline void lapic_write(uint32_t reg, uint32_t value) {
+    lapic[reg / 4] = value;
+    (void)lapic[LAPIC_ID / 4];      // wait for the write to land
+}
+
+bool lapic_present(void) {
+    uint32_t edx = cpuid_edx(1);
+    return (edx & CPUID_EDX_APIC) && (edx & CPUID_EDX_MSR);
+}
+
+void lapic_init(uint32_t base) {
+    if (!base) {
+        base = (uint32_t)rdmsr(MSR_IA32_APIC_BASE) & 0xFFFFF000;
+    }
+
+    apic_map(base);
+    lapic = (volatile uint32_t*)base;
+
+    // the IDT is shared, the gates only need to be set once
+    idt_set_gate(LAPIC_TIMER_VECTOR, (uint32_t)lapic_timer_entry, 0x08,
+                 IDT_FLAG_PRESENT | IDT_FLAG_RING0 | IDT_FLAG_32BIT);
+    idt_set_gate(RESCHED_VECTOR, (uint32_t)lapic_resched_entry, 0x08,
+                 IDT_FLAG_PRESENT | IDT_FLAG_RING0 | IDT_FLAG_32BIT);
+    idt_set_gate(TLB_FLUSH_VECTOR, (uint32_t)lapic_tlb_flush_entry, 0x08,
+                 IDT_FLAG_PRESENT | IDT_FLAG_RING0 | IDT_FLAG_32BIT);
+    idt_set_gate(SPURIOUS_VECTOR, (uint32_t)lapic_spurious_entry, 0x08,
+                 IDT_FLAG_PRESENT | IDT_FLAG_RING0 | IDT_FLAG_32BIT);
+
+    lapic_init_cpu();
+}
+
+void lapic_init_cpu(void) {
+    uint64_t msr = rdmsr(MSR_IA32_APIC_BASE);
+    wrmsr(MSR_IA32_APIC_BASE, msr | APIC_BASE_ENABLE);
+
+    lapic_write(LAPIC_SVR, LAPIC_SVR_ENABLE | SPURIOUS_VECTOR);
+    lapic_write(LAPIC_TPR, 0);
+    lapic_write(LAPIC_LVT_TIMER, LAPIC_LVT_MASKED);
+    lapic_write(LAPIC_LVT_ERROR, LAPIC_LVT_MASKED);
+
+    // only the boot CPU may take ExtINT from the PIC, until the I/O APIC
+    // takes over
+    if (this_cpu()->id != 0 || irqs_routed) {
+        lapic_write(LAPIC_LVT_LINT0, LAPIC_LVT_MASKED);
+    }
+
+    // clearing the error status takes two writes
+    lapic_write(LAPIC_ESR, 0);
+    lapic_write(LAPIC_ESR, 0);
+    lapic_eoi();
+}
+
+uint32_t lapic_id(void) {
+    return lapic_read(LAPIC_ID) >> 24;
+}
+
+void lapic_eoi(void) {
+    lapic_write(LAPIC_EOI, 0);
+}
+
+static void lapic_icr_wait(void) {
+    while (lapic_read(LAPIC_ICR_LOW) & ICR_DELIVERY_PENDING) {
+        cpu_relax();
+    }
+}
+
+static void lapic_send(uint32_t apic_id, uint32_t command) {
+    uint32_t flags = irq_save();
+
+    lapic_icr_wait();
+    lapic_write(LAPIC_ICR_HIGH, apic_id << 24);
+    lapic_write(LAPIC_ICR_LOW, command);
+    lapic_icr_wait();
+
+    irq_restore(flags);
+}
+
+void lapic_send_ipi(uint32_t apic_id, uint32_t vector) {
+    lapic_send(apic_id, vector & 0xFF);
+}
+
+void lapic_send_init(uint32_t apic_id) {
+    lapic_send(apic_id, ICR_INIT | ICR_LEVEL_ASSERT);
+}
+
+void lapic_send_startup(uint32_t apic_id, uint32_t page) {
+    lapic_send(apic_id, ICR_STARTUP | ICR_LEVEL_ASSERT | (page & 0xFF));
+}
+
+void apic_udelay(uint32_t us) {
+    uint32_t khz = clocksource_tsc_khz();
+
+    if (!khz) {
+        // an I/O port write takes about a microsecond
+        for (uint32_t i = 0; i < us; i++) {
+            outb(0x80, 0);
+        }
+        return;
+    }
+
+    uint64_t cycles = div_u64_u32((uint64_t)khz * us, 1000, NULL);
+    uint64_t start = rdtsc();
+    while (rdtsc() - start < cycles) {
+        cpu_relax();
+    }
+}
+
+void lapic_timer_start(uint32_t hz) {
+    if (!lapic || hz == 0) {
+        return;
+    }
+
+    lapic_write(LAPIC_TIMER_DIVIDE, LAPIC_TIMER_DIV_16);
+
+    // count down from the top for 10 ms on the first CPU that asks
+    if (!timer_count) {
+        lapic_write(LAPIC_LVT_TIMER, LAPIC_LVT_MASKED);
+        lapic_write(LAPIC_TIMER_INIT, 0xFFFFFFFF);
+        apic_udelay(10000);
+        uint32_t elapsed = 0xFFFFFFFF - lapic_read(LAPIC_TIMER_CURRENT);
+        lapic_write(LAPIC_TIMER_INIT, 0);
+
+        timer_count = (uint32_t)div_u64_u32((uint64_t)elapsed * 100, hz, NULL);
+        if (!timer_count) {
+            timer_count = 1;
+        }
+    }
+
+    lapic_write(LAPIC_LVT_TIMER, LAPIC_TIMER_VECTOR | LAPIC_TIMER_PERIODIC);
+    lapic_write(LAPIC_TIMER_INIT, timer_count);
+}
+
+// ========= I/O APIC =========
+
+static uint32_t ioapic_read(uint32_t reg) {
+    ioapic[0] = reg;
+    return ioapic[4];
+}
+
+static void ioapic_write(uint32_t reg, uint32_t value) {
+    ioapic[0] = reg;
+    ioapic[4] = value;
+}
+
+static void isa_defaults(void) {
+    for (uint32_t irq = 0; irq < ISA_IRQS; irq++) {
+        isa_gsi[irq] = irq;
+        isa_flags[irq] = 0;
+    }
+    overrides_set = true;
+}
+
+void ioapic_set_override(uint32_t irq, uint32_t gsi, uint32_t flags) {
+    if (!overrides_set) {
+        isa_defaults();
+    }
+    if (irq < ISA_IRQS) {
+        isa_gsi[irq] = gsi;
+        isa_flags[irq] = flags;
+    }
+}
+
+void ioapic_init(uint32_t base) {
+    if (!overrides_set) {
+        isa_defaults();
+    }
+    if (!base) {
+        base = IOAPIC_DEFAULT_BASE;
+    }
+
+    apic_map(base);
+    ioapic = (volatile uint32_t*)base;
+
+    uint32_t entries = ((ioapic_read(IOAPIC_REG_VERSION) >> 16) & 0xFF) + 1;
+    for (uint32_t i = 0; i < entries; i++) {
+        ioapic_write(IOAPIC_REDTBL(i), IOAPIC_MASKED);
+        ioapic_write(IOAPIC_REDTBL(i) + 1, 0);
+    }
+
+    uint32_t dest = lapic_id();
+    for (uint32_t irq = 0; irq < ISA_IRQS; irq++) {
+        uint32_t gsi = isa_gsi[irq];
+        if (gsi >= entries) {
+            continue;
+        }
+
+        // MP table flags: polarity in bits 0-1, trigger mode in bits 2-3,
+        // 3 means active low / level; 0 keeps the ISA default (high, edge)
+        uint32_t low = (32 + irq) | IOAPIC_MASKED;
+        if ((isa_flags[irq] & 0x3) == 0x3) {
+            low |= IOAPIC_ACTIVE_LOW;
+        }
+        if (((isa_flags[irq] >> 2) & 0x3) == 0x3) {
+            low |= IOAPIC_LEVEL;
+        }
+
+        ioapic_write(IOAPIC_REDTBL(gsi) + 1, dest << 24);
+        ioapic_write(IOAPIC_REDTBL(gsi), low);
+    }
+
+    pic_disable();
+    lapic_write(LAPIC_LVT_LINT0, LAPIC_LVT_MASKED);
+    irqs_routed = true;
+
+    // keep the interrupts that already have a handler
+    for (uint32_t irq = 0; irq < ISA_IRQS; irq++) {
+        if (interrupt_handler_registered(32 + irq)) {
+            ioapic_unmask_irq(irq);
+        }
+    }
+}
+
+static void ioapic_set_masked(uint32_t irq, bool masked) {
+    if (!ioapic || irq >= ISA_IRQS) {
+        return;
+    }
+
+    uint32_t reg = IOAPIC_REDTBL(isa_gsi[irq]);
+    uint32_t low = ioapic_read(reg);
+    ioapic_write(reg, masked ? (low | IOAPIC_MASKED) : (low & ~IOAPIC_MASKED));
+}
+
+void ioapic_mask_irq(uint32_t irq) {
+    ioapic_set_masked(irq, true);
+}
+
+void ioapic_unmask_irq(uint32_t irq) {
+    ioapic_set_masked(irq, false);
+}
+
+bool apic_irqs_routed(void) {
+    return irqs_routed;
+}
+
+// ========= local interrupts =========
+
+void lapic_interrupt(uint32_t vector) {
+    cpu_t* cpu = this_cpu();
+
+    irq_enter();
+
+    if (vector == LAPIC_TIMER_VECTOR) {
+        cpu->lapic_ticks++;
+        scheduler_tick();
+    } else if (vector == RESCHED_VECTOR) {
+        cpu->need_resched = 1;
+    } else if (vector == TLB_FLUSH_VECTOR) {
+        smp_flush_tlb_interrupt();
+    }
+
+    lapic_eoi();
+    irq_exit();
+    process_preempt();
+}
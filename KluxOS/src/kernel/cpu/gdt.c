@@ -0,0 +1,142 @@
+#include <kernel/cpu/gdt.h>
+#include <kernel/cpu/percpu.h>
+#include <drivers/terminal.h>
+#include "../mm/memory.h"
+#include "../mm/kstack.h"
+
+#define DF_STACK_SIZE  4096
+
+static uint8_t df_stacks[MAX_CPUS][DF_STACK_SIZE] __attribute__((aligned(16)));
+
+// Runs as its own task on df_stacks. The interrupted state was saved in
+// the CPU's TSS by the task switch; nothing can be resumed from here.
+static void double_fault_task(void) {
+    cpu_t* cpu = this_cpu();
+    uint32_t cr2;
+    __asm__ volatile("mov %%cr2, %0" : "=r"(cr2));
+
+    terminal_set_fg_color(VGA_COLOR_RED);
+    terminal_writestring("CIFT HATA: eip=0x");
+    terminal_print_hex(cpu->tss.eip);
+    terminal_writestring(" esp=0x");
+    terminal_print_hex(cpu->tss.esp);
+    terminal_writestring(" cr2=0x");
+    terminal_print_hex(cr2);
+    terminal_writestring("\n");
+
+    if (kstack_guard_hit(cpu->tss.esp) || kstack_guard_hit(cr2)) {
+        terminal_writestring("ERROR: Kernel stack overflow (guard page hit)\n");
+    }
+    terminal_reset_color();
+
+    for (;;) {
+        __asm__ volatile("cli; hlt");
+    }
+}
+
+static void df_tss_init(cpu_t* cpu) {
+    tss_entry_t* tss = &cpu->df_tss;
+    uint32_t cr3;
+    __asm__ volatile("mov %%cr3, %0" : "=r"(cr3));
+
+    memset(tss, 0, sizeof(tss_entry_t));
+    tss->eip = (uint32_t)double_fault_task;
+    tss->esp = (uint32_t)&df_stacks[cpu->id][DF_STACK_SIZE];
+    tss->eflags = 0x2;                           // interrupts off
+    tss->cr3 = cr3;
+    tss->cs = GDT_KERNEL_CODE;
+    tss->ss = tss->ds = tss->es = tss->gs = GDT_KERNEL_DATA;
+    tss->ss0 = GDT_KERNEL_DATA;
+    tss->fs = GDT_PERCPU;
+    tss->iomap_base = sizeof(tss_entry_t);
+}
+
+void gdt_set_gate(gdt_entry_t* gdt, int num, uint32_t base, uint32_t limit,
+                  uint8_t access, uint8_t flags) {
+    gdt[num].base_low = base & 0xFFFF;
+    gdt[num].base_middle = (base >> 16) & 0xFF;
+    gdt[num].base_high = (base >> 24) & 0xFF;
+    gdt[num].limit_low = limit & 0xFFFF;
+    gdt[num].granularity = ((limit >> 16) & 0x0F) | (flags & 0xF0);
+    gdt[num].access = access;
+}
+
+static void gdt_flush(gdt_ptr_t* ptr) {
+    __asm__ volatile(
+        "lgdt (%0)\n\t"
+        "mov %1, %%ax\n\t"
+        "mov %%ax, %%ds\n\t"
+        "mov %%ax, %%es\n\t"
+        "mov %%ax, %%gs\n\t"
+        "mov %%ax, %%ss\n\t"
+        "ljmp %2, $1f\n"
+        "1:\n\t"
+        "mov %3, %%ax\n\t"
+        "ltr %%ax\n\t"
+        "mov %4, %%ax\n\t"
+        "mov %%ax, %%fs"
+        :
+        : "r"(ptr), "i"(GDT_KERNEL_DATA), "i"(GDT_KERNEL_CODE), "i"(GDT_TSS),
+          "i"(GDT_PERCPU)
+        : "eax", "memory");
+}
+
+void gdt_init_cpu(cpu_t* cpu) {
+    gdt_entry_t* gdt = cpu->gdt;
+
+    cpu->self = cpu;
+    cpu->gdt_ptr.limit = sizeof(gdt_entry_t) * GDT_ENTRIES - 1;
+    cpu->gdt_ptr.base = (uint32_t)gdt;
+
+    uint8_t code = GDT_ACCESS_PRESENT | GDT_ACCESS_SEGMENT | GDT_ACCESS_CODE;
+    uint8_t data = GDT_ACCESS_PRESENT | GDT_ACCESS_SEGMENT | GDT_ACCESS_DATA;
+    uint8_t flags = GDT_FLAG_4K | GDT_FLAG_32BIT;
+
+    gdt_set_gate(gdt, 0, 0, 0, 0, 0);                                    // null
+    gdt_set_gate(gdt, 1, 0, 0xFFFFF, code, flags);                       // kernel code
+    gdt_set_gate(gdt, 2, 0, 0xFFFFF, data, flags);                       // kernel data
+    gdt_set_gate(gdt, 3, 0, 0xFFFFF, code | GDT_ACCESS_RING3, flags);    // user code
+    gdt_set_gate(gdt, 4, 0, 0xFFFFF, data | GDT_ACCESS_RING3, flags);    // user data
+
+    memset(&cpu->tss, 0, sizeof(tss_entry_t));
+    cpu->tss.ss0 = GDT_KERNEL_DATA;
+    cpu->tss.iomap_base = sizeof(tss_entry_t);   // no I/O bitmap
+    gdt_set_gate(gdt, 5, (uint32_t)&cpu->tss, sizeof(tss_entry_t) - 1,
+                 GDT_ACCESS_PRESENT | GDT_ACCESS_TSS, 0);
+
+    // byte granular, just large enough for the cpu_t
+    gdt_set_gate(gdt, 6, (uint32_t)cpu, sizeof(cpu_t) - 1, data, GDT_FLAG_32BIT);
+
+    df_tss_init(cpu);
+    gdt_set_gate(gdt, 7, (uint32_t)&cpu->df_tss, sizeof(tss_entry_t) - 1,
+                 GDT_ACCESS_PRESENT | GDT_ACCESS_TSS, 0);
+
+    gdt_flush(&cpu->gdt_ptr);
+}
+
+void gdt_init(void) {
+    terminal_writestring("Initializing GDT...\n");
+
+    cpu_t* cpu = boot_cpu();
+    cpu->id = 0;
+    cpu->online = 1;
+    gdt_init_cpu(cpu);
+
+    terminal_writestring("GDT initialized.\n");
+}
+
+void tss_set_kernel_stack(uint32_t esp0) {
+    this_cpu()->tss.esp0 = esp0;
+}
+
+uint32_t tss_get_kernel_stack(void) {
+    return this_cpu()->tss.esp0;
+}
+
+tss_entry_t* gdt_get_tss(void) {
+    return &this_cpu()->tss;
+}
+
+void tss_set_double_fault_cr3(uint32_t cr3) {
+    this_cpu()->df_tss.cr3 = cr3;
+}
@@ -0,0 +1,143 @@
+#include <kernel/cpu/mptable.h>
+#include <kernel/cpu/apic.h>
+#include <drivers/terminal.h>
+
+static bool checksum_ok(const void* data, uint32_t length) {
+    const uint8_t* bytes = (const uint8_t*)data;
+    uint8_t sum = 0;
+
+    for (uint32_t i = 0; i < length; i++) {
+        sum += bytes[i];
+    }
+    return sum == 0;
+}
+
+// the pointer sits on a 16 byte boundary
+static mp_floating_t* mp_search(uint32_t start, uint32_t length) {
+    for (uint32_t addr = start; addr + sizeof(mp_floating_t) <= start + length; addr += 16) {
+        mp_floating_t* mp = (mp_floating_t*)addr;
+
+        if (mp->signature[0] == '_' && mp->signature[1] == 'M' &&
+            mp->signature[2] == 'P' && mp->signature[3] == '_' &&
+            checksum_ok(mp, mp->length * 16)) {
+            return mp;
+        }
+    }
+    return NULL;
+}
+
+static mp_floating_t* mp_find(void) {
+    mp_floating_t* mp;
+
+    // first KiB of the extended BIOS data area
+    uint32_t ebda = (uint32_t)(*(volatile uint16_t*)0x40E) << 4;
+    if (ebda && (mp = mp_search(ebda, 1024))) {
+        return mp;
+    }
+
+    // last KiB of base memory
+    uint32_t base_kb = *(volatile uint16_t*)0x413;
+    if (base_kb && (mp = mp_search(base_kb * 1024 - 1024, 1024))) {
+        return mp;
+    }
+
+    return mp_search(0xF0000, 0x10000);
+}
+
+static bool bus_is_isa(const mp_bus_t* bus) {
+    return bus->bus_type[0] == 'I' && bus->bus_type[1] == 'S' && bus->bus_type[2] == 'A';
+}
+
+static void mp_add_cpu(mp_info_t* info, uint32_t apic_id, bool bsp) {
+    if (info->cpu_count < MAX_CPUS) {
+        info->apic_ids[info->cpu_count++] = apic_id;
+    }
+    if (bsp) {
+        info->bsp_apic_id = apic_id;
+    }
+}
+
+int mptable_parse(mp_info_t* info) {
+    info->lapic_base = LAPIC_DEFAULT_BASE;
+    info->ioapic_base = 0;
+    info->imcr = false;
+    info->cpu_count = 0;
+    info->bsp_apic_id = 0;
+
+    mp_floating_t* mp = mp_find();
+    if (!mp) {
+        return -1;
+    }
+
+    info->imcr = (mp->feature2 & 0x80) != 0;
+
+    // one of the default configurations: two CPUs, one I/O APIC
+    if (mp->feature1 != 0 || mp->config == 0) {
+        mp_add_cpu(info, 0, true);
+        mp_add_cpu(info, 1, false);
+        info->ioapic_base = IOAPIC_DEFAULT_BASE;
+        return 0;
+    }
+
+    mp_config_t* config = (mp_config_t*)mp->config;
+    if (config->signature[0] != 'P' || config->signature[1] != 'C' ||
+        config->signature[2] != 'M' || config->signature[3] != 'P' ||
+        !checksum_ok(config, config->length)) {
+        terminal_writestring("ERROR: Invalid MP configuration table\n");
+        return -1;
+    }
+
+    info->lapic_base = config->lapic_base;
+
+    uint32_t isa_buses = 0;          // bit per bus id below 32
+    uint8_t* entry = (uint8_t*)config + sizeof(mp_config_t);
+    uint8_t* end = (uint8_t*)config + config->length;
+
+    for (uint32_t i = 0; i < config->entry_count && entry < end; i++) {
+        switch (*entry) {
+            case MP_ENTRY_PROCESSOR: {
+                mp_processor_t* cpu = (mp_processor_t*)entry;
+                if (cpu->flags & MP_CPU_ENABLED) {
+                    mp_add_cpu(info, cpu->apic_id, (cpu->flags & MP_CPU_BSP) != 0);
+                }
+                entry += sizeof(mp_processor_t);
+                break;
+            }
+            case MP_ENTRY_BUS: {
+                mp_bus_t* bus = (mp_bus_t*)entry;
+                if (bus_is_isa(bus) && bus->bus_id < 32) {
+                    isa_buses |= 1u << bus->bus_id;
+                }
+                entry += sizeof(mp_bus_t);
+                break;
+            }
+            case MP_ENTRY_IOAPIC: {
+                mp_ioapic_t* ioapic = (mp_ioapic_t*)entry;
+                if ((ioapic->flags & 1) && !info->ioapic_base) {
+                    info->ioapic_base = ioapic->address;
+                }
+                entry += sizeof(mp_ioapic_t);
+                break;
+            }
+            case MP_ENTRY_IOINT: {
+                // bus entries come first, so the ISA buses are known here
+                mp_ioint_t* irq = (mp_ioint_t*)entry;
+                if (irq->int_type == 0 && irq->src_bus < 32 &&
+                    (isa_buses & (1u << irq->src_bus))) {
+                    ioapic_set_override(irq->src_irq, irq->dst_intin, irq->flags);
+                }
+                entry += sizeof(mp_ioint_t);
+                break;
+            }
+            case MP_ENTRY_LOCALINT:
+                entry += 8;
+                break;
+            default:
+                // unknown entry, its size is not known either
+                i = config->entry_count;
+                break;
+        }
+    }
+
+    return info->cpu_count ? 0 : -1;
+}
@@ -0,0 +1,35 @@
+#include <kernel/cpu/percpu.h>
+
+cpu_t cpus[MAX_CPUS];
+
+// the boot CPU is always cpus[0]
+static uint32_t nr_cpus = 1;
+
+cpu_t* percpu_add(uint32_t apic_id) {
+    if (nr_cpus >= MAX_CPUS) {
+        return NULL;
+    }
+
+    cpu_t* cpu = &cpus[nr_cpus];
+    cpu->self = cpu;
+    cpu->id = nr_cpus;
+    cpu->apic_id = apic_id;
+    cpu->online = 0;
+    nr_cpus++;
+    return cpu;
+}
+
+uint32_t cpu_count(void) {
+    return nr_cpus;
+}
+
+uint32_t cpu_online_count(void) {
+    uint32_t online = 0;
+
+    for (uint32_t i = 0; i < nr_cpus; i++) {
+        if (cpus[i].online) {
+            online++;
+        }
+    }
+    return online;
+}
@@ -0,0 +1,216 @@
+#include <kernel/cpu/smp.h>
+#include <kernel/cpu/cpu.h>
+#include <kernel/cpu/apic.h>
+#include <kernel/cpu/mptable.h>
+#include <kernel/cpu/gdt.h>
+#include <kernel/interrupt/idt.h>
+#include <kernel/process.h>
+#include <kernel/syscall.h>
+#include <kernel/timer/pit.h>
+#include <kernel/io.h>
+#include <drivers/terminal.h>
+#include "../mm/memory.h"
+
+// ap_trampoline.asm
+extern uint8_t ap_trampoline_start[], ap_trampoline_end[];
+extern uint8_t ap_trampoline_cr3[], ap_trampoline_cr0[];
+extern uint8_t ap_trampoline_stack[], ap_trampoline_entry[], ap_trampoline_arg[];
+
+static bool smp_active = false;
+
+// a data field of the trampoline copy
+static volatile uint32_t* tramp_field(uint8_t* label) {
+    return (volatile uint32_t*)(AP_TRAMPOLINE_ADDR + (label - ap_trampoline_start));
+}
+
+static uint32_t timer_hz(void) {
+    timer_info_t* info = get_timer_info();
+    return (info && info->frequency) ? info->frequency : 100;
+}
+
+// first C code on an application processor, on its boot stack
+static void ap_main(cpu_t* cpu) {
+    gdt_init_cpu(cpu);
+    idt_init_cpu();
+    lapic_init_cpu();
+    syscall_init_cpu();
+
+    cpu->apic_id = lapic_id();
+    cpu->online = 1;
+
+    lapic_timer_start(timer_hz());
+
+    // the boot stack becomes this CPU's idle process
+    process_idle_enter(cpu);
+}
+
+static bool smp_boot_ap(cpu_t* cpu) {
+    cpu->boot_stack = kmalloc(PROCESS_KERNEL_STACK_SIZE);
+    if (!cpu->boot_stack) {
+        return false;
+    }
+
+    *tramp_field(ap_trampoline_stack) = (uint32_t)cpu->boot_stack + PROCESS_KERNEL_STACK_SIZE;
+    *tramp_field(ap_trampoline_entry) = (uint32_t)ap_main;
+    *tramp_field(ap_trampoline_arg) = (uint32_t)cpu;
+
+    // INIT, wait 10 ms, then up to two startup IPIs
+    lapic_send_init(cpu->apic_id);
+    apic_udelay(10000);
+
+    for (int i = 0; i < 2 && !cpu->online; i++) {
+        lapic_send_startup(cpu->apic_id, AP_TRAMPOLINE_ADDR >> 12);
+        apic_udelay(200);
+    }
+
+    for (uint32_t waited = 0; waited < AP_BOOT_TIMEOUT_MS * 10 && !cpu->online; waited++) {
+        apic_udelay(100);
+    }
+
+    return cpu->online != 0;
+}
+
+void smp_init(void) {
+    mp_info_t info;
+
+    terminal_writestring("Initializing SMP...\n");
+
+    if (!lapic_present() || mptable_parse(&info) != 0) {
+        terminal_writestring("  no MP tables, running on one CPU\n");
+        terminal_writestring("SMP initialized.\n");
+        return;
+    }
+
+    lapic_init(info.lapic_base);
+    boot_cpu()->apic_id = lapic_id();
+
+    if (info.ioapic_base) {
+        // PIC mode: connect the interrupt lines to the APICs
+        if (info.imcr) {
+            outb(0x22, 0x70);
+            outb(0x23, 0x01);
+        }
+        ioapic_init(info.ioapic_base);
+    }
+
+    // the trampoline only has one set of fields, start the APs one by one
+    memcpy((void*)AP_TRAMPOLINE_ADDR, ap_trampoline_start,
+           ap_trampoline_end - ap_trampoline_start);
+
+    uint32_t cr0, cr3;
+    __asm__ volatile("mov %%cr0, %0" : "=r"(cr0));
+    __asm__ volatile("mov %%cr3, %0" : "=r"(cr3));
+    *tramp_field(ap_trampoline_cr0) = cr0;
+    *tramp_field(ap_trampoline_cr3) = cr3;
+
+    for (uint32_t i = 0; i < info.cpu_count; i++) {
+        if (info.apic_ids[i] == boot_cpu()->apic_id) {
+            continue;
+        }
+
+        cpu_t* cpu = percpu_add(info.apic_ids[i]);
+        if (!cpu) {
+            break;
+        }
+
+        // the queue must exist before the CPU is online and can be picked
+        scheduler_init_cpu(cpu);
+
+        if (!smp_boot_ap(cpu)) {
+            terminal_writestring("ERROR: CPU did not start, APIC id ");
+            terminal_print_int(cpu->apic_id);
+            terminal_writestring("\n");
+        }
+    }
+
+    smp_active = true;
+
+    terminal_writestring("  ");
+    terminal_print_int(cpu_online_count());
+    terminal_writestring(" of ");
+    terminal_print_int(cpu_count());
+    terminal_writestring(" CPUs online\n");
+    terminal_writestring("SMP initialized.\n");
+}
+
+void smp_send_reschedule(cpu_t* cpu) {
+    cpu->need_resched = 1;
+
+    // a CPU waiting in MWAIT wakes up from the store alone; the barrier
+    // pairs with the one in the idle loop so one side sees the other
+    smp_mb();
+
+    if (smp_active && cpu != this_cpu() && !cpu->idle_polling) {
+        lapic_send_ipi(cpu->apic_id, RESCHED_VECTOR);
+    }
+}
+
+// one shootdown at a time; the range and the CPUs still to answer
+static lock_class_t tlb_class = LOCK_CLASS_INIT("tlb shootdown");
+static spinlock_t tlb_lock = SPINLOCK_INIT_CLASS(&tlb_class);
+static volatile uint32_t flush_start;
+static volatile uint32_t flush_end;
+static volatile uint32_t flush_pending;
+
+static void flush_local(uint32_t start, uint32_t end) {
+    for (uint32_t addr = start; addr < end; addr += PAGE_SIZE) {
+        __asm__ volatile("invlpg (%0)" : : "r"(addr) : "memory");
+    }
+}
+
+void smp_flush_tlb_range(uint32_t start, uint32_t size) {
+    uint32_t end = start + size;
+
+    // the lock only keeps us on this CPU, interrupts stay on
+    spin_lock(&tlb_lock);
+    flush_local(start, end);
+
+    if (smp_active) {
+        cpu_t* self = this_cpu();
+        uint32_t targets = 0;
+
+        flush_start = start;
+        flush_end = end;
+        for (uint32_t i = 0; i < cpu_count(); i++) {
+            if (&cpus[i] != self && cpus[i].online) {
+                targets++;
+            }
+        }
+        flush_pending = targets;
+        smp_mb();
+
+        for (uint32_t i = 0; i < cpu_count(); i++) {
+            if (&cpus[i] != self && cpus[i].online) {
+                lapic_send_ipi(cpus[i].apic_id, TLB_FLUSH_VECTOR);
+            }
+        }
+        while (flush_pending) {
+            cpu_relax();
+        }
+    }
+
+    spin_unlock(&tlb_lock);
+}
+
+void smp_flush_tlb_interrupt(void) {
+    flush_local(flush_start, flush_end);
+    __asm__ volatile("lock decl %0" : "+m"(flush_pending) : : "memory");
+}
+
+void smp_dump(void) {
+    terminal_writestring("CPU  APIC  STATE    TICKS     RUNNING\n");
+
+    for (uint32_t i = 0; i < cpu_count(); i++) {
+        cpu_t* cpu = &cpus[i];
+
+        terminal_print_int(i);
+        terminal_writestring("    ");
+        terminal_print_int(cpu->apic_id);
+        terminal_writestring("     ");
+        terminal_writestring(cpu->online ? "online   " : "offline  ");
+        terminal_print_int(cpu->lapic_ticks);
+        terminal_writestring("  ");
+        terminal_writestring(cpu->current ? cpu->current->name : "-");
+        terminal_writestring("\n");
+    }
+}
@@ -0,0 +1,259 @@
+; System call entry points
+;
+; Both paths use the same register ABI:
+;   eax = call number
+;   ebx, ecx, edx, esi, edi, ebp = arguments 1-6
+;   eax = return value, every other register is preserved
+;
+; int 0x80 goes through its own ring-3 IDT gate instead of the generic
+; isr path. sysenter is reached through the vDSO stub below, which the
+; kernel copies to VDSO_TEXT_ADDR so that sysexit has a fixed return
+; address.
+
+[bits 32]
+
+; must match kernel/cpu/gdt.h, kernel/cpu/percpu.h, kernel/syscall.h and kernel/timer/vdso.h
+%define KERNEL_DS        0x10
+%define PERCPU_DS        0x30
+%define PERCPU_USER_RETURN_ESP  12
+%define USER_CS          0x1B
+%define USER_DS          0x23
+%define TSS_ESP0         4
+%define SYS_USER_RETURN  31
+%define VDSO_TEXT_ADDR   0xBFFFF000
+%define USER_SPACE_START 0x00400000       ; kernel/mm/vm.h
+%define USER_SPACE_END   0xBF800000       ; kernel/mm/vm.h
+
+global syscall_int80_entry
+global sysenter_entry
+global vdso_sysenter_start
+global vdso_sysenter_end
+global vdso_int80_start
+global vdso_int80_end
+global user_enter
+global user_exec_enter
+
+extern syscall_dispatch
+extern tss_set_kernel_stack
+
+section .text
+
+; ========= int 0x80 =========
+
+syscall_int80_entry:
+    cmp eax, SYS_USER_RETURN
+    je .user_return
+
+.dispatch:
+    push ds
+    push es
+    push fs
+    push ecx                ; caller-saved in C, preserved for the user
+    push edx
+
+    push ebp                ; arg6
+    push edi                ; arg5
+    push esi                ; arg4
+    push edx                ; arg3
+    push ecx                ; arg2
+    push ebx                ; arg1
+    push eax                ; number
+
+    mov dx, KERNEL_DS
+    mov ds, dx
+    mov es, dx
+    mov dx, PERCPU_DS
+    mov fs, dx
+    sti
+
+    call syscall_dispatch
+    add esp, 28
+
+    cli
+    pop edx
+    pop ecx
+    pop fs
+    pop es
+    pop ds
+    iret
+
+; only while user_enter runs on this CPU; any other caller gets the
+; invalid-call path
+.user_return:
+    push fs
+    push edx
+    mov dx, PERCPU_DS
+    mov fs, dx
+    mov edx, [fs:PERCPU_USER_RETURN_ESP]
+    test edx, edx
+    pop edx
+    jnz user_return         ; drops the saved fs with the rest of the stack
+    pop fs
+    jmp .dispatch
+
+; ========= sysenter =========
+
+; Entered from vdso_sysenter_start with interrupts off and esp pointing
+; at this CPU's TSS. ebp holds the user stack: [ebp] = arg6, [ebp+4] = edx,
+; [ebp+8] = ecx, [ebp+12] = return address into user code. ebp comes
+; from the caller and must lie in user space before it is read. A user
+; address that is not mapped faults in kernel mode; handle_page_fault
+; ends the caller, which has its own address space like every process
+; that runs user code. A kernel thread faulting there is a kernel bug
+; and halts.
+sysenter_entry:
+    mov esp, [esp + TSS_ESP0]
+
+    push ebp                ; user stack, becomes ecx for sysexit
+    push ds
+    push es
+    push fs
+
+    mov dx, KERNEL_DS
+    mov ds, dx
+    mov es, dx
+    mov dx, PERCPU_DS
+    mov fs, dx
+    sti
+
+    cmp ebp, USER_SPACE_START
+    jb .bad_stack
+    cmp ebp, USER_SPACE_END - 12
+    jae .bad_stack
+
+    push dword [ebp]        ; arg6
+    push edi                ; arg5
+    push esi                ; arg4
+    push dword [ebp + 4]    ; arg3
+    push dword [ebp + 8]    ; arg2
+    push ebx                ; arg1
+    push eax                ; number
+
+    call syscall_dispatch
+    add esp, 28
+
+.exit:
+    cli
+    pop fs
+    pop es
+    pop ds
+    pop ecx
+    mov edx, VDSO_TEXT_ADDR + (vdso_sysenter_return - vdso_sysenter_start)
+    sti                     ; takes effect after sysexit
+    sysexit
+
+.bad_stack:
+    mov eax, -1
+    jmp .exit
+
+; ========= vDSO stubs =========
+
+; Copied to VDSO_TEXT_ADDR; user code calls the page with the ABI above.
+; Position independent, never executed at its link address.
+vdso_sysenter_start:
+    push ecx
+    push edx
+    push ebp
+    mov ebp, esp
+    sysenter
+vdso_sysenter_return:
+    pop ebp
+    pop edx
+    pop ecx
+    ret
+vdso_sysenter_end:
+
+; fallback for CPUs without sysenter
+vdso_int80_start:
+    int 0x80
+    ret
+vdso_int80_end:
+
+; ========= running code in ring 3 =========
+
+; uint64_t user_enter(uint32_t eip, uint32_t esp, uint32_t arg)
+;
+; Run user code at eip with the given stack and arg in esi until it
+; issues SYS_USER_RETURN through int 0x80; its ebx:ecx is returned in
+; eax:edx. Interrupts taken in ring 3 use the stack below our frame.
+; The frame is recorded in this CPU's cpu_t, so the caller must keep
+; preemption off until we return.
+user_enter:
+    push ebp
+    push ebx
+    push esi
+    push edi
+    pushfd
+    mov [fs:PERCPU_USER_RETURN_ESP], esp
+
+    push esp
+    call tss_set_kernel_stack
+    add esp, 4
+
+    mov eax, [esp + 24]     ; eip
+    mov ecx, [esp + 28]     ; esp
+    mov esi, [esp + 32]     ; arg
+
+    push dword USER_DS      ; ss
+    push ecx                ; esp
+    push dword 0x202        ; eflags, interrupts on
+    push dword USER_CS      ; cs
+    push eax                ; eip
+
+    mov dx, USER_DS
+    mov ds, dx
+    mov es, dx
+    mov gs, dx
+    iret                    ; fs is nulled on the way to ring 3
+
+user_return:
+    mov dx, KERNEL_DS
+    mov ds, dx
+    mov es, dx
+    mov gs, dx
+    mov dx, PERCPU_DS
+    mov fs, dx
+
+    mov eax, ebx
+    mov edx, ecx
+    mov esp, [fs:PERCPU_USER_RETURN_ESP]
+    mov dword [fs:PERCPU_USER_RETURN_ESP], 0
+
+    popfd
+    pop edi
+    pop esi
+    pop ebx
+    pop ebp
+    ret
+
+; void user_exec_enter(uint32_t eip, uint32_t esp, uint32_t kernel_stack_top)
+;
+; Start a program exec has just loaded. Nothing on the kernel stack is
+; needed any more, so it is dropped and ring 3 is entered from its top,
+; where the TSS already points interrupts and system calls. Never returns.
+user_exec_enter:
+    cli
+    mov eax, [esp + 4]      ; eip
+    mov ecx, [esp + 8]      ; esp
+    mov esp, [esp + 12]
+
+    push dword USER_DS      ; ss
+    push ecx                ; esp
+    push dword 0x202        ; eflags, interrupts on
+    push dword USER_CS      ; cs
+    push eax                ; eip
+
+    mov dx, USER_DS
+    mov ds, dx
+    mov es, dx
+    mov gs, dx
+
+    ; nothing of the kernel leaks into the program
+    xor eax, eax
+    xor ebx, ebx
+    xor ecx, ecx
+    xor edx, edx
+    xor esi, esi
+    xor edi, edi
+    xor ebp, ebp
+    iret                    ; fs is nulled on the way to ring 3
@@ -0,0 +1,501 @@
+#include <kernel/epoll.h>
+#include <kernel/process.h>
+#include <kernel/cpu/cpu.h>
+#include <kernel/timer/timer.h>
+#include <kernel/timer/pit.h>
+#include <drivers/keyboard.h>
+#include <drivers/terminal.h>
+#include "mm/memory.h"
+#include "mm/vm.h"
+
+static lock_class_t epoll_class = LOCK_CLASS_INIT("epoll");
+static lock_class_t epoll_list_class = LOCK_CLASS_INIT("epoll list");
+static spinlock_t epoll_list_lock = SPINLOCK_INIT_CLASS(&epoll_list_class);
+static list_node_t epoll_list = LIST_HEAD_INIT(epoll_list);
+
+// file->epoll_items of every file; taken before any ep->mutex
+static mutex_t epoll_mutex = MUTEX_INIT(epoll_mutex);
+
+typedef struct {
+    wait_entry_t entry;
+    epoll_t* ep;
+    ktimer_t timer;
+    volatile int timer_done;     // the callback no longer touches this frame
+} epoll_waiter_t;
+
+static void epoll_close(fs_node_t* node);
+
+static epoll_t* epoll_from_file(file_t* file) {
+    if (!file || !file->node || file->node->close != epoll_close) {
+        return NULL;
+    }
+    return (epoll_t*)file->node->device;
+}
+
+// the file's readiness; with a table, also hook its wait queues
+static uint32_t file_poll(file_t* file, poll_table_t* table) {
+    fs_node_t* node = file->node;
+
+    if (!node) {
+        return keyboard_poll(table) | EPOLLOUT;
+    }
+    if (node->poll) {
+        return node->poll(node, table);
+    }
+    return EPOLLIN | EPOLLOUT;
+}
+
+static uint32_t item_poll(epoll_item_t* item, poll_table_t* table) {
+    return file_poll(item->file, table) & (item->events | EPOLLERR | EPOLLHUP);
+}
+
+// ep->lock held
+static void make_ready(epoll_item_t* item) {
+    if (!item->ready) {
+        item->ready = true;
+        list_add_tail(&item->ep->ready, &item->ready_node);
+    }
+}
+
+// runs under the hooked queue's lock, often from an interrupt
+static void item_wake(wait_entry_t* entry) {
+    epoll_item_t* item = (epoll_item_t*)entry->data;
+    epoll_t* ep = item->ep;
+
+    uint32_t flags = spin_lock_irqsave(&ep->lock);
+    item->wakeups++;
+    make_ready(item);
+    spin_unlock_irqrestore(&ep->lock, flags);
+
+    wait_queue_wake_all(&ep->wq);
+}
+
+static void item_queue(poll_table_t* table, wait_queue_t* wq) {
+    epoll_item_t* item = (epoll_item_t*)table->data;
+
+    if (item->nwaits == EPOLL_MAX_QUEUES) {
+        return;
+    }
+
+    wait_entry_t* entry = &item->waits[item->nwaits++];
+    wait_entry_init(entry);
+    entry->func = item_wake;
+    entry->data = item;
+    entry->keep = true;
+    wait_queue_add(wq, entry);
+
+    // the poll method reads its state next; a waker that changed it
+    // before this point either sees the entry or is seen by that read
+    smp_mb();
+}
+
+// unhook and free; epoll_mutex and ep->mutex held
+static void item_remove(epoll_t* ep, epoll_item_t* item) {
+    // once off its queues no callback can be running on the item
+    for (uint32_t i = 0; i < item->nwaits; i++) {
+        wait_queue_remove(item->waits[i].queue, &item->waits[i]);
+    }
+
+    uint32_t flags = spin_lock_irqsave(&ep->lock);
+    if (item->ready) {
+        list_del(&item->ready_node);
+    }
+    spin_unlock_irqrestore(&ep->lock, flags);
+
+    list_del(&item->node);
+    list_del(&item->file_node);
+    ep->nitems--;
+
+    kfree(item);
+}
+
+void epoll_file_release(file_t* file) {
+    mutex_lock(&epoll_mutex);
+
+    while (!list_empty(&file->epoll_items)) {
+        epoll_item_t* item = list_entry(file->epoll_items.next, epoll_item_t, file_node);
+        epoll_t* ep = item->ep;
+
+        mutex_lock(&ep->mutex);
+        item_remove(ep, item);
+        mutex_unlock(&ep->mutex);
+    }
+
+    mutex_unlock(&epoll_mutex);
+}
+
+static void epoll_close(fs_node_t* node) {
+    epoll_t* ep = (epoll_t*)node->device;
+
+    mutex_lock(&epoll_mutex);
+    mutex_lock(&ep->mutex);
+    while (!list_empty(&ep->items)) {
+        item_remove(ep, list_entry(ep->items.next, epoll_item_t, node));
+    }
+    mutex_unlock(&ep->mutex);
+    mutex_unlock(&epoll_mutex);
+
+    uint32_t flags = spin_lock_irqsave(&epoll_list_lock);
+    list_del(&ep->list_node);
+    spin_unlock_irqrestore(&epoll_list_lock, flags);
+
+    kfree(ep);
+}
+
+int epoll_create(void) {
+    epoll_t* ep = (epoll_t*)kmalloc(sizeof(epoll_t));
+    if (!ep) {
+        terminal_writestring("ERROR: Not enough memory for an epoll instance\n");
+        return -1;
+    }
+
+    memset(ep, 0, sizeof(epoll_t));
+    mutex_init(&ep->mutex);
+    spin_lock_init_class(&ep->lock, &epoll_class);
+    list_init(&ep->items);
+    list_init(&ep->ready);
+    wait_queue_init(&ep->wq);
+
+    const char* name = "epoll";
+    for (uint32_t i = 0; name[i]; i++) {
+        ep->node.name[i] = name[i];
+    }
+    ep->node.type = FS_CHARDEVICE;
+    ep->node.mask = FS_PERM_READ;
+    ep->node.close = epoll_close;
+    ep->node.device = ep;
+
+    file_t* file = file_alloc(&ep->node, O_RDONLY);
+    if (!file) {
+        kfree(ep);
+        terminal_writestring("ERROR: Not enough memory to open an epoll instance\n");
+        return -1;
+    }
+
+    uint32_t flags = spin_lock_irqsave(&epoll_list_lock);
+    list_add_tail(&epoll_list, &ep->list_node);
+    spin_unlock_irqrestore(&epoll_list_lock, flags);
+
+    // from here on the last file_put frees the instance
+    int fd = fd_alloc(fdtable_current(), file);
+    if (fd < 0) {
+        file_put(file);
+    }
+    return fd;
+}
+
+static epoll_item_t* item_find(epoll_t* ep, int fd, file_t* file) {
+    list_node_t* pos;
+
+    list_for_each(pos, &ep->items) {
+        epoll_item_t* item = list_entry(pos, epoll_item_t, node);
+        if (item->fd == fd && item->file == file) {
+            return item;
+        }
+    }
+    return NULL;
+}
+
+static int item_add(epoll_t* ep, int fd, file_t* file, const epoll_event_t* event) {
+    epoll_item_t* item = (epoll_item_t*)kmalloc(sizeof(epoll_item_t));
+    if (!item) {
+        terminal_writestring("ERROR: Not enough memory to watch a descriptor\n");
+        return -1;
+    }
+
+    memset(item, 0, sizeof(epoll_item_t));
+    list_init(&item->ready_node);
+    item->ep = ep;
+    item->fd = fd;
+    item->file = file;
+    item->events = event->events;
+    item->data = event->data;
+
+    list_add_tail(&ep->items, &item->node);
+    list_add_tail(&file->epoll_items, &item->file_node);
+    ep->nitems++;
+
+    poll_table_t table = { item_queue, item };
+    uint32_t mask = item_poll(item, &table);
+
+    // already ready: it will not see a wakeup for what happened before
+    if (mask) {
+        uint32_t flags = spin_lock_irqsave(&ep->lock);
+        make_ready(item);
+        spin_unlock_irqrestore(&ep->lock, flags);
+        wait_queue_wake_all(&ep->wq);
+    }
+    return 0;
+}
+
+static void item_modify(epoll_t* ep, epoll_item_t* item, const epoll_event_t* event) {
+    uint32_t flags = spin_lock_irqsave(&ep->lock);
+    item->events = event->events;
+    item->data = event->data;
+    spin_unlock_irqrestore(&ep->lock, flags);
+
+    // the new interest may already be met
+    if (item_poll(item, NULL)) {
+        flags = spin_lock_irqsave(&ep->lock);
+        make_ready(item);
+        spin_unlock_irqrestore(&ep->lock, flags);
+        wait_queue_wake_all(&ep->wq);
+    }
+}
+
+// both files referenced by the caller, so neither is released meanwhile
+static int do_ctl(epoll_t* ep, int op, int fd, file_t* file, const epoll_event_t* event) {
+    epoll_event_t copy;
+    int result = 0;
+
+    if (!ep) {
+        terminal_writestring("ERROR: Not an epoll descriptor\n");
+        return -1;
+    }
+    if (!file) {
+        terminal_writestring("ERROR: Invalid file descriptor\n");
+        return -1;
+    }
+    if (epoll_from_file(file)) {
+        terminal_writestring("ERROR: Cannot watch an epoll descriptor\n");
+        return -1;
+    }
+    if (op != EPOLL_CTL_DEL) {
+        if (!event) {
+            return -1;
+        }
+        copy = *event;
+    }
+
+    mutex_lock(&epoll_mutex);
+    mutex_lock(&ep->mutex);
+    epoll_item_t* item = item_find(ep, fd, file);
+
+    if (op == EPOLL_CTL_ADD && !item) {
+        result = item_add(ep, fd, file, &copy);
+    } else if (op == EPOLL_CTL_MOD && item) {
+        item_modify(ep, item, &copy);
+    } else if (op == EPOLL_CTL_DEL && item) {
+        item_remove(ep, item);
+    } else if (op == EPOLL_CTL_ADD) {
+        terminal_writestring("ERROR: Descriptor is already watched\n");
+        result = -1;
+    } else if (op == EPOLL_CTL_MOD || op == EPOLL_CTL_DEL) {
+        terminal_writestring("ERROR: Descriptor is not watched\n");
+        result = -1;
+    } else {
+        terminal_writestring("ERROR: Bad epoll_ctl operation\n");
+        result = -1;
+    }
+
+    mutex_unlock(&ep->mutex);
+    mutex_unlock(&epoll_mutex);
+    return result;
+}
+
+int epoll_ctl(int epfd, int op, int fd, const epoll_event_t* event) {
+    // the event is only read for ADD and MOD
+    if (op != EPOLL_CTL_DEL && event &&
+        vm_check_user(event, sizeof(epoll_event_t), false) != 0) {
+        terminal_writestring("ERROR: Bad epoll event\n");
+        return -1;
+    }
+
+    fdtable_t* table = fdtable_current();
+    file_t* epfile = file_get(fd_get(table, epfd));
+    file_t* file = file_get(fd_get(table, fd));
+
+    int result = do_ctl(epoll_from_file(epfile), op, fd, file, event);
+
+    // may be the last references, which take epoll_mutex themselves
+    file_put(file);
+    file_put(epfile);
+    return result;
+}
+
+// report what is ready now, at most max events. Only the ready list is
+// walked; each item on it is asked again, since a wakeup only says
+// something may have changed.
+static int harvest(epoll_t* ep, epoll_event_t* events, uint32_t max) {
+    list_node_t batch;
+    uint32_t count = 0;
+
+    list_init(&batch);
+
+    mutex_lock(&ep->mutex);
+
+    uint32_t flags = spin_lock_irqsave(&ep->lock);
+    list_splice_tail_init(&ep->ready, &batch);
+    spin_unlock_irqrestore(&ep->lock, flags);
+
+    // items in the batch keep ready set, so callbacks leave them alone
+    while (!list_empty(&batch) && count < max) {
+        epoll_item_t* item = list_entry(batch.next, epoll_item_t, ready_node);
+        list_del(&item->ready_node);
+
+        // a wakeup after this read is caught below, even if the poll missed it
+        uint32_t seen = item->wakeups;
+        uint32_t mask = item_poll(item, NULL);
+
+        if (mask) {
+            events[count].events = mask;
+            events[count].data = item->data;
+            count++;
+        }
+
+        flags = spin_lock_irqsave(&ep->lock);
+        if ((mask && !(item->events & EPOLLET)) || item->wakeups != seen) {
+            list_add_tail(&ep->ready, &item->ready_node);
+        } else {
+            item->ready = false;
+        }
+        spin_unlock_irqrestore(&ep->lock, flags);
+    }
+
+    // not reported for lack of room, still ready for the next call
+    flags = spin_lock_irqsave(&ep->lock);
+    list_splice_tail_init(&batch, &ep->ready);
+    spin_unlock_irqrestore(&ep->lock, flags);
+
+    ep->reported += count;
+    mutex_unlock(&ep->mutex);
+    return (int)count;
+}
+
+static void epoll_timeout(void* data) {
+    epoll_waiter_t* waiter = (epoll_waiter_t*)data;
+    uint32_t flags = spin_lock_irqsave(&waiter->ep->wq.lock);
+
+    // a callback may have woken us just before the timer fired
+    if (!waiter->entry.woken) {
+        wait_entry_wake_locked(&waiter->entry);
+    }
+
+    spin_unlock_irqrestore(&waiter->ep->wq.lock, flags);
+    waiter->timer_done = 1;
+}
+
+// sleep until something is put on the ready list or expires passes;
+// -1 when the process is killed first
+static int epoll_sleep(epoll_t* ep, bool timed, uint32_t expires) {
+    epoll_waiter_t waiter;
+    int result = 0;
+
+    uint32_t flags = spin_lock_irqsave(&ep->wq.lock);
+
+    // callbacks fill the ready list before they take wq.lock to wake us
+    if (!list_empty(&ep->ready)) {
+        spin_unlock_irqrestore(&ep->wq.lock, flags);
+        return 0;
+    }
+
+    waiter.ep = ep;
+    waiter.timer_done = 0;
+    wait_entry_init(&waiter.entry);
+    wait_queue_add_locked(&ep->wq, &waiter.entry);
+    spin_unlock(&ep->wq.lock);
+
+    if (timed) {
+        ktimer_init(&waiter.timer, epoll_timeout, &waiter);
+        ktimer_add(&waiter.timer, expires);
+    }
+
+    if (wait_entry_block_killable(&waiter.entry) != 0) {
+        spin_lock(&ep->wq.lock);
+        list_del(&waiter.entry.node);
+        spin_unlock(&ep->wq.lock);
+        result = -1;
+    }
+
+    // the callback may be running on another CPU, wait it out
+    if (timed && !ktimer_cancel(&waiter.timer)) {
+        while (!waiter.timer_done) {
+            cpu_relax();
+        }
+    }
+
+    irq_restore(flags);
+    return result;
+}
+
+static int do_wait(epoll_t* ep, epoll_event_t* events, uint32_t max, int timeout_ms) {
+    if (!ep) {
+        terminal_writestring("ERROR: Not an epoll descriptor\n");
+        return -1;
+    }
+    if (!events || max == 0) {
+        return -1;
+    }
+
+    ep->waits++;
+    uint32_t expires = get_ticks() + (timeout_ms > 0 ? ms_to_ticks((uint32_t)timeout_ms) : 0);
+
+    while (1) {
+        int count = harvest(ep, events, max);
+
+        if (count > 0 || timeout_ms == 0) {
+            return count;
+        }
+        if (timeout_ms > 0 && (int32_t)(get_ticks() - expires) >= 0) {
+            return 0;
+        }
+
+        if (epoll_sleep(ep, timeout_ms > 0, expires) != 0) {
+            return -1;
+        }
+    }
+}
+
+int epoll_wait(int epfd, epoll_event_t* events, uint32_t max, int timeout_ms) {
+    // harvest writes up to max events straight into the caller's array
+    if (max > 0xFFFFFFFF / sizeof(epoll_event_t) ||
+        vm_check_user(events, max * sizeof(epoll_event_t), true) != 0) {
+        terminal_writestring("ERROR: Bad epoll event buffer\n");
+        return -1;
+    }
+
+    // a close while we sleep must not free the instance under us
+    file_t* epfile = file_get(fd_get(fdtable_current(), epfd));
+
+    int count = do_wait(epoll_from_file(epfile), events, max, timeout_ms);
+
+    file_put(epfile);
+    return count;
+}
+
+void epoll_dump(void) {
+    bool any = false;
+    list_node_t* pos;
+
+    terminal_writestring("Watched  Ready  Waits     Events\n");
+
+    uint32_t flags = spin_lock_irqsave(&epoll_list_lock);
+
+    list_for_each(pos, &epoll_list) {
+        epoll_t* ep = list_entry(pos, epoll_t, list_node);
+        uint32_t ready = 0;
+        list_node_t* r;
+        any = true;
+
+        spin_lock(&ep->lock);
+        list_for_each(r, &ep->ready) {
+            ready++;
+        }
+        spin_unlock(&ep->lock);
+
+        terminal_print_uint(ep->nitems);
+        terminal_writestring("        ");
+        terminal_print_uint(ready);
+        terminal_writestring("      ");
+        terminal_print_uint(ep->waits);
+        terminal_writestring("         ");
+        terminal_print_uint(ep->reported);
+        terminal_writestring("\n");
+    }
+
+    spin_unlock_irqrestore(&epoll_list_lock, flags);
+
+    if (!any) {
+        terminal_writestring("No epoll instances\n");
+    }
+}
@@ -0,0 +1,284 @@
+#include <kernel/exec.h>
+#include <kernel/elf.h>
+#include <kernel/fs.h>
+#include <kernel/irqflags.h>
+#include <drivers/terminal.h>
+#include "mm/memory.h"
+#include "mm/vm.h"
+#include "mm/pagecache.h"
+
+// drops the kernel stack and enters ring 3 (cpu/syscall_entry.asm)
+extern void user_exec_enter(uint32_t eip, uint32_t esp, uint32_t kernel_stack_top) __attribute__((noreturn));
+
+// path and arguments, copied out of the caller's address space into one page
+typedef struct {
+    char path[EXEC_PATH_MAX];
+    uint32_t argc;
+    uint32_t used;                        // bytes of strings[]
+    uint32_t arg[EXEC_MAX_ARGS];          // offsets into strings[]
+    char strings[];
+} exec_args_t;
+
+#define EXEC_STRINGS_SIZE  (PAGE_SIZE - sizeof(exec_args_t))
+
+static int copy_args(exec_args_t* args, const char* path, char* const argv[]) {
+    uint32_t i;
+
+    for (i = 0; path[i] && i < EXEC_PATH_MAX - 1; i++) {
+        args->path[i] = path[i];
+    }
+    if (path[i]) {
+        terminal_writestring("ERROR: Path too long\n");
+        return -1;
+    }
+    args->path[i] = '\0';
+
+    args->argc = 0;
+    args->used = 0;
+
+    for (; argv && argv[args->argc]; args->argc++) {
+        const char* arg = argv[args->argc];
+
+        if (args->argc == EXEC_MAX_ARGS) {
+            terminal_writestring("ERROR: Too many arguments\n");
+            return -1;
+        }
+
+        args->arg[args->argc] = args->used;
+        do {
+            if (args->used == EXEC_STRINGS_SIZE) {
+                terminal_writestring("ERROR: Arguments too long\n");
+                return -1;
+            }
+            args->strings[args->used++] = *arg;
+        } while (*arg++);
+    }
+
+    return 0;
+}
+
+// read through the page cache, so the headers' page is already there
+// when the program first touches it
+static int read_file(fs_node_t* node, uint32_t offset, void* buf, uint32_t size) {
+    uint8_t* out = (uint8_t*)buf;
+
+    if (offset > node->length || size > node->length - offset) {
+        return -1;
+    }
+
+    while (size > 0) {
+        cached_page_t* page = pagecache_get(node, offset / PAGE_SIZE);
+        if (!page) {
+            return -1;
+        }
+
+        uint32_t in_page = offset % PAGE_SIZE;
+        uint32_t chunk = PAGE_SIZE - in_page < size ? PAGE_SIZE - in_page : size;
+
+        memcpy(out, (uint8_t*)page->data + in_page, chunk);
+        out += chunk;
+        offset += chunk;
+        size -= chunk;
+    }
+    return 0;
+}
+
+// record the PT_LOAD segments as areas, nothing is mapped yet
+static int load_image(fs_node_t* node, mm_t* mm, uint32_t* entry) {
+    elf32_ehdr_t ehdr;
+    uint32_t segments = 0;
+
+    if (read_file(node, 0, &ehdr, sizeof(ehdr)) != 0 || ehdr.magic != ELF_MAGIC) {
+        terminal_writestring("ERROR: Not an ELF file\n");
+        return -1;
+    }
+
+    if (ehdr.class != ELF_CLASS_32 || ehdr.data != ELF_DATA_LSB || ehdr.type != ELF_TYPE_EXEC ||
+        ehdr.machine != ELF_MACHINE_386 || ehdr.phentsize != sizeof(elf32_phdr_t) ||
+        ehdr.phnum > ELF_MAX_PHDRS) {
+        terminal_writestring("ERROR: Not an i386 ELF executable\n");
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < ehdr.phnum; i++) {
+        elf32_phdr_t phdr;
+
+        if (read_file(node, ehdr.phoff + i * sizeof(phdr), &phdr, sizeof(phdr)) != 0) {
+            terminal_writestring("ERROR: Truncated program header\n");
+            return -1;
+        }
+
+        if (phdr.type != ELF_PT_LOAD || phdr.memsz == 0) {
+            continue;
+        }
+
+        if (phdr.filesz > phdr.memsz || phdr.offset > node->length ||
+            phdr.filesz > node->length - phdr.offset) {
+            terminal_writestring("ERROR: Segment outside the file\n");
+            return -1;
+        }
+
+        // file pages are mapped as they are, so they must line up
+        if ((phdr.vaddr ^ phdr.offset) & (PAGE_SIZE - 1)) {
+            terminal_writestring("ERROR: Segment not page aligned in the file\n");
+            return -1;
+        }
+
+        uint32_t skew = phdr.vaddr & (PAGE_SIZE - 1);
+        uint32_t flags = 0;
+
+        if (phdr.flags & ELF_PF_R) flags |= VMA_READ;
+        if (phdr.flags & ELF_PF_W) flags |= VMA_WRITE;
+        if (phdr.flags & ELF_PF_X) flags |= VMA_EXEC;
+
+        if (mm_map(mm, phdr.vaddr - skew, phdr.memsz + skew, flags, node,
+                   phdr.offset - skew, phdr.filesz ? phdr.filesz + skew : 0) != 0) {
+            return -1;
+        }
+        segments++;
+    }
+
+    if (segments == 0) {
+        terminal_writestring("ERROR: Executable has nothing to load\n");
+        return -1;
+    }
+
+    *entry = ehdr.entry;
+    return 0;
+}
+
+// argc, argv[], NULL, envp NULL, auxv AT_NULL; the stack faults in as we write
+static uint32_t push_args(const exec_args_t* args) {
+    uint32_t sp = USER_STACK_TOP;
+    uint32_t argv[EXEC_MAX_ARGS];
+
+    for (int i = (int)args->argc - 1; i >= 0; i--) {
+        const char* arg = args->strings + args->arg[i];
+        uint32_t len = 1;
+
+        while (arg[len - 1]) {
+            len++;
+        }
+        sp -= len;
+        memcpy((void*)sp, arg, len);
+        argv[i] = sp;
+    }
+
+    uint32_t* stack = (uint32_t*)(sp & ~0xF) - (args->argc + 5);
+
+    stack[0] = args->argc;
+    for (uint32_t i = 0; i < args->argc; i++) {
+        stack[1 + i] = argv[i];
+    }
+    stack[args->argc + 1] = 0;
+    stack[args->argc + 2] = 0;
+    stack[args->argc + 3] = 0;
+    stack[args->argc + 4] = 0;
+
+    return (uint32_t)stack;
+}
+
+static void set_name(process_t* process, const char* path) {
+    const char* name = path;
+    int i;
+
+    for (const char* p = path; *p; p++) {
+        if (*p == '/' && p[1]) {
+            name = p + 1;
+        }
+    }
+
+    for (i = 0; name[i] && i < 31; i++) {
+        process->name[i] = name[i];
+    }
+    process->name[i] = '\0';
+}
+
+// load and run; frees args, returns only on failure
+static int exec_args(exec_args_t* args) {
+    process_t* self = current_process;
+    uint32_t entry;
+
+    if (!self->kernel_stack) {
+        terminal_writestring("ERROR: exec needs a process with its own kernel stack\n");
+        page_free(args);
+        return -1;
+    }
+
+    fs_node_t* node = fs_resolve_path(args->path);
+    if (!node || node->type != FS_FILE) {
+        terminal_writestring("ERROR: Executable not found: ");
+        terminal_writestring(args->path);
+        terminal_writestring("\n");
+        page_free(args);
+        return -1;
+    }
+
+    mm_t* mm = mm_create();
+    if (!mm) {
+        page_free(args);
+        return -1;
+    }
+
+    if (load_image(node, mm, &entry) != 0 ||
+        mm_map(mm, USER_STACK_TOP - USER_STACK_SIZE, USER_STACK_SIZE,
+               VMA_READ | VMA_WRITE, NULL, 0, 0) != 0) {
+        mm_destroy(mm);
+        page_free(args);
+        return -1;
+    }
+
+    // no way back from here, the old program is gone
+    uint32_t flags = irq_save();
+    mm_t* old = self->mm;
+    self->mm = mm;
+    vm_switch(mm);
+    irq_restore(flags);
+
+    mm_destroy(old);
+    set_name(self, args->path);
+
+    uint32_t sp = push_args(args);
+    page_free(args);
+
+    process_account_user_enter();
+    user_exec_enter(entry, sp, (uint32_t)self->kernel_stack + self->kernel_stack_size);
+}
+
+int process_exec(const char* path, char* const argv[]) {
+    phys_addr_t phys;
+    exec_args_t* args = (exec_args_t*)page_alloc(&phys);
+
+    if (!path || !args) {
+        page_free(args);
+        return -1;
+    }
+
+    // the caller's strings go away with its address space
+    if (copy_args(args, path, argv) != 0) {
+        page_free(args);
+        return -1;
+    }
+
+    return exec_args(args);
+}
+
+static void exec_start(void* arg) {
+    exec_args((exec_args_t*)arg);
+}
+
+process_t* exec_spawn(const char* path, char* const argv[]) {
+    phys_addr_t phys;
+    exec_args_t* args = (exec_args_t*)page_alloc(&phys);
+
+    if (!path || !args || copy_args(args, path, argv) != 0) {
+        page_free(args);
+        return NULL;
+    }
+
+    process_t* process = process_create_arg("exec", (void*)exec_start, args);
+    if (!process) {
+        page_free(args);
+    }
+    return process;
+}
@@ -0,0 +1,354 @@
+#include <kernel/fdtable.h>
+#include <kernel/process.h>
+#include <kernel/epoll.h>
+#include <kernel/math64.h>
+#include <drivers/terminal.h>
+#include "mm/memory.h"
+#include "mm/pagecache.h"
+
+extern uint32_t get_tick_count(void);
+
+#define BITS_PER_WORD  32
+
+// used before process_init and by kernel code without a process
+static fdtable_t* boot_table = NULL;
+
+// references are taken and dropped outside any table lock, on any CPU
+static inline void atomic_inc(volatile uint32_t* value) {
+    __asm__ volatile("lock incl %0" : "+m"(*value) : : "memory");
+}
+
+// the new value
+static inline uint32_t atomic_dec_return(volatile uint32_t* value) {
+    uint32_t old = (uint32_t)-1;
+    __asm__ volatile("lock xaddl %0, %1" : "+r"(old), "+m"(*value) : : "memory");
+    return old - 1;
+}
+
+static lock_class_t fdtable_class = LOCK_CLASS_INIT("fdtable");
+
+file_t* file_alloc(fs_node_t* node, uint32_t flags) {
+    file_t* file = (file_t*)kmalloc(sizeof(file_t));
+    if (!file) {
+        return NULL;
+    }
+
+    file->node = node;
+    file->offset = 0;
+    file->flags = flags;
+    file->refcount = 1;
+    list_init(&file->epoll_items);
+    return file;
+}
+
+file_t* file_get(file_t* file) {
+    if (file) {
+        atomic_inc(&file->refcount);
+    }
+    return file;
+}
+
+void file_put(file_t* file) {
+    if (!file || atomic_dec_return(&file->refcount) > 0) {
+        return;
+    }
+
+    // interest lists do not hold a reference, they let go here
+    if (!list_empty(&file->epoll_items)) {
+        epoll_file_release(file);
+    }
+
+    if (file->node) {
+        fs_close(file->node);
+    }
+    kfree(file);
+}
+
+int file_write(file_t* file, const void* buf, uint32_t count) {
+    fs_node_t* node = file->node;
+    uint32_t written = 0;
+
+    if (node->write) {
+        written = node->write(node, file->offset, count, (uint8_t*)buf);
+    } else {
+        uint32_t new_size = file->offset + count;
+
+        if (new_size > node->length) {
+            uint8_t* contents = (uint8_t*)krealloc(node->contents, new_size);
+            if (!contents) {
+                terminal_writestring("ERROR: File could not be resized - insufficient memory\n");
+                return -1;
+            }
+            node->contents = contents;
+
+            memset((uint8_t*)node->contents + node->length, 0, new_size - node->length);
+            node->length = new_size;
+        }
+
+        if (count > 0) {
+            memcpy((uint8_t*)node->contents + file->offset, buf, count);
+            written = count;
+        }
+    }
+
+    // programs mapping these pages see the new data
+    pagecache_update(node, file->offset, written);
+
+    file->offset += written;
+    node->modified_time = get_tick_count();
+    return written;
+}
+
+// grow to hold at least 'min' descriptors
+static int fdtable_expand(fdtable_t* table, uint32_t min) {
+    uint32_t size = table->max_fds ? table->max_fds : FDTABLE_INITIAL;
+
+    while (size < min) {
+        size *= 2;
+    }
+    if (size > FDTABLE_MAX) {
+        size = FDTABLE_MAX;
+    }
+    if (size < min || size == table->max_fds) {
+        return -1;
+    }
+
+    file_t** files = (file_t**)kmalloc(size * sizeof(file_t*));
+    uint32_t* open_map = (uint32_t*)kmalloc(size / BITS_PER_WORD * sizeof(uint32_t));
+    if (!files || !open_map) {
+        return -1;
+    }
+
+    memset(files, 0, size * sizeof(file_t*));
+    memset(open_map, 0, size / BITS_PER_WORD * sizeof(uint32_t));
+
+    if (table->max_fds) {
+        memcpy(files, table->files, table->max_fds * sizeof(file_t*));
+        memcpy(open_map, table->open_map, table->max_fds / BITS_PER_WORD * sizeof(uint32_t));
+        kfree(table->files);
+        kfree(table->open_map);
+    }
+
+    table->files = files;
+    table->open_map = open_map;
+    table->max_fds = size;
+    return 0;
+}
+
+static void fd_set_used(fdtable_t* table, uint32_t fd) {
+    table->open_map[fd / BITS_PER_WORD] |= 1u << (fd % BITS_PER_WORD);
+    table->count++;
+}
+
+static void fd_clear_used(fdtable_t* table, uint32_t fd) {
+    table->open_map[fd / BITS_PER_WORD] &= ~(1u << (fd % BITS_PER_WORD));
+    table->count--;
+    if (fd < table->next_fd) {
+        table->next_fd = fd;
+    }
+}
+
+// lowest free slot at or above 'start', -1 if the table is full
+static int find_next_zero(fdtable_t* table, uint32_t start) {
+    uint32_t words = table->max_fds / BITS_PER_WORD;
+
+    for (uint32_t word = start / BITS_PER_WORD; word < words; word++) {
+        uint32_t bits = table->open_map[word];
+
+        // ignore slots below start in the first word
+        if (word == start / BITS_PER_WORD) {
+            bits |= (1u << (start % BITS_PER_WORD)) - 1;
+        }
+
+        if (bits != 0xFFFFFFFF) {
+            return (int)(word * BITS_PER_WORD + ffz32(bits));
+        }
+    }
+
+    return -1;
+}
+
+fdtable_t* fdtable_create(void) {
+    fdtable_t* table = (fdtable_t*)kmalloc(sizeof(fdtable_t));
+    if (!table) {
+        return NULL;
+    }
+
+    memset(table, 0, sizeof(fdtable_t));
+    ticket_lock_init_class(&table->lock, &fdtable_class);
+    if (fdtable_expand(table, FDTABLE_INITIAL) != 0) {
+        return NULL;
+    }
+
+    // stdin, stdout and stderr share one console file
+    file_t* console = file_alloc(NULL, 0);
+    if (!console) {
+        return NULL;
+    }
+
+    fd_alloc(table, console);
+    fd_alloc(table, file_get(console));
+    fd_alloc(table, file_get(console));
+
+    return table;
+}
+
+void fdtable_destroy(fdtable_t* table) {
+    if (!table) {
+        return;
+    }
+
+    for (uint32_t fd = 0; fd < table->max_fds && table->count > 0; fd++) {
+        if (table->files[fd]) {
+            fd_close(table, (int)fd);
+        }
+    }
+
+    kfree(table->files);
+    kfree(table->open_map);
+    kfree(table);
+}
+
+fdtable_t* fdtable_current(void) {
+    process_t* current = process_get_current();
+
+    if (current && current->files) {
+        return current->files;
+    }
+
+    if (!boot_table) {
+        boot_table = fdtable_create();
+    }
+    return boot_table;
+}
+
+// place the file in a known free slot
+static void fd_install(fdtable_t* table, int fd, file_t* file) {
+    table->files[fd] = file;
+    fd_set_used(table, (uint32_t)fd);
+}
+
+// table lock held
+static int fd_alloc_locked(fdtable_t* table, file_t* file) {
+    int fd = find_next_zero(table, table->next_fd);
+    if (fd < 0) {
+        if (fdtable_expand(table, table->max_fds + 1) != 0) {
+            terminal_writestring("ERROR: Maximum number of open files reached\n");
+            return -1;
+        }
+        fd = find_next_zero(table, table->next_fd);
+    }
+
+    fd_install(table, fd, file);
+    table->next_fd = (uint32_t)fd + 1;
+    return fd;
+}
+
+static file_t* fd_get_locked(fdtable_t* table, int fd) {
+    if (fd < 0 || (uint32_t)fd >= table->max_fds) {
+        return NULL;
+    }
+    return table->files[fd];
+}
+
+// empty the slot and hand back its file for file_put outside the lock
+static file_t* fd_remove_locked(fdtable_t* table, int fd) {
+    file_t* file = fd_get_locked(table, fd);
+    if (file) {
+        table->files[fd] = NULL;
+        fd_clear_used(table, (uint32_t)fd);
+    }
+    return file;
+}
+
+int fd_alloc(fdtable_t* table, file_t* file) {
+    if (!table || !file) {
+        return -1;
+    }
+
+    uint32_t flags = ticket_lock_irqsave(&table->lock);
+    int fd = fd_alloc_locked(table, file);
+    ticket_unlock_irqrestore(&table->lock, flags);
+    return fd;
+}
+
+file_t* fd_get(fdtable_t* table, int fd) {
+    if (!table) {
+        return NULL;
+    }
+
+    uint32_t flags = ticket_lock_irqsave(&table->lock);
+    file_t* file = fd_get_locked(table, fd);
+    ticket_unlock_irqrestore(&table->lock, flags);
+    return file;
+}
+
+int fd_close(fdtable_t* table, int fd) {
+    if (!table) {
+        return -1;
+    }
+
+    uint32_t flags = ticket_lock_irqsave(&table->lock);
+    file_t* file = fd_remove_locked(table, fd);
+    ticket_unlock_irqrestore(&table->lock, flags);
+
+    if (!file) {
+        return -1;
+    }
+    file_put(file);
+    return 0;
+}
+
+int fd_dup(fdtable_t* table, int oldfd) {
+    if (!table) {
+        return -1;
+    }
+
+    uint32_t flags = ticket_lock_irqsave(&table->lock);
+    int fd = -1;
+    file_t* file = fd_get_locked(table, oldfd);
+    if (file) {
+        file_get(file);
+        fd = fd_alloc_locked(table, file);
+        if (fd < 0) {
+            atomic_dec_return(&file->refcount);    // the descriptor still holds one
+        }
+    }
+    ticket_unlock_irqrestore(&table->lock, flags);
+    return fd;
+}
+
+int fd_dup2(fdtable_t* table, int oldfd, int newfd) {
+    if (!table || newfd < 0 || newfd >= FDTABLE_MAX) {
+        return -1;
+    }
+
+    uint32_t flags = ticket_lock_irqsave(&table->lock);
+    file_t* file = fd_get_locked(table, oldfd);
+    file_t* old = NULL;
+
+    if (!file) {
+        ticket_unlock_irqrestore(&table->lock, flags);
+        return -1;
+    }
+
+    if (oldfd != newfd) {
+        if ((uint32_t)newfd >= table->max_fds &&
+            fdtable_expand(table, (uint32_t)newfd + 1) != 0) {
+            ticket_unlock_irqrestore(&table->lock, flags);
+            return -1;
+        }
+
+        // take the reference first in case newfd held the last one
+        file_get(file);
+        old = fd_remove_locked(table, newfd);
+        fd_install(table, newfd, file);
+    }
+
+    ticket_unlock_irqrestore(&table->lock, flags);
+
+    if (old) {
+        file_put(old);
+    }
+    return newfd;
+}
@@ -1,5 +1,7 @@
 #include <kernel/fs.h>
 #include <kernel/types.h>
+#include <kernel/sync/spinlock.h>
+#include <kernel/sync/rcu.h>
 #include <drivers/terminal.h>
 #include "mm/memory.h"
 #include <libc/string.h>
@@ -7,6 +9,14 @@
 
 fs_node_t* fs_root = NULL;
 
+// Dizin ağacı yol çözümlemede kilitsiz (RCU) okunur; yalnızca ağacı
+// değiştirenler bu kilidi alır
+static lock_class_t fs_tree_class = LOCK_CLASS_INIT("vfs");
+static spinlock_t fs_tree_lock = SPINLOCK_INIT_CLASS(&fs_tree_class);
+
+static fs_node_t* dir_readdir(fs_node_t* node, uint32_t index);
+static fs_node_t* dir_finddir(fs_node_t* node, char* name);
+
 void fs_init(void) {
     terminal_writestring("Dosya sistemi baslatiliyor...\n");
     
@@ -46,8 +56,8 @@ fs_node_t* fs_create_node(char* name, fs_node_type_t type) {
     
 
     if (type == FS_DIRECTORY) {
-        node->readdir = fs_readdir;
-        node->finddir = fs_finddir;
+        node->readdir = dir_readdir;
+        node->finddir = dir_finddir;
     }
     
     if (type == FS_FILE) {
@@ -69,17 +79,23 @@ void fs_add_node(fs_node_t* parent, fs_node_t* child) {
         return;
     }
     
+    uint32_t flags = spin_lock_irqsave(&fs_tree_lock);
+    
+    // Düğüm, okuyuculara görünmeden önce tamamen hazır olmalı
     child->parent = parent;
+    child->next = NULL;
     
     if (parent->children == NULL) {
-        parent->children = child;
+        rcu_assign_pointer(parent->children, child);
     } else {
         fs_node_t* current = parent->children;
         while (current->next != NULL) {
             current = current->next;
         }
-        current->next = child;
+        rcu_assign_pointer(current->next, child);
     }
+    
+    spin_unlock_irqrestore(&fs_tree_lock, flags);
 }
 
 int fs_remove_node(fs_node_t* parent, fs_node_t* node) {
@@ -90,9 +106,11 @@ int fs_remove_node(fs_node_t* parent, fs_node_t* node) {
         return -1;
     }
     
+    uint32_t flags = spin_lock_irqsave(&fs_tree_lock);
+    
     // Çocuk düğümü ebeveynden ayır
     if (parent->children == node) {
-        parent->children = node->next;
+        rcu_assign_pointer(parent->children, node->next);
     } else {
         fs_node_t* current = parent->children;
         while (current != NULL && current->next != node) {
@@ -100,12 +118,19 @@ int fs_remove_node(fs_node_t* parent, fs_node_t* node) {
         }
         
         if (current != NULL) {
-            current->next = node->next;
+            rcu_assign_pointer(current->next, node->next);
         } else {
+            spin_unlock_irqrestore(&fs_tree_lock, flags);
             return -1;
         }
     }
     
+    spin_unlock_irqrestore(&fs_tree_lock, flags);
+    
+    // Düğümde duran okuyucular node->next üzerinden devam edebilmeli,
+    // bağlantılar ancak hepsi çıktıktan sonra temizlenir
+    synchronize_rcu();
+    
     node->parent = NULL;
     node->next = NULL;
     
@@ -152,6 +177,32 @@ fs_node_t* fs_finddir(fs_node_t* node, char* name) {
     return NULL;
 }
 
+// Bellekteki dizinlerin varsayılan işlemleri, RCU okuma bölümünde çalışır
+static fs_node_t* dir_readdir(fs_node_t* node, uint32_t index) {
+    rcu_read_lock();
+    
+    fs_node_t* child = rcu_dereference(node->children);
+    while (child && index > 0) {
+        child = rcu_dereference(child->next);
+        index--;
+    }
+    
+    rcu_read_unlock();
+    return child;
+}
+
+static fs_node_t* dir_finddir(fs_node_t* node, char* name) {
+    rcu_read_lock();
+    
+    fs_node_t* child = rcu_dereference(node->children);
+    while (child && strcmp(child->name, name) != 0) {
+        child = rcu_dereference(child->next);
+    }
+    
+    rcu_read_unlock();
+    return child;
+}
+
 int fs_check_permission(fs_node_t* node, uint32_t access_mask, uint32_t uid, uint32_t gid) {
     if (!node) return 0;
     
@@ -213,6 +264,10 @@ fs_node_t* fs_resolve_path(const char* path) {
     char component[128];
     int i = 0, j = 0;
     
+    // Tüm yürüyüş tek okuma bölümünde; düğümler ağaçtan çıkarılsa da
+    // serbest bırakılmaz, dönen düğüm bölüm dışında da geçerlidir
+    rcu_read_lock();
+    
     while (path[i] != '\0') {
         j = 0;
         while (path[i] != '/' && path[i] != '\0' && j < 127) {
@@ -243,6 +298,7 @@ fs_node_t* fs_resolve_path(const char* path) {
 
         fs_node_t* next = fs_finddir(current, component);
         if (!next) {
+            rcu_read_unlock();
             return NULL; 
         }
         
@@ -252,12 +308,16 @@ fs_node_t* fs_resolve_path(const char* path) {
 
         if (current->type == FS_SYMLINK) {
             current = fs_readlink(current);
-            if (!current) return NULL;
+            if (!current) {
+                rcu_read_unlock();
+                return NULL;
+            }
         }
         
         if (path[i] == '/') i++;
     }
     
+    rcu_read_unlock();
     return current;
 }
 
@@ -0,0 +1,198 @@
+#include <kernel/futex.h>
+#include <kernel/sync/wait.h>
+#include <kernel/sync/spinlock.h>
+#include <kernel/irqflags.h>
+#include <kernel/list.h>
+#include <kernel/cpu/cpu.h>
+#include <kernel/process.h>
+#include "mm/memory.h"
+#include "mm/vm.h"
+
+typedef struct {
+    wait_entry_t entry;
+    phys_addr_t key;
+    uint64_t woken_at;       // TSC when futex_wake picked this waiter
+} futex_waiter_t;
+
+static wait_queue_t futex_queues[FUTEX_HASH_SIZE];
+static lock_class_t futex_class = LOCK_CLASS_INIT("futex");
+
+static futex_stats_t stats;
+static spinlock_t stats_lock = SPINLOCK_INIT;
+static bool have_tsc = false;
+
+void futex_init(void) {
+    for (int i = 0; i < FUTEX_HASH_SIZE; i++) {
+        wait_queue_init(&futex_queues[i]);
+        spin_lock_init_class(&futex_queues[i].lock, &futex_class);
+    }
+    futex_stats_reset();
+    have_tsc = (cpuid_edx(1) & CPUID_EDX_TSC) != 0;
+}
+
+// physical address of the word, 0 if it is not mapped. A word named
+// by user space must be on a user page, and inside the user part of
+// a program's own address space, or the wait would read kernel memory.
+static phys_addr_t futex_key(volatile uint32_t* uaddr, bool user) {
+    uint32_t addr = (uint32_t)uaddr;
+    page_directory_t* dir = get_kernel_directory();
+    process_t* current = current_process;
+
+    if (user && current && current->mm && addr >= USER_SPACE_END) {
+        return 0;
+    }
+
+    if (!dir) {
+        return user ? 0 : addr;     // paging is off, addresses are physical
+    }
+
+    // programs loaded by exec have their own directory
+    dir = vm_current_directory();
+
+    uint32_t* pte = (uint32_t*)get_page(addr, 0, dir);
+    if (!pte || !(*pte & MEMORY_PRESENT)) {
+        return 0;
+    }
+    if (user && !(*pte & MEMORY_USER)) {
+        return 0;
+    }
+    return (*pte & MEMORY_FRAME) | (addr & (PAGE_SIZE - 1));
+}
+
+static wait_queue_t* futex_queue(phys_addr_t key) {
+    // words are 4-byte aligned, the low bits carry nothing
+    uint32_t hash = (key >> 2) * 0x9E3779B1u;
+    return &futex_queues[hash >> (32 - FUTEX_HASH_BITS)];
+}
+
+static int do_wait(volatile uint32_t* uaddr, uint32_t val, bool user) {
+    if (!uaddr || ((uint32_t)uaddr & 3)) {
+        return -1;
+    }
+
+    phys_addr_t key = futex_key(uaddr, user);
+    if (!key) {
+        return -1;
+    }
+
+    wait_queue_t* wq = futex_queue(key);
+    futex_waiter_t waiter;
+
+    uint32_t flags = spin_lock_irqsave(&wq->lock);
+
+    // futex_wake takes the same lock, so a release that happens after
+    // this check cannot miss us
+    if (*uaddr != val) {
+        spin_unlock_irqrestore(&wq->lock, flags);
+
+        flags = spin_lock_irqsave(&stats_lock);
+        stats.wait_retries++;
+        spin_unlock_irqrestore(&stats_lock, flags);
+        return -1;
+    }
+
+    wait_entry_init(&waiter.entry);
+    waiter.key = key;
+    waiter.woken_at = 0;
+    wait_queue_add_locked(wq, &waiter.entry);
+    spin_unlock(&wq->lock);
+
+    if (wait_entry_block_killable(&waiter.entry) != 0) {
+        spin_lock(&wq->lock);
+        bool woken = waiter.entry.woken;
+        list_del(&waiter.entry.node);
+        spin_unlock(&wq->lock);
+
+        // a wake that raced with the kill was counted, so it stands
+        if (!woken) {
+            irq_restore(flags);
+            return -1;
+        }
+    }
+
+    uint32_t latency = 0;
+    if (waiter.woken_at) {
+        uint64_t cycles = rdtsc() - waiter.woken_at;
+        latency = (cycles >> 32) ? 0xFFFFFFFF : (uint32_t)cycles;
+    }
+
+    spin_lock(&stats_lock);
+    stats.waits++;
+    stats.wake_cycles += latency;
+    if (latency > stats.max_wake_cycles) {
+        stats.max_wake_cycles = latency;
+    }
+    spin_unlock_irqrestore(&stats_lock, flags);
+
+    return 0;
+}
+
+static int do_wake(volatile uint32_t* uaddr, uint32_t count, bool user) {
+    if (!uaddr || ((uint32_t)uaddr & 3) || count == 0) {
+        return uaddr ? 0 : -1;
+    }
+
+    phys_addr_t key = futex_key(uaddr, user);
+    if (!key) {
+        return -1;
+    }
+
+    wait_queue_t* wq = futex_queue(key);
+    list_node_t* node;
+    list_node_t* tmp;
+    uint32_t woken = 0;
+
+    uint32_t flags = spin_lock_irqsave(&wq->lock);
+
+    // the bucket is shared with other words, wake only ours, oldest first
+    list_for_each_safe(node, tmp, &wq->waiters) {
+        futex_waiter_t* waiter = list_entry(node, futex_waiter_t, entry.node);
+
+        if (waiter->key != key) {
+            continue;
+        }
+
+        waiter->woken_at = have_tsc ? rdtsc() : 0;
+        wait_entry_wake_locked(&waiter->entry);
+
+        if (++woken == count) {
+            break;
+        }
+    }
+
+    spin_unlock(&wq->lock);
+
+    spin_lock(&stats_lock);
+    stats.wakes += woken;
+    spin_unlock_irqrestore(&stats_lock, flags);
+
+    return (int)woken;
+}
+
+int futex_wait(volatile uint32_t* uaddr, uint32_t val) {
+    return do_wait(uaddr, val, false);
+}
+
+int futex_wake(volatile uint32_t* uaddr, uint32_t count) {
+    return do_wake(uaddr, count, false);
+}
+
+int futex_wait_user(volatile uint32_t* uaddr, uint32_t val) {
+    return do_wait(uaddr, val, true);
+}
+
+int futex_wake_user(volatile uint32_t* uaddr, uint32_t count) {
+    return do_wake(uaddr, count, true);
+}
+
+void futex_stats_get(futex_stats_t* out) {
+    uint32_t flags = spin_lock_irqsave(&stats_lock);
+    *out = stats;
+    spin_unlock_irqrestore(&stats_lock, flags);
+}
+
+void futex_stats_reset(void) {
+    uint32_t flags = spin_lock_irqsave(&stats_lock);
+    memset(&stats, 0, sizeof(stats));
+    spin_unlock_irqrestore(&stats_lock, flags);
+}
@@ -0,0 +1,143 @@
+#include <kernel/futex_bench.h>
+#include <kernel/futex.h>
+#include <kernel/kthread.h>
+#include <kernel/sync/spinlock.h>
+#include <kernel/sync/semaphore.h>
+#include <kernel/cpu/cpu.h>
+#include <kernel/timer/clocksource.h>
+#include <kernel/math64.h>
+#include <drivers/terminal.h>
+
+#define LOCK_FREE       0
+#define LOCK_HELD       1
+#define LOCK_WAITERS    2
+
+typedef struct {
+    volatile uint32_t lock;
+    volatile uint32_t counter;   // protected by lock
+    uint32_t iterations;
+    semaphore_t done;
+} bench_state_t;
+
+// what a user-space mutex does: only a contended lock enters the kernel
+static void bench_lock(volatile uint32_t* word) {
+    uint32_t c = spin_cmpxchg(word, LOCK_FREE, LOCK_HELD);
+
+    if (c == LOCK_FREE) {
+        return;
+    }
+
+    // announce a waiter so the holder's unlock calls futex_wake
+    if (c != LOCK_WAITERS) {
+        c = spin_xchg(word, LOCK_WAITERS);
+    }
+    while (c != LOCK_FREE) {
+        futex_wait(word, LOCK_WAITERS);
+        c = spin_xchg(word, LOCK_WAITERS);
+    }
+}
+
+static void bench_unlock(volatile uint32_t* word) {
+    if (spin_xchg(word, LOCK_FREE) == LOCK_WAITERS) {
+        futex_wake(word, 1);
+    }
+}
+
+static void bench_thread(void* arg) {
+    bench_state_t* state = (bench_state_t*)arg;
+
+    for (uint32_t i = 0; i < state->iterations; i++) {
+        bench_lock(&state->lock);
+        state->counter++;
+        bench_unlock(&state->lock);
+    }
+
+    up(&state->done);
+}
+
+int futex_bench_run(uint32_t threads, uint32_t iterations, futex_bench_result_t* result) {
+    static bench_state_t state;
+
+    if (!result || threads == 0 || threads > FUTEX_BENCH_MAX_THREADS || iterations == 0) {
+        return -1;
+    }
+
+    state.lock = LOCK_FREE;
+    state.counter = 0;
+    state.iterations = iterations;
+    sema_init(&state.done, 0);
+
+    futex_stats_reset();
+    uint64_t start = rdtsc();
+
+    for (uint32_t i = 0; i < threads; i++) {
+        if (!kthread_create("futexbench", bench_thread, &state)) {
+            terminal_writestring("ERROR: Could not start benchmark thread\n");
+            return -1;
+        }
+    }
+    for (uint32_t i = 0; i < threads; i++) {
+        down(&state.done);
+    }
+
+    futex_stats_t stats;
+    futex_stats_get(&stats);
+
+    result->threads = threads;
+    result->iterations = iterations;
+    result->cycles = rdtsc() - start;
+    result->sleeps = stats.waits;
+    result->wakes = stats.wakes;
+    result->avg_wake_cycles = stats.waits ? (uint32_t)div_u64_u32(stats.wake_cycles, stats.waits, NULL) : 0;
+    result->max_wake_cycles = stats.max_wake_cycles;
+    result->consistent = state.counter == threads * iterations;
+    return 0;
+}
+
+static void print_result(const futex_bench_result_t* result) {
+    uint64_t ops = (uint64_t)result->threads * result->iterations;
+    uint64_t ns = clocksource_cycles_to_ns(result->cycles);
+    uint32_t us = (uint32_t)div_u64_u32(ns, 1000, NULL);
+
+    terminal_print_int(result->threads);
+    terminal_writestring(result->threads < 10 ? "        " : "       ");
+    terminal_print_int((uint32_t)div_u64_u32(result->cycles, (uint32_t)ops, NULL));
+    terminal_writestring("  ");
+    // lock/unlock pairs per millisecond
+    terminal_print_int(us ? (uint32_t)div_u64_u32(ops * 1000, us, NULL) : 0);
+    terminal_writestring("  ");
+    terminal_print_int(result->sleeps);
+    terminal_writestring("  ");
+    terminal_print_int((uint32_t)clocksource_cycles_to_ns(result->avg_wake_cycles));
+    terminal_writestring("  ");
+    terminal_print_int((uint32_t)clocksource_cycles_to_ns(result->max_wake_cycles));
+    terminal_writestring(result->consistent ? "\n" : "  COUNTER MISMATCH\n");
+}
+
+void futex_bench(uint32_t threads, uint32_t iterations) {
+    static const uint32_t sweep[] = { 2, 4, 8, 16 };
+    futex_bench_result_t result;
+
+    if (!(cpuid_edx(1) & CPUID_EDX_TSC)) {
+        terminal_writestring("ERROR: The benchmark needs a time stamp counter\n");
+        return;
+    }
+
+    terminal_writestring("Contended futex mutex, ");
+    terminal_print_int(iterations);
+    terminal_writestring(" lock/unlock pairs per thread\n");
+    terminal_writestring("THREADS  CYC/OP  OPS/MS  SLEEPS  AVG WAKE NS  MAX WAKE NS\n");
+
+    for (uint32_t i = 0; i < sizeof(sweep) / sizeof(sweep[0]); i++) {
+        uint32_t n = threads ? threads : sweep[i];
+
+        if (futex_bench_run(n, iterations, &result) != 0) {
+            return;
+        }
+        print_result(&result);
+
+        if (threads) {
+            break;
+        }
+    }
+}
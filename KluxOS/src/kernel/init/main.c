@@ -1,7 +1,15 @@
 #include <kernel/kernel.h>
 #include <kernel/types.h>
+#include <kernel/cpu/gdt.h>
+#include <kernel/cpu/smp.h>
 #include <kernel/interrupt/idt.h>
 #include <kernel/timer/pit.h>
+#include <kernel/syscall.h>
+#include <kernel/process.h>
+#include <kernel/workqueue.h>
+#include <kernel/softirq.h>
+#include <kernel/sync/rcu.h>
+#include <kernel/math64.h>
 #include <drivers/terminal.h>
 #include <drivers/keyboard.h>
 #include <shell/shell.h>
@@ -38,24 +46,23 @@ static struct {
 
 static int init_complete = 0;
 
-static void timer_callback() {
-    static uint32_t seconds = 0;
-    static uint32_t last_tick = 0;
-    uint32_t current_tick = get_ticks();
-    
-    if (current_tick - last_tick >= get_timer_info()->frequency) {
-        seconds++;
-        last_tick = current_tick;
+static delayed_work_t uptime_work;
+
+// Redraw the uptime once a second from the system work queue instead of
+// the timer interrupt
+static void uptime_update(work_t* work) {
+    if (init_complete) {
+        uint32_t seconds = (uint32_t)div_u64_u32(get_uptime_ms(), 1000, NULL);
         
-        if (init_complete) {
-            terminal_set_cursor_position(70, 0);
-            terminal_set_fg_color(VGA_COLOR_LIGHT_GREEN);
-            terminal_writestring("Uptime: ");
-            terminal_print_int(seconds);
-            terminal_writestring("s ");
-            terminal_reset_color();
-        }
+        terminal_set_cursor_position(70, 0);
+        terminal_set_fg_color(VGA_COLOR_LIGHT_GREEN);
+        terminal_writestring("Uptime: ");
+        terminal_print_int(seconds);
+        terminal_writestring("s ");
+        terminal_reset_color();
     }
+    
+    schedule_delayed_work(to_delayed_work(work), get_timer_info()->frequency);
 }
 
 
@@ -89,14 +96,31 @@ void kernel_main(void* multiboot_struct) {
     terminal_writestring(" (c) 2023-2024 KluxOS Gelistirme Ekibi\n\n");
     terminal_reset_color();
     
-    init_memory();
+    // Kilitler %fs'teki işlemci kaydına yazar, ilk kilitten önce yüklenmeli
+    gdt_init();
     
+    init_memory();
 
     idt_init();
     
+    softirq_init();
+    
+    rcu_init();
+    
     pit_init(100);
+    
+    init_syscalls();
+    
+    process_init();
+    
+    smp_init();
+    
+    workqueue_init();
+    
+    softirq_start_thread();
 
-    register_timer_callback(timer_callback);
+    delayed_work_init(&uptime_work, uptime_update, NULL);
+    schedule_delayed_work(&uptime_work, get_timer_info()->frequency);
     
     keyboard_init();
     
@@ -128,8 +152,6 @@ void kernel_main(void* multiboot_struct) {
     
     shell_run();
     
-    while(1) {
-       
-        ASM_INLINE("hlt"); 
-    }
+    // Kabuk bitti; bu işlemci artık boşta işleminde bekler
+    process_exit();
 }  
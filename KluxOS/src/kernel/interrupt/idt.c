@@ -1,6 +1,10 @@
 #include "idt.h"
 #include "pic.h"
 #include <kernel/io.h>
+#include <kernel/process.h>
+#include <kernel/softirq.h>
+#include <kernel/cpu/apic.h>
+#include <kernel/cpu/gdt.h>
 #include <drivers/terminal.h>
 
 #define IDT_ENTRIES 256
@@ -29,7 +33,9 @@ void idt_init(void) {
     idt_set_gate(5, (uint32_t)isr5, 0x08, IDT_FLAG_PRESENT | IDT_FLAG_RING0 | IDT_FLAG_32BIT);
     idt_set_gate(6, (uint32_t)isr6, 0x08, IDT_FLAG_PRESENT | IDT_FLAG_RING0 | IDT_FLAG_32BIT);
     idt_set_gate(7, (uint32_t)isr7, 0x08, IDT_FLAG_PRESENT | IDT_FLAG_RING0 | IDT_FLAG_32BIT);
-    idt_set_gate(8, (uint32_t)isr8, 0x08, IDT_FLAG_PRESENT | IDT_FLAG_RING0 | IDT_FLAG_32BIT);
+    // #DF switches to its own TSS and stack: a kernel stack overflow
+    // cannot push a frame on the stack that faulted
+    idt_set_gate(8, 0, GDT_DF_TSS, IDT_FLAG_PRESENT | IDT_FLAG_RING0 | IDT_FLAG_TASK);
     idt_set_gate(9, (uint32_t)isr9, 0x08, IDT_FLAG_PRESENT | IDT_FLAG_RING0 | IDT_FLAG_32BIT);
     idt_set_gate(10, (uint32_t)isr10, 0x08, IDT_FLAG_PRESENT | IDT_FLAG_RING0 | IDT_FLAG_32BIT);
     idt_set_gate(11, (uint32_t)isr11, 0x08, IDT_FLAG_PRESENT | IDT_FLAG_RING0 | IDT_FLAG_32BIT);
@@ -90,8 +96,22 @@ void idt_set_gate(uint8_t num, uint32_t base, uint16_t selector, uint8_t flags)
     idt_entries[num].flags = flags;
 }
 
+// application processors share the boot CPU's table
+void idt_init_cpu(void) {
+    idt_flush((uint32_t)&idt_ptr);
+}
+
 void register_interrupt_handler(uint8_t num, isr_t handler) {
     interrupt_handlers[num] = handler;
+    
+    // the I/O APIC starts with every line masked
+    if (num >= 32 && num < 48 && apic_irqs_routed()) {
+        ioapic_unmask_irq(num - 32);
+    }
+}
+
+bool interrupt_handler_registered(uint8_t num) {
+    return interrupt_handlers[num] != 0;
 }
 
 void isr_handler(uint32_t int_no, uint32_t err_code) {
@@ -109,9 +129,22 @@ void isr_handler(uint32_t int_no, uint32_t err_code) {
 }
 
 void irq_handler(uint32_t irq_no) {
+    irq_enter();
+    
+    // top half: acknowledge the device and raise a softirq for the rest
     if (interrupt_handlers[irq_no + 32] != 0) {
         interrupt_handlers[irq_no + 32](0);
     }
     
-    pic_send_eoi(irq_no);
+    if (apic_irqs_routed()) {
+        lapic_eoi();
+    } else {
+        pic_send_eoi(irq_no);
+    }
+    
+    // runs pending softirqs with interrupts enabled
+    irq_exit();
+    
+    // switch only after EOI so the next tick is not held back
+    process_preempt();
 } 
\ No newline at end of file
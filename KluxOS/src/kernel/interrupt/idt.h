@@ -11,6 +11,7 @@
 #define IDT_FLAG_RING3       0x60   // user mode (ring 3)
 #define IDT_FLAG_32BIT       0x0E   // 32-bit interrupt gate
 #define IDT_FLAG_TRAP        0x0F   // trap gate
+#define IDT_FLAG_TASK        0x05   // task gate, the selector names a TSS
 
 typedef struct {
     uint16_t base_low;      // interrupt handler address low 16 bits
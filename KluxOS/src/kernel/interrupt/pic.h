@@ -26,7 +26,8 @@
 #define ICW4_BUF_MASTER 0x0C // Buffer mode - Master
 #define ICW4_SFNM    0x10    // Special fully nested mode
 
-// IRQ tanımları
+// IRQ tanımları (idt.h vektör numaralarını tanımladıysa onlar geçerli)
+#ifndef IRQ0
 #define IRQ0  0
 #define IRQ1  1
 #define IRQ2  2
@@ -43,6 +44,7 @@
 #define IRQ13 13
 #define IRQ14 14
 #define IRQ15 15
+#endif
 
 void pic_init(uint8_t offset1, uint8_t offset2);
 void pic_send_eoi(uint8_t irq);
@@ -1,13 +1,19 @@
 [bits 32]
 global isr0
 global isr1
+global isr14
 ; ... diğer ISR'lar
 global irq0
 global irq1
 ; ... diğer IRQ'lar
+global lapic_timer_entry
+global lapic_resched_entry
+global lapic_tlb_flush_entry
+global lapic_spurious_entry
 
 extern isr_handler
 extern irq_handler
+extern lapic_interrupt
 
 ; CPU Exception Handlers
 isr0:
@@ -22,18 +28,25 @@ isr1:
     push byte 1
     jmp isr_common_stub
 
+; page fault: the CPU has pushed the error code itself
+isr14:
+    push dword 14
+    jmp isr_error_stub
+
 isr_common_stub:
     pusha                  
     
 
     mov ax, ds
     push eax
+    push fs
     
     mov ax, 0x10
     mov ds, ax
     mov es, ax
-    mov fs, ax
     mov gs, ax
+    mov ax, 0x30            ; per-CPU data
+    mov fs, ax
     
 
     push esp                ; exception number and error code
@@ -41,10 +54,10 @@ isr_common_stub:
     add esp, 4
     
 
+    pop fs                  ; same selector on every CPU
     pop eax
     mov ds, ax
     mov es, ax
-    mov fs, ax
     mov gs, ax
     
     popa                    
@@ -52,6 +65,36 @@ isr_common_stub:
     sti                     
     iret                    
 
+; exceptions with an error code, isr_handler(int_no, err_code)
+isr_error_stub:
+    pusha
+
+    mov ax, ds
+    push eax
+    push fs
+
+    mov ax, 0x10
+    mov ds, ax
+    mov es, ax
+    mov gs, ax
+    mov ax, 0x30            ; per-CPU data
+    mov fs, ax
+
+    push dword [esp + 44]   ; error code
+    push dword [esp + 44]   ; exception number
+    call isr_handler
+    add esp, 8
+
+    pop fs
+    pop eax
+    mov ds, ax
+    mov es, ax
+    mov gs, ax
+
+    popa
+    add esp, 8              ; number and error code
+    iret                    ; interrupt flag as it was
+
 ; IRQ Handlers (hardware interrupts)
 irq0:
     cli
@@ -72,25 +115,72 @@ irq_common_stub:
 
     mov ax, ds
     push eax
+    push fs
     
 
     mov ax, 0x10
     mov ds, ax
     mov es, ax
-    mov fs, ax
     mov gs, ax
+    mov ax, 0x30            ; per-CPU data
+    mov fs, ax
     
     push esp
     call irq_handler
     add esp, 4
     
+    pop fs                  ; same selector on every CPU
     pop eax
     mov ds, ax
     mov es, ax
-    mov fs, ax
     mov gs, ax
     
     popa
     add esp, 8
     sti
     iret
+
+; Local APIC interrupts (kernel/cpu/apic.h vectors), one per CPU
+lapic_timer_entry:
+    push dword 0xEF
+    jmp lapic_common_stub
+
+lapic_resched_entry:
+    push dword 0xF0
+    jmp lapic_common_stub
+
+lapic_tlb_flush_entry:
+    push dword 0xF1
+    jmp lapic_common_stub
+
+lapic_common_stub:
+    pusha
+
+    mov ax, ds
+    push eax
+    push fs
+
+    mov ax, 0x10
+    mov ds, ax
+    mov es, ax
+    mov gs, ax
+    mov ax, 0x30
+    mov fs, ax
+
+    push dword [esp + 40]   ; vector
+    call lapic_interrupt
+    add esp, 4
+
+    pop fs
+    pop eax
+    mov ds, ax
+    mov es, ax
+    mov gs, ax
+
+    popa
+    add esp, 4
+    iret
+
+; spurious interrupts are not acknowledged
+lapic_spurious_entry:
+    iret
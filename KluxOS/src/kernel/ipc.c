@@ -0,0 +1,352 @@
+#include <kernel/ipc.h>
+#include <kernel/process.h>
+#include <drivers/terminal.h>
+#include "mm/vm.h"
+
+#define stat_inc(field) __asm__ volatile("lock incl %0" : "+m"(field) : : "memory")
+
+static lock_class_t ipc_class = LOCK_CLASS_INIT("ipc");
+static spinlock_t create_lock = SPINLOCK_INIT_CLASS(&ipc_class);
+
+static ipc_endpoint_t endpoints[IPC_MAX_ENDPOINTS] = {
+    [0 ... IPC_MAX_ENDPOINTS - 1] = { .lock = SPINLOCK_INIT_CLASS(&ipc_class) }
+};
+
+static int endpoint_id(ipc_endpoint_t* ep) {
+    return (int)(ep->gen * IPC_MAX_ENDPOINTS + (uint32_t)(ep - endpoints));
+}
+
+// the endpoint behind id with its lock held, NULL once it is destroyed
+static ipc_endpoint_t* endpoint_lock(int id, uint32_t* flags) {
+    if (id < 0) {
+        terminal_writestring("ERROR: Bad IPC endpoint\n");
+        return NULL;
+    }
+
+    ipc_endpoint_t* ep = &endpoints[(uint32_t)id % IPC_MAX_ENDPOINTS];
+    *flags = spin_lock_irqsave(&ep->lock);
+
+    if (!ep->used || ep->gen != (uint32_t)id / IPC_MAX_ENDPOINTS) {
+        spin_unlock_irqrestore(&ep->lock, *flags);
+        terminal_writestring("ERROR: Bad IPC endpoint\n");
+        return NULL;
+    }
+    return ep;
+}
+
+// a program's message buffer must be its own; write when we copy back
+static int check_msg(const ipc_msg_t* msg, bool write) {
+    if (!msg || vm_check_user(msg, sizeof(ipc_msg_t), write) != 0) {
+        terminal_writestring("ERROR: Bad IPC message buffer\n");
+        return -1;
+    }
+    return 0;
+}
+
+static void waiter_init(ipc_waiter_t* waiter) {
+    list_init(&waiter->node);
+    waiter->process = current_process;
+    waiter->caller = NULL;
+    waiter->done = 0;
+    waiter->status = 0;
+}
+
+// hand a blocked waiter its message; returns the process to run, since
+// the waiter's frame may be gone as soon as done is set
+static process_t* deliver(ipc_waiter_t* waiter, const ipc_msg_t* msg, int status) {
+    process_t* process = waiter->process;
+
+    if (msg) {
+        waiter->msg = *msg;
+    }
+    waiter->status = status;
+
+    __asm__ volatile("" : : : "memory");
+    waiter->done = 1;
+    return process;
+}
+
+// run the other side now: straight to it if it waits on this CPU, else
+// through its run queue. We block in the first case and carry on in
+// the second; either way the caller then waits for its own message.
+// done is that message's flag: once our waiter is published it may be
+// set before we get to block, and then we must not.
+static void ipc_run(ipc_endpoint_t* ep, process_t* target, volatile int* done) {
+    if (process_handoff(target, done)) {
+        stat_inc(ep->handoffs);
+    } else {
+        process_wake(target);
+    }
+}
+
+// wait for our message; 0 once it is here, -1 if we were killed while
+// the waiter was still queued. A call a server has already taken
+// cannot be withdrawn, so that one still waits for its reply.
+static int ipc_wait(ipc_endpoint_t* ep, ipc_waiter_t* waiter) {
+    while (!waiter->done) {
+        if (process_wait_event_killable(&waiter->done) == 0) {
+            continue;
+        }
+
+        uint32_t flags = spin_lock_irqsave(&ep->lock);
+        if (!waiter->done && !list_empty(&waiter->node)) {
+            list_del(&waiter->node);
+            spin_unlock_irqrestore(&ep->lock, flags);
+            return -1;
+        }
+        spin_unlock_irqrestore(&ep->lock, flags);
+
+        while (!waiter->done) {
+            process_wait_event(&waiter->done);
+        }
+    }
+    return 0;
+}
+
+int ipc_endpoint_create(void) {
+    int id = -1;
+
+    uint32_t flags = spin_lock_irqsave(&create_lock);
+
+    for (uint32_t i = 0; i < IPC_MAX_ENDPOINTS; i++) {
+        ipc_endpoint_t* ep = &endpoints[i];
+
+        spin_lock(&ep->lock);
+        if (!ep->used) {
+            list_init(&ep->callers);
+            list_init(&ep->receivers);
+            ep->calls = 0;
+            ep->handoffs = 0;
+            ep->queued = 0;
+            ep->used = true;
+            id = endpoint_id(ep);
+        }
+        spin_unlock(&ep->lock);
+
+        if (id >= 0) {
+            break;
+        }
+    }
+
+    spin_unlock_irqrestore(&create_lock, flags);
+
+    if (id < 0) {
+        terminal_writestring("ERROR: Too many IPC endpoints\n");
+    }
+    return id;
+}
+
+int ipc_endpoint_destroy(int id) {
+    uint32_t flags;
+    list_node_t* pos;
+    list_node_t* tmp;
+
+    ipc_endpoint_t* ep = endpoint_lock(id, &flags);
+    if (!ep) {
+        return -1;
+    }
+
+    ep->used = false;
+    ep->gen++;
+
+    // calls a server has already taken still get their reply
+    list_for_each_safe(pos, tmp, &ep->callers) {
+        ipc_waiter_t* waiter = list_entry(pos, ipc_waiter_t, node);
+        list_del(&waiter->node);
+        process_wake(deliver(waiter, NULL, -1));
+    }
+    list_for_each_safe(pos, tmp, &ep->receivers) {
+        ipc_waiter_t* waiter = list_entry(pos, ipc_waiter_t, node);
+        list_del(&waiter->node);
+        process_wake(deliver(waiter, NULL, -1));
+    }
+
+    spin_unlock_irqrestore(&ep->lock, flags);
+    return 0;
+}
+
+int ipc_call(int id, ipc_msg_t* msg) {
+    ipc_waiter_t self;
+    process_t* target = NULL;
+    uint32_t flags;
+
+    if (check_msg(msg, true) != 0) {
+        return -1;
+    }
+
+    // a user buffer may fault, so copy it before taking the lock
+    waiter_init(&self);
+    self.msg = *msg;
+
+    ipc_endpoint_t* ep = endpoint_lock(id, &flags);
+    if (!ep) {
+        return -1;
+    }
+    ep->calls++;
+
+    if (!list_empty(&ep->receivers)) {
+        ipc_waiter_t* receiver = list_entry(ep->receivers.next, ipc_waiter_t, node);
+
+        list_del(&receiver->node);
+        receiver->caller = &self;
+        target = deliver(receiver, &self.msg, 0);
+    } else {
+        list_add_tail(&ep->callers, &self.node);
+        ep->queued++;
+    }
+
+    spin_unlock_irqrestore(&ep->lock, flags);
+
+    if (target) {
+        ipc_run(ep, target, &self.done);
+    }
+
+    if (ipc_wait(ep, &self) != 0 || self.status != 0) {
+        return -1;
+    }
+    *msg = self.msg;
+    return 0;
+}
+
+// wait for the next call; with reply, answer the pending one first
+static int wait_call(int id, ipc_msg_t* msg, bool reply) {
+    process_t* self = current_process;
+    ipc_waiter_t* caller = self->ipc_caller;
+    process_t* target = NULL;
+    ipc_waiter_t me;
+    ipc_msg_t out;
+    uint32_t flags;
+
+    if (check_msg(msg, true) != 0) {
+        return -1;
+    }
+    if (reply && !caller) {
+        terminal_writestring("ERROR: No IPC call to reply to\n");
+        return -1;
+    }
+    if (!reply && caller) {
+        terminal_writestring("ERROR: Reply to the pending IPC call first\n");
+        return -1;
+    }
+
+    if (reply) {
+        out = *msg;
+    }
+    waiter_init(&me);
+
+    ipc_endpoint_t* ep = endpoint_lock(id, &flags);
+    if (!ep) {
+        return -1;
+    }
+
+    if (caller) {
+        self->ipc_caller = NULL;
+        target = deliver(caller, &out, 0);
+    }
+
+    // a call is already queued: take it and keep running, the one we
+    // answered goes through the run queue
+    if (!list_empty(&ep->callers)) {
+        ipc_waiter_t* next = list_entry(ep->callers.next, ipc_waiter_t, node);
+
+        list_del(&next->node);
+        out = next->msg;
+        self->ipc_caller = next;
+        spin_unlock_irqrestore(&ep->lock, flags);
+
+        if (target) {
+            process_wake(target);
+        }
+        *msg = out;
+        return 0;
+    }
+
+    list_add_tail(&ep->receivers, &me.node);
+    spin_unlock_irqrestore(&ep->lock, flags);
+
+    // switch to the caller we answered; the next call switches back
+    if (target) {
+        ipc_run(ep, target, &me.done);
+    }
+
+    if (ipc_wait(ep, &me) != 0 || me.status != 0) {
+        return -1;
+    }
+    self->ipc_caller = me.caller;
+    *msg = me.msg;
+    return 0;
+}
+
+int ipc_recv(int id, ipc_msg_t* msg) {
+    return wait_call(id, msg, false);
+}
+
+int ipc_reply_recv(int id, ipc_msg_t* msg) {
+    return wait_call(id, msg, true);
+}
+
+int ipc_reply(const ipc_msg_t* msg) {
+    process_t* self = current_process;
+    ipc_waiter_t* caller = self->ipc_caller;
+
+    if (!caller) {
+        terminal_writestring("ERROR: No IPC call to reply to\n");
+        return -1;
+    }
+    if (check_msg(msg, false) != 0) {
+        return -1;
+    }
+
+    ipc_msg_t out = *msg;
+    self->ipc_caller = NULL;
+    process_wake(deliver(caller, &out, 0));
+    return 0;
+}
+
+void ipc_release_process(process_t* process) {
+    ipc_waiter_t* caller = process->ipc_caller;
+
+    if (caller) {
+        process->ipc_caller = NULL;
+        process_wake(deliver(caller, NULL, -1));
+    }
+}
+
+void ipc_stats_get(ipc_stats_t* stats) {
+    stats->calls = 0;
+    stats->handoffs = 0;
+    stats->queued = 0;
+
+    for (uint32_t i = 0; i < IPC_MAX_ENDPOINTS; i++) {
+        stats->calls += endpoints[i].calls;
+        stats->handoffs += endpoints[i].handoffs;
+        stats->queued += endpoints[i].queued;
+    }
+}
+
+void ipc_dump(void) {
+    bool any = false;
+
+    terminal_writestring("ID    Calls     Handoffs  Queued\n");
+
+    for (uint32_t i = 0; i < IPC_MAX_ENDPOINTS; i++) {
+        ipc_endpoint_t* ep = &endpoints[i];
+        if (!ep->used) {
+            continue;
+        }
+        any = true;
+
+        terminal_print_uint(endpoint_id(ep));
+        terminal_writestring("     ");
+        terminal_print_uint(ep->calls);
+        terminal_writestring("     ");
+        terminal_print_uint(ep->handoffs);
+        terminal_writestring("     ");
+        terminal_print_uint(ep->queued);
+        terminal_writestring("\n");
+    }
+
+    if (!any) {
+        terminal_writestring("No IPC endpoints\n");
+    }
+}
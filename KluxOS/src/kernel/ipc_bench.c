@@ -0,0 +1,187 @@
+#include <kernel/ipc_bench.h>
+#include <kernel/ipc.h>
+#include <kernel/kthread.h>
+#include <kernel/sync/semaphore.h>
+#include <kernel/cpu/cpu.h>
+#include <kernel/timer/clocksource.h>
+#include <kernel/math64.h>
+#include <drivers/terminal.h>
+
+#define LABEL_ECHO      1
+#define LABEL_STOP      2
+
+typedef struct {
+    int endpoint;
+    uint32_t iterations;
+    semaphore_t ping;
+    semaphore_t pong;
+    semaphore_t done;
+} bench_state_t;
+
+// answers every call with its first word plus one until told to stop
+static void echo_server(void* arg) {
+    bench_state_t* state = (bench_state_t*)arg;
+    ipc_msg_t msg;
+
+    if (ipc_recv(state->endpoint, &msg) == 0) {
+        while (msg.label == LABEL_ECHO) {
+            msg.words[0]++;
+            if (ipc_reply_recv(state->endpoint, &msg) != 0) {
+                break;
+            }
+        }
+        if (msg.label == LABEL_STOP) {
+            ipc_reply(&msg);
+        }
+    }
+
+    up(&state->done);
+}
+
+static void sema_server(void* arg) {
+    bench_state_t* state = (bench_state_t*)arg;
+
+    for (uint32_t i = 0; i < state->iterations; i++) {
+        down(&state->ping);
+        up(&state->pong);
+    }
+
+    up(&state->done);
+}
+
+int ipc_bench_run(uint32_t iterations, ipc_bench_result_t* result) {
+    static bench_state_t state;
+    ipc_stats_t before, after;
+    ipc_msg_t msg;
+
+    if (!result || iterations == 0) {
+        return -1;
+    }
+
+    state.endpoint = ipc_endpoint_create();
+    if (state.endpoint < 0) {
+        return -1;
+    }
+    sema_init(&state.done, 0);
+
+    if (!kthread_create("ipcbench", echo_server, &state)) {
+        terminal_writestring("ERROR: Could not start benchmark thread\n");
+        ipc_endpoint_destroy(state.endpoint);
+        return -1;
+    }
+
+    result->iterations = iterations;
+    result->min_cycles = 0xFFFFFFFF;
+    result->max_cycles = 0;
+    result->consistent = true;
+
+    uint64_t total = 0;
+
+    for (uint32_t i = 0; i < IPC_BENCH_WARMUP + iterations; i++) {
+        msg.label = LABEL_ECHO;
+        msg.words[0] = i;
+
+        if (i == IPC_BENCH_WARMUP) {
+            ipc_stats_get(&before);
+        }
+
+        uint64_t start = rdtsc();
+        if (ipc_call(state.endpoint, &msg) != 0) {
+            result->consistent = false;
+            break;
+        }
+        uint32_t cycles = (uint32_t)(rdtsc() - start);
+
+        if (msg.words[0] != i + 1) {
+            result->consistent = false;
+        }
+        if (i < IPC_BENCH_WARMUP) {
+            continue;
+        }
+
+        total += cycles;
+        if (cycles < result->min_cycles) {
+            result->min_cycles = cycles;
+        }
+        if (cycles > result->max_cycles) {
+            result->max_cycles = cycles;
+        }
+    }
+
+    ipc_stats_get(&after);
+    result->avg_cycles = (uint32_t)div_u64_u32(total, iterations, NULL);
+    result->handoffs = after.handoffs - before.handoffs;
+    result->queued = after.queued - before.queued;
+
+    msg.label = LABEL_STOP;
+    if (ipc_call(state.endpoint, &msg) != 0) {
+        // the server never got the stop, destroying fails its receive
+        ipc_endpoint_destroy(state.endpoint);
+        down(&state.done);
+    } else {
+        down(&state.done);
+        ipc_endpoint_destroy(state.endpoint);
+    }
+
+    // the same round trip through the run queue
+    sema_init(&state.ping, 0);
+    sema_init(&state.pong, 0);
+    state.iterations = iterations;
+
+    if (!kthread_create("ipcbench", sema_server, &state)) {
+        terminal_writestring("ERROR: Could not start benchmark thread\n");
+        return -1;
+    }
+
+    uint64_t start = rdtsc();
+    for (uint32_t i = 0; i < iterations; i++) {
+        up(&state.ping);
+        down(&state.pong);
+    }
+    result->sema_avg_cycles = (uint32_t)div_u64_u32(rdtsc() - start, iterations, NULL);
+
+    down(&state.done);
+    return 0;
+}
+
+static void print_ns(const char* label, uint32_t cycles) {
+    terminal_writestring(label);
+    terminal_print_uint((uint32_t)clocksource_cycles_to_ns(cycles));
+    terminal_writestring(" ns (");
+    terminal_print_uint(cycles);
+    terminal_writestring(" cycles)\n");
+}
+
+void ipc_bench(uint32_t iterations) {
+    ipc_bench_result_t result;
+
+    if (!(cpuid_edx(1) & CPUID_EDX_TSC)) {
+        terminal_writestring("ERROR: The benchmark needs a time stamp counter\n");
+        return;
+    }
+
+    terminal_writestring("IPC call/reply round trip, ");
+    terminal_print_uint(iterations);
+    terminal_writestring(" calls\n");
+
+    if (ipc_bench_run(iterations, &result) != 0) {
+        return;
+    }
+
+    print_ns("  min:             ", result.min_cycles);
+    print_ns("  avg:             ", result.avg_cycles);
+    print_ns("  max:             ", result.max_cycles);
+    print_ns("  semaphore avg:   ", result.sema_avg_cycles);
+
+    terminal_writestring("  direct handoffs: ");
+    terminal_print_uint(result.handoffs);
+    terminal_writestring(" of ");
+    terminal_print_uint(iterations * 2);
+    terminal_writestring(", ");
+    terminal_print_uint(result.queued);
+    terminal_writestring(" calls queued\n");
+
+    if (!result.consistent) {
+        terminal_writestring("  REPLY MISMATCH\n");
+    }
+}
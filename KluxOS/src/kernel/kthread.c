@@ -0,0 +1,10 @@
+#include <kernel/kthread.h>
+
+process_t* kthread_create(const char* name, kthread_fn_t fn, void* arg) {
+    // the argument is in place before another CPU can pick the thread
+    return process_create_arg(name, (void*)fn, arg);
+}
+
+void kthread_exit(void) {
+    process_exit();
+}
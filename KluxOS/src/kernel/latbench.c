@@ -0,0 +1,190 @@
+#include <kernel/latbench.h>
+#include <kernel/process.h>
+#include <kernel/kthread.h>
+#include <kernel/sync/wait.h>
+#include <kernel/sync/semaphore.h>
+#include <kernel/sync/preempt.h>
+#include <kernel/cpu/cpu.h>
+#include <kernel/cpu/percpu.h>
+#include <kernel/timer/timer.h>
+#include <kernel/timer/pit.h>
+#include <kernel/timer/clocksource.h>
+#include <kernel/math64.h>
+#include <drivers/terminal.h>
+#include "mm/memory.h"
+
+typedef struct {
+    wait_entry_t entry;
+    ktimer_t timer;
+    volatile uint64_t fired_ns;
+    volatile int timer_done;     // the callback no longer touches this frame
+} lat_sleep_t;
+
+typedef struct {
+    uint32_t samples;
+    volatile bool stop;              // tells the load threads to finish
+    latbench_result_t* result;
+    uint64_t total_ns;
+    semaphore_t done;
+} lat_state_t;
+
+static void lat_timer(void* data) {
+    lat_sleep_t* sleep = (lat_sleep_t*)data;
+
+    sleep->fired_ns = clock_monotonic_ns();
+    wait_entry_wake(&sleep->entry);
+    sleep->timer_done = 1;
+}
+
+static uint32_t hist_bucket(uint32_t ns) {
+    uint32_t bucket = 0;
+
+    for (uint32_t limit = 1000; ns >= limit && bucket < LATBENCH_HIST_BUCKETS - 1; limit *= 10) {
+        bucket++;
+    }
+    return bucket;
+}
+
+static void measure_thread(void* arg) {
+    lat_state_t* state = (lat_state_t*)arg;
+    latbench_result_t* result = state->result;
+    lat_sleep_t sleep;
+
+    for (uint32_t i = 0; i < state->samples; i++) {
+        sleep.fired_ns = 0;
+        sleep.timer_done = 0;
+        wait_entry_init(&sleep.entry);
+        ktimer_init(&sleep.timer, lat_timer, &sleep);
+        ktimer_add(&sleep.timer, get_ticks() + 1);
+
+        wait_entry_block(&sleep.entry);
+
+        uint64_t delay = clock_monotonic_ns() - sleep.fired_ns;
+        uint32_t ns = (delay >> 32) ? 0xFFFFFFFF : (uint32_t)delay;
+
+        // the callback may still be finishing on another CPU
+        while (!sleep.timer_done) {
+            cpu_relax();
+        }
+
+        state->total_ns += ns;
+        if (ns < result->min_ns) {
+            result->min_ns = ns;
+        }
+        if (ns > result->max_ns) {
+            result->max_ns = ns;
+        }
+        result->hist[hist_bucket(ns)]++;
+    }
+
+    state->stop = true;
+    up(&state->done);
+}
+
+// a long kernel path that only offers to reschedule now and then
+static void load_thread(void* arg) {
+    lat_state_t* state = (lat_state_t*)arg;
+    uint64_t chunk = (uint64_t)LATBENCH_LOAD_CHUNK_US * NSEC_PER_USEC;
+
+    while (!state->stop) {
+        uint64_t until = clock_monotonic_ns() + chunk;
+
+        while (clock_monotonic_ns() < until) {
+            cpu_relax();
+        }
+        cond_resched();
+    }
+
+    up(&state->done);
+}
+
+int latbench_run(uint32_t samples, uint32_t load_threads, bool full_preempt,
+                 latbench_result_t* result) {
+    static lat_state_t state;
+
+    if (!result || samples == 0 || load_threads > LATBENCH_MAX_LOAD) {
+        return -1;
+    }
+
+    memset(result, 0, sizeof(*result));
+    result->samples = samples;
+    result->load_threads = load_threads;
+    result->full_preempt = full_preempt;
+    result->min_ns = 0xFFFFFFFF;
+
+    state.samples = samples;
+    state.stop = false;
+    state.result = result;
+    state.total_ns = 0;
+    sema_init(&state.done, 0);
+
+    bool saved = preempt_is_full();
+    preempt_set_full(full_preempt);
+
+    uint32_t started = 0;
+    for (; started < load_threads; started++) {
+        if (!kthread_create("latload", load_thread, &state)) {
+            break;
+        }
+    }
+
+    bool ok = started == load_threads && kthread_create("latbench", measure_thread, &state);
+    if (!ok) {
+        state.stop = true;
+    }
+
+    // load threads, plus the measuring thread if it started
+    for (uint32_t i = 0; i < started + (ok ? 1 : 0); i++) {
+        down(&state.done);
+    }
+
+    preempt_set_full(saved);
+
+    if (!ok) {
+        terminal_writestring("ERROR: Could not start benchmark thread\n");
+        return -1;
+    }
+
+    result->avg_ns = (uint32_t)div_u64_u32(state.total_ns, samples, NULL);
+    return 0;
+}
+
+static void print_result(const latbench_result_t* result) {
+    terminal_writestring(result->full_preempt ? "on     " : "off    ");
+    terminal_print_uint(result->min_ns / 1000);
+    terminal_writestring("  ");
+    terminal_print_uint(result->avg_ns / 1000);
+    terminal_writestring("  ");
+    terminal_print_uint(result->max_ns / 1000);
+    terminal_writestring("   ");
+
+    for (int i = 0; i < LATBENCH_HIST_BUCKETS; i++) {
+        terminal_print_uint(result->hist[i]);
+        terminal_writestring(i < LATBENCH_HIST_BUCKETS - 1 ? "/" : "\n");
+    }
+}
+
+void latbench(uint32_t samples, uint32_t load_threads) {
+    latbench_result_t result;
+
+    if (load_threads == 0) {
+        load_threads = 2 * cpu_online_count();
+        if (load_threads > LATBENCH_MAX_LOAD) {
+            load_threads = LATBENCH_MAX_LOAD;
+        }
+    }
+
+    terminal_writestring("Wakeup latency, ");
+    terminal_print_uint(samples);
+    terminal_writestring(" samples, ");
+    terminal_print_uint(load_threads);
+    terminal_writestring(" load threads\n");
+    terminal_writestring("PREEMPT  MIN US  AVG US  MAX US  <1us/<10us/<100us/<1ms/<10ms/<100ms/<1s/more\n");
+
+    for (int full = 0; full < 2; full++) {
+        if (latbench_run(samples, load_threads, full != 0, &result) != 0) {
+            return;
+        }
+        print_result(&result);
+    }
+}
@@ -0,0 +1,166 @@
+#include "kstack.h"
+#include "memory.h"
+#include <kernel/cpu/percpu.h>
+#include <kernel/sync/spinlock.h>
+#include <kernel/irqflags.h>
+#include <kernel/process.h>
+#include <drivers/terminal.h>
+
+_Static_assert(KSTACK_MAX >= PID_MAX, "a process without a kernel stack");
+_Static_assert(KSTACK_AREA_BASE + KSTACK_MAX * KSTACK_SLOT_SIZE <= PHYS_MAP_BASE,
+               "kernel stack area overlaps the physical memory window");
+
+// freed stacks are chained through their lowest word
+typedef struct free_stack {
+    struct free_stack* next;
+} free_stack_t;
+
+static lock_class_t kstack_class = LOCK_CLASS_INIT("kstack");
+static spinlock_t pool_lock = SPINLOCK_INIT_CLASS(&kstack_class);
+
+static free_stack_t* free_list = NULL;
+static uint32_t next_slot = 0;
+static uint32_t pool_hits = 0;
+static volatile uint32_t in_use = 0;
+
+// give the next unused slot its pages; pool_lock held
+static void* kstack_map_slot(void) {
+    page_directory_t* dir = get_kernel_directory();
+
+    if (!dir) {
+        return kmalloc_aligned(KSTACK_SIZE);
+    }
+
+    if (next_slot >= KSTACK_MAX) {
+        return NULL;
+    }
+
+    uint32_t stack = KSTACK_AREA_BASE + next_slot * KSTACK_SLOT_SIZE + KSTACK_GUARD_SIZE;
+    void* pages[KSTACK_SIZE / PAGE_SIZE];
+    phys_addr_t phys[KSTACK_SIZE / PAGE_SIZE];
+    uint32_t i;
+
+    // page tables first: once they exist the mapping below cannot fail
+    for (i = 0; i < KSTACK_SIZE / PAGE_SIZE; i++) {
+        if (!get_page(stack + i * PAGE_SIZE, 1, dir)) {
+            return NULL;
+        }
+    }
+
+    for (i = 0; i < KSTACK_SIZE / PAGE_SIZE; i++) {
+        pages[i] = page_alloc(&phys[i]);
+        if (!pages[i]) {
+            while (i--) {
+                page_free(pages[i]);
+            }
+            return NULL;
+        }
+    }
+
+    // the guard page below stays unmapped
+    for (i = 0; i < KSTACK_SIZE / PAGE_SIZE; i++) {
+        map_page_dir(dir, stack + i * PAGE_SIZE, phys[i], MEMORY_PRESENT | MEMORY_READWRITE);
+    }
+
+    next_slot++;
+    return (void*)stack;
+}
+
+void* kstack_alloc(void) {
+    uint32_t flags = irq_save();
+    cpu_t* cpu = this_cpu();
+    void* stack = NULL;
+
+    if (cpu->kstack_cached > 0) {
+        stack = cpu->kstack_cache[--cpu->kstack_cached];
+        cpu->kstack_cache_hits++;
+    } else {
+        spin_lock(&pool_lock);
+
+        if (free_list) {
+            stack = free_list;
+            free_list = free_list->next;
+            pool_hits++;
+        } else {
+            stack = kstack_map_slot();
+        }
+
+        spin_unlock(&pool_lock);
+    }
+
+    if (stack) {
+        __asm__ volatile("lock incl %0" : "+m"(in_use) : : "memory");
+    }
+
+    irq_restore(flags);
+
+    if (!stack) {
+        terminal_writestring("ERROR: Out of kernel stacks\n");
+    }
+    return stack;
+}
+
+void kstack_free(void* stack) {
+    if (!stack) {
+        return;
+    }
+
+    uint32_t flags = irq_save();
+    cpu_t* cpu = this_cpu();
+
+    __asm__ volatile("lock decl %0" : "+m"(in_use) : : "memory");
+
+    if (cpu->kstack_cached < PERCPU_KSTACK_CACHE) {
+        cpu->kstack_cache[cpu->kstack_cached++] = stack;
+    } else {
+        free_stack_t* entry = (free_stack_t*)stack;
+
+        spin_lock(&pool_lock);
+        entry->next = free_list;
+        free_list = entry;
+        spin_unlock(&pool_lock);
+    }
+
+    irq_restore(flags);
+}
+
+bool kstack_guard_hit(uint32_t address) {
+    if (address < KSTACK_AREA_BASE ||
+        address >= KSTACK_AREA_BASE + KSTACK_MAX * KSTACK_SLOT_SIZE) {
+        return false;
+    }
+    return (address - KSTACK_AREA_BASE) % KSTACK_SLOT_SIZE < KSTACK_GUARD_SIZE;
+}
+
+void kstack_stats_get(kstack_stats_t* stats) {
+    uint32_t hits = 0;
+
+    for (uint32_t i = 0; i < cpu_count(); i++) {
+        hits += cpus[i].kstack_cache_hits;
+    }
+
+    uint32_t flags = spin_lock_irqsave(&pool_lock);
+    stats->mapped = get_kernel_directory() ? next_slot : 0;
+    stats->pool_hits = pool_hits;
+    spin_unlock_irqrestore(&pool_lock, flags);
+
+    stats->in_use = in_use;
+    stats->cache_hits = hits;
+}
+
+void kstack_stats_dump(void) {
+    kstack_stats_t stats;
+    kstack_stats_get(&stats);
+
+    terminal_writestring("Kernel stacks: ");
+    terminal_print_int(stats.in_use);
+    terminal_writestring(" in use, ");
+    terminal_print_int(stats.mapped);
+    terminal_writestring("/");
+    terminal_print_int(KSTACK_MAX);
+    terminal_writestring(" slots mapped, reused ");
+    terminal_print_int(stats.cache_hits);
+    terminal_writestring(" from CPU caches and ");
+    terminal_print_int(stats.pool_hits);
+    terminal_writestring(" from the pool\n");
+}
@@ -0,0 +1,43 @@
+#ifndef KSTACK_H
+#define KSTACK_H
+
+#include <kernel/types.h>
+
+// Kernel stack pool.
+//
+// Stacks live in their own virtual area, one slot per stack: an
+// unmapped guard page followed by the stack pages. Running off the
+// bottom of a stack therefore faults on the guard page instead of
+// overwriting whatever the heap placed below it. A slot is mapped once,
+// the first time it is needed, and freed stacks stay mapped: they go to
+// a small per-CPU cache and, when that is full, to a shared free list,
+// so creating a process normally reuses a stack without touching the
+// page tables. Slot pages come from the frame allocator, so there is a
+// slot for every PID and the pool grows until physical memory runs out.
+// Without paging stacks come from the aligned heap and have no guard.
+
+#define KSTACK_SIZE        8192
+#define KSTACK_GUARD_SIZE  4096
+#define KSTACK_SLOT_SIZE   (KSTACK_GUARD_SIZE + KSTACK_SIZE)
+#define KSTACK_AREA_BASE   0xD0000000
+#define KSTACK_MAX         4096     // slots in the area, one per PID
+
+typedef struct {
+    uint32_t mapped;         // slots given pages so far
+    uint32_t in_use;
+    uint32_t cache_hits;     // taken from a per-CPU cache
+    uint32_t pool_hits;      // taken from the shared free list
+} kstack_stats_t;
+
+// lowest address of a KSTACK_SIZE stack, NULL when the pool is exhausted
+void* kstack_alloc(void);
+
+void kstack_free(void* stack);
+
+// address lies in the guard page below some stack
+bool kstack_guard_hit(uint32_t address);
+
+void kstack_stats_get(kstack_stats_t* stats);
+void kstack_stats_dump(void);
+
+#endif // KSTACK_H
@@ -1,6 +1,12 @@
 #include "memory.h"
+#include "kstack.h"
+#include "vm.h"
 #include <kernel/types.h>
 #include <drivers/terminal.h>
+#include <kernel/sync/spinlock.h>
+#include <kernel/process.h>
+#include <kernel/interrupt/idt.h>
+#include <kernel/cpu/gdt.h>
 
 extern void* multiboot_info;
 
@@ -32,6 +38,21 @@ static uint32_t memory_region_count = 0;
 static uint32_t frames[MAX_PAGES / 32];
 static uint32_t nframes = 0;
 
+// Çerçeve bitmap'i ve heap tüm işlemcilerce paylaşılır
+static spinlock_t frame_lock = SPINLOCK_INIT;
+static spinlock_t heap_lock = SPINLOCK_INIT;
+static spinlock_t page_lock = SPINLOCK_INIT;
+
+// Serbest bırakılan tek sayfalar, ilk kelimeleri üzerinden zincirli
+static void* free_pages = NULL;
+
+// Paylaşılan sayfaların sayaçları, frame_lock ile korunur
+static page_frame_t frame_table[FRAME_TABLE_SIZE];
+
+static volatile uint32_t kernel_pde_gen = 0;
+
+static void page_fault_isr(uint32_t error_code);
+
 static uint32_t get_frame_index(phys_addr_t addr) {
     return addr / PAGE_SIZE;
 }
@@ -81,6 +102,7 @@ void alloc_frame(page_frame_t* frame, int is_kernel, int is_writeable) {
         return; 
     }
     
+    uint32_t lock_flags = spin_lock_irqsave(&frame_lock);
     uint32_t idx = first_free_frame();
     if (idx == 0xFFFFFFFF) {
         terminal_writestring("HATA: Yeterli bellek yok!\n");
@@ -88,6 +110,7 @@ void alloc_frame(page_frame_t* frame, int is_kernel, int is_writeable) {
     }
     
     set_frame(idx * PAGE_SIZE);
+    spin_unlock_irqrestore(&frame_lock, lock_flags);
     frame->used = 1;
     frame->kernel_page = is_kernel ? 1 : 0;
     frame->ref_count = 1;
@@ -108,7 +131,9 @@ void free_frame(page_frame_t* frame) {
     }
     
     phys_addr_t physaddr = (phys_addr_t)get_physaddr((void*)frame);
+    uint32_t lock_flags = spin_lock_irqsave(&frame_lock);
     clear_frame(physaddr);
+    spin_unlock_irqrestore(&frame_lock, lock_flags);
     frame->used = 0;
     frame->ref_count = 0;
 }
@@ -157,6 +182,12 @@ void init_memory() {
         set_frame(i * PAGE_SIZE);
     }
     
+    // Ayrılmış bölgenin çerçeveleri page_alloc'a verilmez
+    for (uint32_t addr = (uint32_t)memory_regions[1].base_addr;
+         addr < nframes * PAGE_SIZE; addr += PAGE_SIZE) {
+        set_frame(addr);
+    }
+    
     init_paging();
     
     terminal_writestring("Bellek yonetimi baslatildi.\n");
@@ -171,15 +202,18 @@ void init_paging() {
     
     for (uint32_t i = 0; i < 1024; i++) {
         page_frame_t* page = get_page(i * PAGE_SIZE, 1, kernel_directory);
-        alloc_frame(page, 1, 0); // Çekirdek, sadece okuma
+        alloc_frame(page, 1, 1); // Çekirdek; CR0.WP açık olduğundan yazılabilir olmalı
     }
     
-    // page error handler (must be added to interrupt.c)
-    // register_interrupt_handler(14, handle_page_fault);
+    // Hata adresi CR2'den okunur
+    register_interrupt_handler(14, page_fault_isr);
     
     // load page directory to CR3
     switch_page_directory(kernel_directory);
     
+    // Çift hata görevi de bu dizinle çalışır
+    tss_set_double_fault_cr3(kernel_directory->physical_addr);
+    
     terminal_writestring("Sayfalama sistemi baslatildi.\n");
 }
 
@@ -192,6 +226,7 @@ void switch_page_directory(page_directory_t* dir) {
     uint32_t cr0;
     ASM_INLINE("mov %%cr0, %0" : "=r"(cr0));
     cr0 |= 0x80000000; // PG bayrağını etkinleştir
+    cr0 |= 0x00010000; // WP: çekirdek de salt okunur kullanıcı sayfalarına yazınca hata alır (yazınca kopyala)
     ASM_INLINE("mov %0, %%cr0" : : "r"(cr0));
 #elif defined(__GNUC__) || defined(__clang__)
     load_page_directory(dir->physical_addr);
@@ -208,17 +243,180 @@ page_frame_t* get_page(uint32_t address, int make, page_directory_t* dir) {
     if (make && !dir->tables[table_idx]) {
 
         uint32_t phys;
-        dir->tables[table_idx] = (uint32_t*)kmalloc_aligned_physical(sizeof(uint32_t) * 1024, &phys);
+        uint32_t* table = (uint32_t*)kmalloc_aligned_physical(sizeof(uint32_t) * 1024, &phys);
+        
+        // Yığın tükendi: tablo yok, çağıran NULL ile başa çıkar
+        if (!table) {
+            return NULL;
+        }
+        
+        memset(table, 0, sizeof(uint32_t) * 1024);
+        dir->tables[table_idx] = table;
         dir->tables_physical[table_idx] = phys | MEMORY_PRESENT | MEMORY_READWRITE | MEMORY_USER;
         
-        memset(dir->tables[table_idx], 0, sizeof(uint32_t) * 1024);
+        if (dir == kernel_directory) {
+            __asm__ volatile("lock incl %0" : "+m"(kernel_pde_gen) : : "memory");
+        }
         return &dir->tables[table_idx][address % 1024];
     }
     
     return dir->tables[table_idx] ? &dir->tables[table_idx][address % 1024] : NULL;
 }
 
+page_directory_t* get_kernel_directory(void) {
+    return kernel_directory;
+}
+
+uint32_t kernel_pde_generation(void) {
+    return kernel_pde_gen;
+}
+
+void* page_alloc(phys_addr_t* phys) {
+    uint32_t flags = spin_lock_irqsave(&page_lock);
+    void* page = free_pages;
+    
+    if (page) {
+        free_pages = *(void**)page;
+    }
+    spin_unlock_irqrestore(&page_lock, flags);
+    
+    if (page) {
+        *phys = virt_to_phys(page);
+        return page;
+    }
+    
+    // Sayfalama açılmadan adresler fizikseldir, pencere yoktur
+    if (!kernel_directory) {
+        return kmalloc_aligned_physical(PAGE_SIZE, phys);
+    }
+    
+    // Yeni çerçeve bit haritasından; 0. çerçeve hep dolu, 0 yok demektir
+    flags = spin_lock_irqsave(&frame_lock);
+    uint32_t idx = first_free_frame();
+    if (idx) {
+        set_frame(idx * PAGE_SIZE);
+    }
+    spin_unlock_irqrestore(&frame_lock, flags);
+    
+    if (!idx) {
+        terminal_writestring("ERROR: Out of physical pages\n");
+        return NULL;
+    }
+    
+    phys_addr_t frame = idx * PAGE_SIZE;
+    page = phys_to_virt(frame);
+    // Pencere için sayfa tablosu kurulamazsa çerçeve geri verilir
+    if (frame >= IDENTITY_MAP_END &&
+        map_page_dir(kernel_directory, (uint32_t)page, frame, MEMORY_PRESENT | MEMORY_READWRITE) != 0) {
+        flags = spin_lock_irqsave(&frame_lock);
+        clear_frame(frame);
+        spin_unlock_irqrestore(&frame_lock, flags);
+        
+        terminal_writestring("ERROR: Out of page tables\n");
+        return NULL;
+    }
+    
+    *phys = frame;
+    return page;
+}
+
+void page_free(void* page) {
+    if (!page) return;
+    
+    uint32_t flags = spin_lock_irqsave(&page_lock);
+    *(void**)page = free_pages;
+    free_pages = page;
+    spin_unlock_irqrestore(&page_lock, flags);
+}
+
+static page_frame_t* frame_entry(phys_addr_t phys) {
+    uint32_t idx = phys / PAGE_SIZE;
+    return idx < FRAME_TABLE_SIZE ? &frame_table[idx] : NULL;
+}
+
+int frame_ref(phys_addr_t phys) {
+    page_frame_t* frame = frame_entry(phys);
+    if (!frame) {
+        terminal_writestring("ERROR: Frame outside the reference table\n");
+        return -1;
+    }
+    
+    uint32_t flags = spin_lock_irqsave(&frame_lock);
+    
+    if (frame->ref_count == FRAME_REF_MAX) {
+        spin_unlock_irqrestore(&frame_lock, flags);
+        terminal_writestring("ERROR: Too many references to a frame\n");
+        return -1;
+    }
+    
+    frame->used = 1;
+    frame->ref_count++;
+    spin_unlock_irqrestore(&frame_lock, flags);
+    return 0;
+}
+
+void frame_unref(phys_addr_t phys) {
+    page_frame_t* frame = frame_entry(phys);
+    if (!frame) return;
+    
+    uint32_t flags = spin_lock_irqsave(&frame_lock);
+    bool last = frame->ref_count == 1;
+    
+    if (frame->ref_count > 0) {
+        frame->ref_count--;
+    }
+    if (last) {
+        frame->used = 0;
+    }
+    spin_unlock_irqrestore(&frame_lock, flags);
+    
+    if (last) {
+        page_free(phys_to_virt(phys));
+    }
+}
+
+uint32_t frame_refcount(phys_addr_t phys) {
+    page_frame_t* frame = frame_entry(phys);
+    return frame ? frame->ref_count : 0;
+}
+
+// map one page into the given directory, creating the page table if needed;
+// -1 when no page table could be allocated
+int map_page_dir(page_directory_t* dir, uint32_t virt, phys_addr_t phys, uint32_t flags) {
+    uint32_t* entry = (uint32_t*)get_page(virt, 1, dir);
+    
+    if (!entry) {
+        return -1;
+    }
+    
+    *entry = (phys & MEMORY_FRAME) | (flags & 0xFFF) | MEMORY_PRESENT;
+    
+#if HAVE_INLINE_ASM
+    if (dir == current_directory) {
+        ASM_INLINE("invlpg (%0)" : : "r"(virt) : "memory");
+    }
+#endif
+    return 0;
+}
+
+static void page_fault_isr(uint32_t error_code) {
+    uint32_t address;
+    __asm__ volatile("mov %%cr2, %0" : "=r"(address));
+    
+    handle_page_fault(error_code, address);
+}
+
 void handle_page_fault(uint32_t error_code, uint32_t address) {
+    process_t* current = process_get_current();
+    if (current) {
+        current->page_faults++;
+    }
+    
+    // Talep üzerine sayfalama: eşlenmemiş bir bölge sayfası ya da yazılınca kopyalanan sayfa
+    if (vm_handle_fault(address, error_code) == 0) {
+        return;
+    }
+    
     terminal_set_fg_color(VGA_COLOR_RED);
     terminal_writestring("SAYFA HATASI: 0x");
     terminal_print_hex(address);
@@ -243,8 +441,21 @@ void handle_page_fault(uint32_t error_code, uint32_t address) {
     }
     
     terminal_writestring(")\n");
+    
+    if (kstack_guard_hit(address)) {
+        terminal_writestring("ERROR: Kernel stack overflow (guard page hit)\n");
+    }
     terminal_reset_color();
     
+    // Kullanıcı programının hatası yalnızca onu sonlandırır. Çekirdek
+    // kullanıcı adresine onun verdiği bir işaretçiyle dokunmuştur; bu da
+    // çekirdeğin değil çağıranın hatasıdır.
+    if (current && current->mm &&
+        ((error_code & PAGE_FAULT_USER) ||
+         (address >= USER_SPACE_START && address < USER_SPACE_END))) {
+        process_exit();
+    }
+    
     for(;;);
 }
 
@@ -255,6 +466,8 @@ static uint8_t kernel_heap[HEAP_SIZE];
 static uint32_t heap_end = 0;  // start value
 
 static uint32_t kmalloc_internal(size_t size, int align, phys_addr_t* phys) {
+    uint32_t flags = spin_lock_irqsave(&heap_lock);
+    
     // if aligned memory is requested
     if (align && (heap_end & 0xFFF)) {
         heap_end = (heap_end + 0x1000) & 0xFFFFF000;
@@ -263,12 +476,19 @@ static uint32_t kmalloc_internal(size_t size, int align, phys_addr_t* phys) {
     // save current heap_end
     uint32_t addr = heap_end;
     
+    // Yığın bitti: çağıran NULL'u görür, ötesindeki belleğe taşılmaz
+    if (addr + size > (uint32_t)&kernel_heap[HEAP_SIZE] || addr + size < addr) {
+        spin_unlock_irqrestore(&heap_lock, flags);
+        return 0;
+    }
+    
     if (phys) {
         *phys = (phys_addr_t)get_physaddr((void*)addr);
     }
     
     heap_end += size;
     
+    spin_unlock_irqrestore(&heap_lock, flags);
     return addr;
 }
 
@@ -65,7 +65,7 @@ typedef struct {
 } page_frame_t;
 
 
-typedef struct {
+typedef struct page_directory {
     uint32_t* tables[1024];          
     uint32_t tables_physical[1024];  
     uint32_t physical_addr;          
@@ -85,6 +85,48 @@ phys_addr_t get_physaddr(void* virtualaddr);
 void map_page(void* physaddr, void* virtualaddr, uint32_t flags);  
 void unmap_page(void* virtualaddr);  
 
+page_directory_t* get_kernel_directory(void);
+int map_page_dir(page_directory_t* dir, uint32_t virt, phys_addr_t phys, uint32_t flags);
+
+// Çekirdek dizinine yeni sayfa tablosu eklendikçe artar; işlem dizinleri
+// çekirdek girdilerini bu sayaç değiştiğinde yeniden kopyalar
+uint32_t kernel_pde_generation(void);
+
+// İlk 4 MiB (çekirdek ve yığını) birebir eşlenmiştir, oradaki bir
+// sayfanın çekirdek adresi fiziksel adresidir. Çerçeve bit haritasından
+// gelen sayfalar çekirdekte PHYS_MAP_BASE + fiziksel adreste görünür;
+// bu pencere kullanıcı alanının üstünde, çekirdek yığınlarının ötesindedir.
+#define IDENTITY_MAP_END  0x00400000
+#define PHYS_MAP_BASE     0xD8000000
+#define PHYS_MAP_SIZE     0x08000000    // 128 MiB, bit haritasının kapsadığı bellek
+
+static inline void* phys_to_virt(phys_addr_t phys) {
+    return phys < IDENTITY_MAP_END ? (void*)phys : (void*)(PHYS_MAP_BASE + phys);
+}
+
+static inline phys_addr_t virt_to_phys(const void* virt) {
+    uint32_t addr = (uint32_t)virt;
+    return (addr >= PHYS_MAP_BASE && addr < PHYS_MAP_BASE + PHYS_MAP_SIZE) ?
+           addr - PHYS_MAP_BASE : addr;
+}
+
+// Tek sayfa ayır / bırak. Sayfalar çerçeve bit haritasından alınır ve
+// fiziksel eşlem penceresinde bir kez eşlenir; bırakılan sayfalar bir
+// listede tekrar kullanılır. Dönen adres phys_to_virt(*phys)'tir.
+void* page_alloc(phys_addr_t* phys);
+void page_free(void* page);
+
+// Birden çok eşlemesi olan sayfalar için referans sayısı
+// (page_frame_t.ref_count). page_alloc sayfalarında ve yığının
+// sayfalarında geçerlidir; son referans bırakılınca sayfa page_free ile
+// geri verilir.
+#define FRAME_TABLE_SIZE  (PHYS_MAP_SIZE / PAGE_SIZE)
+#define FRAME_REF_MAX     1023      // ref_count alanı 10 bit
+
+int frame_ref(phys_addr_t phys);    // 0, ya da sayaç doluysa -1
+void frame_unref(phys_addr_t phys);
+uint32_t frame_refcount(phys_addr_t phys);
+
 void* kmalloc(size_t size);  
 void* kmalloc_aligned(size_t size);  
 void* kmalloc_physical(size_t size, phys_addr_t* phys);  
@@ -0,0 +1,149 @@
+#include "pagecache.h"
+#include <kernel/sync/spinlock.h>
+#include <drivers/terminal.h>
+
+static lock_class_t pagecache_class = LOCK_CLASS_INIT("pagecache");
+static spinlock_t cache_lock = SPINLOCK_INIT_CLASS(&pagecache_class);
+
+static list_node_t hash[PAGECACHE_HASH_SIZE];
+static bool hash_ready = false;
+static pagecache_stats_t stats;
+
+static uint32_t hash_index(fs_node_t* node, uint32_t index) {
+    return (((uint32_t)node >> 4) ^ (index * 0x9E3779B1)) & (PAGECACHE_HASH_SIZE - 1);
+}
+
+// cache_lock held
+static cached_page_t* lookup(fs_node_t* node, uint32_t index) {
+    list_node_t* pos;
+
+    if (!hash_ready) {
+        for (int i = 0; i < PAGECACHE_HASH_SIZE; i++) {
+            list_init(&hash[i]);
+        }
+        hash_ready = true;
+    }
+
+    list_for_each(pos, &hash[hash_index(node, index)]) {
+        cached_page_t* page = list_entry(pos, cached_page_t, hash_node);
+        if (page->node == node && page->index == index) {
+            return page;
+        }
+    }
+    return NULL;
+}
+
+// copy one page of the file, zero past its end
+static void read_page(fs_node_t* node, uint32_t index, uint8_t* buf) {
+    uint32_t offset = index * PAGE_SIZE;
+    uint32_t size = 0;
+
+    if (offset < node->length) {
+        size = node->length - offset < PAGE_SIZE ? node->length - offset : PAGE_SIZE;
+    }
+
+    if (size && node->contents) {
+        memcpy(buf, (uint8_t*)node->contents + offset, size);
+    } else if (size && node->read && node->read != fs_read) {
+        size = node->read(node, offset, size, buf);
+    } else {
+        size = 0;
+    }
+
+    memset(buf + size, 0, PAGE_SIZE - size);
+}
+
+cached_page_t* pagecache_get(fs_node_t* node, uint32_t index) {
+    uint32_t flags = spin_lock_irqsave(&cache_lock);
+    cached_page_t* page = lookup(node, index);
+
+    if (page) {
+        stats.hits++;
+        spin_unlock_irqrestore(&cache_lock, flags);
+        return page;
+    }
+    spin_unlock_irqrestore(&cache_lock, flags);
+
+    // read without the lock, then check nobody added the page meanwhile
+    phys_addr_t phys;
+    void* data = page_alloc(&phys);
+    cached_page_t* fresh = (cached_page_t*)kmalloc(sizeof(cached_page_t));
+    if (!data || !fresh) {
+        page_free(data);
+        terminal_writestring("ERROR: Out of memory for the page cache\n");
+        return NULL;
+    }
+    read_page(node, index, (uint8_t*)data);
+
+    flags = spin_lock_irqsave(&cache_lock);
+    page = lookup(node, index);
+
+    if (page) {
+        stats.hits++;
+        spin_unlock_irqrestore(&cache_lock, flags);
+        page_free(data);
+        kfree(fresh);
+        return page;
+    }
+
+    // the cache's own reference; splice takes more, and the count never
+    // drops to zero while the page is cached
+    frame_ref(phys);
+
+    fresh->node = node;
+    fresh->index = index;
+    fresh->data = data;
+    fresh->phys = phys;
+    fresh->mapcount = 0;
+    list_add(&hash[hash_index(node, index)], &fresh->hash_node);
+    stats.pages++;
+    stats.misses++;
+
+    spin_unlock_irqrestore(&cache_lock, flags);
+    return fresh;
+}
+
+cached_page_t* pagecache_map(fs_node_t* node, uint32_t index) {
+    cached_page_t* page = pagecache_get(node, index);
+
+    if (page) {
+        uint32_t flags = spin_lock_irqsave(&cache_lock);
+        page->mapcount++;
+        stats.mapped++;
+        spin_unlock_irqrestore(&cache_lock, flags);
+    }
+    return page;
+}
+
+void pagecache_unmap(fs_node_t* node, uint32_t index) {
+    uint32_t flags = spin_lock_irqsave(&cache_lock);
+    cached_page_t* page = lookup(node, index);
+
+    if (page && page->mapcount > 0) {
+        page->mapcount--;
+        stats.mapped--;
+    }
+    spin_unlock_irqrestore(&cache_lock, flags);
+}
+
+void pagecache_update(fs_node_t* node, uint32_t offset, uint32_t size) {
+    if (!node || size == 0) return;
+
+    uint32_t last = (offset + size - 1) / PAGE_SIZE;
+    uint32_t flags = spin_lock_irqsave(&cache_lock);
+
+    for (uint32_t index = offset / PAGE_SIZE; index <= last; index++) {
+        cached_page_t* page = lookup(node, index);
+        if (page) {
+            read_page(node, index, (uint8_t*)page->data);
+        }
+    }
+
+    spin_unlock_irqrestore(&cache_lock, flags);
+}
+
+void pagecache_stats_get(pagecache_stats_t* out) {
+    uint32_t flags = spin_lock_irqsave(&cache_lock);
+    *out = stats;
+    spin_unlock_irqrestore(&cache_lock, flags);
+}
@@ -0,0 +1,50 @@
+#ifndef PAGECACHE_H
+#define PAGECACHE_H
+
+#include <kernel/types.h>
+#include <kernel/list.h>
+#include <kernel/fs.h>
+#include "memory.h"
+
+// Page cache.
+//
+// File contents in page-sized, page-aligned frames, looked up by file
+// node and page index. The program loader maps these frames straight
+// into user address spaces, so a page of an executable is read once and
+// shared by every process that runs it. Pages are kept for as long as
+// the file exists; writes to a file refresh the cached copies so mapped
+// pages never go stale. The cache holds a reference on every frame
+// (frame_ref), so others can take their own, as splice does.
+
+#define PAGECACHE_HASH_BITS  8
+#define PAGECACHE_HASH_SIZE  (1 << PAGECACHE_HASH_BITS)
+
+typedef struct cached_page {
+    fs_node_t* node;
+    uint32_t index;             // file offset / PAGE_SIZE
+    void* data;                 // kernel address of the frame
+    phys_addr_t phys;
+    uint32_t mapcount;          // user mappings of the frame
+    list_node_t hash_node;
+} cached_page_t;
+
+typedef struct {
+    uint32_t pages;
+    uint32_t mapped;            // user mappings over all pages
+    uint32_t hits;
+    uint32_t misses;            // pages read from the file
+} pagecache_stats_t;
+
+// find the page or read it in, NULL when out of memory
+cached_page_t* pagecache_get(fs_node_t* node, uint32_t index);
+
+// the same, counting one more / one less user mapping of the frame
+cached_page_t* pagecache_map(fs_node_t* node, uint32_t index);
+void pagecache_unmap(fs_node_t* node, uint32_t index);
+
+// [offset, offset + size) of the file changed, reread cached pages
+void pagecache_update(fs_node_t* node, uint32_t offset, uint32_t size);
+
+void pagecache_stats_get(pagecache_stats_t* stats);
+
+#endif // PAGECACHE_H
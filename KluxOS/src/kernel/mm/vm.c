@@ -0,0 +1,601 @@
+#include "vm.h"
+#include "pagecache.h"
+#include <kernel/process.h>
+#include <kernel/cpu/percpu.h>
+#include <drivers/terminal.h>
+
+static lock_class_t mm_class = LOCK_CLASS_INIT("mm");
+static spinlock_t zero_lock = SPINLOCK_INIT;
+
+// freed address spaces, reused whole since kfree gives nothing back
+static spinlock_t spare_lock = SPINLOCK_INIT;
+static mm_t* spare_mms = NULL;
+
+static phys_addr_t zero_phys = 0;
+static vm_stats_t stats;
+
+#define stat_inc(field) __asm__ volatile("lock incl %0" : "+m"(stats.field) : : "memory")
+
+static inline void flush_page(uint32_t address) {
+    __asm__ volatile("invlpg (%0)" : : "r"(address) : "memory");
+}
+
+static uint32_t page_index(const vm_area_t* area, uint32_t page) {
+    return (area->file_offset + (page - area->start)) / PAGE_SIZE;
+}
+
+// Copy kernel page tables the directory does not have yet. The
+// generation is read first, so a table added while we copy makes the
+// next call copy again.
+static void sync_kernel(mm_t* mm) {
+    uint32_t gen = kernel_pde_generation();
+    if (mm->kernel_gen == gen) {
+        return;
+    }
+
+    page_directory_t* kdir = get_kernel_directory();
+    page_directory_t* dir = mm->dir;
+
+    for (int i = 0; i < 1024; i++) {
+        if ((kdir->tables_physical[i] & MEMORY_PRESENT) && !(dir->tables_physical[i] & MEMORY_PRESENT)) {
+            dir->tables[i] = kdir->tables[i];
+            dir->tables_physical[i] = kdir->tables_physical[i];
+        }
+    }
+
+    mm->kernel_gen = gen;
+    stat_inc(kernel_syncs);
+}
+
+mm_t* mm_create(void) {
+    phys_addr_t phys;
+
+    uint32_t flags = spin_lock_irqsave(&zero_lock);
+    if (!zero_phys) {
+        void* zero = page_alloc(&zero_phys);
+        if (zero) {
+            memset(zero, 0, PAGE_SIZE);
+        }
+    }
+    spin_unlock_irqrestore(&zero_lock, flags);
+
+    flags = spin_lock_irqsave(&spare_lock);
+    mm_t* mm = spare_mms;
+    if (mm) {
+        spare_mms = mm->next_free;
+    }
+    spin_unlock_irqrestore(&spare_lock, flags);
+
+    page_directory_t* dir;
+    if (mm) {
+        dir = mm->dir;
+        phys = dir->physical_addr - offsetof(page_directory_t, tables_physical);
+    } else {
+        mm = (mm_t*)kmalloc(sizeof(mm_t));
+        dir = (page_directory_t*)kmalloc_aligned_physical(sizeof(page_directory_t), &phys);
+    }
+    if (!mm || !dir || !zero_phys) {
+        terminal_writestring("ERROR: Not enough memory for an address space\n");
+        return NULL;
+    }
+
+    // the CPU walks tables_physical, which starts on the next page
+    memset(dir, 0, sizeof(page_directory_t));
+    dir->physical_addr = phys + offsetof(page_directory_t, tables_physical);
+
+    mm->dir = dir;
+    list_init(&mm->areas);
+    spin_lock_init_class(&mm->lock, &mm_class);
+    mm->kernel_gen = kernel_pde_generation() - 1;
+    mm->resident = 0;
+    mm->shared = 0;
+    mm->users = 1;
+    mm->next_free = NULL;
+
+    sync_kernel(mm);
+    return mm;
+}
+
+// give back every page of the area and unlink it; mm->lock held
+static void release_area(mm_t* mm, vm_area_t* area, bool flush) {
+    for (uint32_t page = area->start; page < area->end; page += PAGE_SIZE) {
+        uint32_t* pte = (uint32_t*)get_page(page, 0, mm->dir);
+        if (!pte || !(*pte & MEMORY_PRESENT)) {
+            continue;
+        }
+
+        uint32_t frame = *pte & MEMORY_FRAME;
+        if (area->flags & VMA_SHARED) {
+            frame_unref(frame);
+            mm->shared--;
+        } else if (!(*pte & VM_PTE_SHARED)) {
+            page_free(phys_to_virt(frame));
+        } else {
+            if (frame != zero_phys) {
+                pagecache_unmap(area->file, page_index(area, page));
+            }
+            mm->shared--;
+        }
+        mm->resident--;
+
+        *pte = 0;
+        if (flush) {
+            flush_page(page);
+        }
+    }
+
+    list_del(&area->node);
+    kfree(area);
+}
+
+// No CPU has the directory loaded any more: give back the page tables
+// it does not share with the kernel directory, and keep the rest for
+// the next mm_create.
+static void mm_free(mm_t* mm) {
+    page_directory_t* kdir = get_kernel_directory();
+    page_directory_t* dir = mm->dir;
+
+    for (int i = 0; i < 1024; i++) {
+        if (dir->tables[i] && dir->tables[i] != kdir->tables[i]) {
+            page_free(dir->tables[i]);
+        }
+    }
+
+    uint32_t flags = spin_lock_irqsave(&spare_lock);
+    mm->next_free = spare_mms;
+    spare_mms = mm;
+    spin_unlock_irqrestore(&spare_lock, flags);
+}
+
+static void mm_get(mm_t* mm) {
+    __asm__ volatile("lock incl %0" : "+m"(mm->users) : : "memory");
+}
+
+static void mm_put(mm_t* mm) {
+    uint32_t old = (uint32_t)-1;
+    __asm__ volatile("lock xaddl %0, %1" : "+r"(old), "+m"(mm->users) : : "memory");
+
+    if (old == 1) {
+        mm_free(mm);
+    }
+}
+
+void mm_destroy(mm_t* mm) {
+    list_node_t* pos;
+    list_node_t* tmp;
+
+    if (!mm) return;
+
+    uint32_t flags = spin_lock_irqsave(&mm->lock);
+
+    // whoever still has the directory loaded runs no user code under it
+    list_for_each_safe(pos, tmp, &mm->areas) {
+        release_area(mm, list_entry(pos, vm_area_t, node), false);
+    }
+
+    spin_unlock_irqrestore(&mm->lock, flags);
+
+    // the owner's reference; a CPU still on the directory frees it in vm_switch
+    mm_put(mm);
+}
+
+int mm_map(mm_t* mm, uint32_t start, uint32_t size, uint32_t flags,
+           fs_node_t* file, uint32_t file_offset, uint32_t file_size) {
+    uint32_t end = (start + size + PAGE_SIZE - 1) & MEMORY_FRAME;
+
+    if (size == 0 || (start & ~MEMORY_FRAME) || (file_offset & ~MEMORY_FRAME) || file_size > size) {
+        terminal_writestring("ERROR: Invalid area\n");
+        return -1;
+    }
+
+    if (start < USER_SPACE_START || end > USER_SPACE_END || end <= start) {
+        terminal_writestring("ERROR: Area outside user space\n");
+        return -1;
+    }
+
+    // user tables are private to the directory, kernel ones are shared
+    page_directory_t* kdir = get_kernel_directory();
+    for (uint32_t pde = start >> 22; pde <= (end - 1) >> 22; pde++) {
+        if (kdir->tables_physical[pde] & MEMORY_PRESENT) {
+            terminal_writestring("ERROR: Area overlaps kernel mappings\n");
+            return -1;
+        }
+    }
+
+    vm_area_t* area = (vm_area_t*)kmalloc(sizeof(vm_area_t));
+    if (!area) {
+        terminal_writestring("ERROR: Not enough memory for an area\n");
+        return -1;
+    }
+
+    area->start = start;
+    area->end = end;
+    area->flags = flags;
+    area->file = file_size ? file : NULL;
+    area->file_offset = file_offset;
+    area->file_size = file ? file_size : 0;
+
+    uint32_t lock_flags = spin_lock_irqsave(&mm->lock);
+    list_node_t* pos;
+
+    // keep the list sorted, insert before the first area above us
+    list_for_each(pos, &mm->areas) {
+        vm_area_t* other = list_entry(pos, vm_area_t, node);
+
+        if (other->start < end && start < other->end) {
+            spin_unlock_irqrestore(&mm->lock, lock_flags);
+            kfree(area);
+            terminal_writestring("ERROR: Areas overlap\n");
+            return -1;
+        }
+        if (other->start >= end) {
+            break;
+        }
+    }
+    list_add_tail(pos, &area->node);
+
+    spin_unlock_irqrestore(&mm->lock, lock_flags);
+    return 0;
+}
+
+uint32_t mm_find_free(mm_t* mm, uint32_t size) {
+    uint32_t start = USER_MMAP_BASE;
+    list_node_t* pos;
+
+    size = (size + PAGE_SIZE - 1) & MEMORY_FRAME;
+    if (size == 0) {
+        return 0;
+    }
+
+    uint32_t flags = spin_lock_irqsave(&mm->lock);
+
+    // areas are sorted, take the first gap that is big enough
+    list_for_each(pos, &mm->areas) {
+        vm_area_t* area = list_entry(pos, vm_area_t, node);
+
+        if (area->end <= start) {
+            continue;
+        }
+        if (area->start >= start + size) {
+            break;
+        }
+        start = area->end;
+    }
+
+    spin_unlock_irqrestore(&mm->lock, flags);
+
+    if (start + size > USER_STACK_TOP - USER_STACK_SIZE || start + size < start) {
+        return 0;
+    }
+    return start;
+}
+
+int mm_map_frames(mm_t* mm, uint32_t start, const phys_addr_t* frames, uint32_t count,
+                  uint32_t flags) {
+    if (mm_map(mm, start, count * PAGE_SIZE, flags | VMA_SHARED, NULL, 0, 0) != 0) {
+        return -1;
+    }
+
+    uint32_t pte_flags = MEMORY_PRESENT | MEMORY_USER | ((flags & VMA_WRITE) ? MEMORY_READWRITE : 0);
+    uint32_t lock_flags = spin_lock_irqsave(&mm->lock);
+
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t* pte = (uint32_t*)get_page(start + i * PAGE_SIZE, 1, mm->dir);
+
+        // a page left unmapped would fault for good; mm_unmap drops what we took
+        if (!pte || frame_ref(frames[i]) != 0) {
+            spin_unlock_irqrestore(&mm->lock, lock_flags);
+            mm_unmap(mm, start);
+            return -1;
+        }
+
+        *pte = (frames[i] & MEMORY_FRAME) | pte_flags;
+        mm->resident++;
+        mm->shared++;
+    }
+
+    spin_unlock_irqrestore(&mm->lock, lock_flags);
+    return 0;
+}
+
+int mm_unmap(mm_t* mm, uint32_t start) {
+    list_node_t* pos;
+
+    uint32_t flags = spin_lock_irqsave(&mm->lock);
+
+    list_for_each(pos, &mm->areas) {
+        vm_area_t* area = list_entry(pos, vm_area_t, node);
+
+        // program areas stay until the program goes
+        if (area->start == start && (area->flags & VMA_SHARED)) {
+            release_area(mm, area, this_cpu()->active_mm == mm);
+            spin_unlock_irqrestore(&mm->lock, flags);
+            return 0;
+        }
+    }
+
+    spin_unlock_irqrestore(&mm->lock, flags);
+    terminal_writestring("ERROR: No area at that address\n");
+    return -1;
+}
+
+page_directory_t* vm_current_directory(void) {
+    process_t* current = this_cpu()->current;
+
+    if (current && current->mm) {
+        return current->mm->dir;
+    }
+    return get_kernel_directory();
+}
+
+// mm->lock held
+static vm_area_t* find_area(mm_t* mm, uint32_t address) {
+    list_node_t* pos;
+
+    list_for_each(pos, &mm->areas) {
+        vm_area_t* area = list_entry(pos, vm_area_t, node);
+
+        if (address < area->start) {
+            break;
+        }
+        if (address < area->end) {
+            return area;
+        }
+    }
+    return NULL;
+}
+
+int vm_check_user(const void* addr, uint32_t size, bool write) {
+    process_t* current = this_cpu()->current;
+    uint32_t start = (uint32_t)addr;
+    uint32_t end = start + size;
+
+    if (!current || !current->mm || size == 0) {
+        return 0;
+    }
+    if (end < start || start < USER_SPACE_START || end > USER_SPACE_END) {
+        return -1;
+    }
+
+    mm_t* mm = current->mm;
+    int result = 0;
+    uint32_t flags = spin_lock_irqsave(&mm->lock);
+
+    // areas are sorted and may sit back to back
+    while (start < end) {
+        vm_area_t* area = find_area(mm, start);
+
+        if (!area || (write && !(area->flags & VMA_WRITE))) {
+            result = -1;
+            break;
+        }
+        start = area->end;
+    }
+
+    spin_unlock_irqrestore(&mm->lock, flags);
+    return result;
+}
+
+int vm_check_user_string(const char* str, uint32_t max) {
+    process_t* current = this_cpu()->current;
+
+    if (!current || !current->mm) {
+        return 0;
+    }
+
+    // look at each page before reading from it
+    for (uint32_t i = 0; i < max; i++) {
+        uint32_t addr = (uint32_t)str + i;
+
+        if ((i == 0 || (addr & (PAGE_SIZE - 1)) == 0) &&
+            vm_check_user((const void*)addr, 1, false) != 0) {
+            return -1;
+        }
+        if (str[i] == '\0') {
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// first touch of a page; mm->lock held
+static int fill_page(mm_t* mm, vm_area_t* area, uint32_t page, uint32_t* pte, bool write) {
+    uint32_t offset = page - area->start;
+    uint32_t from_file = 0;
+
+    if (offset < area->file_size) {
+        from_file = area->file_size - offset < PAGE_SIZE ? area->file_size - offset : PAGE_SIZE;
+    }
+
+    // reads share a frame until somebody writes
+    if (!write && (from_file == PAGE_SIZE || from_file == 0)) {
+        phys_addr_t frame = zero_phys;
+
+        if (from_file) {
+            cached_page_t* cached = pagecache_map(area->file, page_index(area, page));
+            if (!cached) {
+                return -1;
+            }
+            frame = cached->phys;
+            stat_inc(file_faults);
+        } else {
+            stat_inc(zero_faults);
+        }
+
+        *pte = frame | MEMORY_PRESENT | MEMORY_USER | VM_PTE_SHARED;
+        mm->resident++;
+        mm->shared++;
+        return 0;
+    }
+
+    phys_addr_t phys;
+    uint8_t* data = (uint8_t*)page_alloc(&phys);
+    if (!data) {
+        terminal_writestring("ERROR: Out of memory for a user page\n");
+        return -1;
+    }
+
+    if (from_file) {
+        cached_page_t* cached = pagecache_get(area->file, page_index(area, page));
+        if (!cached) {
+            page_free(data);
+            return -1;
+        }
+        memcpy(data, cached->data, from_file);
+    }
+    memset(data + from_file, 0, PAGE_SIZE - from_file);
+
+    *pte = phys | MEMORY_PRESENT | MEMORY_USER | ((area->flags & VMA_WRITE) ? MEMORY_READWRITE : 0);
+    mm->resident++;
+    stat_inc(private_faults);
+    return 0;
+}
+
+// write to a shared frame in a writable area; mm->lock held
+static int copy_on_write(mm_t* mm, vm_area_t* area, uint32_t page, uint32_t* pte) {
+    // another CPU's stale entry, the page is already private
+    if (!(*pte & VM_PTE_SHARED)) {
+        return 0;
+    }
+
+    phys_addr_t phys;
+    uint8_t* data = (uint8_t*)page_alloc(&phys);
+    if (!data) {
+        terminal_writestring("ERROR: Out of memory for a user page\n");
+        return -1;
+    }
+
+    // page cache frames come from page_alloc, seen at phys_to_virt
+    uint32_t frame = *pte & MEMORY_FRAME;
+    if (frame == zero_phys) {
+        memset(data, 0, PAGE_SIZE);
+    } else {
+        memcpy(data, phys_to_virt(frame), PAGE_SIZE);
+        pagecache_unmap(area->file, page_index(area, page));
+    }
+
+    *pte = phys | MEMORY_PRESENT | MEMORY_USER | MEMORY_READWRITE;
+    mm->shared--;
+    stat_inc(cow_faults);
+    return 0;
+}
+
+int vm_handle_fault(uint32_t address, uint32_t error_code) {
+    cpu_t* cpu = this_cpu();
+    mm_t* mm = cpu->active_mm;
+
+    // the kernel directory is always complete
+    if (!mm) {
+        return -1;
+    }
+
+    if (address < USER_SPACE_START || address >= USER_SPACE_END) {
+        // a kernel table added since this directory was brought up to date
+        uint32_t pde = address >> 22;
+        page_directory_t* kdir = get_kernel_directory();
+
+        if ((kdir->tables_physical[pde] & MEMORY_PRESENT) &&
+            !(mm->dir->tables_physical[pde] & MEMORY_PRESENT)) {
+            mm->dir->tables[pde] = kdir->tables[pde];
+            mm->dir->tables_physical[pde] = kdir->tables_physical[pde];
+            stat_inc(kernel_syncs);
+            return 0;
+        }
+        return -1;
+    }
+
+    // a kernel thread borrowing the directory has no business down here
+    process_t* current = cpu->current;
+    if (!current || current->mm != mm) {
+        return -1;
+    }
+
+    uint32_t page = address & MEMORY_FRAME;
+    bool write = (error_code & PAGE_FAULT_WRITE) != 0;
+    int result = -1;
+
+    uint32_t flags = spin_lock_irqsave(&mm->lock);
+    vm_area_t* area = find_area(mm, page);
+
+    // shared areas are mapped in full, a fault there is the program's own
+    if (area && !(area->flags & VMA_SHARED) && (!write || (area->flags & VMA_WRITE))) {
+        uint32_t* pte = (uint32_t*)get_page(page, 1, mm->dir);
+
+        // no memory left for the page table, the fault stays unresolved
+        if (!pte) {
+            result = -1;
+        } else if (!(*pte & MEMORY_PRESENT)) {
+            result = fill_page(mm, area, page, pte, write);
+        } else if (write) {
+            result = copy_on_write(mm, area, page, pte);
+        } else {
+            result = 0;
+        }
+
+        if (result == 0) {
+            flush_page(page);
+        }
+    }
+
+    spin_unlock_irqrestore(&mm->lock, flags);
+    return result;
+}
+
+void vm_switch(mm_t* next) {
+    cpu_t* cpu = this_cpu();
+    mm_t* mm = next ? next : cpu->active_mm;
+
+    if (!mm) {
+        return;
+    }
+
+    // the stack we are about to run on may sit in a table added meanwhile
+    sync_kernel(mm);
+
+    // reloading also drops entries left from the last time next ran here
+    if (next) {
+        mm_t* prev = cpu->active_mm;
+
+        if (prev != next) {
+            mm_get(next);
+        }
+        __asm__ volatile("mov %0, %%cr3" : : "r"(next->dir->physical_addr) : "memory");
+        cpu->active_mm = next;
+
+        // off the old directory now, it may have been the last CPU on it
+        if (prev && prev != next) {
+            mm_put(prev);
+        }
+    }
+}
+
+void vm_stats_get(vm_stats_t* out) {
+    *out = stats;
+}
+
+void vm_stats_dump(void) {
+    pagecache_stats_t cache;
+    pagecache_stats_get(&cache);
+
+    terminal_writestring("Demand paging: ");
+    terminal_print_uint(stats.file_faults);
+    terminal_writestring(" file, ");
+    terminal_print_uint(stats.zero_faults);
+    terminal_writestring(" zero, ");
+    terminal_print_uint(stats.private_faults);
+    terminal_writestring(" private, ");
+    terminal_print_uint(stats.cow_faults);
+    terminal_writestring(" copy-on-write faults, ");
+    terminal_print_uint(stats.kernel_syncs);
+    terminal_writestring(" kernel table syncs\n");
+
+    terminal_writestring("Page cache: ");
+    terminal_print_uint(cache.pages);
+    terminal_writestring(" pages, ");
+    terminal_print_uint(cache.mapped);
+    terminal_writestring(" user mappings, ");
+    terminal_print_uint(cache.hits);
+    terminal_writestring(" hits, ");
+    terminal_print_uint(cache.misses);
+    terminal_writestring(" reads\n");
+}
@@ -0,0 +1,121 @@
+#ifndef VM_H
+#define VM_H
+
+#include <kernel/types.h>
+#include <kernel/list.h>
+#include <kernel/fs.h>
+#include <kernel/sync/spinlock.h>
+#include "memory.h"
+
+// User address spaces.
+//
+// A program loaded by exec gets its own page directory. The kernel part
+// is shared: the directory starts as a copy of the kernel directory's
+// page table pointers, and picks up tables the kernel adds later either
+// at the next switch to it or, on the CPU that is running it, from the
+// page fault they cause. The user part is described by areas and filled
+// in lazily. Nothing is mapped when an area is created; the first touch
+// of a page faults and the page is brought in then:
+//
+//   file page   the frame of the page cache is mapped read-only, so
+//               every process running the same executable shares it
+//   zero page   one shared zeroed frame, read-only
+//   write       a read-only shared frame in a writable area is copied
+//               to a private page first (copy on write)
+//
+// A page that is only partly backed by the file (where .data ends and
+// .bss begins) is always private. Areas never overlap the page tables
+// of the kernel directory.
+//
+// Shared areas (VMA_SHARED) are different: all of their pages are mapped
+// when the area is created, and each mapping holds a reference on the
+// frame (frame_ref), so the frames outlive whoever allocated them until
+// the last address space lets go.
+
+#define USER_SPACE_START   0x00400000
+#define USER_SPACE_END     0xBF800000       // the vDSO table sits above
+#define USER_STACK_TOP     USER_SPACE_END
+#define USER_STACK_SIZE    0x40000          // reserved, faulted in as it grows
+#define USER_MMAP_BASE     0x40000000       // shared areas are placed from here up
+
+#define VMA_READ    0x1
+#define VMA_WRITE   0x2
+#define VMA_EXEC    0x4
+#define VMA_SHARED  0x8         // referenced frames, mapped up front
+
+#define VM_PTE_SHARED  0x200    // available PTE bit: frame is shared, copy before writing
+
+typedef struct vm_area {
+    uint32_t start;             // page aligned
+    uint32_t end;               // page aligned, exclusive
+    uint32_t flags;             // VMA_*
+    fs_node_t* file;            // NULL for zero-filled memory
+    uint32_t file_offset;       // file offset of start, page aligned
+    uint32_t file_size;         // bytes from start that come from the file
+    list_node_t node;           // mm_t.areas, sorted by address
+} vm_area_t;
+
+typedef struct mm {
+    page_directory_t* dir;
+    list_node_t areas;
+    spinlock_t lock;            // areas and user page tables
+    uint32_t kernel_gen;        // kernel_pde_generation() last copied
+    uint32_t resident;          // user pages mapped
+    uint32_t shared;            // ... of them page cache or zero page frames
+    volatile uint32_t users;    // the owner until mm_destroy, plus each CPU with dir loaded
+    struct mm* next_free;       // spare list once freed
+} mm_t;
+
+typedef struct {
+    uint32_t file_faults;       // page cache frame mapped
+    uint32_t zero_faults;       // zero page mapped
+    uint32_t private_faults;    // private page filled
+    uint32_t cow_faults;        // shared frame copied on write
+    uint32_t kernel_syncs;      // kernel tables copied into a user directory
+} vm_stats_t;
+
+mm_t* mm_create(void);
+
+// give back every user page. The directory and its tables go once no
+// CPU has them loaded, which may be at that CPU's next vm_switch.
+void mm_destroy(mm_t* mm);
+
+// add an area of [start, start + size); 0 on success
+int mm_map(mm_t* mm, uint32_t start, uint32_t size, uint32_t flags,
+           fs_node_t* file, uint32_t file_offset, uint32_t file_size);
+
+// lowest free page-aligned range of size bytes above USER_MMAP_BASE, 0 if none
+uint32_t mm_find_free(mm_t* mm, uint32_t size);
+
+// add a VMA_SHARED area over the given frames, taking a reference on each
+int mm_map_frames(mm_t* mm, uint32_t start, const phys_addr_t* frames, uint32_t count,
+                  uint32_t flags);
+
+// remove the shared area starting at start and release its pages; 0 on success
+int mm_unmap(mm_t* mm, uint32_t start);
+
+// directory a user address is looked up in: the running program's, or
+// the kernel's for kernel threads
+page_directory_t* vm_current_directory(void);
+
+// A pointer a program hands to a system call: 0 when [addr, addr + size)
+// lies inside its areas, writable ones if the kernel writes there, and
+// -1 otherwise. Pages not touched yet are faulted in by the copy itself.
+// Kernel threads have no areas; their pointers are kernel ones and pass.
+int vm_check_user(const void* addr, uint32_t size, bool write);
+
+// the same for a string of at most max bytes with its terminator
+int vm_check_user_string(const char* str, uint32_t max);
+
+// called from the page fault handler, 0 when the fault was resolved
+int vm_handle_fault(uint32_t address, uint32_t error_code);
+
+// context switch, interrupts off: load next's directory. Kernel threads
+// (next == NULL) keep whatever directory is loaded. Leaving a destroyed
+// directory frees it.
+void vm_switch(mm_t* next);
+
+void vm_stats_get(vm_stats_t* stats);
+void vm_stats_dump(void);
+
+#endif // VM_H
@@ -0,0 +1,919 @@
+#include <kernel/pipe.h>
+#include <kernel/epoll.h>
+#include <kernel/process.h>
+#include <kernel/cpu/cpu.h>
+#include <kernel/sync/spinlock.h>
+#include <drivers/terminal.h>
+#include "mm/memory.h"
+#include "mm/pagecache.h"
+#include "mm/vm.h"
+
+#define SLOT(pipe, n)  (&(pipe)->slots[(n) & (PIPE_SLOTS - 1)])
+
+typedef bool (*pipe_cond_t)(pipe_t* pipe, uint32_t arg);
+
+static lock_class_t pipe_class = LOCK_CLASS_INIT("pipe");
+static lock_class_t pipe_list_class = LOCK_CLASS_INIT("pipe list");
+static spinlock_t pipe_list_lock = SPINLOCK_INIT_CLASS(&pipe_list_class);
+static list_node_t pipe_list = LIST_HEAD_INIT(pipe_list);
+
+static inline void atomic_inc(volatile uint32_t* value) {
+    __asm__ volatile("lock incl %0" : "+m"(*value) : : "memory");
+}
+
+static inline void atomic_dec(volatile uint32_t* value) {
+    __asm__ volatile("lock decl %0" : "+m"(*value) : : "memory");
+}
+
+// stores stay in order on x86, the compiler must keep them so too
+static inline void compiler_barrier(void) {
+    __asm__ volatile("" : : : "memory");
+}
+
+static inline uint32_t min_u32(uint32_t a, uint32_t b) {
+    return a < b ? a : b;
+}
+
+bool pipe_readable(pipe_t* pipe) {
+    uint32_t head = pipe->head;
+    uint32_t tail = pipe->tail;
+
+    // only the last slot can be left behind empty
+    if (tail - head > 1) {
+        return true;
+    }
+    if (tail != head && SLOT(pipe, head)->offset < SLOT(pipe, head)->len) {
+        return true;
+    }
+    return pipe->writers == 0;
+}
+
+// bytes a writer can put in without sleeping
+static uint32_t pipe_room(pipe_t* pipe) {
+    uint32_t tail = pipe->tail;
+    uint32_t used = tail - pipe->head;
+    uint32_t room = (PIPE_SLOTS - used) * PAGE_SIZE;
+
+    if (used > 0) {
+        pipe_slot_t* last = SLOT(pipe, tail - 1);
+        if (last->flags & PIPE_SLOT_MERGE) {
+            room += PAGE_SIZE - last->len;
+        }
+    }
+    return room;
+}
+
+bool pipe_writable(pipe_t* pipe) {
+    return pipe_room(pipe) > 0 || pipe->readers == 0;
+}
+
+static bool can_read(pipe_t* pipe, uint32_t arg) {
+    (void)arg;
+    return pipe_readable(pipe);
+}
+
+// room for count bytes, or for something if count is 0
+static bool can_write(pipe_t* pipe, uint32_t count) {
+    return pipe_room(pipe) >= (count ? count : 1) || pipe->readers == 0;
+}
+
+// a free slot, which splice and tee need whatever the last page holds
+static bool has_slot(pipe_t* pipe, uint32_t arg) {
+    (void)arg;
+    return pipe->tail - pipe->head < PIPE_SLOTS || pipe->readers == 0;
+}
+
+static bool writer_opened(pipe_t* pipe, uint32_t seen) {
+    return pipe->writers > 0 || pipe->writer_opens != seen;
+}
+
+static bool reader_opened(pipe_t* pipe, uint32_t seen) {
+    return pipe->readers > 0 || pipe->reader_opens != seen;
+}
+
+// sleep until cond holds; the other end sees sleepers and wakes us.
+// -1 when the process is killed while waiting.
+static int pipe_wait(pipe_t* pipe, wait_queue_t* wq, volatile uint32_t* sleepers,
+                     pipe_cond_t cond, uint32_t arg) {
+    wait_entry_t entry;
+
+    uint32_t flags = spin_lock_irqsave(&wq->lock);
+    atomic_inc(sleepers);
+
+    if (cond(pipe, arg)) {
+        atomic_dec(sleepers);
+        spin_unlock_irqrestore(&wq->lock, flags);
+        return 0;
+    }
+
+    wait_entry_init(&entry);
+    wait_queue_add_locked(wq, &entry);
+    spin_unlock_irqrestore(&wq->lock, flags);
+
+    int result = wait_entry_block_killable(&entry);
+    if (result != 0) {
+        wait_queue_remove(wq, &entry);
+    }
+    atomic_dec(sleepers);
+    return result;
+}
+
+static void pipe_wake(wait_queue_t* wq, volatile uint32_t* sleepers) {
+    // the store that made progress must be visible before sleepers is read
+    smp_mb();
+
+    // epoll entries stay queued without counting as sleepers
+    if (*sleepers || wait_queue_active(wq)) {
+        wait_queue_wake_all(wq);
+    }
+}
+
+// drop read slots, never the last one; read_lock held
+static void retire_slots(pipe_t* pipe) {
+    while (pipe->tail - pipe->head > 1) {
+        pipe_slot_t* slot = SLOT(pipe, pipe->head);
+        uint32_t page = slot->page;
+
+        // not the last slot, so its length is final
+        if (slot->offset < slot->len) {
+            break;
+        }
+
+        // the writer may reuse the slot as soon as head moves
+        compiler_barrier();
+        pipe->head++;
+        frame_unref(page);
+    }
+}
+
+// copy out up to count bytes; read_lock held
+static uint32_t copy_out(pipe_t* pipe, uint8_t* buf, uint32_t count) {
+    uint32_t done = 0;
+
+    while (done < count) {
+        retire_slots(pipe);
+        if (pipe->tail == pipe->head) {
+            break;
+        }
+
+        pipe_slot_t* slot = SLOT(pipe, pipe->head);
+        uint32_t len = slot->len;
+        if (slot->offset == len) {
+            break;
+        }
+        compiler_barrier();
+
+        uint32_t n = min_u32(len - slot->offset, count - done);
+        memcpy(buf + done, (uint8_t*)phys_to_virt(slot->page) + slot->offset, n);
+        compiler_barrier();
+        slot->offset += n;
+        done += n;
+    }
+
+    retire_slots(pipe);
+    return done;
+}
+
+// append to the last page while it has room, then fill new slots;
+// write_lock held
+static uint32_t copy_in(pipe_t* pipe, const uint8_t* buf, uint32_t count) {
+    uint32_t done = 0;
+
+    while (done < count) {
+        uint32_t tail = pipe->tail;
+
+        // head != tail, so the reader keeps this slot
+        if (tail != pipe->head) {
+            pipe_slot_t* last = SLOT(pipe, tail - 1);
+
+            if ((last->flags & PIPE_SLOT_MERGE) && last->len < PAGE_SIZE) {
+                uint32_t n = min_u32(PAGE_SIZE - last->len, count - done);
+
+                memcpy((uint8_t*)phys_to_virt(last->page) + last->len, buf + done, n);
+                compiler_barrier();
+                last->len += n;
+                done += n;
+                continue;
+            }
+        }
+
+        if (tail - pipe->head >= PIPE_SLOTS) {
+            break;
+        }
+
+        phys_addr_t phys;
+        void* page = page_alloc(&phys);
+        if (!page) {
+            terminal_writestring("ERROR: Out of memory for a pipe buffer\n");
+            break;
+        }
+        frame_ref(phys);
+
+        uint32_t n = min_u32(PAGE_SIZE, count - done);
+        memcpy(page, buf + done, n);
+
+        pipe_slot_t* slot = SLOT(pipe, tail);
+        slot->page = phys;
+        slot->offset = 0;
+        slot->len = n;
+        slot->flags = PIPE_SLOT_MERGE;
+
+        compiler_barrier();
+        pipe->tail = tail + 1;
+        done += n;
+    }
+
+    return done;
+}
+
+// publish [offset, offset + len) of a frame someone else owns, taking a
+// reference; write_lock held and a slot free
+static int push_page(pipe_t* pipe, uint32_t page, uint32_t offset, uint32_t len) {
+    if (frame_ref(page) != 0) {
+        return -1;
+    }
+
+    uint32_t tail = pipe->tail;
+    pipe_slot_t* slot = SLOT(pipe, tail);
+
+    // shared with the source, nobody may write into it
+    slot->page = page;
+    slot->offset = offset;
+    slot->len = offset + len;
+    slot->flags = 0;
+
+    compiler_barrier();
+    pipe->tail = tail + 1;
+    return 0;
+}
+
+int pipe_read(file_t* file, void* buf, uint32_t count) {
+    pipe_t* pipe = (pipe_t*)file->node->device;
+    int done;
+
+    if (count == 0) {
+        return 0;
+    }
+    if (vm_check_user(buf, count, true) != 0) {
+        terminal_writestring("ERROR: Bad buffer\n");
+        return -1;
+    }
+
+    mutex_lock(&pipe->read_lock);
+
+    for (;;) {
+        done = (int)copy_out(pipe, (uint8_t*)buf, count);
+        if (done > 0) {
+            break;
+        }
+
+        // a writer may have written and closed since we looked
+        if (pipe->writers == 0) {
+            done = (int)copy_out(pipe, (uint8_t*)buf, count);
+            break;
+        }
+
+        if (file->flags & O_NONBLOCK) {
+            done = -1;
+            break;
+        }
+
+        if (pipe_wait(pipe, &pipe->read_wait, &pipe->read_sleepers, can_read, 0) != 0) {
+            done = -1;
+            break;
+        }
+    }
+
+    mutex_unlock(&pipe->read_lock);
+
+    if (done > 0) {
+        pipe_wake(&pipe->write_wait, &pipe->write_sleepers);
+    }
+    return done;
+}
+
+int pipe_write(file_t* file, const void* buf, uint32_t count) {
+    pipe_t* pipe = (pipe_t*)file->node->device;
+    bool nonblock = (file->flags & O_NONBLOCK) != 0;
+    uint32_t done = 0;
+
+    if (vm_check_user(buf, count, false) != 0) {
+        terminal_writestring("ERROR: Bad buffer\n");
+        return -1;
+    }
+
+    mutex_lock(&pipe->write_lock);
+
+    // small writes go in whole or, without blocking, not at all
+    uint32_t want = count <= PIPE_BUF ? count : 0;
+
+    while (done < count) {
+        if (pipe->readers == 0) {
+            terminal_writestring("ERROR: Broken pipe\n");
+            break;
+        }
+
+        if (!can_write(pipe, want)) {
+            if (nonblock) {
+                break;
+            }
+            if (pipe_wait(pipe, &pipe->write_wait, &pipe->write_sleepers, can_write, want) != 0) {
+                break;
+            }
+            continue;
+        }
+
+        uint32_t n = copy_in(pipe, (const uint8_t*)buf + done, count - done);
+        if (n == 0) {
+            break;
+        }
+        done += n;
+        want = 0;
+
+        pipe_wake(&pipe->read_wait, &pipe->read_sleepers);
+    }
+
+    pipe->bytes += done;
+    mutex_unlock(&pipe->write_lock);
+
+    return done > 0 || count == 0 ? (int)done : -1;
+}
+
+// move or, with keep, copy references to up to len bytes from one pipe
+// to the other
+static int splice_pipes(pipe_t* in, pipe_t* out, uint32_t len, bool nonblock, bool keep) {
+    uint32_t done = 0;
+    int result = 0;
+
+    mutex_lock(&in->read_lock);
+    mutex_lock(&out->write_lock);
+
+    // tee walks the slots without consuming them
+    uint32_t cursor = in->head;
+    uint32_t pos = in->tail != cursor ? SLOT(in, cursor)->offset : 0;
+
+    while (done < len) {
+        if (out->readers == 0) {
+            terminal_writestring("ERROR: Broken pipe\n");
+            result = -1;
+            break;
+        }
+
+        if (!keep) {
+            retire_slots(in);
+            cursor = in->head;
+            pos = in->tail != cursor ? SLOT(in, cursor)->offset : 0;
+        }
+
+        pipe_slot_t* slot = in->tail != cursor ? SLOT(in, cursor) : NULL;
+        uint32_t end = slot ? slot->len : 0;
+
+        if (slot && pos == end && cursor + 1 != in->tail) {
+            cursor++;
+            pos = SLOT(in, cursor)->offset;
+            continue;
+        }
+
+        if (!slot || pos == end) {
+            if (done > 0 || in->writers == 0) {
+                break;
+            }
+            if (nonblock) {
+                result = -1;
+                break;
+            }
+            if (pipe_wait(in, &in->read_wait, &in->read_sleepers, can_read, 0) != 0) {
+                result = -1;
+                break;
+            }
+            cursor = in->head;
+            pos = in->tail != cursor ? SLOT(in, cursor)->offset : 0;
+            continue;
+        }
+
+        if (out->tail - out->head >= PIPE_SLOTS) {
+            if (done > 0) {
+                break;
+            }
+            if (nonblock) {
+                result = -1;
+                break;
+            }
+            if (pipe_wait(out, &out->write_wait, &out->write_sleepers, has_slot, 0) != 0) {
+                result = -1;
+                break;
+            }
+            continue;
+        }
+
+        uint32_t n = min_u32(end - pos, len - done);
+        if (push_page(out, slot->page, pos, n) != 0) {
+            result = -1;
+            break;
+        }
+
+        pos += n;
+        done += n;
+        if (!keep) {
+            compiler_barrier();
+            slot->offset = pos;
+        }
+        pipe_wake(&out->read_wait, &out->read_sleepers);
+    }
+
+    if (!keep) {
+        retire_slots(in);
+    }
+    out->spliced += done;
+    in->spliced += done;
+
+    mutex_unlock(&out->write_lock);
+    mutex_unlock(&in->read_lock);
+
+    if (done > 0 && !keep) {
+        pipe_wake(&in->write_wait, &in->write_sleepers);
+    }
+    return done > 0 ? (int)done : result;
+}
+
+// page cache frames straight into the pipe
+static int splice_from_file(file_t* file, pipe_t* out, uint32_t len, bool nonblock) {
+    fs_node_t* node = file->node;
+    uint32_t done = 0;
+    int result = 0;
+
+    mutex_lock(&out->write_lock);
+
+    while (done < len && file->offset < node->length) {
+        if (out->readers == 0) {
+            terminal_writestring("ERROR: Broken pipe\n");
+            result = -1;
+            break;
+        }
+
+        if (out->tail - out->head >= PIPE_SLOTS) {
+            if (done > 0) {
+                break;
+            }
+            if (nonblock) {
+                result = -1;
+                break;
+            }
+            if (pipe_wait(out, &out->write_wait, &out->write_sleepers, has_slot, 0) != 0) {
+                result = -1;
+                break;
+            }
+            continue;
+        }
+
+        cached_page_t* page = pagecache_get(node, file->offset / PAGE_SIZE);
+        if (!page) {
+            result = -1;
+            break;
+        }
+
+        uint32_t in_page = file->offset % PAGE_SIZE;
+        uint32_t n = min_u32(min_u32(PAGE_SIZE - in_page, node->length - file->offset), len - done);
+
+        // a later write to the file shows through until the pipe is read
+        if (push_page(out, page->phys, in_page, n) != 0) {
+            result = -1;
+            break;
+        }
+
+        file->offset += n;
+        done += n;
+        pipe_wake(&out->read_wait, &out->read_sleepers);
+    }
+
+    out->spliced += done;
+    mutex_unlock(&out->write_lock);
+
+    return done > 0 ? (int)done : result;
+}
+
+// the pipe's pages written into the file, no user buffer in between
+static int splice_to_file(pipe_t* in, file_t* file, uint32_t len, bool nonblock) {
+    uint32_t done = 0;
+    int result = 0;
+
+    mutex_lock(&in->read_lock);
+
+    while (done < len) {
+        retire_slots(in);
+
+        pipe_slot_t* slot = in->tail != in->head ? SLOT(in, in->head) : NULL;
+        uint32_t end = slot ? slot->len : 0;
+
+        if (!slot || slot->offset == end) {
+            if (done > 0 || in->writers == 0) {
+                break;
+            }
+            if (nonblock) {
+                result = -1;
+                break;
+            }
+            if (pipe_wait(in, &in->read_wait, &in->read_sleepers, can_read, 0) != 0) {
+                result = -1;
+                break;
+            }
+            continue;
+        }
+
+        compiler_barrier();
+        uint32_t n = min_u32(end - slot->offset, len - done);
+        int written = file_write(file, (uint8_t*)phys_to_virt(slot->page) + slot->offset, n);
+        if (written <= 0) {
+            result = -1;
+            break;
+        }
+
+        compiler_barrier();
+        slot->offset += (uint32_t)written;
+        done += (uint32_t)written;
+        if ((uint32_t)written < n) {
+            break;
+        }
+    }
+
+    retire_slots(in);
+    in->spliced += done;
+    mutex_unlock(&in->read_lock);
+
+    if (done > 0) {
+        pipe_wake(&in->write_wait, &in->write_sleepers);
+    }
+    return done > 0 ? (int)done : result;
+}
+
+// the pipe behind a descriptor's read or write end, NULL if it is not one
+static pipe_t* pipe_end(file_t* file, bool read_end) {
+    if (!file || !file->node || file->node->type != FS_PIPE || !file->node->device) {
+        return NULL;
+    }
+
+    pipe_t* pipe = (pipe_t*)file->node->device;
+    return file->node == (read_end ? &pipe->read_end : &pipe->write_end) ? pipe : NULL;
+}
+
+int pipe_splice(int fd_in, int fd_out, uint32_t len, uint32_t flags) {
+    fdtable_t* table = fdtable_current();
+    file_t* in = fd_get(table, fd_in);
+    file_t* out = fd_get(table, fd_out);
+    bool nonblock = (flags & SPLICE_F_NONBLOCK) != 0;
+
+    if (!in || !out) {
+        terminal_writestring("ERROR: Invalid file descriptor\n");
+        return -1;
+    }
+
+    pipe_t* pin = pipe_end(in, true);
+    pipe_t* pout = pipe_end(out, false);
+
+    if (pin && pout) {
+        if (pin == pout) {
+            terminal_writestring("ERROR: Cannot splice a pipe into itself\n");
+            return -1;
+        }
+        return splice_pipes(pin, pout, len, nonblock, false);
+    }
+
+    if (pin && out->node && out->node->type == FS_FILE) {
+        if (!(out->node->mask & FS_PERM_WRITE)) {
+            terminal_writestring("ERROR: Write permission denied\n");
+            return -1;
+        }
+        return splice_to_file(pin, out, len, nonblock);
+    }
+
+    if (pout && in->node && in->node->type == FS_FILE) {
+        if (!(in->node->mask & FS_PERM_READ)) {
+            terminal_writestring("ERROR: Read permission denied\n");
+            return -1;
+        }
+        return splice_from_file(in, pout, len, nonblock);
+    }
+
+    terminal_writestring("ERROR: splice needs a pipe and a pipe or file\n");
+    return -1;
+}
+
+int pipe_tee(int fd_in, int fd_out, uint32_t len, uint32_t flags) {
+    fdtable_t* table = fdtable_current();
+    pipe_t* pin = pipe_end(fd_get(table, fd_in), true);
+    pipe_t* pout = pipe_end(fd_get(table, fd_out), false);
+
+    if (!pin || !pout || pin == pout) {
+        terminal_writestring("ERROR: tee needs two different pipes\n");
+        return -1;
+    }
+    return splice_pipes(pin, pout, len, (flags & SPLICE_F_NONBLOCK) != 0, true);
+}
+
+// every slot's frame goes back; pipe->lock held, no end open
+static void pipe_release_slots(pipe_t* pipe) {
+    for (uint32_t n = pipe->head; n != pipe->tail; n++) {
+        frame_unref(SLOT(pipe, n)->page);
+    }
+    pipe->head = 0;
+    pipe->tail = 0;
+}
+
+static void pipe_free(pipe_t* pipe) {
+    uint32_t flags = spin_lock_irqsave(&pipe_list_lock);
+    list_del(&pipe->node);
+    spin_unlock_irqrestore(&pipe_list_lock, flags);
+
+    kfree(pipe);
+}
+
+static void pipe_end_open(fs_node_t* node) {
+    pipe_t* pipe = (pipe_t*)node->device;
+    bool reader = node == &pipe->read_end;
+
+    uint32_t flags = spin_lock_irqsave(&pipe->lock);
+    if (reader) {
+        pipe->readers++;
+        pipe->reader_opens++;
+    } else {
+        pipe->writers++;
+        pipe->writer_opens++;
+    }
+    spin_unlock_irqrestore(&pipe->lock, flags);
+
+    // fifo opens waiting for this end
+    if (reader) {
+        pipe_wake(&pipe->write_wait, &pipe->write_sleepers);
+    } else {
+        pipe_wake(&pipe->read_wait, &pipe->read_sleepers);
+    }
+}
+
+static void pipe_end_close(fs_node_t* node) {
+    pipe_t* pipe = (pipe_t*)node->device;
+    bool reader = node == &pipe->read_end;
+
+    uint32_t flags = spin_lock_irqsave(&pipe->lock);
+    if (reader) {
+        pipe->readers--;
+    } else {
+        pipe->writers--;
+    }
+
+    bool last = pipe->readers == 0 && pipe->writers == 0;
+    if (last) {
+        pipe_release_slots(pipe);
+    }
+    spin_unlock_irqrestore(&pipe->lock, flags);
+
+    // end of file for readers, a broken pipe for writers
+    if (reader) {
+        wait_queue_wake_all(&pipe->write_wait);
+    } else {
+        wait_queue_wake_all(&pipe->read_wait);
+    }
+
+    // a named pipe stays with its node
+    if (last && !pipe->fifo) {
+        pipe_free(pipe);
+    }
+}
+
+// readers wait on read_wait and writers on write_wait, so each end
+// hooks the queue its own side sleeps on
+static uint32_t pipe_end_poll(fs_node_t* node, poll_table_t* table) {
+    pipe_t* pipe = (pipe_t*)node->device;
+    uint32_t mask = 0;
+
+    if (node == &pipe->read_end) {
+        poll_wait(table, &pipe->read_wait);
+        if (pipe->writers == 0) {
+            mask |= EPOLLHUP;
+        }
+        if (pipe_readable(pipe)) {
+            mask |= EPOLLIN;
+        }
+    } else {
+        poll_wait(table, &pipe->write_wait);
+        if (pipe->readers == 0) {
+            mask |= EPOLLERR;
+        } else if (pipe_writable(pipe)) {
+            mask |= EPOLLOUT;
+        }
+    }
+    return mask;
+}
+
+static void init_end(pipe_t* pipe, fs_node_t* end, const char* name, uint32_t mask) {
+    uint32_t i;
+
+    for (i = 0; name[i] && i < sizeof(end->name) - 1; i++) {
+        end->name[i] = name[i];
+    }
+    end->name[i] = '\0';
+
+    end->type = FS_PIPE;
+    end->mask = mask;
+    end->open = pipe_end_open;
+    end->close = pipe_end_close;
+    end->poll = pipe_end_poll;
+    end->device = pipe;
+}
+
+static pipe_t* pipe_alloc(fs_node_t* fifo) {
+    pipe_t* pipe = (pipe_t*)kmalloc(sizeof(pipe_t));
+    if (!pipe) {
+        terminal_writestring("ERROR: Not enough memory for a pipe\n");
+        return NULL;
+    }
+
+    memset(pipe, 0, sizeof(pipe_t));
+    mutex_init(&pipe->read_lock);
+    mutex_init(&pipe->write_lock);
+    wait_queue_init(&pipe->read_wait);
+    wait_queue_init(&pipe->write_wait);
+    spin_lock_init_class(&pipe->lock, &pipe_class);
+
+    const char* name = fifo ? fifo->name : "pipe";
+    init_end(pipe, &pipe->read_end, name, FS_PERM_READ);
+    init_end(pipe, &pipe->write_end, name, FS_PERM_WRITE);
+    pipe->fifo = fifo;
+
+    uint32_t flags = spin_lock_irqsave(&pipe_list_lock);
+    list_add_tail(&pipe_list, &pipe->node);
+    spin_unlock_irqrestore(&pipe_list_lock, flags);
+
+    return pipe;
+}
+
+int pipe_create(int fds[2]) {
+    fdtable_t* table = fdtable_current();
+
+    if (!fds || vm_check_user(fds, 2 * sizeof(int), true) != 0) {
+        return -1;
+    }
+
+    pipe_t* pipe = pipe_alloc(NULL);
+    if (!pipe) {
+        return -1;
+    }
+
+    file_t* rfile = file_alloc(&pipe->read_end, O_RDONLY);
+    file_t* wfile = file_alloc(&pipe->write_end, O_WRONLY);
+    if (!rfile || !wfile) {
+        kfree(rfile);
+        kfree(wfile);
+        pipe_free(pipe);
+        terminal_writestring("ERROR: Not enough memory to open a pipe\n");
+        return -1;
+    }
+
+    // from here on the last file_put frees the pipe
+    fs_open(&pipe->read_end);
+    fs_open(&pipe->write_end);
+
+    fds[0] = fd_alloc(table, rfile);
+    if (fds[0] < 0) {
+        file_put(rfile);
+        file_put(wfile);
+        return -1;
+    }
+
+    fds[1] = fd_alloc(table, wfile);
+    if (fds[1] < 0) {
+        fd_close(table, fds[0]);
+        file_put(wfile);
+        return -1;
+    }
+
+    return 0;
+}
+
+int pipe_mkfifo(const char* path) {
+    if (!path || vm_check_user_string(path, PIPE_PATH_MAX) != 0) {
+        terminal_writestring("ERROR: Bad path\n");
+        return -1;
+    }
+
+    if (fs_resolve_path(path)) {
+        terminal_writestring("ERROR: File exists: ");
+        terminal_writestring(path);
+        terminal_writestring("\n");
+        return -1;
+    }
+
+    fs_node_t* parent = fs_get_parent_dir(path);
+    if (!parent) {
+        terminal_writestring("ERROR: Parent directory not found: ");
+        terminal_writestring(path);
+        terminal_writestring("\n");
+        return -1;
+    }
+
+    const char* last_slash = strrchr(path, '/');
+    fs_node_t* node = fs_create_node((char*)(last_slash ? last_slash + 1 : path), FS_PIPE);
+    if (!node) {
+        return -1;
+    }
+
+    // opened through pipe_open, never as a node of its own
+    node->open = NULL;
+    node->close = NULL;
+    node->mask = FS_PERM_READ | FS_PERM_WRITE;
+
+    node->device = pipe_alloc(node);
+    if (!node->device) {
+        kfree(node);
+        return -1;
+    }
+
+    fs_add_node(parent, node);
+    return 0;
+}
+
+int pipe_open(fs_node_t* node, uint32_t flags) {
+    pipe_t* pipe = (pipe_t*)node->device;
+    uint32_t access = flags & O_RDWR;
+
+    if (!pipe || (access != O_RDONLY && access != O_WRONLY)) {
+        terminal_writestring("ERROR: A named pipe opens for reading or for writing\n");
+        return -1;
+    }
+
+    bool reader = access == O_RDONLY;
+    fs_node_t* end = reader ? &pipe->read_end : &pipe->write_end;
+
+    if (!reader && (flags & O_NONBLOCK) && pipe->readers == 0) {
+        terminal_writestring("ERROR: Named pipe has no reader\n");
+        return -1;
+    }
+
+    file_t* file = file_alloc(end, flags);
+    if (!file) {
+        terminal_writestring("ERROR: Not enough memory to open file\n");
+        return -1;
+    }
+
+    uint32_t seen = reader ? pipe->writer_opens : pipe->reader_opens;
+    fs_open(end);
+
+    // wait for the other end, so a reader does not see end of file at once
+    if (!(flags & O_NONBLOCK)) {
+        int waited;
+
+        if (reader) {
+            waited = pipe_wait(pipe, &pipe->read_wait, &pipe->read_sleepers, writer_opened, seen);
+        } else {
+            waited = pipe_wait(pipe, &pipe->write_wait, &pipe->write_sleepers, reader_opened, seen);
+        }
+        if (waited != 0) {
+            file_put(file);
+            return -1;
+        }
+    }
+
+    int fd = fd_alloc(fdtable_current(), file);
+    if (fd < 0) {
+        file_put(file);
+    }
+    return fd;
+}
+
+void pipe_dump(void) {
+    list_node_t* pos;
+    bool any = false;
+
+    terminal_writestring("Buffered  Readers  Writers  Written   Spliced   Name\n");
+
+    uint32_t flags = spin_lock_irqsave(&pipe_list_lock);
+
+    list_for_each(pos, &pipe_list) {
+        pipe_t* pipe = list_entry(pos, pipe_t, node);
+        uint32_t buffered = 0;
+
+        // racy against a running reader or writer, good enough to look at
+        for (uint32_t n = pipe->head; n != pipe->tail; n++) {
+            buffered += SLOT(pipe, n)->len - SLOT(pipe, n)->offset;
+        }
+        any = true;
+
+        terminal_print_uint(buffered);
+        terminal_writestring("         ");
+        terminal_print_uint(pipe->readers);
+        terminal_writestring("        ");
+        terminal_print_uint(pipe->writers);
+        terminal_writestring("        ");
+        terminal_print_uint(pipe->bytes);
+        terminal_writestring("         ");
+        terminal_print_uint(pipe->spliced);
+        terminal_writestring("         ");
+        terminal_writestring(pipe->fifo ? pipe->fifo->name : "(anonymous)");
+        terminal_writestring("\n");
+    }
+
+    spin_unlock_irqrestore(&pipe_list_lock, flags);
+
+    if (!any) {
+        terminal_writestring("No pipes\n");
+    }
+}
@@ -1,19 +1,351 @@
 #include <kernel/process.h>
 #include <kernel/types.h>
-#include <kernel/interrupt.h>
+#include <kernel/timer/pit.h>
+#include <kernel/syscall.h>
+#include <kernel/fdtable.h>
+#include <kernel/uring.h>
+#include <kernel/ipc.h>
+#include <kernel/irqflags.h>
+#include <kernel/sync/spinlock.h>
+#include <kernel/sync/rwlock.h>
+#include <kernel/sync/rcu.h>
+#include <kernel/sync/preempt.h>
+#include <kernel/softirq.h>
+#include <kernel/cpu/smp.h>
+#include <kernel/cpu/cpu.h>
+#include <kernel/math64.h>
+#include <kernel/timer/clocksource.h>
 #include <drivers/terminal.h>
 #include "../kernel/mm/memory.h"
+#include "../kernel/mm/kstack.h"
+#include "../kernel/mm/vm.h"
 
-static inline void cli(void) { /* Kesmeleri devre dışı bırak */ }
-static inline void sti(void) { /* Kesmeleri etkinleştir */ }
-static inline void save_context(process_t* proc) { /* İşlem bağlamını kaydet */ }
-static inline void load_context(process_t* proc) { /* İşlem bağlamını yükle */ }
 static inline void io_wait(void) { /* I/O beklemesi */ }
 static inline void port_out(uint8_t value, uint16_t port) { /* Port I/O işlemi */ }
 
-process_t* current_process = NULL;
-process_t* process_list = NULL;
-static uint32_t next_pid = 1;
+
+// Her işlemcinin hazır işlemleri kendi çalışma kuyruğundadır; zamanlama
+// kararı yalnızca o işlemcinin kuyruk kilidini alır. Kilit geçiş
+// boyunca tutulur ve geçilen taraf bırakır: yığını henüz kaydedilmemiş
+// bir işlem başka işlemciye taşınamaz. Boşta kalan işlemci meşgul bir
+// komşunun kuyruğundan işlem çalar, belirli aralıklarla da kuyruklar
+// dengelenir. task_list tüm işlemlerin listesidir (ps); PID ile arama
+// karma tablosundan yapılır. Üçü de tasklist_lock ile korunur.
+static lock_class_t tasklist_class = LOCK_CLASS_INIT("tasklist");
+static lock_class_t runqueue_class = LOCK_CLASS_INIT("runqueue");
+rwlock_t tasklist_lock = RWLOCK_INIT_CLASS(&tasklist_class);
+
+list_node_t task_list = LIST_HEAD_INIT(task_list);
+static list_node_t pid_hash[PID_HASH_SIZE];
+
+// Kullanılan PID'ler; arama son verilenden sonra başlar, böylece yeni
+// sonlanan bir işlemin kimliği hemen tekrar verilmez
+static uint32_t pid_map[PID_MAX / 32];
+static uint32_t last_pid = 0;
+
+#define CACHE_HOT_TICKS   2     // bu kadar tick önce çalışan işlem önbellekte sayılır
+#define BALANCE_TICKS     20    // periyodik dengeleme aralığı
+
+static uint32_t tick_count = 0;
+static uint32_t time_slice = 10;
+
+// Tam kip: kesme çıkışında çekirdek kodu da kesilir. Kapalıyken
+// yalnızca bloke olunca, yield'de ve cond_resched noktalarında geçilir.
+static volatile bool preempt_full = true;
+
+// Boşta işlemci MONITOR/MWAIT ile need_resched üzerinde bekler; yoksa hlt
+static bool have_mwait = false;
+
+// Yük ortalaması: çalışabilir işlem sayısının üstel ortalaması, Linux'taki
+// gibi 5 saniyede bir ve LOADAVG_SHIFT bitlik sabit noktalı hesaplanır
+#define LOAD_FREQ_MS   5000
+#define LOAD_FIXED_1   (1 << LOADAVG_SHIFT)
+#define LOAD_EXP_1     1884    // LOAD_FIXED_1 / e^(5s/1dk)
+#define LOAD_EXP_5     2014    // LOAD_FIXED_1 / e^(5s/5dk)
+#define LOAD_EXP_15    2037    // LOAD_FIXED_1 / e^(5s/15dk)
+
+static uint32_t load_avg[3];
+static uint32_t next_load_tick = 0;
+
+// process_switch.asm
+extern void switch_context(uint32_t* old_esp, uint32_t new_esp);
+
+static void process_free(process_t* process);
+static process_t* process_alloc(const char* name, void* entry_point, void* arg);
+static void idle_loop(void* arg) __attribute__((noreturn));
+
+// ========= çalışma kuyrukları =========
+
+void scheduler_init_cpu(cpu_t* cpu) {
+    spin_lock_init_class(&cpu->rq.lock, &runqueue_class);
+    list_init(&cpu->rq.queue);
+    cpu->rq.nr_running = 0;
+}
+
+// Kuyruk kilidi tutulurken çağrılır
+static void rq_enqueue(cpu_t* cpu, process_t* process) {
+    list_add_tail(&cpu->rq.queue, &process->run_node);
+    cpu->rq.nr_running++;
+    process->cpu = cpu->id;
+}
+
+// Sıranın başına, hemen çalışsın
+static void rq_enqueue_head(cpu_t* cpu, process_t* process) {
+    list_add(&cpu->rq.queue, &process->run_node);
+    cpu->rq.nr_running++;
+    process->cpu = cpu->id;
+}
+
+static void rq_dequeue(cpu_t* cpu, process_t* process) {
+    list_del(&process->run_node);
+    cpu->rq.nr_running--;
+}
+
+// İşlemin bağlı olduğu işlemcinin kuyruğunu kilitle. Bloke olan işlem
+// geçiş boyunca bu kilidi tuttuğundan, kilit alındığında işlem
+// tamamen CPU'dan ayrılmıştır. Kesmeler kapalı olmalı.
+static cpu_t* lock_process_rq(process_t* process) {
+    while (1) {
+        cpu_t* cpu = &cpus[process->cpu];
+        spin_lock(&cpu->rq.lock);
+        if (&cpus[process->cpu] == cpu) {
+            return cpu;
+        }
+        spin_unlock(&cpu->rq.lock);
+    }
+}
+
+static bool cache_hot(process_t* process) {
+    return tick_count - process->last_ran < CACHE_HOT_TICKS;
+}
+
+// En uzun kuyruğa sahip diğer işlemci (kilitsiz okunur, yalnızca ipucu)
+static cpu_t* find_busiest(cpu_t* self) {
+    cpu_t* busiest = NULL;
+    
+    for (uint32_t i = 0; i < cpu_count(); i++) {
+        cpu_t* cpu = &cpus[i];
+        
+        if (cpu == self || !cpu->online || cpu->rq.nr_running == 0) {
+            continue;
+        }
+        if (!busiest || cpu->rq.nr_running > busiest->rq.nr_running) {
+            busiest = cpu;
+        }
+    }
+    
+    return busiest;
+}
+
+// Kaynak kuyruktan taşınacak işlem: önbellekte soğuk olanlardan ilki;
+// allow_hot ise yoksa en son kuyruğa gireni (en geç çalışacak olan)
+static process_t* pick_migratable(cpu_t* src, bool allow_hot) {
+    list_node_t* node;
+    
+    for (node = src->rq.queue.next; node != &src->rq.queue; node = node->next) {
+        process_t* process = list_entry(node, process_t, run_node);
+        if (!cache_hot(process)) {
+            return process;
+        }
+    }
+    
+    if (allow_hot && !list_empty(&src->rq.queue)) {
+        return list_entry(src->rq.queue.prev, process_t, run_node);
+    }
+    return NULL;
+}
+
+// Kendi kuyruk kilidimiz tutulurken başka bir işlemciden bir işlem çek.
+// Karşı kilit trylock ile alınır, iki işlemci birbirini beklemez.
+static process_t* pull_task(cpu_t* cpu, uint32_t min_imbalance, bool allow_hot) {
+    cpu_t* busiest = find_busiest(cpu);
+    
+    if (!busiest || busiest->rq.nr_running < cpu->rq.nr_running + min_imbalance) {
+        return NULL;
+    }
+    if (!spin_trylock(&busiest->rq.lock)) {
+        return NULL;
+    }
+    
+    process_t* process = NULL;
+    if (busiest->rq.nr_running >= cpu->rq.nr_running + min_imbalance) {
+        process = pick_migratable(busiest, allow_hot);
+        if (process) {
+            rq_dequeue(busiest, process);
+            process->cpu = cpu->id;
+            process->migrations++;
+            cpu->migrations++;
+        }
+    }
+    
+    spin_unlock(&busiest->rq.lock);
+    return process;
+}
+
+// Uyanan işlem için işlemci seç
+static cpu_t* select_wake_cpu(process_t* process, cpu_t* local) {
+    cpu_t* prev = &cpus[process->cpu];
+    
+    // Önbelleği hâlâ sıcak olabilir: son çalıştığı işlemci boştaysa orada
+    if (prev->online && prev->current == prev->idle) {
+        return prev;
+    }
+    
+    // Uyandıran işlemci daha az meşgulse veriler zaten burada
+    if (!prev->online || local->rq.nr_running < prev->rq.nr_running) {
+        return local;
+    }
+    
+    return prev;
+}
+
+// Yeni işlem en kısa kuyruğa
+static cpu_t* select_new_cpu(void) {
+    cpu_t* best = this_cpu();
+    
+    for (uint32_t i = 0; i < cpu_count(); i++) {
+        cpu_t* cpu = &cpus[i];
+        
+        if (cpu->online && cpu->idle && cpu->rq.nr_running < best->rq.nr_running) {
+            best = cpu;
+        }
+    }
+    
+    return best;
+}
+
+// Kuyruğa yeni giren işlem için hedef işlemciyi dürt
+static void kick_cpu(cpu_t* cpu) {
+    if (cpu == this_cpu()) {
+        cpu->need_resched = 1;
+    } else if (cpu->current == cpu->idle) {
+        smp_send_reschedule(cpu);
+    }
+}
+
+// Çalışan işlem ne olursa olsun geçiş iste
+static void resched_cpu(cpu_t* cpu) {
+    if (cpu == this_cpu()) {
+        cpu->need_resched = 1;
+    } else {
+        smp_send_reschedule(cpu);
+    }
+}
+
+// Uyanan işlem çalışandan daha az CPU kullandıysa onu keser; sürekli
+// uyuyup uyanan bir çift de kullanımı geçince sırasını bekler.
+// Hedef kuyruğun kilidi tutulurken.
+static bool wakeup_preempt(cpu_t* cpu, process_t* process) {
+    process_t* curr = cpu->current;
+    
+    return preempt_full && curr != cpu->idle && process->runtime_ns < curr->runtime_ns;
+}
+
+// ========= bağlam geçişi =========
+
+// Geçişin yeni işlem tarafında, kuyruk kilidi tutulurken ve kesmeler kapalıyken çağrılır
+static void finish_switch(void) {
+    // İşlem başka işlemcide devam ediyor olabilir, this_cpu tekrar okunur
+    cpu_t* cpu = this_cpu();
+    process_t* dead = cpu->dead;
+    
+    cpu->dead = NULL;
+    spin_unlock(&cpu->rq.lock);
+    
+    // Kendi yığınında sonlanan işlem artık serbest bırakılabilir
+    if (dead) {
+        process_free(dead);
+    }
+}
+
+// Yeni bir işlemin ilk çalıştığı yer (switch_context buraya döner)
+static void process_start(void) {
+    finish_switch();
+    
+    process_t* self = current_process;
+    void (*entry)(void*) = (void (*)(void*))self->context.eip;
+    
+    irq_enable();
+    entry(self->start_arg);
+    process_exit();
+}
+
+// tasklist_lock yazma kilidi tutulurken; 0 döndürürse PID kalmamıştır
+static uint32_t pid_alloc(void) {
+    uint32_t start = (last_pid + 1) % PID_MAX;
+    uint32_t word = start / 32;
+    
+    // İlk kelimede başlangıçtan önceki bitleri dolu say
+    uint32_t bits = pid_map[word] | ((1u << (start % 32)) - 1);
+    
+    for (uint32_t i = 0; i <= PID_MAX / 32; i++) {
+        if (bits != 0xFFFFFFFF) {
+            uint32_t pid = word * 32 + ffz32(bits);
+            pid_map[word] |= 1u << (pid % 32);
+            last_pid = pid;
+            return pid;
+        }
+        word = (word + 1) % (PID_MAX / 32);
+        bits = pid_map[word];
+    }
+    
+    return 0;
+}
+
+static list_node_t* pid_bucket(uint32_t pid) {
+    return &pid_hash[pid & (PID_HASH_SIZE - 1)];
+}
+
+process_t* process_find(uint32_t pid) {
+    list_node_t* node;
+    
+    list_for_each(node, pid_bucket(pid)) {
+        process_t* process = list_entry(node, process_t, pid_node);
+        if (process->pid == pid) {
+            return process;
+        }
+    }
+    
+    return NULL;
+}
+
+// tasklist_lock yazma kilidi tutulurken
+static void process_link(process_t* process) {
+    list_add_tail(&task_list, &process->task_node);
+    list_add(pid_bucket(process->pid), &process->pid_node);
+}
+
+// tasklist_lock yazma kilidi tutulurken
+static void process_unlink(process_t* process) {
+    list_del(&process->task_node);
+    list_del(&process->pid_node);
+    
+    if (process->pid != 0) {
+        pid_map[process->pid / 32] &= ~(1u << (process->pid % 32));
+    }
+}
+
+static void process_free(process_t* process) {
+    if (process->kernel_stack) {
+        kstack_free(process->kernel_stack);
+    }
+    
+    // Kapanmamış halkaları bırak
+    uring_release_process(process);
+    
+    // Alınıp yanıtlanmamış IPC çağrısı bekleyeni hata ile uyandır
+    ipc_release_process(process);
+    
+    // Açık dosyaları kapat
+    fdtable_destroy(process->files);
+    process->files = NULL;
+    
+    // Kullanıcı sayfalarını geri ver
+    mm_destroy(process->mm);
+    process->mm = NULL;
+    
+    kfree(process);
+}
 
 void process_init(void) {
     terminal_writestring("Islem yonetimi baslatiliyor...\n");
@@ -31,30 +363,69 @@ void process_init(void) {
     }
     kernel_process->name[i] = '\0';
     
+    // Bağlam ilk geçişte switch_context tarafından kaydedilir
     kernel_process->context.eip = 0;
     kernel_process->context.esp = 0;
     kernel_process->context.ebp = 0;
+    kernel_process->start_arg = NULL;
+    
+    kernel_process->kernel_stack_size = KSTACK_SIZE;
+    kernel_process->kernel_stack = kstack_alloc();
     
-    kernel_process->kernel_stack_size = 4096;
-    kernel_process->kernel_stack = kmalloc(kernel_process->kernel_stack_size);
+    // Çekirdek, açılıştan beri kullanılan tabloyu devralır
+    kernel_process->files = fdtable_current();
+    kernel_process->mm = NULL;
+    kernel_process->syscalls = 0;
+    kernel_process->syscall_errors = 0;
+    kernel_process->syscall_cycles = 0;
+    kernel_process->cpu = 0;
+    list_init(&kernel_process->run_node);
+    kernel_process->last_ran = 0;
+    kernel_process->migrations = 0;
+    kernel_process->exec_start_ns = 0;
+    kernel_process->user_start_ns = 0;
+    kernel_process->runtime_ns = 0;
+    kernel_process->user_ns = 0;
+    kernel_process->in_user = 0;
+    kernel_process->nvcsw = 0;
+    kernel_process->nivcsw = 0;
+    kernel_process->page_faults = 0;
+    kernel_process->ipc_caller = NULL;
+    kernel_process->killed = 0;
     
-    kernel_process->next = NULL;
-    process_list = kernel_process;
+    for (i = 0; i < PID_HASH_SIZE; i++) {
+        list_init(&pid_hash[i]);
+    }
+    pid_map[0] = 1;     // PID 0 çekirdeğin
+    process_link(kernel_process);
     current_process = kernel_process;
     
+    // Hazır işlem olmadığında açılış işlemcisinde çalışır, listede değil
+    scheduler_init_cpu(this_cpu());
+    this_cpu()->idle = process_alloc("idle", idle_loop, NULL);
+    
     terminal_writestring("Islem yonetimi baslatildi.\n");
     
     scheduler_init();
 }   
 
-process_t* process_create(const char* name, void* entry_point) {
-    terminal_writestring("Yeni islem olusturuluyor: ");
-    terminal_writestring(name);
-    terminal_writestring("\n");
+// İşlemi hazırla ama listeye ekleme
+static process_t* process_alloc(const char* name, void* entry_point, void* arg) {
+    // Önceden eşlenmiş, altında koruma sayfası olan yığın; genelde
+    // işlemcinin önbelleğinden gelir, sayfa tablosuna dokunulmaz
+    void* stack = kstack_alloc();
+    if (!stack) {
+        return NULL;
+    }
     
     process_t* new_process = (process_t*)kmalloc(sizeof(process_t));
+    if (!new_process) {
+        terminal_writestring("ERROR: No memory for a new process\n");
+        kstack_free(stack);
+        return NULL;
+    }
     
-    new_process->pid = next_pid++;
+    new_process->pid = 0;
     new_process->state = PROCESS_READY;
     
     int i;
@@ -65,19 +436,127 @@ process_t* process_create(const char* name, void* entry_point) {
     
     new_process->context.eip = (uint32_t)entry_point;
     new_process->context.eflags = 0x202; // Kesmeler aktif
+    new_process->start_arg = arg;
+    
+    new_process->kernel_stack_size = KSTACK_SIZE;
+    new_process->kernel_stack = stack;
     
-    new_process->kernel_stack_size = 4096;
-    new_process->kernel_stack = kmalloc(new_process->kernel_stack_size);
+    // switch_context'in geri yükleyeceği ilk çerçeve: eflags, edi, esi,
+    // ebx, ebp ve dönüş adresi olarak process_start
+    uint32_t* sp = (uint32_t*)((uint32_t)new_process->kernel_stack + new_process->kernel_stack_size);
+    *--sp = 0;                          // process_start hiç dönmez
+    *--sp = (uint32_t)process_start;
+    *--sp = 0;                          // ebp
+    *--sp = 0;                          // ebx
+    *--sp = 0;                          // esi
+    *--sp = 0;                          // edi
+    *--sp = 0x002;                      // eflags, kesmeler finish_switch'ten sonra açılır
     
-    new_process->context.esp = (uint32_t)new_process->kernel_stack + new_process->kernel_stack_size;
-    new_process->context.ebp = new_process->context.esp;
+    new_process->context.esp = (uint32_t)sp;
+    new_process->context.ebp = 0;
     
-    new_process->next = process_list;
-    process_list = new_process;
+    new_process->files = fdtable_create();
+    if (!new_process->files) {
+        kstack_free(stack);
+        kfree(new_process);
+        return NULL;
+    }
+    new_process->mm = NULL;
+    new_process->syscalls = 0;
+    new_process->syscall_errors = 0;
+    new_process->syscall_cycles = 0;
+    new_process->cpu = 0;
+    list_init(&new_process->run_node);
+    new_process->last_ran = 0;
+    new_process->migrations = 0;
+    new_process->exec_start_ns = 0;
+    new_process->user_start_ns = 0;
+    new_process->runtime_ns = 0;
+    new_process->user_ns = 0;
+    new_process->in_user = 0;
+    new_process->nvcsw = 0;
+    new_process->nivcsw = 0;
+    new_process->page_faults = 0;
+    new_process->ipc_caller = NULL;
+    new_process->killed = 0;
+    list_init(&new_process->task_node);
+    list_init(&new_process->pid_node);
     
     return new_process;
 }
 
+process_t* process_create_arg(const char* name, void* entry_point, void* arg) {
+    terminal_writestring("Yeni islem olusturuluyor: ");
+    terminal_writestring(name);
+    terminal_writestring("\n");
+    
+    // Argüman kuyruğa girmeden önce yerinde olmalı, işlem hemen
+    // başka bir işlemcide başlayabilir
+    process_t* new_process = process_alloc(name, entry_point, arg);
+    if (!new_process) {
+        return NULL;
+    }
+    
+    uint32_t flags = write_lock_irqsave(&tasklist_lock);
+    new_process->pid = pid_alloc();
+    if (new_process->pid == 0) {
+        write_unlock_irqrestore(&tasklist_lock, flags);
+        terminal_writestring("ERROR: Out of process IDs\n");
+        process_free(new_process);
+        return NULL;
+    }
+    
+    // Listede görünen hazır işlem kuyrukta olmalı: process_kill onu
+    // kuyruktan çıkarır. Başka işlemcide hemen başlasa da çıkışı
+    // listeden silmek için bu kilidi bekler
+    cpu_t* cpu = select_new_cpu();
+    spin_lock(&cpu->rq.lock);
+    rq_enqueue(cpu, new_process);
+    spin_unlock(&cpu->rq.lock);
+    
+    process_link(new_process);
+    write_unlock(&tasklist_lock);
+    kick_cpu(cpu);
+    
+    irq_restore(flags);
+    
+    return new_process;
+}
+
+process_t* process_create(const char* name, void* entry_point) {
+    return process_create_arg(name, entry_point, NULL);
+}
+
+// Kesmeler kapalıyken: işlemi kuyruğundan çıkar ve sonlanmış işaretle.
+// Başka işlemcide çalışıyorsa ya da zaten sonlanıyorsa -1, bloke ise
+// yalnızca işaretleyip 1 döner.
+static int process_stop(process_t* process) {
+    cpu_t* cpu = lock_process_rq(process);
+    
+    // Başka işlemcide çalışırken yığını serbest bırakılamaz
+    if (process->state == PROCESS_RUNNING || process->state == PROCESS_TERMINATED) {
+        spin_unlock(&cpu->rq.lock);
+        return -1;
+    }
+    
+    // Bekleme kuyruğu, zamanlayıcı ya da IPC kaydı hâlâ yığınında;
+    // uyandığında bunları kendisi çözer ve syscall_dispatch'te çıkar.
+    // Uyanıp kuyruğa girmiş olsa da çözmeyi bitirmemiş olabilir.
+    if (process->state == PROCESS_BLOCKED || process->killed) {
+        process->killed = 1;
+        spin_unlock(&cpu->rq.lock);
+        return 1;
+    }
+    
+    if (process->state == PROCESS_READY) {
+        rq_dequeue(cpu, process);
+    }
+    process->state = PROCESS_TERMINATED;
+    spin_unlock(&cpu->rq.lock);
+    
+    return 0;
+}
+
 void process_terminate(process_t* process) {
     if (!process) return;
     
@@ -85,89 +564,600 @@ void process_terminate(process_t* process) {
     terminal_writestring(process->name);
     terminal_writestring("\n");
     
-    if (process == process_list) {
-        process_list = process->next;
-    } else {
-        process_t* temp = process_list;
-        while (temp && temp->next != process) {
-            temp = temp->next;
-        }
-        
-        if (temp) {
-            temp->next = process->next;
-        }
+    if (process == current_process) {
+        process_exit();
+    }
+    
+    uint32_t flags = irq_save();
+    
+    int result = process_stop(process);
+    if (result > 0) {
+        // Öldürülebilir beklemeler -1 ile döner, işlem çıkışa ilerler
+        process_wake(process);
+        irq_restore(flags);
+        terminal_writestring("Islem bloke, uyandiginda sonlanacak\n");
+        return;
+    }
+    if (result != 0) {
+        irq_restore(flags);
+        terminal_writestring("ERROR: Process is running on another CPU\n");
+        return;
+    }
+    
+    write_lock(&tasklist_lock);
+    process_unlink(process);
+    write_unlock(&tasklist_lock);
+    irq_restore(flags);
+    
+    process_free(process);
+}
+
+int process_kill(uint32_t pid) {
+    if (pid == 0) {
+        terminal_writestring("ERROR: Cannot kill the kernel process\n");
+        return -1;
+    }
+    
+    // Okuma kilidi tutulurken işlem process_exit ile listeden çıkamaz
+    uint32_t flags = read_lock_irqsave(&tasklist_lock);
+    process_t* process = process_find(pid);
+    
+    if (!process) {
+        read_unlock_irqrestore(&tasklist_lock, flags);
+        terminal_writestring("ERROR: No such process\n");
+        return -1;
     }
     
     if (process == current_process) {
-        current_process = process_list;
+        read_unlock_irqrestore(&tasklist_lock, flags);
+        process_exit();
     }
     
-    process->state = PROCESS_TERMINATED;
+    int result = process_stop(process);
     
-    if (process->kernel_stack) {
-        kfree(process->kernel_stack);
+    // Okuma kilidi tutulurken çıkıp serbest bırakılamaz
+    if (result > 0) {
+        process_wake(process);
     }
+    read_unlock(&tasklist_lock);
     
-    kfree(process);
+    if (result > 0) {
+        irq_restore(flags);
+        terminal_writestring("Islem bloke, uyandiginda sonlanacak\n");
+        return 0;
+    }
+    if (result != 0) {
+        irq_restore(flags);
+        terminal_writestring("ERROR: Process is running on another CPU\n");
+        return -1;
+    }
+    
+    // Sonlanmış işaretli, başka bir kill ya da zamanlayıcı dokunmaz
+    write_lock(&tasklist_lock);
+    process_unlink(process);
+    write_unlock(&tasklist_lock);
+    irq_restore(flags);
+    
+    process_free(process);
+    return 0;
+}
+
+// Giden işlemin dilimini kapat, geleninkini aç; kuyruk kilidi tutulurken
+static void account_switch(process_t* prev, process_t* next) {
+    uint64_t now = clock_monotonic_ns();
+    
+    prev->runtime_ns += now - prev->exec_start_ns;
+    if (prev->in_user) {
+        prev->user_ns += now - prev->user_start_ns;
+    }
+    
+    // Kuyruğa geri dönen işlem kesilmiştir, diğerleri kendisi bıraktı
+    if (prev->state == PROCESS_READY || prev->state == PROCESS_RUNNING) {
+        prev->nivcsw++;
+    } else {
+        prev->nvcsw++;
+    }
+    
+    next->exec_start_ns = now;
+    if (next->in_user) {
+        next->user_start_ns = now;
+    }
+}
+
+// Kuyruk kilidi tutulurken ve kesmeler kapalıyken çağrılır, kilidi bırakır
+static void context_switch(cpu_t* cpu, process_t* prev, process_t* next) {
+    prev->last_ran = tick_count;
+    account_switch(prev, next);
+    
+    cpu->current = next;
+    next->state = PROCESS_RUNNING;
+    next->cpu = cpu->id;
+    cpu->switches++;
+    rcu_note_context_switch(cpu);
+    
+    // Ring 3'ten gelen kesmeler ve sysenter bu işlemin çekirdek yığınını kullanır
+    if (next->kernel_stack) {
+        syscall_set_kernel_stack((uint32_t)next->kernel_stack + next->kernel_stack_size);
+    }
+    
+    // Kullanıcı programının sayfa dizinine geç; çekirdek işlemleri yüklü olanı kullanır
+    vm_switch(next->mm);
+    
+    switch_context(&prev->context.esp, next->context.esp);
+    
+    // Buraya tekrar seçildiğimizde, belki başka bir işlemcide dönülür
+    finish_switch();
+}
+
+// Kuyruk kilidi tutulurken ve kesmeler kapalıyken çağrılır, kilidi bırakır
+static void schedule_locked(void) {
+    cpu_t* cpu = this_cpu();
+    process_t* prev = cpu->current;
+    process_t* next = NULL;
+    
+    // Çalışmaya devam edebilen işlem kuyruğun sonuna
+    if (prev->state == PROCESS_RUNNING && prev != cpu->idle) {
+        prev->state = PROCESS_READY;
+        rq_enqueue(cpu, prev);
+    }
+    
+    if (!list_empty(&cpu->rq.queue)) {
+        next = list_entry(cpu->rq.queue.next, process_t, run_node);
+        rq_dequeue(cpu, next);
+    } else {
+        // Boşta kalmak yerine meşgul bir işlemciden çal
+        next = pull_task(cpu, 1, true);
+        if (next) {
+            cpu->steals++;
+        }
+    }
+    
+    if (!next) {
+        // Boşta işlemi yokken bloke olan işlem çalışmaya devam eder
+        next = cpu->idle ? cpu->idle : prev;
+    }
+    
+    if (next == prev) {
+        if (prev->state == PROCESS_READY) {
+            prev->state = PROCESS_RUNNING;
+        }
+        spin_unlock(&cpu->rq.lock);
+        return;
+    }
+    
+    // Bloke olan işlem uyandırılana kadar bloke kalır
+    context_switch(cpu, prev, next);
+}
+
+void process_exit(void) {
+    irq_disable();
+    
+    cpu_t* cpu = this_cpu();
+    process_t* self = cpu->current;
+    
+    write_lock(&tasklist_lock);
+    process_unlink(self);
+    write_unlock(&tasklist_lock);
+    
+    spin_lock(&cpu->rq.lock);
+    self->state = PROCESS_TERMINATED;
+    
+    // Yığın hâlâ kullanımda, bu işlemcide sonraki işlem serbest bırakır
+    cpu->dead = self;
+    
+    // Boşta işlemi her zaman çalışabilir, buraya geri dönülmez
+    schedule_locked();
+    
+    // Boşta işlemi yokken çalışabilecek işlem yoksa biri uyanana kadar bekle
+    while (1) {
+        irq_enable_and_halt();
+        irq_disable();
+        spin_lock(&this_cpu()->rq.lock);
+        schedule_locked();
+    }
 }
 
 void process_switch(process_t* next) {
     if (!next || next == current_process) return;
     
-    cli();
+    uint32_t flags = irq_save();
+    cpu_t* cpu = this_cpu();
+    spin_lock(&cpu->rq.lock);
     
-    save_context(current_process);
+    // Yalnızca bu işlemcinin kuyruğundaki hazır işleme doğrudan geçilir
+    if (next->state != PROCESS_READY || next->cpu != cpu->id) {
+        spin_unlock(&cpu->rq.lock);
+        irq_restore(flags);
+        return;
+    }
     
-    current_process->state = PROCESS_READY;
+    process_t* prev = cpu->current;
+    rq_dequeue(cpu, next);
+    if (prev->state == PROCESS_RUNNING && prev != cpu->idle) {
+        prev->state = PROCESS_READY;
+        rq_enqueue(cpu, prev);
+    }
     
-    current_process = next;
-    current_process->state = PROCESS_RUNNING;
+    context_switch(cpu, prev, next);
+    irq_restore(flags);
+}
+
+bool process_handoff(process_t* next, volatile int* done) {
+    uint32_t flags = irq_save();
+    cpu_t* cpu = this_cpu();
+    spin_lock(&cpu->rq.lock);
+    
+    process_t* prev = cpu->current;
+    
+    // Bu işlemcide bloke ve geçilmiş bir işlemin yığını kaydedilmiştir;
+    // onu değiştiren herkes bu kuyruğun kilidini almak zorundadır.
+    // *done process_wait_event'teki gibi kilit altında bakılır: onu
+    // ayarlayan, biz hâlâ çalışırken process_wake çağırmış olabilir.
+    if (!next || next == prev || prev == cpu->idle || *done ||
+        next->state != PROCESS_BLOCKED || next->cpu != cpu->id) {
+        spin_unlock(&cpu->rq.lock);
+        irq_restore(flags);
+        return false;
+    }
     
-    load_context(current_process);
+    prev->state = PROCESS_BLOCKED;
+    cpu->handoffs++;
+    context_switch(cpu, prev, next);
     
-    sti();
+    irq_restore(flags);
+    return true;
 }
 
 void process_schedule(void) {
-    if (!process_list) return;
+    if (list_empty(&task_list) || !current_process) return;
     
-    process_t* next = current_process->next;
+    uint32_t flags = irq_save();
+    spin_lock(&this_cpu()->rq.lock);
+    schedule_locked();
+    irq_restore(flags);
+}
+
+// Daha meşgul bir işlemciden önbellekte soğuk bir işlemi bu kuyruğa al
+static void rebalance(cpu_t* cpu) {
+    uint32_t flags = spin_lock_irqsave(&cpu->rq.lock);
+    process_t* process = pull_task(cpu, 2, false);
     
-    if (!next) {
-        next = process_list;
+    if (process) {
+        process->state = PROCESS_READY;
+        rq_enqueue(cpu, process);
+        if (cpu->current == cpu->idle) {
+            cpu->need_resched = 1;
+        }
     }
     
-    while (next != current_process) {
-        if (next->state == PROCESS_READY) {
-            break;
+    spin_unlock_irqrestore(&cpu->rq.lock, flags);
+}
+
+void process_preempt(void) {
+    cpu_t* cpu = this_cpu();
+    
+    // Kilit ya da okuma bölümü tutan kod kesildi: geçiş, sayaç sıfıra
+    // inince preempt_enable içinde yapılır. İç içe kesmede dıştaki bekler.
+    if (cpu->preempt_count || in_interrupt()) {
+        if (cpu->need_resched) {
+            cpu->preempt_deferred++;
         }
-        
-        next = next->next;
-        if (!next) {
-            next = process_list;
+        return;
+    }
+    
+    if (cpu->need_balance) {
+        cpu->need_balance = 0;
+        rebalance(cpu);
+    }
+    
+    // Tam kipte değilse çekirdek kodu yalnızca kendi bıraktığında geçilir
+    if (cpu->need_resched && (preempt_full || cpu->current == cpu->idle)) {
+        cpu->need_resched = 0;
+        if (cpu->current != cpu->idle) {
+            cpu->preemptions++;
         }
+        process_schedule();
     }
+}
+
+void preempt_schedule(void) {
+    cpu_t* cpu = this_cpu();
     
-    if (next != current_process && next->state == PROCESS_READY) {
-        process_switch(next);
+    // Kesmeleri kapatan kod geçişi kendi irq_restore'undan sonra bekler
+    if (cpu->preempt_count || !irqs_enabled() || in_interrupt()) {
+        return;
     }
+    
+    cpu->need_resched = 0;
+    cpu->preemptions++;
+    process_schedule();
+}
+
+void preempt_set_full(bool full) {
+    preempt_full = full;
+}
+
+bool preempt_is_full(void) {
+    return preempt_full;
 }
 
 process_t* process_get_current(void) {
     return current_process;
 }
 
+void process_cputime(process_t* process, uint64_t* runtime_ns, uint64_t* user_ns) {
+    uint32_t flags = irq_save();
+    cpu_t* cpu = lock_process_rq(process);
+    uint64_t runtime = process->runtime_ns;
+    uint64_t user = process->user_ns;
+    
+    // Çalışan işlemin açık dilimi henüz eklenmedi
+    if (process->state == PROCESS_RUNNING) {
+        uint64_t now = clock_monotonic_ns();
+        runtime += now - process->exec_start_ns;
+        if (process->in_user) {
+            user += now - process->user_start_ns;
+        }
+    }
+    
+    spin_unlock(&cpu->rq.lock);
+    irq_restore(flags);
+    
+    *runtime_ns = runtime;
+    *user_ns = user;
+}
+
+void process_account_user_enter(void) {
+    uint32_t flags = irq_save();
+    process_t* self = current_process;
+    
+    self->user_start_ns = clock_monotonic_ns();
+    self->in_user = 1;
+    
+    irq_restore(flags);
+}
+
+void process_account_user_exit(void) {
+    uint32_t flags = irq_save();
+    process_t* self = current_process;
+    
+    if (self->in_user) {
+        self->user_ns += clock_monotonic_ns() - self->user_start_ns;
+        self->in_user = 0;
+    }
+    
+    irq_restore(flags);
+}
+
+void process_block(process_t* process) {
+    if (!process) return;
+    
+    // Çalışan işlem bloke olduysa CPU'yu başka bir işleme ver
+    if (process == current_process) {
+        int never = 0;
+        process_wait_event(&never);
+        return;
+    }
+    
+    uint32_t flags = irq_save();
+    cpu_t* cpu = lock_process_rq(process);
+    if (process->state == PROCESS_READY) {
+        rq_dequeue(cpu, process);
+        process->state = PROCESS_BLOCKED;
+    }
+    spin_unlock(&cpu->rq.lock);
+    irq_restore(flags);
+}
+
+void process_wait_event(volatile int* done) {
+    uint32_t flags = irq_save();
+    spin_lock(&this_cpu()->rq.lock);
+    
+    if (*done) {
+        spin_unlock(&this_cpu()->rq.lock);
+        irq_restore(flags);
+        return;
+    }
+    
+    current_process->state = PROCESS_BLOCKED;
+    schedule_locked();
+    
+    irq_restore(flags);
+}
+
+int process_wait_event_killable(volatile int* done) {
+    uint32_t flags = irq_save();
+    spin_lock(&this_cpu()->rq.lock);
+    process_t* self = current_process;
+    
+    // killed de aynı kilit altında ayarlanır: ya burada görülür ya da
+    // process_stop bizi bloke bulup uyandırır
+    if (!*done && !self->killed) {
+        self->state = PROCESS_BLOCKED;
+        schedule_locked();
+    } else {
+        spin_unlock(&this_cpu()->rq.lock);
+    }
+    
+    irq_restore(flags);
+    return (!*done && self->killed) ? -1 : 0;
+}
+
+// İki kuyruğu işlemci numarası sırasıyla kilitle, iki uyandıran
+// birbirini beklemez. pull_task karşı kilidi yalnızca trylock ile alır.
+static void lock_rq_pair(cpu_t* a, cpu_t* b) {
+    if (a == b) {
+        spin_lock(&a->rq.lock);
+    } else if (a->id < b->id) {
+        spin_lock(&a->rq.lock);
+        spin_lock(&b->rq.lock);
+    } else {
+        spin_lock(&b->rq.lock);
+        spin_lock(&a->rq.lock);
+    }
+}
+
+static void unlock_rq_pair(cpu_t* a, cpu_t* b) {
+    if (a != b) {
+        spin_unlock(&b->rq.lock);
+    }
+    spin_unlock(&a->rq.lock);
+}
+
+void process_wake(process_t* process) {
+    if (!process) return;
+    
+    uint32_t flags = irq_save();
+    cpu_t* local = this_cpu();
+    cpu_t* src;
+    cpu_t* target;
+    
+    // Kaynak ve hedef kuyruk birlikte tutulur; işlem READY olduğu an
+    // bir kuyruktadır, process_stop ya da pull_task onu arada göremez
+    while (1) {
+        src = &cpus[process->cpu];
+        target = select_wake_cpu(process, local);
+        lock_rq_pair(src, target);
+        if (&cpus[process->cpu] == src) {
+            break;
+        }
+        unlock_rq_pair(src, target);
+    }
+    
+    if (process->state != PROCESS_BLOCKED) {
+        unlock_rq_pair(src, target);
+        irq_restore(flags);
+        return;
+    }
+    
+    if (process == src->current) {
+        // Boşta işlemi yokken bloke olup çalışmaya devam etmiş
+        process->state = PROCESS_RUNNING;
+        unlock_rq_pair(src, target);
+        irq_restore(flags);
+        return;
+    }
+    
+    process->state = PROCESS_READY;
+    if (target != src) {
+        process->migrations++;
+        target->migrations++;
+    }
+    if (target == local) {
+        local->wake_local++;
+    }
+    
+    bool preempt = wakeup_preempt(target, process);
+    if (preempt) {
+        rq_enqueue_head(target, process);
+    } else {
+        rq_enqueue(target, process);
+    }
+    unlock_rq_pair(src, target);
+    
+    // Uyanan işlem kesme çıkışında hemen çalışabilsin
+    if (preempt) {
+        resched_cpu(target);
+    } else {
+        kick_cpu(target);
+    }
+    
+    irq_restore(flags);
+    cond_resched();
+}
+
+// Boşta işlemi: çalışacak bir şey çıkana kadar işlemciyi durdur
+// Kesmeler kapalıyken çağrılır, açık döner
+static void cpu_idle(cpu_t* cpu) {
+    uint64_t start = clock_monotonic_ns();
+    
+    if (have_mwait) {
+        // Önce bayrak, sonra need_resched okuması: smp_send_reschedule
+        // ya bayrağı görüp IPI göndermez ya da biz yazısını görürüz
+        cpu->idle_polling = 1;
+        smp_mb();
+        cpu_monitor(&cpu->need_resched);
+        
+        if (!cpu->need_resched) {
+            irq_enable_and_mwait();
+        } else {
+            irq_enable();
+        }
+    } else {
+        irq_enable_and_halt();
+    }
+    
+    // Uyandıran kesme burada işlendi
+    irq_disable();
+    cpu->idle_polling = 0;
+    cpu->idle_ns += clock_monotonic_ns() - start;
+    cpu->idle_wakeups++;
+    irq_enable();
+}
+
+static void idle_loop(void* arg) {
+    (void)arg;
+    cpu_t* cpu = this_cpu();
+    
+    while (1) {
+        process_schedule();
+        
+        // need_resched kontrolü ile hlt arasında uyandırma kaçmasın
+        irq_disable();
+        if (!cpu->need_resched) {
+            cpu_idle(cpu);
+        } else {
+            cpu->need_resched = 0;
+            irq_enable();
+        }
+    }
+}
+
+void process_idle_enter(cpu_t* cpu) {
+    process_t* idle = (process_t*)kmalloc(sizeof(process_t));
+    
+    // Boşta işlemi olmayan işlemci hiçbir şey çalıştıramaz; işlem
+    // yerleştirilmesin diye çevrimdışı sayılır ve durdurulur
+    if (!idle) {
+        terminal_writestring("ERROR: No memory for the idle process, CPU halted\n");
+        cpu->online = 0;
+        for (;;) {
+            __asm__ volatile("cli; hlt");
+        }
+    }
+    
+    memset(idle, 0, sizeof(process_t));
+    
+    const char* name = "idle";
+    for (int i = 0; name[i] != '\0'; i++) {
+        idle->name[i] = name[i];
+    }
+    
+    idle->pid = 0;
+    idle->state = PROCESS_RUNNING;
+    idle->kernel_stack = cpu->boot_stack;
+    idle->kernel_stack_size = PROCESS_KERNEL_STACK_SIZE;
+    idle->cpu = cpu->id;
+    list_init(&idle->run_node);
+    idle->exec_start_ns = clock_monotonic_ns();
+    
+    cpu->idle = idle;
+    cpu->current = idle;
+    
+    idle_loop(NULL);
+}
+
 void scheduler_init(void) {
     terminal_writestring("Zamanlayici baslatiliyor...\n");
     
-    register_interrupt_handler(32, (isr_t)scheduler_tick);
+    have_mwait = (cpuid_ecx(1) & CPUID_ECX_MONITOR) != 0;
+    
+    // IRQ0 PIT sürücüsüne ait, zamanlayıcı onun tick çağrılarına bağlanır
+    register_timer_callback(scheduler_tick);
     
     terminal_writestring("Zamanlayici baslatildi.\n");
 }
 
-static uint32_t tick_count = 0;
-static uint32_t time_slice = 10;
-
 uint32_t get_tick_count(void) {
     return tick_count;
 }
@@ -179,14 +1169,115 @@ void ack_irq(int irq_no) {
     port_out(0x20, 0x20);
 }
 
-void scheduler_tick(void) {
-    ack_irq(0); // IRQ0 - timer 
+static uint32_t calc_load(uint32_t load, uint32_t exp, uint32_t active) {
+    uint64_t next = (uint64_t)load * exp + (uint64_t)active * (LOAD_FIXED_1 - exp);
+    return (uint32_t)((next + (LOAD_FIXED_1 / 2)) >> LOADAVG_SHIFT);
+}
+
+// Kuyruktakiler ve boşta olmayan çalışan işlemler; kilitsiz okunur
+static void update_load_avg(void) {
+    uint32_t active = 0;
     
-    tick_count++;
+    for (uint32_t i = 0; i < cpu_count(); i++) {
+        cpu_t* cpu = &cpus[i];
+        
+        if (!cpu->online) {
+            continue;
+        }
+        active += cpu->rq.nr_running;
+        if (cpu->current != cpu->idle) {
+            active++;
+        }
+    }
+    
+    active *= LOAD_FIXED_1;
+    load_avg[0] = calc_load(load_avg[0], LOAD_EXP_1, active);
+    load_avg[1] = calc_load(load_avg[1], LOAD_EXP_5, active);
+    load_avg[2] = calc_load(load_avg[2], LOAD_EXP_15, active);
+}
+
+void scheduler_loadavg(uint32_t loads[3]) {
+    for (int i = 0; i < 3; i++) {
+        loads[i] = load_avg[i];
+    }
+}
+
+// Açılış işlemcisinde PIT, diğerlerinde yerel APIC zamanlayıcısından çağrılır
+void scheduler_tick(void) {
+    cpu_t* cpu = this_cpu();
     
-    if (tick_count % time_slice == 0) {
-        if (process_list && process_list->next) {
-            process_schedule();
+    if (cpu->id == 0) {
+        tick_count++;
+        
+        if ((int32_t)(tick_count - next_load_tick) >= 0) {
+            next_load_tick = tick_count + ms_to_ticks(LOAD_FREQ_MS);
+            update_load_avg();
         }
     }
+    cpu->sched_ticks++;
+    
+    if (cpu->current == cpu->idle) {
+        cpu->idle_ticks++;
+    } else {
+        cpu->busy_ticks++;
+    }
+    
+    rcu_check_tick(cpu);
+    
+    // Geçiş kesme çıkışında, EOI gönderildikten sonra yapılır
+    if (cpu->sched_ticks % time_slice == 0 && cpu->rq.nr_running > 0) {
+        cpu->need_resched = 1;
+    }
+    
+    if (cpu->sched_ticks % BALANCE_TICKS == 0 && cpu_count() > 1) {
+        cpu->need_balance = 1;
+    }
+}
+
+void scheduler_stats_dump(void) {
+    uint64_t uptime_ns = clock_monotonic_ns();
+    uint32_t uptime_us = (uint32_t)div_u64_u32(uptime_ns, NSEC_PER_USEC, NULL);
+    
+    terminal_writestring("CPU  QUEUED  BUSY%  SWITCHES  MIGR-IN  STEALS  WAKE-LOCAL  IDLE%  WAKEUPS\n");
+    
+    for (uint32_t i = 0; i < cpu_count(); i++) {
+        cpu_t* cpu = &cpus[i];
+        uint32_t ticks = cpu->busy_ticks + cpu->idle_ticks;
+        // ns / us: açılıştan beri durdurulmuş geçen pay, binde
+        uint64_t idle = uptime_us ? div_u64_u32(cpu->idle_ns, uptime_us, NULL) : 0;
+        
+        terminal_print_int(i);
+        terminal_writestring("    ");
+        terminal_print_int(cpu->rq.nr_running);
+        terminal_writestring("       ");
+        terminal_print_int(ticks ? cpu->busy_ticks * 100 / ticks : 0);
+        terminal_writestring("      ");
+        terminal_print_int(cpu->switches);
+        terminal_writestring("  ");
+        terminal_print_int(cpu->migrations);
+        terminal_writestring("  ");
+        terminal_print_int(cpu->steals);
+        terminal_writestring("  ");
+        terminal_print_int(cpu->wake_local);
+        terminal_writestring("  ");
+        terminal_print_int((uint32_t)idle / 10);
+        terminal_writestring("  ");
+        terminal_print_int(cpu->idle_wakeups);
+        terminal_writestring("\n");
+    }
+    
+    terminal_writestring(have_mwait ? "Idle: MWAIT" : "Idle: HLT");
+    terminal_writestring(preempt_full ? ", kernel preemption on\n" : ", kernel preemption off\n");
+    
+    for (uint32_t i = 0; i < cpu_count(); i++) {
+        terminal_writestring("CPU ");
+        terminal_print_int(i);
+        terminal_writestring(": ");
+        terminal_print_int(cpus[i].preemptions);
+        terminal_writestring(" preemptions, ");
+        terminal_print_int(cpus[i].preempt_deferred);
+        terminal_writestring(" deferred by a held lock, ");
+        terminal_print_int(cpus[i].handoffs);
+        terminal_writestring(" direct handoffs\n");
+    }
 }
@@ -0,0 +1,34 @@
+; Kernel stack switch
+;
+; void switch_context(uint32_t* old_esp, uint32_t new_esp)
+;
+; Saves the callee-saved registers and eflags on the current stack,
+; stores the stack pointer in *old_esp and resumes the stack at
+; new_esp, which must have been saved by switch_context or built by
+; process_create in the same layout.
+
+[bits 32]
+
+global switch_context
+
+section .text
+
+switch_context:
+    mov eax, [esp + 4]      ; old_esp
+    mov edx, [esp + 8]      ; new_esp
+
+    push ebp
+    push ebx
+    push esi
+    push edi
+    pushfd
+
+    mov [eax], esp
+    mov esp, edx
+
+    popfd
+    pop edi
+    pop esi
+    pop ebx
+    pop ebp
+    ret
@@ -0,0 +1,359 @@
+#include <kernel/shm.h>
+#include <kernel/process.h>
+#include <kernel/cpu/percpu.h>
+#include <kernel/cpu/smp.h>
+#include <kernel/sync/spinlock.h>
+#include <drivers/terminal.h>
+#include "mm/memory.h"
+#include "mm/vm.h"
+
+static lock_class_t shm_class = LOCK_CLASS_INIT("shm");
+static spinlock_t shm_lock = SPINLOCK_INIT_CLASS(&shm_class);
+
+static shm_object_t objects[SHM_MAX_OBJECTS];
+
+_Static_assert(SHM_KERNEL_BASE + SHM_MAX_OBJECTS * SHM_KERNEL_WINDOW <= SHM_KERNEL_END,
+               "shm kernel windows overlap the kernel stacks");
+
+static inline uint32_t atomic_inc(volatile uint32_t* value) {
+    uint32_t old = 1;
+    __asm__ volatile("lock xaddl %0, %1" : "+r"(old), "+m"(*value) : : "memory");
+    return old + 1;
+}
+
+static inline void atomic_dec(volatile uint32_t* value) {
+    __asm__ volatile("lock decl %0" : "+m"(*value) : : "memory");
+}
+
+static bool name_equal(const char* a, const char* b) {
+    while (*a && *a == *b) {
+        a++;
+        b++;
+    }
+    return *a == *b;
+}
+
+static int object_id(shm_object_t* obj) {
+    return (int)(obj->gen * SHM_MAX_OBJECTS + (uint32_t)(obj - objects));
+}
+
+// the live object behind id, NULL once it is removed or the slot reused
+static shm_object_t* object_get(int id) {
+    if (id < 0) {
+        return NULL;
+    }
+
+    shm_object_t* obj = &objects[(uint32_t)id % SHM_MAX_OBJECTS];
+    if (!obj->used || obj->removed || obj->gen != (uint32_t)id / SHM_MAX_OBJECTS) {
+        return NULL;
+    }
+    return obj;
+}
+
+// take the kernel view down on this CPU; shm_lock held
+static void unmap_object(shm_object_t* obj) {
+    page_directory_t* dir = get_kernel_directory();
+
+    for (uint32_t i = 0; i < obj->pages; i++) {
+        uint32_t addr = (uint32_t)obj->kaddr + i * PAGE_SIZE;
+        uint32_t* pte = (uint32_t*)get_page(addr, 0, dir);
+
+        if (pte) {
+            *pte = 0;
+            __asm__ volatile("invlpg (%0)" : : "r"(addr) : "memory");
+        }
+    }
+}
+
+// drop the object's frames and free the slot, with the view unmapped
+// everywhere; shm_lock held
+static void free_object(shm_object_t* obj) {
+    for (uint32_t i = 0; i < obj->pages; i++) {
+        frame_unref(obj->frames[i]);
+    }
+
+    obj->pages = 0;
+    obj->used = false;
+    obj->gen++;
+}
+
+// shm_lock held
+static shm_object_t* create_object(const char* name, uint32_t size) {
+    shm_object_t* obj = NULL;
+    uint32_t pages = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+
+    if (pages == 0 || pages > SHM_MAX_PAGES) {
+        terminal_writestring("ERROR: Bad shared memory size\n");
+        return NULL;
+    }
+
+    // a slot whose last waiter has not left yet still has its queue in use
+    for (uint32_t i = 0; i < SHM_MAX_OBJECTS; i++) {
+        if (!objects[i].used && objects[i].sleepers == 0) {
+            obj = &objects[i];
+            break;
+        }
+    }
+    if (!obj) {
+        terminal_writestring("ERROR: Too many shared memory objects\n");
+        return NULL;
+    }
+
+    uint32_t kaddr = SHM_KERNEL_BASE + (uint32_t)(obj - objects) * SHM_KERNEL_WINDOW;
+
+    uint32_t i;
+    for (i = 0; name[i] && i < SHM_NAME_MAX - 1; i++) {
+        obj->name[i] = name[i];
+    }
+    obj->name[i] = '\0';
+
+    obj->used = true;
+    obj->removed = false;
+    obj->size = pages * PAGE_SIZE;
+    obj->pages = 0;
+    obj->kaddr = (void*)kaddr;
+    obj->seq = 0;
+    obj->notifies = 0;
+    obj->wakeups = 0;
+    wait_queue_init(&obj->wq);
+
+    page_directory_t* dir = get_kernel_directory();
+
+    for (i = 0; i < pages; i++) {
+        phys_addr_t phys;
+        void* page = page_alloc(&phys);
+
+        // the id was never handed out, no other CPU has touched the view
+        if (!page) {
+            unmap_object(obj);
+            free_object(obj);
+            return NULL;
+        }
+
+        // the object's own reference, dropped by shm_remove
+        memset(page, 0, PAGE_SIZE);
+        frame_ref(phys);
+        obj->frames[i] = phys;
+        obj->pages++;
+
+        if (map_page_dir(dir, kaddr + i * PAGE_SIZE, phys, MEMORY_PRESENT | MEMORY_READWRITE) != 0) {
+            unmap_object(obj);
+            free_object(obj);
+            return NULL;
+        }
+    }
+
+    return obj;
+}
+
+int shm_get(const char* uname, uint32_t size, uint32_t flags) {
+    shm_object_t* obj = NULL;
+    char name[SHM_NAME_MAX];
+    int id = -1;
+
+    // copied before the lock, a user page may still have to fault in
+    if (!uname || vm_check_user_string(uname, SHM_NAME_MAX) != 0) {
+        terminal_writestring("ERROR: Bad shared memory name\n");
+        return -1;
+    }
+    for (uint32_t i = 0; i < SHM_NAME_MAX; i++) {
+        name[i] = uname[i];
+        if (!name[i]) {
+            break;
+        }
+    }
+    if (!name[0]) {
+        return -1;
+    }
+
+    uint32_t irq = spin_lock_irqsave(&shm_lock);
+
+    for (uint32_t i = 0; i < SHM_MAX_OBJECTS; i++) {
+        if (objects[i].used && !objects[i].removed && name_equal(objects[i].name, name)) {
+            obj = &objects[i];
+            break;
+        }
+    }
+
+    if (obj && (flags & SHM_CREATE) && (flags & SHM_EXCL)) {
+        terminal_writestring("ERROR: Shared memory object exists\n");
+        obj = NULL;
+    } else if (!obj && (flags & SHM_CREATE)) {
+        obj = create_object(name, size);
+    } else if (!obj) {
+        terminal_writestring("ERROR: No such shared memory object\n");
+    }
+
+    if (obj) {
+        id = object_id(obj);
+    }
+
+    spin_unlock_irqrestore(&shm_lock, irq);
+    return id;
+}
+
+void* shm_map(int id) {
+    process_t* current = this_cpu()->current;
+    void* addr = NULL;
+
+    uint32_t irq = spin_lock_irqsave(&shm_lock);
+    shm_object_t* obj = object_get(id);
+
+    if (!obj) {
+        terminal_writestring("ERROR: Bad shared memory id\n");
+    } else if (!current || !current->mm) {
+        addr = obj->kaddr;
+    } else {
+        uint32_t start = mm_find_free(current->mm, obj->size);
+
+        if (!start) {
+            terminal_writestring("ERROR: No room to map shared memory\n");
+        } else if (mm_map_frames(current->mm, start, obj->frames, obj->pages,
+                                 VMA_READ | VMA_WRITE) == 0) {
+            addr = (void*)start;
+        }
+    }
+
+    spin_unlock_irqrestore(&shm_lock, irq);
+    return addr;
+}
+
+int shm_unmap(void* addr) {
+    process_t* current = this_cpu()->current;
+
+    if (!current || !current->mm) {
+        terminal_writestring("ERROR: The kernel view cannot be unmapped\n");
+        return -1;
+    }
+    return mm_unmap(current->mm, (uint32_t)addr);
+}
+
+int shm_remove(int id) {
+    uint32_t irq = spin_lock_irqsave(&shm_lock);
+    shm_object_t* obj = object_get(id);
+
+    if (!obj) {
+        spin_unlock_irqrestore(&shm_lock, irq);
+        terminal_writestring("ERROR: Bad shared memory id\n");
+        return -1;
+    }
+
+    // removed keeps the slot out of lookups and out of create_object
+    // until the frames go back below
+    obj->removed = true;
+    unmap_object(obj);
+    spin_unlock_irqrestore(&shm_lock, irq);
+
+    // waiters go while the slot is still this object's; it is not
+    // reused until they have left shm_wait
+    wait_queue_wake_all(&obj->wq);
+
+    // other CPUs may still translate the view to these frames
+    smp_flush_tlb_range((uint32_t)obj->kaddr, obj->pages * PAGE_SIZE);
+
+    irq = spin_lock_irqsave(&shm_lock);
+    free_object(obj);
+    spin_unlock_irqrestore(&shm_lock, irq);
+    return 0;
+}
+
+uint32_t shm_notify(int id) {
+    shm_object_t* obj = object_get(id);
+
+    if (!obj) {
+        return 0;
+    }
+
+    uint32_t seq = atomic_inc(&obj->seq);
+    obj->notifies++;
+
+    // the locked increment orders against shm_wait's, one side sees the other
+    if (obj->sleepers) {
+        wait_queue_wake_all(&obj->wq);
+    }
+    return seq;
+}
+
+uint32_t shm_seq(int id) {
+    shm_object_t* obj = object_get(id);
+    return obj ? obj->seq : 0;
+}
+
+int shm_wait(int id, uint32_t seen) {
+    shm_object_t* obj = object_get(id);
+    wait_entry_t entry;
+
+    if (!obj) {
+        return -1;
+    }
+
+    uint32_t irq = spin_lock_irqsave(&obj->wq.lock);
+    atomic_inc(&obj->sleepers);
+
+    // removed, maybe even reused, since we looked it up
+    if (object_get(id) != obj) {
+        atomic_dec(&obj->sleepers);
+        spin_unlock_irqrestore(&obj->wq.lock, irq);
+        return -1;
+    }
+
+    if (obj->seq != seen) {
+        atomic_dec(&obj->sleepers);
+        spin_unlock_irqrestore(&obj->wq.lock, irq);
+        return 0;
+    }
+
+    // removed only holds for the object we slept on, the slot may be
+    // freed by the time we look again
+    uint32_t gen = obj->gen;
+
+    wait_entry_init(&entry);
+    wait_queue_add_locked(&obj->wq, &entry);
+    obj->wakeups++;
+    spin_unlock_irqrestore(&obj->wq.lock, irq);
+
+    int killed = wait_entry_block_killable(&entry);
+    if (killed != 0) {
+        wait_queue_remove(&obj->wq, &entry);
+    }
+
+    bool removed = obj->removed || obj->gen != gen;
+    atomic_dec(&obj->sleepers);
+    return (killed != 0 || removed) ? -1 : 0;
+}
+
+void shm_dump(void) {
+    bool any = false;
+
+    terminal_writestring("ID    Size      Maps  Notifies  Slept     Name\n");
+
+    uint32_t irq = spin_lock_irqsave(&shm_lock);
+
+    for (uint32_t i = 0; i < SHM_MAX_OBJECTS; i++) {
+        shm_object_t* obj = &objects[i];
+        if (!obj->used) {
+            continue;
+        }
+        any = true;
+
+        // one reference is the object's own
+        terminal_print_uint(object_id(obj));
+        terminal_writestring("    ");
+        terminal_print_uint(obj->size);
+        terminal_writestring("    ");
+        terminal_print_uint(frame_refcount(obj->frames[0]) - 1);
+        terminal_writestring("     ");
+        terminal_print_uint(obj->notifies);
+        terminal_writestring("     ");
+        terminal_print_uint(obj->wakeups);
+        terminal_writestring("     ");
+        terminal_writestring(obj->name);
+        terminal_writestring("\n");
+    }
+
+    spin_unlock_irqrestore(&shm_lock, irq);
+
+    if (!any) {
+        terminal_writestring("No shared memory objects\n");
+    }
+}
@@ -0,0 +1,212 @@
+#include <kernel/softirq.h>
+#include <kernel/kthread.h>
+#include <kernel/irqflags.h>
+#include <kernel/sync/spinlock.h>
+#include <kernel/cpu/cpu.h>
+#include <kernel/cpu/percpu.h>
+#include <kernel/math64.h>
+#include <kernel/sync/wait.h>
+#include <drivers/terminal.h>
+
+static softirq_action_t softirq_vec[NR_SOFTIRQS];
+static softirq_stat_t softirq_stats[NR_SOFTIRQS];
+
+static const char* softirq_names[NR_SOFTIRQS] = {
+    [SOFTIRQ_TIMER] = "TIMER",
+    [SOFTIRQ_INPUT] = "INPUT",
+    [SOFTIRQ_NET_TX] = "NET_TX",
+    [SOFTIRQ_NET_RX] = "NET_RX",
+    [SOFTIRQ_RCU] = "RCU",
+};
+
+// Device interrupts all arrive on the boot CPU, so one pending mask is
+// kept and only one CPU at a time runs softirqs (softirq_owner). The
+// hardirq nesting depth is per CPU.
+static spinlock_t softirq_lock = SPINLOCK_INIT;    // pending mask, owner and stats
+static volatile uint32_t softirq_pending = 0;
+static cpu_t* volatile softirq_owner = NULL;
+
+static bool have_tsc = false;
+
+// ksoftirqd
+static process_t* softirq_thread = NULL;
+static wait_queue_t softirq_wait;
+static uint32_t deferred = 0;        // times the work was handed to ksoftirqd
+
+void softirq_init(void) {
+    for (int i = 0; i < NR_SOFTIRQS; i++) {
+        softirq_vec[i] = NULL;
+    }
+    softirq_pending = 0;
+    wait_queue_init(&softirq_wait);
+    have_tsc = (cpuid_edx(1) & CPUID_EDX_TSC) != 0;
+}
+
+void open_softirq(uint32_t nr, softirq_action_t action) {
+    if (nr < NR_SOFTIRQS) {
+        softirq_vec[nr] = action;
+    }
+}
+
+void raise_softirq(uint32_t nr) {
+    if (nr >= NR_SOFTIRQS) {
+        return;
+    }
+
+    uint32_t flags = spin_lock_irqsave(&softirq_lock);
+    softirq_pending |= 1u << nr;
+    softirq_stats[nr].raised++;
+    spin_unlock_irqrestore(&softirq_lock, flags);
+}
+
+void irq_enter(void) {
+    this_cpu()->hardirq_depth++;
+}
+
+void irq_exit(void) {
+    cpu_t* cpu = this_cpu();
+
+    cpu->hardirq_depth--;
+
+    if (cpu->hardirq_depth == 0 && !softirq_owner && softirq_pending) {
+        do_softirq();
+    }
+}
+
+bool in_interrupt(void) {
+    return this_cpu()->hardirq_depth > 0 || in_softirq();
+}
+
+bool in_softirq(void) {
+    return softirq_owner == this_cpu();
+}
+
+static void run_action(uint32_t nr) {
+    uint64_t start = have_tsc ? rdtsc() : 0;
+
+    softirq_vec[nr]();
+
+    uint64_t cycles = have_tsc ? rdtsc() - start : 0;
+    uint32_t short_cycles = (cycles >> 32) ? 0xFFFFFFFF : (uint32_t)cycles;
+
+    uint32_t flags = spin_lock_irqsave(&softirq_lock);
+    softirq_stat_t* stat = &softirq_stats[nr];
+    stat->runs++;
+    stat->cycles += cycles;
+    if (short_cycles > stat->max_cycles) {
+        stat->max_cycles = short_cycles;
+    }
+    spin_unlock_irqrestore(&softirq_lock, flags);
+}
+
+// returns true if softirqs are still pending after the allowed rounds
+static bool softirq_rounds(uint32_t max_rounds) {
+    for (uint32_t round = 0; round < max_rounds; round++) {
+        // take the whole pending mask, new raises go into the next round
+        irq_disable();
+        spin_lock(&softirq_lock);
+        uint32_t pending = softirq_pending;
+        softirq_pending = 0;
+        spin_unlock(&softirq_lock);
+        if (!pending) {
+            return false;
+        }
+        irq_enable();
+
+        for (uint32_t nr = 0; nr < NR_SOFTIRQS; nr++) {
+            if ((pending & (1u << nr)) && softirq_vec[nr]) {
+                run_action(nr);
+            }
+        }
+    }
+
+    irq_disable();
+    return softirq_pending != 0;
+}
+
+void do_softirq(void) {
+    uint32_t flags = spin_lock_irqsave(&softirq_lock);
+
+    if (softirq_owner || !softirq_pending) {
+        spin_unlock_irqrestore(&softirq_lock, flags);
+        return;
+    }
+
+    softirq_owner = this_cpu();
+    spin_unlock(&softirq_lock);
+
+    bool more = softirq_rounds(SOFTIRQ_MAX_RESTART);
+    softirq_owner = NULL;
+
+    // still busy: let the thread finish so processes get the CPU
+    if (more && softirq_thread) {
+        deferred++;
+        wait_queue_wake_one(&softirq_wait);
+    }
+
+    irq_restore(flags);
+}
+
+static void ksoftirqd(void* arg) {
+    (void)arg;
+
+    while (1) {
+        uint32_t flags = spin_lock_irqsave(&softirq_lock);
+
+        while (!softirq_pending) {
+            wait_entry_t wait;
+
+            wait_entry_init(&wait);
+            wait_queue_add(&softirq_wait, &wait);
+            spin_unlock(&softirq_lock);
+
+            wait_entry_block(&wait);
+            wait_queue_remove(&softirq_wait, &wait);
+            spin_lock(&softirq_lock);
+        }
+
+        spin_unlock_irqrestore(&softirq_lock, flags);
+
+        do_softirq();
+    }
+}
+
+void softirq_start_thread(void) {
+    softirq_thread = kthread_create("ksoftirqd", ksoftirqd, NULL);
+}
+
+const softirq_stat_t* softirq_get_stat(uint32_t nr) {
+    return nr < NR_SOFTIRQS ? &softirq_stats[nr] : NULL;
+}
+
+const char* softirq_name(uint32_t nr) {
+    return nr < NR_SOFTIRQS ? softirq_names[nr] : "unknown";
+}
+
+uint32_t softirq_deferred_count(void) {
+    return deferred;
+}
+
+void softirq_stats_dump(void) {
+    terminal_writestring("SOFTIRQ   RAISED    RUNS      AVG CYC   MAX CYC\n");
+
+    for (uint32_t nr = 0; nr < NR_SOFTIRQS; nr++) {
+        const softirq_stat_t* stat = &softirq_stats[nr];
+        uint32_t avg = stat->runs ? (uint32_t)div_u64_u32(stat->cycles, stat->runs, NULL) : 0;
+
+        terminal_writestring(softirq_names[nr]);
+        terminal_writestring("  ");
+        terminal_print_int(stat->raised);
+        terminal_writestring("  ");
+        terminal_print_int(stat->runs);
+        terminal_writestring("  ");
+        terminal_print_int(avg);
+        terminal_writestring("  ");
+        terminal_print_int(stat->max_cycles);
+        terminal_writestring("\n");
+    }
+
+    terminal_writestring("deferred to ksoftirqd: ");
+    terminal_print_int(deferred);
+    terminal_writestring("\n");
+}
@@ -0,0 +1,137 @@
+#include <kernel/sync/lockstat.h>
+#include <kernel/sync/spinlock.h>
+#include <kernel/irqflags.h>
+#include <kernel/math64.h>
+#include <drivers/terminal.h>
+
+volatile bool lockstat_enabled = false;
+
+static lock_class_t* classes = NULL;
+static spinlock_t classes_lock = SPINLOCK_INIT;    // no class, never profiled
+
+// the counters of a class are shared by all of its locks and all CPUs
+static uint32_t class_lock(lock_class_t* cls) {
+    uint32_t flags = irq_save();
+
+    while (spin_xchg(&cls->busy, 1)) {
+        while (cls->busy) {
+            cpu_relax();
+        }
+    }
+    return flags;
+}
+
+static void class_unlock(lock_class_t* cls, uint32_t flags) {
+    __asm__ volatile("" : : : "memory");
+    cls->busy = 0;
+    irq_restore(flags);
+}
+
+static void class_register(lock_class_t* cls) {
+    uint32_t flags = spin_lock_irqsave(&classes_lock);
+
+    if (!cls->registered) {
+        cls->next = classes;
+        classes = cls;
+        cls->registered = true;
+    }
+
+    spin_unlock_irqrestore(&classes_lock, flags);
+}
+
+void lockstat_acquired(lock_class_t* cls, uint32_t spin_cycles, bool contended) {
+    if (!cls->registered) {
+        class_register(cls);
+    }
+
+    uint32_t flags = class_lock(cls);
+
+    cls->acquisitions++;
+    if (contended) {
+        cls->contended++;
+        cls->spin_cycles += spin_cycles;
+        if (spin_cycles > cls->max_spin) {
+            cls->max_spin = spin_cycles;
+        }
+    }
+
+    class_unlock(cls, flags);
+}
+
+void lockstat_released(lock_class_t* cls, uint32_t hold_cycles) {
+    uint32_t flags = class_lock(cls);
+
+    cls->holds++;
+    cls->hold_cycles += hold_cycles;
+    if (hold_cycles > cls->max_hold) {
+        cls->max_hold = hold_cycles;
+    }
+
+    class_unlock(cls, flags);
+}
+
+void lockstat_enable(bool enable) {
+    lockstat_enabled = enable;
+}
+
+void lockstat_reset(void) {
+    uint32_t flags = spin_lock_irqsave(&classes_lock);
+
+    for (lock_class_t* cls = classes; cls; cls = cls->next) {
+        uint32_t class_flags = class_lock(cls);
+
+        cls->acquisitions = 0;
+        cls->contended = 0;
+        cls->spin_cycles = 0;
+        cls->max_spin = 0;
+        cls->hold_cycles = 0;
+        cls->holds = 0;
+        cls->max_hold = 0;
+
+        class_unlock(cls, class_flags);
+    }
+
+    spin_unlock_irqrestore(&classes_lock, flags);
+}
+
+static void print_padded(const char* s, int width) {
+    int len = 0;
+    terminal_writestring(s);
+    while (s[len]) {
+        len++;
+    }
+    for (; len < width; len++) {
+        terminal_putchar(' ');
+    }
+}
+
+void lockstat_dump(void) {
+    terminal_writestring("CLASS           ACQUIRED  CONTENDED  AVG SPIN  MAX SPIN  AVG HOLD  MAX HOLD\n");
+
+    // classes only ever join the list at its head, a snapshot of the head is enough
+    for (lock_class_t* cls = classes; cls; cls = cls->next) {
+        lock_class_t snap;
+        uint32_t flags = class_lock(cls);
+        snap = *cls;
+        class_unlock(cls, flags);
+
+        uint32_t avg_spin = snap.contended ? (uint32_t)div_u64_u32(snap.spin_cycles, snap.contended, NULL) : 0;
+        uint32_t avg_hold = snap.holds ? (uint32_t)div_u64_u32(snap.hold_cycles, snap.holds, NULL) : 0;
+
+        print_padded(snap.name, 16);
+        terminal_print_int(snap.acquisitions);
+        terminal_writestring("  ");
+        terminal_print_int(snap.contended);
+        terminal_writestring("  ");
+        terminal_print_int(avg_spin);
+        terminal_writestring("  ");
+        terminal_print_int(snap.max_spin);
+        terminal_writestring("  ");
+        terminal_print_int(avg_hold);
+        terminal_writestring("  ");
+        terminal_print_int(snap.max_hold);
+        terminal_writestring("\n");
+    }
+
+    terminal_writestring(lockstat_enabled ? "profiling: on (cycles)\n" : "profiling: off\n");
+}
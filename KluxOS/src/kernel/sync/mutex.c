@@ -0,0 +1,116 @@
+#include <kernel/sync/mutex.h>
+#include <kernel/sync/spinlock.h>
+#include <kernel/process.h>
+#include <kernel/irqflags.h>
+
+void mutex_init(mutex_t* mutex) {
+    mutex->state = MUTEX_UNLOCKED;
+    mutex->owner = NULL;
+    wait_queue_init(&mutex->waiters);
+    mutex->spins = 0;
+    mutex->sleeps = 0;
+}
+
+int mutex_trylock(mutex_t* mutex) {
+    if (spin_cmpxchg(&mutex->state, MUTEX_UNLOCKED, MUTEX_LOCKED) != MUTEX_UNLOCKED) {
+        return 0;
+    }
+
+    mutex->owner = process_get_current();
+    return 1;
+}
+
+// the owner is executing right now on some other CPU
+static bool owner_running(process_t* owner) {
+    if (!owner || owner->state != PROCESS_RUNNING) {
+        return false;
+    }
+
+    cpu_t* cpu = &cpus[owner->cpu];
+    return cpu != this_cpu() && cpu->current == owner;
+}
+
+// spin while the owner runs elsewhere; returns true once the mutex is ours
+static bool mutex_spin_on_owner(mutex_t* mutex) {
+    cpu_t* cpu = this_cpu();
+
+    if (cpu_online_count() < 2) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < MUTEX_SPIN_LIMIT; i++) {
+        if (mutex->state == MUTEX_UNLOCKED && mutex_trylock(mutex)) {
+            return true;
+        }
+
+        // sleeping waiters are served first, and a sleeping owner or
+        // pending reschedule makes spinning pointless
+        if (mutex->state == MUTEX_CONTENDED || !owner_running(mutex->owner) ||
+            cpu->need_resched) {
+            return false;
+        }
+
+        cpu_relax();
+    }
+
+    return false;
+}
+
+void mutex_lock(mutex_t* mutex) {
+    if (mutex_trylock(mutex)) {
+        return;
+    }
+
+    if (mutex_spin_on_owner(mutex)) {
+        mutex->spins++;
+        return;
+    }
+
+    uint32_t flags = spin_lock_irqsave(&mutex->waiters.lock);
+
+    // mark the mutex contended so the owner's unlock takes the slow path
+    if (spin_xchg(&mutex->state, MUTEX_CONTENDED) == MUTEX_UNLOCKED) {
+        mutex->owner = process_get_current();
+        spin_unlock_irqrestore(&mutex->waiters.lock, flags);
+        return;
+    }
+
+    wait_entry_t entry;
+    wait_entry_init(&entry);
+    wait_queue_add_locked(&mutex->waiters, &entry);
+    spin_unlock(&mutex->waiters.lock);
+
+    // mutex_unlock made us the owner before waking us
+    wait_entry_block(&entry);
+    mutex->sleeps++;
+
+    irq_restore(flags);
+}
+
+void mutex_unlock(mutex_t* mutex) {
+    // cleared first: once the state drops another CPU may already own it
+    mutex->owner = NULL;
+
+    // nobody queued since we took it
+    if (spin_cmpxchg(&mutex->state, MUTEX_LOCKED, MUTEX_UNLOCKED) == MUTEX_LOCKED) {
+        return;
+    }
+
+    uint32_t flags = spin_lock_irqsave(&mutex->waiters.lock);
+    wait_entry_t* next = wait_queue_first_locked(&mutex->waiters);
+
+    if (!next) {
+        __asm__ volatile("" : : : "memory");
+        mutex->state = MUTEX_UNLOCKED;
+    } else {
+        // hand over without releasing, the state stays contended while
+        // anyone else is still queued
+        mutex->owner = next->process;
+        if (next->node.next == &mutex->waiters.waiters) {
+            mutex->state = MUTEX_LOCKED;
+        }
+        wait_queue_wake_one_locked(&mutex->waiters);
+    }
+
+    spin_unlock_irqrestore(&mutex->waiters.lock, flags);
+}
@@ -0,0 +1,154 @@
+#include <kernel/sync/rcu.h>
+#include <kernel/sync/spinlock.h>
+#include <kernel/sync/wait.h>
+#include <kernel/softirq.h>
+#include <kernel/irqflags.h>
+
+// Callbacks move through three lists: 'next' waits for a grace period
+// to start, 'wait' for the running one to end, 'done' for the softirq.
+// A grace period starts as soon as callbacks are queued and none is
+// running; it ends when the last CPU in qs_pending reported.
+
+typedef struct {
+    rcu_head_t* head;
+    rcu_head_t** tail;
+} rcu_list_t;
+
+static lock_class_t rcu_class = LOCK_CLASS_INIT("rcu");
+static spinlock_t rcu_lock = SPINLOCK_INIT_CLASS(&rcu_class);
+
+// usable before rcu_init, callbacks just wait for the softirq
+static rcu_list_t next_list = { NULL, &next_list.head };
+static rcu_list_t wait_list = { NULL, &wait_list.head };
+static rcu_list_t done_list = { NULL, &done_list.head };
+
+static volatile uint32_t qs_pending = 0;     // bit per CPU still to pass a quiescent state
+static bool gp_active = false;
+static volatile uint32_t gp_completed = 0;
+
+static void list_reset(rcu_list_t* list) {
+    list->head = NULL;
+    list->tail = &list->head;
+}
+
+static void list_splice(rcu_list_t* dst, rcu_list_t* src) {
+    if (!src->head) {
+        return;
+    }
+    *dst->tail = src->head;
+    dst->tail = src->tail;
+    list_reset(src);
+}
+
+// rcu_lock held
+static void start_gp_locked(void) {
+    if (gp_active || !next_list.head) {
+        return;
+    }
+
+    uint32_t mask = 0;
+    for (uint32_t i = 0; i < cpu_count(); i++) {
+        if (cpus[i].online) {
+            mask |= 1u << i;
+        }
+    }
+
+    list_splice(&wait_list, &next_list);
+    gp_active = true;
+    qs_pending = mask;
+}
+
+static void rcu_report_qs(cpu_t* cpu) {
+    uint32_t bit = 1u << cpu->id;
+
+    // nearly always nothing to report, check without the lock
+    if (!(qs_pending & bit)) {
+        return;
+    }
+
+    uint32_t flags = spin_lock_irqsave(&rcu_lock);
+
+    qs_pending &= ~bit;
+    if (gp_active && qs_pending == 0) {
+        gp_active = false;
+        gp_completed++;
+        list_splice(&done_list, &wait_list);
+        start_gp_locked();
+        raise_softirq(SOFTIRQ_RCU);
+    }
+
+    spin_unlock_irqrestore(&rcu_lock, flags);
+}
+
+void rcu_note_context_switch(cpu_t* cpu) {
+    rcu_report_qs(cpu);
+}
+
+void rcu_check_tick(cpu_t* cpu) {
+    // the tick interrupted code outside any read-side section
+    if (cpu->rcu_nesting == 0) {
+        rcu_report_qs(cpu);
+    }
+}
+
+static void rcu_softirq(void) {
+    uint32_t flags = spin_lock_irqsave(&rcu_lock);
+    rcu_head_t* head = done_list.head;
+    list_reset(&done_list);
+    spin_unlock_irqrestore(&rcu_lock, flags);
+
+    while (head) {
+        rcu_head_t* next = head->next;
+        head->func(head);
+        head = next;
+    }
+}
+
+void rcu_init(void) {
+    open_softirq(SOFTIRQ_RCU, rcu_softirq);
+}
+
+void call_rcu(rcu_head_t* head, rcu_callback_t func) {
+    head->next = NULL;
+    head->func = func;
+
+    uint32_t flags = spin_lock_irqsave(&rcu_lock);
+    *next_list.tail = head;
+    next_list.tail = &head->next;
+    start_gp_locked();
+    spin_unlock_irqrestore(&rcu_lock, flags);
+}
+
+typedef struct {
+    rcu_head_t head;
+    wait_entry_t wait;
+} rcu_sync_t;
+
+static void rcu_sync_done(rcu_head_t* head) {
+    rcu_sync_t* sync = list_entry(head, rcu_sync_t, head);
+    wait_entry_wake(&sync->wait);
+}
+
+void synchronize_rcu(void) {
+    // readers cannot be preempted, so with one CPU and the caller
+    // outside a read-side section no reader can be in progress
+    if (cpu_online_count() < 2) {
+        rcu_barrier_compiler();
+        return;
+    }
+
+    rcu_sync_t sync;
+    wait_entry_init(&sync.wait);
+    call_rcu(&sync.head, rcu_sync_done);
+
+    // the caller itself is in a quiescent state; no migration in between
+    uint32_t flags = irq_save();
+    rcu_report_qs(this_cpu());
+    irq_restore(flags);
+
+    wait_entry_block(&sync.wait);
+}
+
+uint32_t rcu_completed(void) {
+    return gp_completed;
+}
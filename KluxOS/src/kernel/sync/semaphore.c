@@ -0,0 +1,107 @@
+#include <kernel/sync/semaphore.h>
+#include <kernel/sync/spinlock.h>
+#include <kernel/timer/timer.h>
+#include <kernel/timer/pit.h>
+#include <kernel/irqflags.h>
+
+void sema_init(semaphore_t* sem, int32_t count) {
+    sem->count = count;
+    wait_queue_init(&sem->waiters);
+}
+
+int down_trylock(semaphore_t* sem) {
+    uint32_t flags = spin_lock_irqsave(&sem->waiters.lock);
+    int taken = sem->count > 0;
+
+    if (taken) {
+        sem->count--;
+    }
+
+    spin_unlock_irqrestore(&sem->waiters.lock, flags);
+    return taken;
+}
+
+void down(semaphore_t* sem) {
+    uint32_t flags = spin_lock_irqsave(&sem->waiters.lock);
+
+    if (sem->count > 0) {
+        sem->count--;
+        spin_unlock_irqrestore(&sem->waiters.lock, flags);
+        return;
+    }
+
+    wait_entry_t entry;
+    wait_entry_init(&entry);
+    wait_queue_add_locked(&sem->waiters, &entry);
+    spin_unlock(&sem->waiters.lock);
+
+    // up handed its unit to us
+    wait_entry_block(&entry);
+
+    irq_restore(flags);
+}
+
+typedef struct {
+    wait_entry_t entry;
+    semaphore_t* sem;
+    ktimer_t timer;
+    volatile int timed_out;
+    volatile int timer_done;     // the callback no longer touches this frame
+} sema_waiter_t;
+
+static void sema_timeout(void* data) {
+    sema_waiter_t* waiter = (sema_waiter_t*)data;
+    uint32_t flags = spin_lock_irqsave(&waiter->sem->waiters.lock);
+
+    // up may have handed over a unit just before the timer fired
+    if (!waiter->entry.woken) {
+        waiter->timed_out = 1;
+        wait_entry_wake_locked(&waiter->entry);
+    }
+
+    spin_unlock_irqrestore(&waiter->sem->waiters.lock, flags);
+    waiter->timer_done = 1;
+}
+
+int down_timeout(semaphore_t* sem, uint32_t ms) {
+    uint32_t flags = spin_lock_irqsave(&sem->waiters.lock);
+
+    if (sem->count > 0) {
+        sem->count--;
+        spin_unlock_irqrestore(&sem->waiters.lock, flags);
+        return 0;
+    }
+
+    sema_waiter_t waiter;
+    waiter.sem = sem;
+    waiter.timed_out = 0;
+    waiter.timer_done = 0;
+    wait_entry_init(&waiter.entry);
+    wait_queue_add_locked(&sem->waiters, &waiter.entry);
+    spin_unlock(&sem->waiters.lock);
+
+    ktimer_init(&waiter.timer, sema_timeout, &waiter);
+    ktimer_add(&waiter.timer, get_ticks() + ms_to_ticks(ms));
+
+    wait_entry_block(&waiter.entry);
+
+    // the callback may be running on another CPU, wait it out
+    if (!ktimer_cancel(&waiter.timer)) {
+        while (!waiter.timer_done) {
+            cpu_relax();
+        }
+    }
+
+    irq_restore(flags);
+    return waiter.timed_out ? -1 : 0;
+}
+
+void up(semaphore_t* sem) {
+    uint32_t flags = spin_lock_irqsave(&sem->waiters.lock);
+
+    if (!wait_queue_wake_one_locked(&sem->waiters)) {
+        sem->count++;
+    }
+
+    spin_unlock_irqrestore(&sem->waiters.lock, flags);
+}
@@ -0,0 +1,164 @@
+#include <kernel/sync/wait.h>
+#include <kernel/process.h>
+#include <kernel/irqflags.h>
+
+void wait_queue_init(wait_queue_t* wq) {
+    spin_lock_init(&wq->lock);
+    list_init(&wq->waiters);
+}
+
+void wait_entry_init(wait_entry_t* entry) {
+    list_init(&entry->node);
+    entry->queue = NULL;
+    entry->process = process_get_current();
+    entry->func = NULL;
+    entry->data = NULL;
+    entry->keep = false;
+    entry->woken = 0;
+}
+
+void wait_queue_add_locked(wait_queue_t* wq, wait_entry_t* entry) {
+    entry->woken = 0;
+    entry->queue = wq;
+    list_add_tail(&wq->waiters, &entry->node);
+}
+
+void wait_queue_add(wait_queue_t* wq, wait_entry_t* entry) {
+    uint32_t flags = spin_lock_irqsave(&wq->lock);
+    wait_queue_add_locked(wq, entry);
+    spin_unlock_irqrestore(&wq->lock, flags);
+}
+
+void wait_queue_remove(wait_queue_t* wq, wait_entry_t* entry) {
+    uint32_t flags = spin_lock_irqsave(&wq->lock);
+    list_del(&entry->node);
+    spin_unlock_irqrestore(&wq->lock, flags);
+}
+
+void wait_entry_block(wait_entry_t* entry) {
+    uint32_t flags = irq_save();
+
+    while (!entry->woken) {
+        // woken is checked again under the scheduler lock, a wakeup from
+        // another CPU between here and blocking is not lost
+        if (entry->process) {
+            process_wait_event(&entry->woken);
+        }
+
+        // nothing else could run: halt until an interrupt wakes us
+        if (!entry->woken) {
+            irq_enable_and_halt();
+            irq_disable();
+        }
+    }
+
+    irq_restore(flags);
+}
+
+int wait_entry_block_killable(wait_entry_t* entry) {
+    uint32_t flags = irq_save();
+    int result = 0;
+
+    while (!entry->woken) {
+        if (entry->process && process_wait_event_killable(&entry->woken) != 0) {
+            result = -1;
+            break;
+        }
+
+        if (!entry->woken) {
+            irq_enable_and_halt();
+            irq_disable();
+        }
+    }
+
+    irq_restore(flags);
+    return result;
+}
+
+void wait_queue_sleep(wait_queue_t* wq) {
+    wait_entry_t entry;
+
+    wait_entry_init(&entry);
+    wait_queue_add(wq, &entry);
+    wait_entry_block(&entry);
+    wait_queue_remove(wq, &entry);
+}
+
+void wait_entry_wake_locked(wait_entry_t* entry) {
+    if (!entry->keep) {
+        list_del(&entry->node);
+    }
+    entry->woken = 1;
+
+    if (entry->func) {
+        entry->func(entry);
+    } else if (entry->process) {
+        process_wake(entry->process);
+    }
+}
+
+void wait_entry_wake(wait_entry_t* entry) {
+    wait_queue_t* wq = entry->queue;
+
+    if (!wq) {
+        uint32_t flags = irq_save();
+        wait_entry_wake_locked(entry);
+        irq_restore(flags);
+        return;
+    }
+
+    uint32_t flags = spin_lock_irqsave(&wq->lock);
+    wait_entry_wake_locked(entry);
+    spin_unlock_irqrestore(&wq->lock, flags);
+}
+
+wait_entry_t* wait_queue_first_locked(wait_queue_t* wq) {
+    if (list_empty(&wq->waiters)) {
+        return NULL;
+    }
+    return list_entry(wq->waiters.next, wait_entry_t, node);
+}
+
+int wait_queue_wake_one_locked(wait_queue_t* wq) {
+    list_node_t* pos;
+    list_node_t* tmp;
+
+    list_for_each_safe(pos, tmp, &wq->waiters) {
+        wait_entry_t* entry = list_entry(pos, wait_entry_t, node);
+
+        // a woken sleeper's entry may be gone once this returns
+        bool keep = entry->keep;
+        wait_entry_wake_locked(entry);
+        if (!keep) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int wait_queue_wake_one(wait_queue_t* wq) {
+    uint32_t flags = spin_lock_irqsave(&wq->lock);
+    int woken = wait_queue_wake_one_locked(wq);
+    spin_unlock_irqrestore(&wq->lock, flags);
+    return woken;
+}
+
+int wait_queue_wake_all(wait_queue_t* wq) {
+    list_node_t* pos;
+    list_node_t* tmp;
+    int woken = 0;
+
+    uint32_t flags = spin_lock_irqsave(&wq->lock);
+
+    list_for_each_safe(pos, tmp, &wq->waiters) {
+        wait_entry_t* entry = list_entry(pos, wait_entry_t, node);
+
+        if (!entry->keep) {
+            woken++;
+        }
+        wait_entry_wake_locked(entry);
+    }
+
+    spin_unlock_irqrestore(&wq->lock, flags);
+    return woken;
+}
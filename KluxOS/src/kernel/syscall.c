@@ -1,24 +1,105 @@
 #include <kernel/syscall.h>
 #include <kernel/types.h>
-#include <kernel/interrupt.h>
+#include <kernel/interrupt/idt.h>
+#include <kernel/cpu/cpu.h>
+#include <kernel/cpu/gdt.h>
 #include <kernel/process.h>
 #include <kernel/fs.h>
+#include <kernel/fdtable.h>
+#include <kernel/uring.h>
+#include <kernel/futex.h>
+#include <kernel/shm.h>
+#include <kernel/pipe.h>
+#include <kernel/ipc.h>
+#include <kernel/epoll.h>
+#include <kernel/exec.h>
+#include <kernel/syscall_stats.h>
+#include <kernel/timer/pit.h>
+#include <kernel/timer/timer.h>
+#include <kernel/timer/clocksource.h>
+#include <kernel/timer/vdso.h>
+#include <kernel/math64.h>
 #include <drivers/terminal.h>
 #include "mm/memory.h"
+#include "mm/pagecache.h"
+
+static void* syscall_table[SYSCALL_MAX];
+
+static bool sysenter_enabled = false;
+static bool have_tsc = false;
+
+static const char* syscall_names[SYSCALL_MAX] = {
+    [SYS_EXIT] = "exit",
+    [SYS_FORK] = "fork",
+    [SYS_READ] = "read",
+    [SYS_WRITE] = "write",
+    [SYS_OPEN] = "open",
+    [SYS_CLOSE] = "close",
+    [SYS_EXEC] = "exec",
+    [SYS_TIME] = "time",
+    [SYS_GETPID] = "getpid",
+    [SYS_SLEEP] = "sleep",
+    [SYS_MALLOC] = "malloc",
+    [SYS_FREE] = "free",
+    [SYS_CLOCK_GETTIME] = "clock_gettime",
+    [SYS_NOP] = "nop",
+    [SYS_URING_SETUP] = "uring_setup",
+    [SYS_URING_ENTER] = "uring_enter",
+    [SYS_DUP] = "dup",
+    [SYS_DUP2] = "dup2",
+    [SYS_FUTEX_WAIT] = "futex_wait",
+    [SYS_FUTEX_WAKE] = "futex_wake",
+    [SYS_SHM_GET] = "shm_get",
+    [SYS_SHM_MAP] = "shm_map",
+    [SYS_SHM_UNMAP] = "shm_unmap",
+    [SYS_SHM_REMOVE] = "shm_remove",
+    [SYS_SHM_NOTIFY] = "shm_notify",
+    [SYS_SHM_WAIT] = "shm_wait",
+    [SYS_PIPE] = "pipe",
+    [SYS_MKFIFO] = "mkfifo",
+    [SYS_SPLICE] = "splice",
+    [SYS_TEE] = "tee",
+    [SYS_USER_RETURN] = "user_return",
+    [SYS_IPC_CREATE] = "ipc_create",
+    [SYS_IPC_DESTROY] = "ipc_destroy",
+    [SYS_IPC_CALL] = "ipc_call",
+    [SYS_IPC_RECV] = "ipc_recv",
+    [SYS_IPC_REPLY] = "ipc_reply",
+    [SYS_IPC_REPLY_RECV] = "ipc_reply_recv",
+    [SYS_EPOLL_CREATE] = "epoll_create",
+    [SYS_EPOLL_CTL] = "epoll_ctl",
+    [SYS_EPOLL_WAIT] = "epoll_wait",
+    [SYS_URING_DESTROY] = "uring_destroy",
+};
+
+// syscall_entry.asm
+extern void syscall_int80_entry(void);
+extern void sysenter_entry(void);
+extern uint8_t vdso_sysenter_start[], vdso_sysenter_end[];
+extern uint8_t vdso_int80_start[], vdso_int80_end[];
+
+// the MSRs are per CPU
+static void sysenter_set_msrs(void) {
+    // esp points at this CPU's TSS, the entry code loads tss.esp0 from
+    // there so a process switch only has to update the TSS
+    wrmsr(MSR_IA32_SYSENTER_CS, GDT_KERNEL_CODE);
+    wrmsr(MSR_IA32_SYSENTER_ESP, (uint32_t)gdt_get_tss());
+    wrmsr(MSR_IA32_SYSENTER_EIP, (uint32_t)sysenter_entry);
+}
 
-#define MAX_FD 32
-
-
-typedef struct {
-    bool used;           
-    fs_node_t* node;     
-    uint32_t offset;     
-    uint32_t flags;      
-} fd_entry_t;
+static void init_sysenter(void) {
+    if (!(cpuid_edx(1) & CPUID_EDX_SEP)) {
+        terminal_writestring("  sysenter not supported, using int 0x80\n");
+        vdso_set_entry(vdso_int80_start, vdso_int80_end - vdso_int80_start);
+        return;
+    }
 
-static fd_entry_t fd_table[MAX_FD];
+    sysenter_set_msrs();
 
-static void* syscall_table[32];
+    vdso_set_entry(vdso_sysenter_start, vdso_sysenter_end - vdso_sysenter_start);
+    sysenter_enabled = true;
+    terminal_writestring("  sysenter enabled\n");
+}
 
 void init_syscalls(void) {
     terminal_writestring("System calls are being initialized...\n");
@@ -35,21 +116,111 @@ void init_syscalls(void) {
     syscall_table[SYS_SLEEP] = syscall_sleep;
     syscall_table[SYS_MALLOC] = syscall_malloc;
     syscall_table[SYS_FREE] = syscall_free;
-    
-    register_interrupt_handler(0x80, (isr_t)syscall_handler);
+    syscall_table[SYS_CLOCK_GETTIME] = syscall_clock_gettime;
+    syscall_table[SYS_NOP] = syscall_nop;
+    syscall_table[SYS_URING_SETUP] = syscall_uring_setup;
+    syscall_table[SYS_URING_ENTER] = syscall_uring_enter;
+    syscall_table[SYS_DUP] = syscall_dup;
+    syscall_table[SYS_DUP2] = syscall_dup2;
+    syscall_table[SYS_FUTEX_WAIT] = syscall_futex_wait;
+    syscall_table[SYS_FUTEX_WAKE] = syscall_futex_wake;
+    syscall_table[SYS_SHM_GET] = syscall_shm_get;
+    syscall_table[SYS_SHM_MAP] = syscall_shm_map;
+    syscall_table[SYS_SHM_UNMAP] = syscall_shm_unmap;
+    syscall_table[SYS_SHM_REMOVE] = syscall_shm_remove;
+    syscall_table[SYS_SHM_NOTIFY] = syscall_shm_notify;
+    syscall_table[SYS_SHM_WAIT] = syscall_shm_wait;
+    syscall_table[SYS_PIPE] = syscall_pipe;
+    syscall_table[SYS_MKFIFO] = syscall_mkfifo;
+    syscall_table[SYS_SPLICE] = syscall_splice;
+    syscall_table[SYS_TEE] = syscall_tee;
+    syscall_table[SYS_IPC_CREATE] = syscall_ipc_create;
+    syscall_table[SYS_IPC_DESTROY] = syscall_ipc_destroy;
+    syscall_table[SYS_IPC_CALL] = syscall_ipc_call;
+    syscall_table[SYS_IPC_RECV] = syscall_ipc_recv;
+    syscall_table[SYS_IPC_REPLY] = syscall_ipc_reply;
+    syscall_table[SYS_IPC_REPLY_RECV] = syscall_ipc_reply_recv;
+    syscall_table[SYS_EPOLL_CREATE] = syscall_epoll_create;
+    syscall_table[SYS_EPOLL_CTL] = syscall_epoll_ctl;
+    syscall_table[SYS_EPOLL_WAIT] = syscall_epoll_wait;
+    syscall_table[SYS_URING_DESTROY] = syscall_uring_destroy;
+    
+    uring_init();
+    futex_init();
+    syscall_stats_init();
+    have_tsc = (cpuid_edx(1) & CPUID_EDX_TSC) != 0;
+    
+    // own gate instead of the generic isr path, callable from ring 3
+    idt_set_gate(0x80, (uint32_t)syscall_int80_entry, GDT_KERNEL_CODE,
+                 IDT_FLAG_PRESENT | IDT_FLAG_RING3 | IDT_FLAG_32BIT);
+    
+    init_sysenter();
     
     terminal_writestring("System calls are initialized.\n");
 }
 
-// System call handler (Interrupt 0x80)
-void syscall_handler(uint32_t syscall_num, uint32_t arg1, uint32_t arg2, uint32_t arg3) {
-    if (syscall_num >= 32 || syscall_table[syscall_num] == 0) {
+// Common dispatcher for int 0x80 and sysenter
+uint32_t syscall_dispatch(uint32_t num, uint32_t arg1, uint32_t arg2, uint32_t arg3,
+                          uint32_t arg4, uint32_t arg5, uint32_t arg6) {
+    if (num >= SYSCALL_MAX || syscall_table[num] == 0) {
+        syscall_stats_invalid();
         terminal_writestring("ERROR: Invalid system call!\n");
-        return;
+        return (uint32_t)-1;
+    }
+    
+    // time in the call is system time even when ring 3 made it
+    process_t* caller = process_get_current();
+    bool from_user = caller && caller->in_user;
+    if (from_user) {
+        process_account_user_exit();
     }
     
-    void (*func)(uint32_t, uint32_t, uint32_t) = syscall_table[syscall_num];
-    func(arg1, arg2, arg3);
+    // cdecl: the caller cleans up, extra arguments are ignored
+    syscall_fn_t func = (syscall_fn_t)syscall_table[num];
+    uint64_t start = have_tsc ? rdtsc() : 0;
+    uint32_t ret = func(arg1, arg2, arg3, arg4, arg5, arg6);
+    uint64_t end = have_tsc ? rdtsc() : 0;
+    
+    if (from_user) {
+        process_account_user_enter();
+    }
+    
+    uint32_t args[6] = { arg1, arg2, arg3, arg4, arg5, arg6 };
+    syscall_stats_record(num, args, ret, start, end - start);
+    
+    // killed while blocked in the call: every wait entry is off its
+    // queue by now, so exiting on this stack is safe
+    if (caller && caller->killed) {
+        process_exit();
+    }
+    
+    return ret;
+}
+
+const char* syscall_name(uint32_t num) {
+    if (num >= SYSCALL_MAX || !syscall_names[num]) {
+        return "unknown";
+    }
+    return syscall_names[num];
+}
+
+// System call handler (legacy three argument interface)
+void syscall_handler(uint32_t syscall_num, uint32_t arg1, uint32_t arg2, uint32_t arg3) {
+    syscall_dispatch(syscall_num, arg1, arg2, arg3, 0, 0, 0);
+}
+
+void syscall_init_cpu(void) {
+    if (sysenter_enabled) {
+        sysenter_set_msrs();
+    }
+}
+
+void syscall_set_kernel_stack(uint32_t esp) {
+    tss_set_kernel_stack(esp);
+}
+
+bool syscall_sysenter_enabled(void) {
+    return sysenter_enabled;
 }
 
 void syscall_exit(int status) {
@@ -68,13 +239,14 @@ int syscall_fork(void) {
 }
 
 size_t syscall_read(int fd, void* buf, size_t count) {
-    if (fd < 0 || fd >= MAX_FD || !fd_table[fd].used) {
+    file_t* file = fd_get(fdtable_current(), fd);
+    if (!file) {
         terminal_writestring("ERROR: Invalid file descriptor\n");
         return -1;
     }
     
-    // stdin operation (fd=0)
-    if (fd == 0) {
+    // console (stdin and anything dup'ed from it)
+    if (!file->node) {
         extern char keyboard_buffer[256];
         extern int keyboard_buffer_pos;
         
@@ -99,46 +271,47 @@ size_t syscall_read(int fd, void* buf, size_t count) {
         return 0;
     }
     
-    fs_node_t* node = fd_table[fd].node;
-    if (!node) {
-        terminal_writestring("ERROR: Invalid file descriptor\n");
-        return -1;
-    }
+    fs_node_t* node = file->node;
     
     if (!(node->mask & FS_PERM_READ)) {
         terminal_writestring("ERROR: Read permission denied\n");
         return -1;
     }
     
+    if (node->type == FS_PIPE) {
+        return pipe_read(file, buf, count);
+    }
+    
     uint32_t read_size = 0;
     if (node->read) {
-        read_size = node->read(node, fd_table[fd].offset, count, (uint8_t*)buf);
+        read_size = node->read(node, file->offset, count, (uint8_t*)buf);
     } else {
         if (node->contents) {
-            uint32_t remaining = node->length - fd_table[fd].offset;
+            uint32_t remaining = node->length - file->offset;
             read_size = count > remaining ? remaining : count;
             
             if (read_size > 0) {
-                memcpy(buf, (uint8_t*)node->contents + fd_table[fd].offset, read_size);
+                memcpy(buf, (uint8_t*)node->contents + file->offset, read_size);
             }
         }
     }
     
 
-    fd_table[fd].offset += read_size;
+    file->offset += read_size;
     
     return read_size;
 }
 
 
 size_t syscall_write(int fd, const void* buf, size_t count) {
-    if (fd < 0 || fd >= MAX_FD) {
+    file_t* file = fd_get(fdtable_current(), fd);
+    if (!file) {
         terminal_writestring("ERROR: Invalid file descriptor\n");
         return -1;
     }
     
-    // stdout/stderr operation (fd=1, fd=2)
-    if (fd == 1 || fd == 2) {
+    // console (stdout/stderr and anything dup'ed from them)
+    if (!file->node) {
         const char* str = (const char*)buf;
         for (size_t i = 0; i < count; i++) {
             terminal_putchar(str[i]);
@@ -146,16 +319,7 @@ size_t syscall_write(int fd, const void* buf, size_t count) {
         return count;
     }
     
-    if (!fd_table[fd].used) {
-        terminal_writestring("ERROR: Unused file descriptor\n");
-        return -1;
-    }
-    
-    fs_node_t* node = fd_table[fd].node;
-    if (!node) {
-        terminal_writestring("ERROR: Invalid file descriptor\n");
-        return -1;
-    }
+    fs_node_t* node = file->node;
     
 
     if (!(node->mask & FS_PERM_WRITE)) {
@@ -164,66 +328,15 @@ size_t syscall_write(int fd, const void* buf, size_t count) {
     }
     
 
-    uint32_t write_size = 0;
-    if (node->write) {
-        write_size = node->write(node, fd_table[fd].offset, count, (uint8_t*)buf);
-    } else {
-
-        uint32_t new_size = fd_table[fd].offset + count;
-        
-
-        if (new_size > node->length) {
-            uint8_t* new_contents = (uint8_t*)krealloc(node->contents, new_size);
-            if (!new_contents) {
-                terminal_writestring("ERROR: File could not be resized - insufficient memory\n");
-                return -1;
-            }
-            node->contents = new_contents;
-            
-
-            if (new_size > node->length) {
-                memset((uint8_t*)node->contents + node->length, 0, new_size - node->length);
-            }
-            
-            node->length = new_size;
-        }
-        
-
-        if (count > 0) {
-            memcpy((uint8_t*)node->contents + fd_table[fd].offset, buf, count);
-            write_size = count;
-        }
+    // pipes sleep for room, files grow
+    if (node->type == FS_PIPE) {
+        return pipe_write(file, buf, count);
     }
     
-
-    fd_table[fd].offset += write_size;
-    
-
-    extern uint32_t get_tick_count(void);
-    node->modified_time = get_tick_count();
-    
-    return write_size;
-}
-
-
-static int find_free_fd(void) {
-    for (int i = 3; i < MAX_FD; i++) {  
-        if (!fd_table[i].used) {
-            return i;
-        }
-    }
-    return -1;  
+    return file_write(file, buf, count);
 }
 
 
-#define O_RDONLY  0x0001
-#define O_WRONLY  0x0002
-#define O_RDWR    0x0003
-#define O_CREAT   0x0100
-#define O_TRUNC   0x0200
-#define O_APPEND  0x0400
-
-
 int syscall_open(const char* pathname, int flags) {
     if (!pathname) {
         return -1;
@@ -264,6 +377,11 @@ int syscall_open(const char* pathname, int flags) {
         terminal_writestring("\n");
     }
     
+    // named pipe: one of its two ends, possibly after waiting for the other
+    if (node->type == FS_PIPE) {
+        return pipe_open(node, (uint32_t)flags);
+    }
+    
     if (node->type != FS_FILE) {
         terminal_writestring("ERROR: Attempted to open a directory: ");
         terminal_writestring(pathname);
@@ -276,67 +394,84 @@ int syscall_open(const char* pathname, int flags) {
             node->truncate(node);
         } else {
             if (node->length > 0 && node->contents) {
+                uint32_t old_length = node->length;
+                
                 memset(node->contents, 0, node->length);
                 node->length = 0;
+                pagecache_update(node, 0, old_length);
             }
         }
     }
     
-    int fd = find_free_fd();
-    if (fd < 0) {
-        terminal_writestring("ERROR: Maximum number of open files reached\n");
+    file_t* file = file_alloc(node, (uint32_t)flags);
+    if (!file) {
+        terminal_writestring("ERROR: Not enough memory to open file\n");
         return -1;
     }
+    file->offset = (flags & O_APPEND) ? node->length : 0;
     
-    fd_table[fd].node = node;
-    fd_table[fd].offset = (flags & O_APPEND) ? node->length : 0;
-    fd_table[fd].used = 1;
-    
-    if (node->open) {
-        node->open(node);
+    int fd = fd_alloc(fdtable_current(), file);
+    if (fd < 0) {
+        kfree(file);
+        return -1;
     }
     
+    fs_open(node);
+    
     return fd;
 }
 
 
 int syscall_close(int fd) {
-    if (fd < 0 || fd >= MAX_FD) {
+    if (fd < 0) {
         terminal_writestring("ERROR: Invalid file descriptor\n");
         return -1;
     }
     
-    if (fd <= 2) {
+    if (fd <= FD_STDERR) {
         terminal_writestring("ERROR: Cannot close standard I/O descriptors\n");
         return -1;
     }
     
-    if (!fd_table[fd].used) {
+    // the node is closed when the last descriptor of the file goes away
+    if (fd_close(fdtable_current(), fd) != 0) {
         terminal_writestring("ERROR: Descriptor is already closed\n");
         return -1;
     }
     
-    fs_node_t* node = fd_table[fd].node;
-    if (node && node->close) {
-        node->close(node);
-    }
-    
-    fd_table[fd].node = NULL;
-    fd_table[fd].offset = 0;
-    fd_table[fd].used = 0;
-    
     return 0;
 }
 
 
+int syscall_dup(int oldfd) {
+    return fd_dup(fdtable_current(), oldfd);
+}
+
+
+int syscall_dup2(int oldfd, int newfd) {
+    return fd_dup2(fdtable_current(), oldfd, newfd);
+}
+
+
+// returns only when the program cannot be loaded
 int syscall_exec(const char* path, char* const argv[]) {
-    terminal_writestring("System call: exec()\n");
-    return -1;
+    return process_exec(path, argv);
 }
 
 
+// seconds since boot, there is no RTC driver yet
 uint32_t syscall_time(void) {
-    terminal_writestring("System call: time()\n");
+    return (uint32_t)div_u64_u32(clock_monotonic_ns(), NSEC_PER_SEC, NULL);
+}
+
+
+// monotonic nanoseconds since boot
+int syscall_clock_gettime(uint64_t* ns) {
+    if (!ns) {
+        return -1;
+    }
+    
+    *ns = clock_monotonic_ns();
     return 0;
 }
 
@@ -351,8 +486,8 @@ uint32_t syscall_getpid(void) {
 
 
 void syscall_sleep(uint32_t ms) {
-    terminal_writestring("System call: sleep()\n");
-    // TODO: Implement sleep
+    // a kill ends the sleep, syscall_dispatch then exits
+    ktimer_sleep_killable(ms_to_ticks(ms));
 }
 
 
@@ -365,3 +500,135 @@ void* syscall_malloc(size_t size) {
 void syscall_free(void* ptr) {
     terminal_writestring("System call: free()\n");
 }
+
+
+int syscall_nop(void) {
+    return 0;
+}
+
+
+int syscall_uring_setup(uint32_t entries, void** ring) {
+    return uring_setup(entries, (uring_t**)ring);
+}
+
+
+// one kernel entry for a whole batch of queued operations
+int syscall_uring_enter(int id, uint32_t to_submit, uint32_t min_complete) {
+    return uring_enter(id, to_submit, min_complete);
+}
+
+
+int syscall_uring_destroy(int id) {
+    return uring_destroy(id);
+}
+
+
+// only called once user space found the lock word contended
+int syscall_futex_wait(uint32_t* uaddr, uint32_t val) {
+    return futex_wait_user(uaddr, val);
+}
+
+
+int syscall_futex_wake(uint32_t* uaddr, uint32_t count) {
+    return futex_wake_user(uaddr, count);
+}
+
+
+int syscall_shm_get(const char* name, uint32_t size, uint32_t flags) {
+    return shm_get(name, size, flags);
+}
+
+
+void* syscall_shm_map(int id) {
+    return shm_map(id);
+}
+
+
+int syscall_shm_unmap(void* addr) {
+    return shm_unmap(addr);
+}
+
+
+int syscall_shm_remove(int id) {
+    return shm_remove(id);
+}
+
+
+// data already sits in the shared pages, only the wakeup goes through here
+uint32_t syscall_shm_notify(int id) {
+    return shm_notify(id);
+}
+
+
+int syscall_shm_wait(int id, uint32_t seen) {
+    return shm_wait(id, seen);
+}
+
+
+int syscall_pipe(int fds[2]) {
+    return pipe_create(fds);
+}
+
+
+int syscall_mkfifo(const char* path) {
+    return pipe_mkfifo(path);
+}
+
+
+// the bytes never pass through the caller
+int syscall_splice(int fd_in, int fd_out, uint32_t len, uint32_t flags) {
+    return pipe_splice(fd_in, fd_out, len, flags);
+}
+
+
+int syscall_tee(int fd_in, int fd_out, uint32_t len, uint32_t flags) {
+    return pipe_tee(fd_in, fd_out, len, flags);
+}
+
+
+int syscall_ipc_create(void) {
+    return ipc_endpoint_create();
+}
+
+
+int syscall_ipc_destroy(int id) {
+    return ipc_endpoint_destroy(id);
+}
+
+
+// the reply overwrites the message in place
+int syscall_ipc_call(int id, ipc_msg_t* msg) {
+    return ipc_call(id, msg);
+}
+
+
+int syscall_ipc_recv(int id, ipc_msg_t* msg) {
+    return ipc_recv(id, msg);
+}
+
+
+int syscall_ipc_reply(const ipc_msg_t* msg) {
+    return ipc_reply(msg);
+}
+
+
+// the server loop: answer and wait for the next call in one entry
+int syscall_ipc_reply_recv(int id, ipc_msg_t* msg) {
+    return ipc_reply_recv(id, msg);
+}
+
+
+int syscall_epoll_create(void) {
+    return epoll_create();
+}
+
+
+int syscall_epoll_ctl(int epfd, int op, int fd, const epoll_event_t* event) {
+    return epoll_ctl(epfd, op, fd, event);
+}
+
+
+// a negative timeout waits until something is ready
+int syscall_epoll_wait(int epfd, epoll_event_t* events, uint32_t max, int timeout_ms) {
+    return epoll_wait(epfd, events, max, timeout_ms);
+}
@@ -0,0 +1,121 @@
+#include <kernel/syscall_bench.h>
+#include <kernel/syscall.h>
+#include <kernel/process.h>
+#include <kernel/cpu/gdt.h>
+#include <kernel/sync/preempt.h>
+#include <kernel/timer/clocksource.h>
+#include <kernel/math64.h>
+#include <drivers/terminal.h>
+#include "mm/memory.h"
+
+// syscall_entry.asm
+extern uint64_t user_enter(uint32_t eip, uint32_t esp, uint32_t arg);
+
+// syscall_bench_user.asm
+extern uint8_t bench_user_start[], bench_user_end[];
+extern uint8_t bench_user_int80[], bench_user_vdso[];
+
+static bool bench_mapped = false;
+
+static int bench_map(void) {
+    page_directory_t* dir = get_kernel_directory();
+    phys_addr_t code_phys, stack_phys;
+
+    if (bench_mapped) {
+        return 0;
+    }
+
+    if (!dir) {
+        terminal_writestring("ERROR: Paging is not initialized\n");
+        return -1;
+    }
+
+    uint8_t* code = (uint8_t*)kmalloc_aligned_physical(PAGE_SIZE, &code_phys);
+    uint8_t* stack = (uint8_t*)kmalloc_aligned_physical(PAGE_SIZE, &stack_phys);
+    if (!code || !stack) {
+        terminal_writestring("ERROR: Not enough memory for the benchmark\n");
+        return -1;
+    }
+
+    memset(code, 0xCC, PAGE_SIZE);
+    memcpy(code, bench_user_start, bench_user_end - bench_user_start);
+    memset(stack, 0, PAGE_SIZE);
+
+    map_page_dir(dir, SYSCALL_BENCH_CODE_ADDR, code_phys, MEMORY_PRESENT | MEMORY_USER);
+    map_page_dir(dir, SYSCALL_BENCH_STACK_ADDR, stack_phys,
+                 MEMORY_PRESENT | MEMORY_READWRITE | MEMORY_USER);
+
+    bench_mapped = true;
+    return 0;
+}
+
+// user address of a label inside the copied loops
+static uint32_t bench_entry(const uint8_t* label) {
+    return SYSCALL_BENCH_CODE_ADDR + (uint32_t)(label - bench_user_start);
+}
+
+// user_enter points this CPU's TSS and return frame at our stack, so
+// the run must not move to another CPU or let another process in
+static uint64_t bench_loop(const uint8_t* label, uint32_t iterations) {
+    preempt_disable();
+    uint32_t saved_esp0 = tss_get_kernel_stack();
+    process_account_user_enter();
+    uint64_t cycles = user_enter(bench_entry(label),
+                                 SYSCALL_BENCH_STACK_ADDR + PAGE_SIZE, iterations);
+    process_account_user_exit();
+    syscall_set_kernel_stack(saved_esp0);
+    preempt_enable();
+    return cycles;
+}
+
+int syscall_bench_run(uint32_t iterations, syscall_bench_result_t* result) {
+    if (!result || iterations == 0) {
+        return -1;
+    }
+
+    if (bench_map() != 0) {
+        return -1;
+    }
+
+    // warm up caches and TLB before measuring
+    bench_loop(bench_user_int80, 16);
+    bench_loop(bench_user_vdso, 16);
+
+    result->iterations = iterations;
+    result->int80_cycles = bench_loop(bench_user_int80, iterations);
+    result->vdso_cycles = bench_loop(bench_user_vdso, iterations);
+    result->sysenter = syscall_sysenter_enabled();
+
+    return 0;
+}
+
+static void print_line(const char* name, uint64_t total, uint32_t iterations) {
+    uint32_t per_call = (uint32_t)div_u64_u32(total, iterations, NULL);
+    uint32_t ns = (uint32_t)div_u64_u32(clocksource_cycles_to_ns(total), iterations, NULL);
+
+    terminal_writestring(name);
+    terminal_print_int(per_call);
+    terminal_writestring(" cycles/call");
+    if (clocksource_type() == CLOCKSOURCE_TSC) {
+        terminal_writestring(", ");
+        terminal_print_int(ns);
+        terminal_writestring(" ns/call");
+    }
+    terminal_writestring("\n");
+}
+
+void syscall_bench(uint32_t iterations) {
+    syscall_bench_result_t result;
+
+    terminal_writestring("Null system call, ");
+    terminal_print_int(iterations);
+    terminal_writestring(" iterations from ring 3\n");
+
+    if (syscall_bench_run(iterations, &result) != 0) {
+        return;
+    }
+
+    print_line("  int 0x80: ", result.int80_cycles, result.iterations);
+    print_line(result.sysenter ? "  sysenter: " : "  vdso (int 0x80): ",
+               result.vdso_cycles, result.iterations);
+}
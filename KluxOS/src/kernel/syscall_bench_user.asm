@@ -0,0 +1,56 @@
+; Ring-3 side of the null system call benchmark
+;
+; The code between bench_user_start and bench_user_end is copied to a
+; user page and entered through user_enter with the iteration count in
+; esi. Each loop reports its TSC delta back with SYS_USER_RETURN.
+
+[bits 32]
+
+; must match kernel/syscall.h and kernel/timer/vdso.h
+%define SYS_NOP          14
+%define SYS_USER_RETURN  31
+%define VDSO_TEXT_ADDR   0xBFFFF000
+
+global bench_user_start
+global bench_user_end
+global bench_user_int80
+global bench_user_vdso
+
+section .text
+
+bench_user_start:
+
+; null calls through int 0x80
+bench_user_int80:
+    rdtsc
+    push edx
+    push eax
+.loop:
+    mov eax, SYS_NOP
+    int 0x80
+    dec esi
+    jnz .loop
+    jmp bench_user_done
+
+; null calls through the vDSO entry (sysenter when available)
+bench_user_vdso:
+    mov edi, VDSO_TEXT_ADDR
+    rdtsc
+    push edx
+    push eax
+.loop:
+    mov eax, SYS_NOP
+    call edi
+    dec esi
+    jnz .loop
+
+bench_user_done:
+    rdtsc
+    sub eax, [esp]
+    sbb edx, [esp + 4]
+    mov ebx, eax
+    mov ecx, edx
+    mov eax, SYS_USER_RETURN
+    int 0x80
+
+bench_user_end:
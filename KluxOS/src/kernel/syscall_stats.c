@@ -0,0 +1,257 @@
+#include <kernel/syscall_stats.h>
+#include <kernel/process.h>
+#include <kernel/sync/spinlock.h>
+#include <kernel/math64.h>
+#include <kernel/timer/clocksource.h>
+#include <drivers/terminal.h>
+#include "mm/memory.h"
+
+static syscall_stat_t stats[SYSCALL_MAX];
+static uint32_t invalid_calls = 0;
+
+static syscall_event_t trace_ring[SYSCALL_TRACE_SIZE];
+static uint32_t trace_head = 0;      // events written
+static uint32_t trace_tail = 0;      // events read
+static bool trace_on = false;
+
+// the counters and the ring are shared by every CPU
+static lock_class_t stats_class = LOCK_CLASS_INIT("syscall stats");
+static spinlock_t stats_lock = SPINLOCK_INIT_CLASS(&stats_class);
+
+void syscall_stats_init(void) {
+    syscall_stats_reset();
+    trace_on = false;
+    trace_head = 0;
+    trace_tail = 0;
+}
+
+static uint32_t hist_bucket(uint64_t cycles) {
+    if (cycles >> 32) {
+        return SYSCALL_HIST_BUCKETS - 1;
+    }
+    if (cycles == 0) {
+        return 0;
+    }
+    return fls32((uint32_t)cycles);
+}
+
+void syscall_stats_record(uint32_t nr, const uint32_t* args, uint32_t ret,
+                          uint64_t start, uint64_t cycles) {
+    syscall_stat_t* stat = &stats[nr];
+    uint32_t short_cycles = (cycles >> 32) ? 0xFFFFFFFF : (uint32_t)cycles;
+    bool failed = (ret == (uint32_t)-1);
+    process_t* current = process_get_current();
+
+    // per-process totals are only touched by their own process
+    if (current) {
+        current->syscalls++;
+        current->syscall_cycles += cycles;
+        if (failed) {
+            current->syscall_errors++;
+        }
+    }
+
+    // calls may nest through interrupts and run on several CPUs at once
+    uint32_t flags = spin_lock_irqsave(&stats_lock);
+
+    stat->calls++;
+    stat->cycles += cycles;
+    stat->hist[hist_bucket(cycles)]++;
+    if (short_cycles > stat->max_cycles) {
+        stat->max_cycles = short_cycles;
+    }
+    if (failed) {
+        stat->errors++;
+    }
+
+    if (trace_on) {
+        syscall_event_t* event = &trace_ring[trace_head & (SYSCALL_TRACE_SIZE - 1)];
+        event->tsc = start;
+        event->pid = current ? current->pid : 0;
+        event->nr = nr;
+        for (int i = 0; i < 6; i++) {
+            event->args[i] = args[i];
+        }
+        event->ret = ret;
+        event->cycles = short_cycles;
+        trace_head++;
+    }
+
+    spin_unlock_irqrestore(&stats_lock, flags);
+}
+
+void syscall_stats_invalid(void) {
+    uint32_t flags = spin_lock_irqsave(&stats_lock);
+    invalid_calls++;
+    spin_unlock_irqrestore(&stats_lock, flags);
+}
+
+const syscall_stat_t* syscall_stats_get(uint32_t nr) {
+    return nr < SYSCALL_MAX ? &stats[nr] : NULL;
+}
+
+uint32_t syscall_stats_invalid_count(void) {
+    return invalid_calls;
+}
+
+void syscall_stats_reset(void) {
+    uint32_t flags = spin_lock_irqsave(&stats_lock);
+    memset(stats, 0, sizeof(stats));
+    invalid_calls = 0;
+    spin_unlock_irqrestore(&stats_lock, flags);
+}
+
+void syscall_trace_enable(bool enable) {
+    uint32_t flags = spin_lock_irqsave(&stats_lock);
+    if (enable && !trace_on) {
+        trace_head = 0;
+        trace_tail = 0;
+    }
+    trace_on = enable;
+    spin_unlock_irqrestore(&stats_lock, flags);
+}
+
+bool syscall_trace_enabled(void) {
+    return trace_on;
+}
+
+uint32_t syscall_trace_read(syscall_event_t* events, uint32_t max, uint32_t* lost) {
+    uint32_t copied = 0;
+    uint32_t flags = spin_lock_irqsave(&stats_lock);
+
+    uint32_t pending = trace_head - trace_tail;
+    uint32_t dropped = 0;
+    if (pending > SYSCALL_TRACE_SIZE) {
+        dropped = pending - SYSCALL_TRACE_SIZE;
+        trace_tail = trace_head - SYSCALL_TRACE_SIZE;
+    }
+
+    while (copied < max && trace_tail != trace_head) {
+        events[copied++] = trace_ring[trace_tail & (SYSCALL_TRACE_SIZE - 1)];
+        trace_tail++;
+    }
+
+    spin_unlock_irqrestore(&stats_lock, flags);
+
+    if (lost) {
+        *lost = dropped;
+    }
+    return copied;
+}
+
+// ========= output =========
+
+static void print_padded(const char* s, int width) {
+    int len = 0;
+    terminal_writestring(s);
+    while (s[len]) {
+        len++;
+    }
+    for (; len < width; len++) {
+        terminal_putchar(' ');
+    }
+}
+
+void syscall_stats_dump(void) {
+    terminal_writestring("NR  NAME            CALLS     ERRORS    AVG CYC   MAX CYC\n");
+
+    for (uint32_t nr = 0; nr < SYSCALL_MAX; nr++) {
+        const syscall_stat_t* stat = &stats[nr];
+        if (stat->calls == 0) {
+            continue;
+        }
+
+        uint32_t avg = (uint32_t)div_u64_u32(stat->cycles, stat->calls, NULL);
+
+        terminal_print_int(nr);
+        terminal_writestring(nr < 10 ? "   " : "  ");
+        print_padded(syscall_name(nr), 16);
+        terminal_print_int(stat->calls);
+        terminal_writestring("  ");
+        terminal_print_int(stat->errors);
+        terminal_writestring("  ");
+        terminal_print_int(avg);
+        terminal_writestring("  ");
+        terminal_print_int(stat->max_cycles);
+        terminal_writestring("\n");
+    }
+
+    if (invalid_calls) {
+        terminal_writestring("invalid calls: ");
+        terminal_print_int(invalid_calls);
+        terminal_writestring("\n");
+    }
+}
+
+void syscall_stats_dump_hist(uint32_t nr) {
+    const syscall_stat_t* stat = syscall_stats_get(nr);
+    uint32_t peak = 0;
+
+    if (!stat || stat->calls == 0) {
+        terminal_writestring("No calls recorded\n");
+        return;
+    }
+
+    for (int i = 0; i < SYSCALL_HIST_BUCKETS; i++) {
+        if (stat->hist[i] > peak) {
+            peak = stat->hist[i];
+        }
+    }
+
+    terminal_writestring(syscall_name(nr));
+    terminal_writestring(" latency (cycles):\n");
+
+    for (int i = 0; i < SYSCALL_HIST_BUCKETS; i++) {
+        if (stat->hist[i] == 0) {
+            continue;
+        }
+
+        terminal_writestring("  >= 2^");
+        terminal_print_int(i);
+        terminal_writestring(i < 10 ? "  " : " ");
+
+        uint32_t bar = (uint32_t)div_u64_u32((uint64_t)stat->hist[i] * 40, peak, NULL);
+        for (uint32_t j = 0; j < 40; j++) {
+            terminal_putchar(j < bar ? '#' : ' ');
+        }
+        terminal_writestring(" ");
+        terminal_print_int(stat->hist[i]);
+        terminal_writestring("\n");
+    }
+}
+
+void syscall_trace_dump(void) {
+    syscall_event_t event;
+    uint32_t lost = 0;
+    uint32_t shown = 0;
+
+    while (syscall_trace_read(&event, 1, shown ? NULL : &lost) == 1) {
+        if (shown == 0 && lost) {
+            terminal_writestring("(");
+            terminal_print_int(lost);
+            terminal_writestring(" events lost)\n");
+        }
+
+        terminal_writestring("pid ");
+        terminal_print_int(event.pid);
+        terminal_writestring(" ");
+        terminal_writestring(syscall_name(event.nr));
+        terminal_writestring("(");
+        for (int i = 0; i < 6; i++) {
+            if (i) {
+                terminal_writestring(", ");
+            }
+            terminal_print_hex(event.args[i]);
+        }
+        terminal_writestring(") = ");
+        terminal_print_hex(event.ret);
+        terminal_writestring(", ");
+        terminal_print_int(event.cycles);
+        terminal_writestring(" cycles\n");
+        shown++;
+    }
+
+    if (shown == 0) {
+        terminal_writestring("No events\n");
+    }
+}
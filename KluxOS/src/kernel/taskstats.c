@@ -0,0 +1,236 @@
+#include <kernel/taskstats.h>
+#include <kernel/process.h>
+#include <kernel/sync/rwlock.h>
+#include <kernel/cpu/percpu.h>
+#include <kernel/timer/clocksource.h>
+#include <kernel/timer/pit.h>
+#include <kernel/math64.h>
+#include <drivers/terminal.h>
+
+// two samples for top, 'cur' is the newest
+static task_usage_t samples[2][TASKSTATS_MAX];
+static uint32_t sample_count[2];
+static uint64_t sample_ns[2];
+static uint64_t idle_ns[2][MAX_CPUS];
+static int cur = 0;
+
+static void copy_usage(task_usage_t* out, process_t* process) {
+    int i;
+
+    out->pid = process->pid;
+    for (i = 0; process->name[i] && i < 31; i++) {
+        out->name[i] = process->name[i];
+    }
+    out->name[i] = '\0';
+    out->state = process->state;
+    out->cpu = process->cpu;
+    out->nvcsw = process->nvcsw;
+    out->nivcsw = process->nivcsw;
+    out->page_faults = process->page_faults;
+    out->syscalls = process->syscalls;
+    process_cputime(process, &out->runtime_ns, &out->user_ns);
+}
+
+uint32_t taskstats_snapshot(task_usage_t* out, uint32_t max) {
+    uint32_t count = 0;
+    list_node_t* node;
+
+    uint32_t flags = read_lock_irqsave(&tasklist_lock);
+
+    list_for_each(node, &task_list) {
+        if (count == max) {
+            break;
+        }
+        copy_usage(&out[count++], list_entry(node, process_t, task_node));
+    }
+
+    read_unlock_irqrestore(&tasklist_lock, flags);
+    return count;
+}
+
+// ========= output =========
+
+static void print_padded(const char* s, int width) {
+    int len = 0;
+    terminal_writestring(s);
+    while (s[len]) {
+        len++;
+    }
+    for (; len < width; len++) {
+        terminal_putchar(' ');
+    }
+}
+
+// right-aligned unsigned number
+static void print_num(uint32_t value, int width) {
+    int digits = 1;
+    for (uint32_t v = value; v >= 10; v /= 10) {
+        digits++;
+    }
+    for (; digits < width; digits++) {
+        terminal_putchar(' ');
+    }
+    terminal_print_uint(value);
+}
+
+static uint32_t ns_to_ms(uint64_t ns) {
+    uint64_t ms = div_u64_u32(ns, NSEC_PER_MSEC, NULL);
+    return (ms >> 32) ? 0xFFFFFFFF : (uint32_t)ms;
+}
+
+static const char* state_name(process_state_t state) {
+    switch (state) {
+        case PROCESS_READY: return "HAZIR";
+        case PROCESS_RUNNING: return "CALISMA";
+        case PROCESS_BLOCKED: return "BLOKE";
+        case PROCESS_TERMINATED: return "SONLANDI";
+        default: return "BILINMIYOR";
+    }
+}
+
+// tenths of a percent as "12.3"
+static void print_permille(uint32_t permille, int width) {
+    print_num(permille / 10, width - 2);
+    terminal_putchar('.');
+    terminal_print_uint(permille % 10);
+}
+
+void taskstats_dump(void) {
+    uint32_t count = taskstats_snapshot(samples[cur], TASKSTATS_MAX);
+
+    terminal_writestring("  PID  STATE     CPU   TIME MS   USER MS    VCSW   IVCSW  FAULTS  SYSCALLS  NAME\n");
+
+    for (uint32_t i = 0; i < count; i++) {
+        const task_usage_t* task = &samples[cur][i];
+
+        print_num(task->pid, 5);
+        terminal_writestring("  ");
+        print_padded(state_name(task->state), 8);
+        print_num(task->cpu, 4);
+        print_num(ns_to_ms(task->runtime_ns), 10);
+        print_num(ns_to_ms(task->user_ns), 10);
+        print_num(task->nvcsw, 8);
+        print_num(task->nivcsw, 8);
+        print_num(task->page_faults, 8);
+        print_num(task->syscalls, 10);
+        terminal_writestring("  ");
+        terminal_writestring(task->name);
+        terminal_writestring("\n");
+    }
+
+    if (count == 0) {
+        terminal_writestring("Aktif islem bulunamadi.\n");
+    }
+}
+
+static void take_sample(int slot) {
+    sample_count[slot] = taskstats_snapshot(samples[slot], TASKSTATS_MAX);
+    sample_ns[slot] = clock_monotonic_ns();
+
+    for (uint32_t i = 0; i < cpu_count(); i++) {
+        uint64_t user;
+        idle_ns[slot][i] = 0;
+        if (cpus[i].online && cpus[i].idle) {
+            process_cputime(cpus[i].idle, &idle_ns[slot][i], &user);
+        }
+    }
+}
+
+void taskstats_top_begin(void) {
+    cur = 0;
+    take_sample(cur);
+}
+
+// runtime of the same process in the older sample, 0 if it is new
+static uint64_t previous_runtime(int slot, const task_usage_t* task) {
+    for (uint32_t i = 0; i < sample_count[slot]; i++) {
+        const task_usage_t* old = &samples[slot][i];
+
+        // a recycled PID has less runtime than the process it replaced
+        if (old->pid == task->pid && old->runtime_ns <= task->runtime_ns) {
+            return old->runtime_ns;
+        }
+    }
+    return 0;
+}
+
+void taskstats_top_frame(void) {
+    int prev = cur;
+    cur ^= 1;
+    take_sample(cur);
+
+    // share = delta ns / interval ns, in tenths of a percent
+    uint64_t interval = sample_ns[cur] - sample_ns[prev];
+    uint32_t interval_us = (uint32_t)div_u64_u32(interval, NSEC_PER_USEC, NULL);
+    if (interval_us == 0) {
+        interval_us = 1;
+    }
+
+    uint32_t count = sample_count[cur];
+    uint32_t share[TASKSTATS_MAX];
+    uint32_t order[TASKSTATS_MAX];
+
+    for (uint32_t i = 0; i < count; i++) {
+        const task_usage_t* task = &samples[cur][i];
+        uint64_t delta = task->runtime_ns - previous_runtime(prev, task);
+        uint64_t permille = div_u64_u32(delta, interval_us, NULL);
+
+        share[i] = permille > 1000 ? 1000 : (uint32_t)permille;
+
+        // insertion sort, busiest first
+        uint32_t j = i;
+        while (j > 0 && share[order[j - 1]] < share[i]) {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = i;
+    }
+
+    terminal_clear();
+
+    terminal_writestring("top - up ");
+    terminal_print_uint((uint32_t)div_u64_u32(get_uptime_ms(), 1000, NULL));
+    terminal_writestring("s, ");
+    terminal_print_uint(count);
+    terminal_writestring(" tasks, busy:");
+
+    for (uint32_t i = 0; i < cpu_count(); i++) {
+        if (!cpus[i].online) {
+            continue;
+        }
+        uint64_t idle = div_u64_u32(idle_ns[cur][i] - idle_ns[prev][i], interval_us, NULL);
+        uint32_t busy = idle >= 1000 ? 0 : 1000 - (uint32_t)idle;
+
+        terminal_writestring(" cpu");
+        terminal_print_uint(i);
+        terminal_writestring(" ");
+        print_permille(busy, 1);
+        terminal_writestring("%");
+    }
+    terminal_writestring("\n\n");
+
+    terminal_writestring("  PID  STATE     CPU   %CPU   TIME MS   USER MS    VCSW   IVCSW  FAULTS  NAME\n");
+
+    // header, blank line, column titles and the hint line
+    uint32_t rows = terminal_get_height() > 5 ? terminal_get_height() - 5 : 1;
+
+    for (uint32_t n = 0; n < count && n < rows; n++) {
+        const task_usage_t* task = &samples[cur][order[n]];
+
+        print_num(task->pid, 5);
+        terminal_writestring("  ");
+        print_padded(state_name(task->state), 8);
+        print_num(task->cpu, 4);
+        print_permille(share[order[n]], 7);
+        print_num(ns_to_ms(task->runtime_ns), 10);
+        print_num(ns_to_ms(task->user_ns), 10);
+        print_num(task->nvcsw, 8);
+        print_num(task->nivcsw, 8);
+        print_num(task->page_faults, 8);
+        terminal_writestring("  ");
+        terminal_writestring(task->name);
+        terminal_writestring("\n");
+    }
+
+    terminal_writestring("\nPress any key to quit\n");
+}
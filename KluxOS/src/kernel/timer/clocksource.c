@@ -0,0 +1,172 @@
+#include <kernel/timer/clocksource.h>
+#include <kernel/timer/vdso.h>
+#include <kernel/timer/pit.h>
+#include <kernel/cpu/cpu.h>
+#include <kernel/math64.h>
+#include <kernel/irqflags.h>
+#include <kernel/io.h>
+#include <drivers/terminal.h>
+
+// PC speaker / PIT channel 2 gate control (keyboard controller port B)
+#define PIT_GATE_PORT       0x61
+#define PIT_GATE_ENABLE     0x01    // channel 2 gate input
+#define PIT_GATE_SPEAKER    0x02    // speaker data, kept off
+#define PIT_GATE_OUT2       0x20    // channel 2 output state
+
+// lives in the vDSO page so user space can read it directly
+static clock_data_t* clock_data = NULL;
+
+// exact tick length: tick_ns_step ns plus tick_ns_rem/tick_hz ns
+static uint32_t tick_ns_step = 0;
+static uint32_t tick_ns_rem = 0;
+static uint32_t tick_ns_acc = 0;
+
+// count TSC cycles over one PIT channel 2 one-shot countdown
+static uint64_t calibrate_window(uint32_t latch) {
+    uint8_t gate = inb(PIT_GATE_PORT);
+    outb(PIT_GATE_PORT, (gate & ~PIT_GATE_SPEAKER) | PIT_GATE_ENABLE);
+
+    // channel 2, lobyte/hibyte, mode 0 (interrupt on terminal count)
+    outb(PIT_COMMAND, PIT_CHANNEL2_SELECT | PIT_BOTH | PIT_MODE0 | PIT_BINARY);
+    outb(PIT_CHANNEL2, latch & 0xFF);
+    outb(PIT_CHANNEL2, (latch >> 8) & 0xFF);
+
+    uint64_t start = rdtsc();
+    while (!(inb(PIT_GATE_PORT) & PIT_GATE_OUT2)) {
+    }
+    uint64_t end = rdtsc();
+
+    outb(PIT_GATE_PORT, gate);
+    return end - start;
+}
+
+static uint32_t calibrate_tsc_khz(void) {
+    uint32_t latch = PIT_FREQUENCY / 1000 * CLOCKSOURCE_CALIBRATE_MS;
+    uint64_t best = 0;
+
+    // the shortest window is the one least disturbed by SMIs or the host
+    uint32_t flags = irq_save();
+    for (int i = 0; i < CLOCKSOURCE_CALIBRATE_RUNS; i++) {
+        uint64_t cycles = calibrate_window(latch);
+        if (best == 0 || cycles < best) {
+            best = cycles;
+        }
+    }
+    irq_restore(flags);
+
+    // khz = cycles / (latch / PIT_FREQUENCY seconds) / 1000
+    return (uint32_t)div_u64_u32(best * PIT_FREQUENCY, latch * 1000, NULL);
+}
+
+// pick the largest shift for which mult still fits in 32 bits
+static void calc_mult_shift(uint32_t khz, uint32_t* mult, uint32_t* shift) {
+    for (uint32_t s = 32; s > 0; s--) {
+        uint64_t m = div_u64_u32((uint64_t)NSEC_PER_MSEC << s, khz, NULL);
+        if ((m >> 32) == 0) {
+            *mult = (uint32_t)m;
+            *shift = s;
+            return;
+        }
+    }
+
+    *mult = NSEC_PER_MSEC / khz;
+    *shift = 0;
+}
+
+void clocksource_init(uint32_t tick_hz) {
+    terminal_writestring("Initializing clocksource...\n");
+
+    clock_data = &vdso_init()->clock;
+    clock_data->seq.sequence = 0;
+    clock_data->type = CLOCKSOURCE_TICK;
+    clock_data->ticks = 0;
+    clock_data->tick_hz = tick_hz;
+    clock_data->tick_ns = 0;
+    clock_data->base_ns = 0;
+
+    tick_ns_step = NSEC_PER_SEC / tick_hz;
+    tick_ns_rem = NSEC_PER_SEC % tick_hz;
+    tick_ns_acc = 0;
+
+    if (!(cpuid_edx(1) & CPUID_EDX_TSC)) {
+        terminal_writestring("  No TSC, using PIT ticks\n");
+        return;
+    }
+
+    uint32_t khz = calibrate_tsc_khz();
+    if (khz == 0) {
+        terminal_writestring("  TSC calibration failed, using PIT ticks\n");
+        return;
+    }
+
+    calc_mult_shift(khz, &clock_data->mult, &clock_data->shift);
+    clock_data->tsc_khz = khz;
+    clock_data->base_cycles = rdtsc();
+    clock_data->type = CLOCKSOURCE_TSC;
+
+    terminal_writestring("  TSC: ");
+    terminal_print_int(khz / 1000);
+    terminal_writestring(" MHz");
+    if (cpuid_max_extended() >= 0x80000007 &&
+        (cpuid_edx(0x80000007) & CPUID_EDX_INVARIANT_TSC)) {
+        terminal_writestring(" (invariant)");
+    }
+    terminal_writestring("\n");
+
+    terminal_writestring("Clocksource initialized.\n");
+}
+
+void clocksource_tick(void) {
+    write_seqbegin(&clock_data->seq);
+
+    clock_data->ticks++;
+    clock_data->tick_ns += tick_ns_step;
+    tick_ns_acc += tick_ns_rem;
+    if (tick_ns_acc >= clock_data->tick_hz) {
+        tick_ns_acc -= clock_data->tick_hz;
+        clock_data->tick_ns++;
+    }
+
+    write_seqend(&clock_data->seq);
+}
+
+uint64_t clock_monotonic_ns(void) {
+    uint32_t seq;
+    uint64_t ns;
+
+    if (!clock_data) {
+        return 0;
+    }
+
+    do {
+        seq = read_seqbegin(&clock_data->seq);
+
+        if (clock_data->type == CLOCKSOURCE_TSC) {
+            ns = clock_data->base_ns +
+                 mul_u64_u32_shr(rdtsc() - clock_data->base_cycles,
+                                 clock_data->mult, clock_data->shift);
+        } else {
+            ns = clock_data->tick_ns;
+        }
+    } while (read_seqretry(&clock_data->seq, seq));
+
+    return ns;
+}
+
+uint64_t clocksource_cycles_to_ns(uint64_t cycles) {
+    if (!clock_data || clock_data->type != CLOCKSOURCE_TSC) {
+        return 0;
+    }
+    return mul_u64_u32_shr(cycles, clock_data->mult, clock_data->shift);
+}
+
+clocksource_type_t clocksource_type(void) {
+    if (!clock_data) {
+        return CLOCKSOURCE_TICK;
+    }
+    return (clocksource_type_t)clock_data->type;
+}
+
+uint32_t clocksource_tsc_khz(void) {
+    return clock_data ? clock_data->tsc_khz : 0;
+}
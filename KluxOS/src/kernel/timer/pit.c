@@ -1,5 +1,9 @@
-#include "pit.h"
+#include <kernel/timer/pit.h>
+#include <kernel/timer/timer.h>
+#include <kernel/timer/clocksource.h>
+#include <kernel/math64.h>
 #include <kernel/interrupt/idt.h>
+#include <kernel/softirq.h>
 #include <kernel/io.h>
 #include <drivers/terminal.h>
 #include <compat.h>
@@ -11,15 +15,35 @@ static timer_info_t timer = {
     .uptime_ms = 0
 };
 
-static timer_callback_t timer_callback = NULL;
+// leftover of 1000 / frequency, so uptime_ms does not drift when
+// the frequency does not divide 1000
+static uint32_t ms_remainder = 0;
+static uint32_t ms_accumulator = 0;
+
+static timer_callback_t timer_callbacks[MAX_TIMER_CALLBACKS];
+static uint32_t timer_callback_count = 0;
 
 static void pit_handler(uint32_t error_code) {
     timer.ticks++;
     
     timer.uptime_ms += timer.ms_per_tick;
+    ms_accumulator += ms_remainder;
+    if (ms_accumulator >= timer.frequency) {
+        ms_accumulator -= timer.frequency;
+        timer.uptime_ms++;
+    }
     
-    if (timer_callback != NULL) {
-        timer_callback();
+    clocksource_tick();
+    
+    raise_softirq(SOFTIRQ_TIMER);
+}
+
+// bottom half: expire timers and run tick callbacks with interrupts on
+static void pit_softirq(void) {
+    timer_wheel_run(timer.ticks);
+    
+    for (uint32_t i = 0; i < timer_callback_count; i++) {
+        timer_callbacks[i]();
     }
 }
 
@@ -31,6 +55,8 @@ void pit_init(uint32_t frequency) {
     
     timer.frequency = frequency;
     timer.ms_per_tick = 1000 / frequency;
+    ms_remainder = 1000 % frequency;
+    ms_accumulator = 0;
     
     uint32_t divisor = PIT_FREQUENCY / frequency;
     
@@ -40,6 +66,10 @@ void pit_init(uint32_t frequency) {
     io_wait();
     outb(PIT_CHANNEL0, (divisor >> 8) & 0xFF);
     
+    clocksource_init(frequency);
+    timer_wheel_init(timer.ticks);
+    
+    open_softirq(SOFTIRQ_TIMER, pit_softirq);
     register_interrupt_handler(IRQ0, pit_handler);
     
     terminal_writestring("  Frequency: ");
@@ -57,21 +87,27 @@ uint32_t get_ticks(void) {
 }
 
 uint64_t get_uptime_ms(void) {
-    return timer.uptime_ms;
+    return div_u64_u32(clock_monotonic_ns(), NSEC_PER_MSEC, NULL);
+}
+
+uint32_t ms_to_ticks(uint32_t ms) {
+    // round up so a sleep never ends early; split to stay in 32 bits
+    return (ms / 1000) * timer.frequency +
+           ((ms % 1000) * timer.frequency + 999) / 1000;
 }
 
 void sleep_ms(uint32_t ms) {
-    uint32_t start = get_ticks();
-    uint32_t ticks_to_wait = (ms + timer.ms_per_tick - 1) / timer.ms_per_tick;
-    uint32_t end = start + ticks_to_wait;
-    
-    while (get_ticks() < end) {
-        ASM_INLINE("hlt");
-    }
+    ktimer_sleep(ms_to_ticks(ms));
 }
 
-void register_timer_callback(timer_callback_t callback) {
-    timer_callback = callback;
+int register_timer_callback(timer_callback_t callback) {
+    if (timer_callback_count >= MAX_TIMER_CALLBACKS) {
+        terminal_writestring("ERROR: Too many timer callbacks\n");
+        return -1;
+    }
+    
+    timer_callbacks[timer_callback_count++] = callback;
+    return 0;
 }
 
 timer_info_t* get_timer_info(void) {
@@ -0,0 +1,210 @@
+#include <kernel/timer/timer.h>
+#include <kernel/timer/pit.h>
+#include <kernel/sync/wait.h>
+#include <kernel/irqflags.h>
+#include <kernel/sync/spinlock.h>
+
+#define ROOT_MASK   (TIMER_WHEEL_ROOT_SIZE - 1)
+#define LEVEL_MASK  (TIMER_WHEEL_LEVEL_SIZE - 1)
+
+// slot index of level n (0-based above the root) for the given tick
+#define LEVEL_INDEX(tick, n) \
+    (((tick) >> (TIMER_WHEEL_ROOT_BITS + (n) * TIMER_WHEEL_LEVEL_BITS)) & LEVEL_MASK)
+
+static list_node_t wheel_root[TIMER_WHEEL_ROOT_SIZE];
+static list_node_t wheel_levels[TIMER_WHEEL_LEVELS][TIMER_WHEEL_LEVEL_SIZE];
+
+static uint32_t wheel_tick = 0;      // next tick to be processed
+static uint32_t active_timers = 0;
+
+// the wheel is run by the boot CPU, timers are armed from any CPU
+static spinlock_t wheel_lock = SPINLOCK_INIT;
+
+// processes sleeping in ktimer_sleep
+static wait_queue_t sleep_queue;
+
+void timer_wheel_init(uint32_t now) {
+    for (int i = 0; i < TIMER_WHEEL_ROOT_SIZE; i++) {
+        list_init(&wheel_root[i]);
+    }
+
+    for (int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        for (int i = 0; i < TIMER_WHEEL_LEVEL_SIZE; i++) {
+            list_init(&wheel_levels[level][i]);
+        }
+    }
+
+    wheel_tick = now;
+    active_timers = 0;
+    wait_queue_init(&sleep_queue);
+}
+
+// pick the slot for the timer relative to wheel_tick; caller holds wheel_lock
+static void wheel_enqueue(ktimer_t* timer) {
+    uint32_t expires = timer->expires;
+    uint32_t delta = expires - wheel_tick;
+    list_node_t* slot;
+
+    if ((int32_t)delta < 0) {
+        // already due, run on the next tick
+        slot = &wheel_root[wheel_tick & ROOT_MASK];
+    } else if (delta < (1u << TIMER_WHEEL_ROOT_BITS)) {
+        slot = &wheel_root[expires & ROOT_MASK];
+    } else if (delta < (1u << (TIMER_WHEEL_ROOT_BITS + TIMER_WHEEL_LEVEL_BITS))) {
+        slot = &wheel_levels[0][LEVEL_INDEX(expires, 0)];
+    } else if (delta < (1u << (TIMER_WHEEL_ROOT_BITS + 2 * TIMER_WHEEL_LEVEL_BITS))) {
+        slot = &wheel_levels[1][LEVEL_INDEX(expires, 1)];
+    } else if (delta < (1u << (TIMER_WHEEL_ROOT_BITS + 3 * TIMER_WHEEL_LEVEL_BITS))) {
+        slot = &wheel_levels[2][LEVEL_INDEX(expires, 2)];
+    } else {
+        slot = &wheel_levels[3][LEVEL_INDEX(expires, 3)];
+    }
+
+    list_add_tail(slot, &timer->node);
+}
+
+// move every timer of one upper-level slot down the wheel
+static uint32_t cascade(int level, uint32_t index) {
+    list_node_t work;
+    list_init(&work);
+    list_splice_tail_init(&wheel_levels[level][index], &work);
+
+    while (!list_empty(&work)) {
+        ktimer_t* timer = list_entry(work.next, ktimer_t, node);
+        list_del(&timer->node);
+        wheel_enqueue(timer);
+    }
+
+    return index;
+}
+
+void timer_wheel_run(uint32_t now) {
+    uint32_t flags = spin_lock_irqsave(&wheel_lock);
+
+    while ((int32_t)(now - wheel_tick) >= 0) {
+        uint32_t index = wheel_tick & ROOT_MASK;
+        list_node_t work;
+
+        // the root wrapped: pull the next slot of each level down
+        if (!index &&
+            !cascade(0, LEVEL_INDEX(wheel_tick, 0)) &&
+            !cascade(1, LEVEL_INDEX(wheel_tick, 1)) &&
+            !cascade(2, LEVEL_INDEX(wheel_tick, 2))) {
+            cascade(3, LEVEL_INDEX(wheel_tick, 3));
+        }
+
+        wheel_tick++;
+
+        list_init(&work);
+        list_splice_tail_init(&wheel_root[index], &work);
+
+        // the callback may re-arm or cancel timers, so take one at a time
+        while (!list_empty(&work)) {
+            ktimer_t* timer = list_entry(work.next, ktimer_t, node);
+
+            list_del(&timer->node);
+            timer->pending = 0;
+            active_timers--;
+
+            // from the timer softirq interrupts stay open during callbacks
+            spin_unlock_irqrestore(&wheel_lock, flags);
+            timer->func(timer->data);
+            flags = spin_lock_irqsave(&wheel_lock);
+        }
+    }
+
+    spin_unlock_irqrestore(&wheel_lock, flags);
+}
+
+uint32_t timer_wheel_active(void) {
+    return active_timers;
+}
+
+void ktimer_init(ktimer_t* timer, ktimer_func_t func, void* data) {
+    list_init(&timer->node);
+    timer->expires = 0;
+    timer->func = func;
+    timer->data = data;
+    timer->pending = 0;
+}
+
+void ktimer_add(ktimer_t* timer, uint32_t expires) {
+    uint32_t flags = spin_lock_irqsave(&wheel_lock);
+
+    if (timer->pending) {
+        list_del(&timer->node);
+    } else {
+        timer->pending = 1;
+        active_timers++;
+    }
+
+    timer->expires = expires;
+    wheel_enqueue(timer);
+
+    spin_unlock_irqrestore(&wheel_lock, flags);
+}
+
+void ktimer_mod(ktimer_t* timer, uint32_t expires) {
+    ktimer_add(timer, expires);
+}
+
+int ktimer_cancel(ktimer_t* timer) {
+    uint32_t flags = spin_lock_irqsave(&wheel_lock);
+    int was_pending = timer->pending;
+
+    if (was_pending) {
+        list_del(&timer->node);
+        timer->pending = 0;
+        active_timers--;
+    }
+
+    spin_unlock_irqrestore(&wheel_lock, flags);
+    return was_pending;
+}
+
+// ========= sleeping =========
+
+typedef struct {
+    ktimer_t timer;
+    wait_entry_t wait;
+} sleeper_t;
+
+static void sleeper_expired(void* data) {
+    sleeper_t* sleeper = (sleeper_t*)data;
+    wait_entry_wake(&sleeper->wait);
+}
+
+static int sleep_ticks(uint32_t ticks, bool killable) {
+    sleeper_t sleeper;
+    int result = 0;
+
+    if (ticks == 0) {
+        return 0;
+    }
+
+    ktimer_init(&sleeper.timer, sleeper_expired, &sleeper);
+    wait_entry_init(&sleeper.wait);
+
+    uint32_t flags = irq_save();
+    wait_queue_add(&sleep_queue, &sleeper.wait);
+    ktimer_add(&sleeper.timer, get_ticks() + ticks);
+    if (killable) {
+        result = wait_entry_block_killable(&sleeper.wait);
+    } else {
+        wait_entry_block(&sleeper.wait);
+    }
+    irq_restore(flags);
+
+    // woken early by someone else: make sure the timer is gone
+    ktimer_cancel(&sleeper.timer);
+    wait_queue_remove(&sleep_queue, &sleeper.wait);
+    return result;
+}
+
+void ktimer_sleep(uint32_t ticks) {
+    sleep_ticks(ticks, false);
+}
+
+int ktimer_sleep_killable(uint32_t ticks) {
+    return sleep_ticks(ticks, true);
+}
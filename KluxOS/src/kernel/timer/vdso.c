@@ -0,0 +1,50 @@
+#include <kernel/timer/vdso.h>
+#include <drivers/terminal.h>
+#include "../mm/memory.h"
+
+static vdso_page_t* vdso_kernel_page = NULL;
+static phys_addr_t vdso_phys = 0;
+
+static uint8_t* vdso_text = NULL;
+static phys_addr_t vdso_text_phys = 0;
+
+vdso_page_t* vdso_init(void) {
+    if (vdso_kernel_page) {
+        return vdso_kernel_page;
+    }
+
+    vdso_kernel_page = (vdso_page_t*)kmalloc_aligned_physical(PAGE_SIZE, &vdso_phys);
+    memset(vdso_kernel_page, 0, PAGE_SIZE);
+
+    vdso_text = (uint8_t*)kmalloc_aligned_physical(PAGE_SIZE, &vdso_text_phys);
+    memset(vdso_text, 0xCC, PAGE_SIZE);     // int3 until a stub is installed
+
+    vdso_kernel_page->magic = VDSO_MAGIC;
+    vdso_kernel_page->version = VDSO_VERSION;
+
+    // every process currently shares the kernel address space
+    page_directory_t* dir = get_kernel_directory();
+    if (dir) {
+        vdso_map(dir);
+    }
+
+    return vdso_kernel_page;
+}
+
+void vdso_map(page_directory_t* dir) {
+    if (!vdso_kernel_page || !dir) {
+        return;
+    }
+
+    // user readable, never writable from user mode
+    map_page_dir(dir, VDSO_DATA_ADDR, vdso_phys, MEMORY_PRESENT | MEMORY_USER);
+    map_page_dir(dir, VDSO_TEXT_ADDR, vdso_text_phys, MEMORY_PRESENT | MEMORY_USER);
+}
+
+void vdso_set_entry(const void* code, uint32_t size) {
+    if (!vdso_text || size > PAGE_SIZE) {
+        return;
+    }
+
+    memcpy(vdso_text, code, size);
+}
@@ -0,0 +1,398 @@
+#include <kernel/uring.h>
+#include <kernel/syscall.h>
+#include <kernel/process.h>
+#include <kernel/list.h>
+#include <kernel/sync/spinlock.h>
+#include <kernel/sync/wait.h>
+#include <kernel/timer/timer.h>
+#include <kernel/timer/pit.h>
+#include <kernel/cpu/cpu.h>
+#include <drivers/terminal.h>
+#include "mm/memory.h"
+#include "mm/vm.h"
+
+struct uring_ctx;
+
+// in-flight URING_OP_SLEEP, preallocated per ring
+typedef struct {
+    ktimer_t timer;
+    list_node_t node;        // link in the free list
+    struct uring_ctx* ctx;
+    uint64_t user_data;
+} uring_timeout_t;
+
+// A slot keeps its ring and timeouts after the ring is destroyed and
+// hands them to the next uring_setup that fits, since kfree does not
+// give memory back yet. The ring holds its own reference on each of its
+// frames for good, so unmapping it from a program never frees them.
+typedef struct uring_ctx {
+    bool used;
+    process_t* owner;        // the only process that may enter the ring
+    uring_t* ring;           // kernel view
+    uint32_t size;           // bytes mapped at ring
+    phys_addr_t* frames;     // one per page of the ring
+    uint32_t uaddr;          // owner's mapping, 0 for a kernel thread
+    uring_timeout_t* timeouts;
+    uint32_t ntimeouts;
+    spinlock_t lock;         // completion ring, inflight, free_timeouts
+    uint32_t inflight;       // submitted but not yet completed
+    wait_queue_t cq_wait;    // uring_enter waiting for completions
+    list_node_t free_timeouts;
+} uring_ctx_t;
+
+static lock_class_t uring_class = LOCK_CLASS_INIT("uring");
+static spinlock_t rings_lock = SPINLOCK_INIT_CLASS(&uring_class);
+static uring_ctx_t rings[URING_MAX_RINGS];
+
+void uring_init(void) {
+    for (int i = 0; i < URING_MAX_RINGS; i++) {
+        rings[i].used = false;
+        rings[i].owner = NULL;
+        rings[i].ring = NULL;
+        rings[i].size = 0;
+        rings[i].frames = NULL;
+        rings[i].uaddr = 0;
+        rings[i].timeouts = NULL;
+        rings[i].ntimeouts = 0;
+        spin_lock_init_class(&rings[i].lock, &uring_class);
+    }
+}
+
+// the ring behind id if the current process owns it
+static uring_ctx_t* uring_get(int id) {
+    if (id < 0 || id >= URING_MAX_RINGS) {
+        return NULL;
+    }
+
+    uring_ctx_t* ctx = &rings[id];
+    if (!ctx->used || ctx->owner != current_process) {
+        return NULL;
+    }
+    return ctx;
+}
+
+static uint32_t round_pow2(uint32_t n) {
+    uint32_t p = 1;
+    while (p < n) {
+        p <<= 1;
+    }
+    return p;
+}
+
+// give a slot claimed by uring_setup back
+static void uring_unclaim(uring_ctx_t* ctx) {
+    uint32_t flags = spin_lock_irqsave(&rings_lock);
+    ctx->owner = NULL;
+    ctx->used = false;
+    spin_unlock_irqrestore(&rings_lock, flags);
+}
+
+int uring_setup(uint32_t entries, uring_t** ring_out) {
+    uring_ctx_t* ctx = NULL;
+    int id;
+
+    if (entries == 0 || entries > URING_MAX_ENTRIES || !ring_out) {
+        return -1;
+    }
+    if (vm_check_user(ring_out, sizeof(*ring_out), true) != 0) {
+        terminal_writestring("ERROR: Bad ring pointer\n");
+        return -1;
+    }
+
+    // claim the slot now, the allocations below run unlocked
+    uint32_t flags = spin_lock_irqsave(&rings_lock);
+    for (id = 0; id < URING_MAX_RINGS; id++) {
+        if (!rings[id].used) {
+            ctx = &rings[id];
+            ctx->used = true;
+            ctx->owner = current_process;
+            break;
+        }
+    }
+    spin_unlock_irqrestore(&rings_lock, flags);
+
+    if (!ctx) {
+        terminal_writestring("ERROR: No free submission rings\n");
+        return -1;
+    }
+
+    // completions may outlive their submission slot, give them twice the room
+    uint32_t sq_entries = round_pow2(entries);
+    uint32_t cq_entries = sq_entries * 2;
+
+    uint32_t sqe_offset = (sizeof(uring_t) + 15) & ~15u;
+    uint32_t cqe_offset = sqe_offset + sq_entries * sizeof(uring_sqe_t);
+    uint32_t size = cqe_offset + cq_entries * sizeof(uring_cqe_t);
+    size = (size + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+
+    if (ctx->size < size) {
+        phys_addr_t phys;
+        uring_t* ring = (uring_t*)kmalloc_aligned_physical(size, &phys);
+        phys_addr_t* frames = (phys_addr_t*)kmalloc((size / PAGE_SIZE) * sizeof(phys_addr_t));
+        if (!ring || !frames) {
+            terminal_writestring("ERROR: Not enough memory for submission ring\n");
+            uring_unclaim(ctx);
+            return -1;
+        }
+
+        for (uint32_t i = 0; i < size / PAGE_SIZE; i++) {
+            frames[i] = phys + i * PAGE_SIZE;
+            frame_ref(frames[i]);
+        }
+        ctx->ring = ring;
+        ctx->size = size;
+        ctx->frames = frames;
+    }
+
+    if (ctx->ntimeouts < cq_entries) {
+        uring_timeout_t* timeouts = (uring_timeout_t*)kmalloc(cq_entries * sizeof(uring_timeout_t));
+        if (!timeouts) {
+            terminal_writestring("ERROR: Not enough memory for submission ring\n");
+            uring_unclaim(ctx);
+            return -1;
+        }
+        ctx->timeouts = timeouts;
+        ctx->ntimeouts = cq_entries;
+    }
+
+    uring_t* ring = ctx->ring;
+    memset(ring, 0, ctx->size);
+    ring->sq.mask = sq_entries - 1;
+    ring->sq.entries = sq_entries;
+    ring->cq.mask = cq_entries - 1;
+    ring->cq.entries = cq_entries;
+    ring->sqe_offset = sqe_offset;
+    ring->cqe_offset = cqe_offset;
+
+    ctx->inflight = 0;
+    wait_queue_init(&ctx->cq_wait);
+    list_init(&ctx->free_timeouts);
+    for (uint32_t i = 0; i < ctx->ntimeouts; i++) {
+        uring_timeout_t* timeout = &ctx->timeouts[i];
+        ktimer_init(&timeout->timer, NULL, timeout);
+        timeout->ctx = ctx;
+        list_add_tail(&ctx->free_timeouts, &timeout->node);
+    }
+
+    // the caller fills and reaps the rings directly, through a mapping
+    // in its own address space; a kernel thread uses the kernel view
+    process_t* current = current_process;
+    ctx->uaddr = 0;
+
+    if (current && current->mm) {
+        uint32_t start = mm_find_free(current->mm, ctx->size);
+
+        if (!start || mm_map_frames(current->mm, start, ctx->frames, ctx->size / PAGE_SIZE,
+                                    VMA_READ | VMA_WRITE) != 0) {
+            terminal_writestring("ERROR: No room to map submission ring\n");
+            uring_unclaim(ctx);
+            return -1;
+        }
+        ctx->uaddr = start;
+    }
+
+    *ring_out = ctx->uaddr ? (uring_t*)ctx->uaddr : ring;
+    return id;
+}
+
+// ctx->lock held; called from process context and from the timer interrupt
+static void uring_post_locked(uring_ctx_t* ctx, uint64_t user_data, int32_t res) {
+    uring_t* ring = ctx->ring;
+    uint32_t tail = ring->cq.tail;
+
+    if (tail - ring->cq.head >= ring->cq.entries) {
+        ring->cq.overflow++;
+    } else {
+        uring_cqe_t* cqe = &uring_cqes(ring)[tail & ring->cq.mask];
+        cqe->user_data = user_data;
+        cqe->res = res;
+        cqe->flags = 0;
+        uring_barrier();
+        ring->cq.tail = tail + 1;
+    }
+
+    wait_queue_wake_all(&ctx->cq_wait);
+}
+
+static void uring_post(uring_ctx_t* ctx, uint64_t user_data, int32_t res) {
+    uint32_t flags = spin_lock_irqsave(&ctx->lock);
+    uring_post_locked(ctx, user_data, res);
+    spin_unlock_irqrestore(&ctx->lock, flags);
+}
+
+// the whole callback holds ctx->lock, so uring_release knows it is done
+// once inflight reads zero under the lock
+static void uring_timeout_expired(void* data) {
+    uring_timeout_t* timeout = (uring_timeout_t*)data;
+    uring_ctx_t* ctx = timeout->ctx;
+    uint32_t flags = spin_lock_irqsave(&ctx->lock);
+
+    list_add_tail(&ctx->free_timeouts, &timeout->node);
+    uring_post_locked(ctx, timeout->user_data, 0);
+    ctx->inflight--;
+
+    spin_unlock_irqrestore(&ctx->lock, flags);
+}
+
+static void uring_sleep(uring_ctx_t* ctx, const uring_sqe_t* sqe) {
+    uint32_t flags = spin_lock_irqsave(&ctx->lock);
+
+    if (list_empty(&ctx->free_timeouts)) {
+        uring_post_locked(ctx, sqe->user_data, -1);
+        spin_unlock_irqrestore(&ctx->lock, flags);
+        return;
+    }
+
+    uring_timeout_t* timeout = list_entry(ctx->free_timeouts.next, uring_timeout_t, node);
+    list_del(&timeout->node);
+
+    timeout->user_data = sqe->user_data;
+    timeout->timer.func = uring_timeout_expired;
+    ctx->inflight++;
+    ktimer_add(&timeout->timer, get_ticks() + ms_to_ticks(sqe->len));
+
+    spin_unlock_irqrestore(&ctx->lock, flags);
+}
+
+// run one entry; synchronous operations complete right away
+static void uring_issue(uring_ctx_t* ctx, const uring_sqe_t* sqe) {
+    int32_t res;
+
+    switch (sqe->opcode) {
+        case URING_OP_NOP:
+            res = 0;
+            break;
+        case URING_OP_READ:
+            res = (int32_t)syscall_read(sqe->fd, (void*)sqe->addr, sqe->len);
+            break;
+        case URING_OP_WRITE:
+            res = (int32_t)syscall_write(sqe->fd, (const void*)sqe->addr, sqe->len);
+            break;
+        case URING_OP_OPEN:
+            res = syscall_open((const char*)sqe->addr, (int)sqe->len);
+            break;
+        case URING_OP_CLOSE:
+            res = syscall_close(sqe->fd);
+            break;
+        case URING_OP_SLEEP:
+            uring_sleep(ctx, sqe);
+            return;
+        default:
+            res = -1;
+            break;
+    }
+
+    uring_post(ctx, sqe->user_data, res);
+}
+
+int uring_enter(int id, uint32_t to_submit, uint32_t min_complete) {
+    uring_ctx_t* ctx = uring_get(id);
+    if (!ctx) {
+        return -1;
+    }
+
+    uring_t* ring = ctx->ring;
+    uint32_t head = ring->sq.head;
+    uint32_t queued = ring->sq.tail - head;
+    uint32_t submitted = 0;
+
+    if (queued > ring->sq.entries) {
+        return -1;      // corrupted tail
+    }
+    if (to_submit > queued) {
+        to_submit = queued;
+    }
+
+    uring_barrier();
+
+    while (submitted < to_submit) {
+        // copy first, the caller may rewrite the slot once head moves
+        uring_sqe_t sqe = uring_sqes(ring)[head & ring->sq.mask];
+        head++;
+        ring->sq.head = head;
+        submitted++;
+
+        uring_issue(ctx, &sqe);
+    }
+
+    if (min_complete > ring->cq.entries) {
+        min_complete = ring->cq.entries;
+    }
+
+    // only asynchronous operations can still add completions; queue up
+    // before dropping the lock so a completion in between still wakes us
+    for (;;) {
+        wait_entry_t wait;
+        uint32_t flags = spin_lock_irqsave(&ctx->lock);
+
+        if (uring_cq_ready(ring) >= min_complete || ctx->inflight == 0) {
+            spin_unlock_irqrestore(&ctx->lock, flags);
+            break;
+        }
+
+        wait_entry_init(&wait);
+        wait_queue_add(&ctx->cq_wait, &wait);
+        spin_unlock_irqrestore(&ctx->lock, flags);
+
+        int killed = wait_entry_block_killable(&wait);
+        wait_queue_remove(&ctx->cq_wait, &wait);
+        if (killed != 0) {
+            return -1;
+        }
+    }
+
+    return (int)submitted;
+}
+
+// cancel outstanding sleeps and give the slot back
+static void uring_release(uring_ctx_t* ctx) {
+    uint32_t flags = spin_lock_irqsave(&ctx->lock);
+
+    for (uint32_t i = 0; i < ctx->ntimeouts; i++) {
+        uring_timeout_t* timeout = &ctx->timeouts[i];
+        if (ktimer_cancel(&timeout->timer)) {
+            list_add_tail(&ctx->free_timeouts, &timeout->node);
+            ctx->inflight--;
+        }
+    }
+    spin_unlock_irqrestore(&ctx->lock, flags);
+
+    // a timer another CPU already took off the wheel is still on its way
+    for (;;) {
+        flags = spin_lock_irqsave(&ctx->lock);
+        uint32_t inflight = ctx->inflight;
+        spin_unlock_irqrestore(&ctx->lock, flags);
+
+        if (inflight == 0) {
+            break;
+        }
+        cpu_relax();
+    }
+
+    // the next owner gets its own mapping
+    if (ctx->uaddr && ctx->owner->mm) {
+        mm_unmap(ctx->owner->mm, ctx->uaddr);
+    }
+    ctx->uaddr = 0;
+
+    uring_unclaim(ctx);
+}
+
+int uring_destroy(int id) {
+    uring_ctx_t* ctx = uring_get(id);
+    if (!ctx) {
+        return -1;
+    }
+
+    uring_release(ctx);
+    return 0;
+}
+
+void uring_release_process(process_t* process) {
+    for (int i = 0; i < URING_MAX_RINGS; i++) {
+        uring_ctx_t* ctx = &rings[i];
+        if (ctx->used && ctx->owner == process) {
+            uring_release(ctx);
+        }
+    }
+}
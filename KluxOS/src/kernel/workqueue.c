@@ -0,0 +1,179 @@
+#include <kernel/workqueue.h>
+#include <kernel/kthread.h>
+#include <kernel/sync/spinlock.h>
+#include <kernel/timer/pit.h>
+#include <drivers/terminal.h>
+#include "mm/memory.h"
+
+workqueue_t* system_wq = NULL;
+
+// body of every worker thread
+static void worker_thread(void* arg) {
+    workqueue_t* wq = (workqueue_t*)arg;
+
+    while (1) {
+        uint32_t flags = spin_lock_irqsave(&wq->lock);
+
+        while (list_empty(&wq->pending)) {
+            wait_entry_t wait;
+
+            // queued before the lock is dropped, so queue_work on another
+            // CPU either sees the waiter or we see its work
+            wait_entry_init(&wait);
+            wait_queue_add(&wq->more_work, &wait);
+            spin_unlock(&wq->lock);
+
+            wait_entry_block(&wait);
+            wait_queue_remove(&wq->more_work, &wait);
+            spin_lock(&wq->lock);
+        }
+
+        work_t* work = list_entry(wq->pending.next, work_t, node);
+        list_del(&work->node);
+        work->pending = 0;
+        wq->processed++;
+
+        spin_unlock_irqrestore(&wq->lock, flags);
+
+        // the item may requeue itself from here
+        work->func(work);
+    }
+}
+
+workqueue_t* workqueue_create(const char* name, uint32_t workers) {
+    if (workers == 0 || workers > WORKQUEUE_MAX_WORKERS) {
+        terminal_writestring("ERROR: Invalid number of workers\n");
+        return NULL;
+    }
+
+    workqueue_t* wq = (workqueue_t*)kmalloc(sizeof(workqueue_t));
+    if (!wq) {
+        return NULL;
+    }
+
+    wq->name = name;
+    spin_lock_init(&wq->lock);
+    list_init(&wq->pending);
+    wait_queue_init(&wq->more_work);
+    wq->nr_workers = 0;
+    wq->processed = 0;
+
+    for (uint32_t i = 0; i < workers; i++) {
+        process_t* worker = kthread_create(name, worker_thread, wq);
+        if (!worker) {
+            break;
+        }
+        wq->workers[wq->nr_workers++] = worker;
+    }
+
+    if (wq->nr_workers == 0) {
+        terminal_writestring("ERROR: Could not start worker threads\n");
+        return NULL;
+    }
+
+    return wq;
+}
+
+void workqueue_init(void) {
+    terminal_writestring("Initializing work queues...\n");
+
+    system_wq = workqueue_create("events", 1);
+
+    terminal_writestring("Work queues initialized.\n");
+}
+
+void work_init(work_t* work, work_func_t func, void* data) {
+    list_init(&work->node);
+    work->func = func;
+    work->data = data;
+    work->pending = 0;
+}
+
+int queue_work(workqueue_t* wq, work_t* work) {
+    if (!wq) {
+        return 0;
+    }
+
+    uint32_t flags = spin_lock_irqsave(&wq->lock);
+    int queued = 0;
+
+    if (!work->pending) {
+        work->pending = 1;
+        list_add_tail(&wq->pending, &work->node);
+        queued = 1;
+    }
+
+    spin_unlock_irqrestore(&wq->lock, flags);
+
+    if (queued) {
+        wait_queue_wake_one(&wq->more_work);
+    }
+    return queued;
+}
+
+int cancel_work(workqueue_t* wq, work_t* work) {
+    // never queued anywhere
+    if (!wq) {
+        return 0;
+    }
+
+    uint32_t flags = spin_lock_irqsave(&wq->lock);
+    int cancelled = work->pending;
+
+    if (cancelled) {
+        list_del(&work->node);
+        work->pending = 0;
+    }
+
+    spin_unlock_irqrestore(&wq->lock, flags);
+    return cancelled;
+}
+
+static void delayed_work_timer(void* data) {
+    delayed_work_t* dwork = (delayed_work_t*)data;
+    queue_work(dwork->wq, &dwork->work);
+}
+
+void delayed_work_init(delayed_work_t* dwork, work_func_t func, void* data) {
+    work_init(&dwork->work, func, data);
+    ktimer_init(&dwork->timer, delayed_work_timer, dwork);
+    dwork->wq = NULL;
+}
+
+int queue_delayed_work(workqueue_t* wq, delayed_work_t* dwork, uint32_t delay) {
+    if (delay == 0) {
+        dwork->wq = wq;
+        return queue_work(wq, &dwork->work);
+    }
+
+    if (!wq) {
+        return 0;
+    }
+
+    uint32_t flags = spin_lock_irqsave(&wq->lock);
+    int queued = 0;
+
+    if (!dwork->work.pending && !ktimer_pending(&dwork->timer)) {
+        dwork->wq = wq;
+        ktimer_add(&dwork->timer, get_ticks() + delay);
+        queued = 1;
+    }
+
+    spin_unlock_irqrestore(&wq->lock, flags);
+    return queued;
+}
+
+int cancel_delayed_work(delayed_work_t* dwork) {
+    if (ktimer_cancel(&dwork->timer)) {
+        return 1;
+    }
+    return cancel_work(dwork->wq, &dwork->work);
+}
+
+int schedule_work(work_t* work) {
+    return queue_work(system_wq, work);
+}
+
+int schedule_delayed_work(delayed_work_t* dwork, uint32_t delay) {
+    return queue_delayed_work(system_wq, dwork, delay);
+}
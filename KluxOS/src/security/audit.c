@@ -1,5 +1,6 @@
 #include <security/audit.h>
 #include <kernel/types.h>
+#include <kernel/sync/spinlock.h>
 #include <drivers/terminal.h>
 #include "../kernel/mm/memory.h"
 
@@ -10,6 +11,10 @@ static uint32_t audit_count = 0;
 static uint32_t next_event_id = 1;
 static audit_level_t current_level = AUDIT_LEVEL_INFO; 
 
+// audit_log herhangi bir bağlamdan çağrılabilir, kilit kesmeler kapalıyken alınır
+static lock_class_t audit_class = LOCK_CLASS_INIT("audit");
+static spinlock_t audit_lock = SPINLOCK_INIT_CLASS(&audit_class);
+
 extern uint32_t get_tick_count(void);
 
 void audit_init(void) {
@@ -69,6 +74,8 @@ int audit_log(audit_event_type_t event_type, audit_level_t level, uint32_t user_
         return -1;
     }
     
+    uint32_t flags = spin_lock_irqsave(&audit_lock);
+    
     if (audit_count >= MAX_AUDIT_LOGS) {
         for (uint32_t i = 1; i < MAX_AUDIT_LOGS; i++) {
             audit_logs[i-1] = audit_logs[i];
@@ -91,6 +98,8 @@ int audit_log(audit_event_type_t event_type, audit_level_t level, uint32_t user_
     
     audit_count++;
     
+    spin_unlock_irqrestore(&audit_lock, flags);
+    
     return 0;
 }
 
@@ -105,8 +114,20 @@ int audit_view_logs(uint32_t start_id, uint32_t count) {
     
     uint32_t displayed = 0;
     
-    for (uint32_t i = 0; i < audit_count && displayed < count; i++) {
-        audit_event_t* event = &audit_logs[i];
+    for (uint32_t i = 0; displayed < count; i++) {
+        // Yazdırma uzun sürer, kayıt kilit altında kopyalanır
+        audit_event_t copy;
+        audit_event_t* event = &copy;
+        uint32_t flags = spin_lock_irqsave(&audit_lock);
+        bool valid = i < audit_count;
+        if (valid) {
+            copy = audit_logs[i];
+        }
+        spin_unlock_irqrestore(&audit_lock, flags);
+        
+        if (!valid) {
+            break;
+        }
         
         if (event->event_id < start_id) {
             continue;
@@ -159,6 +180,7 @@ int audit_find_events(audit_event_type_t type, uint32_t user_id, uint32_t* resul
     }
     
     uint32_t found = 0;
+    uint32_t flags = spin_lock_irqsave(&audit_lock);
     
     for (uint32_t i = 0; i < audit_count && found < max_results; i++) {
         audit_event_t* event = &audit_logs[i];
@@ -170,5 +192,7 @@ int audit_find_events(audit_event_type_t type, uint32_t user_id, uint32_t* resul
         }
     }
     
+    spin_unlock_irqrestore(&audit_lock, flags);
+    
     return found;
 }
@@ -1,25 +1,61 @@
 #include <security/firewall.h>
 #include <kernel/types.h>
+#include <kernel/sync/mutex.h>
+#include <kernel/sync/rcu.h>
 #include <drivers/terminal.h>
 
 #define MAX_RULES 256
 
-static struct firewall_rule rules[MAX_RULES];
-static int rule_count = 0;
+// Kural tablosu her pakette okunur, nadiren değişir. Okuyucular kilitsiz
+// (RCU) okur. İki sabit tablo dönüşümlü kullanılır: ekleme boştakine
+// yazıp onu yayınlar, bekleme süresi dolunca eskisi bir sonraki
+// eklemenin boş tablosu olur. Bellek ayrılmaz, serbest bırakılmaz.
+typedef struct {
+    int count;
+    struct firewall_rule rules[MAX_RULES];
+} rule_table_t;
+
+static rule_table_t rule_tables[2];
+static rule_table_t* rule_table = NULL;
 static int firewall_enabled = 1;
 
+// Yalnızca yazarları sıraya koyar; synchronize_rcu uyuyabilir
+static mutex_t rules_update_mutex = MUTEX_INIT(rules_update_mutex);
+
 void firewall_init(void) {
-    rule_count = 0;
+    mutex_lock(&rules_update_mutex);
+    rule_table_t* table = (rule_table == &rule_tables[0]) ? &rule_tables[1] : &rule_tables[0];
+    table->count = 0;
+    rcu_assign_pointer(rule_table, table);
+    synchronize_rcu();
+    mutex_unlock(&rules_update_mutex);
+
     firewall_enabled = 1;
     terminal_writestring("Firewall initialized.\n");
 }
 
 int firewall_add_rule(struct firewall_rule* rule) {
-    if (rule_count >= MAX_RULES) {
+    mutex_lock(&rules_update_mutex);
+    rule_table_t* old = rule_table;
+    int count = old ? old->count : 0;
+    
+    if (count >= MAX_RULES) {
+        mutex_unlock(&rules_update_mutex);
         return -1;
     }
     
-    rules[rule_count++] = *rule;
+    // Önceki eklemenin bekleme süresi bitti, boştakini okuyan kalmadı
+    rule_table_t* table = (old == &rule_tables[0]) ? &rule_tables[1] : &rule_tables[0];
+    
+    for (int i = 0; i < count; i++) {
+        table->rules[i] = old->rules[i];
+    }
+    table->rules[count] = *rule;
+    table->count = count + 1;
+    
+    rcu_assign_pointer(rule_table, table);
+    synchronize_rcu();
+    mutex_unlock(&rules_update_mutex);
     return 0;
 }
 
@@ -30,17 +66,26 @@ int firewall_check_packet(uint32_t src_ip, uint32_t dst_ip,
         return RULE_ALLOW;
     }
     
+    int action = RULE_DENY;
+    rcu_read_lock();
+    
+    rule_table_t* table = rcu_dereference(rule_table);
+    struct firewall_rule* rules = table ? table->rules : NULL;
+    int rule_count = table ? table->count : 0;
+    
     for (int i = 0; i < rule_count; i++) {
         if ((rules[i].src_ip == src_ip || rules[i].src_ip == 0) &&
             (rules[i].dst_ip == dst_ip || rules[i].dst_ip == 0) &&
             (rules[i].src_port == src_port || rules[i].src_port == 0) &&
             (rules[i].dst_port == dst_port || rules[i].dst_port == 0) &&
             (rules[i].protocol == protocol || rules[i].protocol == 0)) {
-            return rules[i].action;
+            action = rules[i].action;
+            break;
         }
     }
     
-    return RULE_DENY;
+    rcu_read_unlock();
+    return action;
 }
 
 void firewall_enable(void) {
@@ -4,6 +4,23 @@
 #include <kernel/fs.h>
 #include <kernel/types.h>
 #include <kernel/process.h>
+#include <kernel/timer/pit.h>
+#include <kernel/math64.h>
+#include <kernel/syscall_bench.h>
+#include <kernel/syscall_stats.h>
+#include <kernel/sync/lockstat.h>
+#include <kernel/sync/rcu.h>
+#include <kernel/futex_bench.h>
+#include <kernel/latbench.h>
+#include <kernel/taskstats.h>
+#include <kernel/exec.h>
+#include <kernel/shm.h>
+#include <kernel/pipe.h>
+#include <kernel/ipc.h>
+#include <kernel/ipc_bench.h>
+#include <kernel/epoll.h>
+#include <kernel/softirq.h>
+#include <kernel/cpu/smp.h>
 
 static shell_context_t shell_ctx;
 
@@ -13,6 +30,7 @@ static void str_copy(char* dest, const char* src, size_t max_len);
 static int str_compare(const char* s1, const char* s2);
 static int str_length(const char* s);
 static void str_clear(char* s, size_t len);
+static int str_to_uint(const char* s, uint32_t* value);
 
 static const shell_command_t commands[] = {
     {
@@ -65,10 +83,28 @@ static const shell_command_t commands[] = {
     },
     {
         .name = "ps",
-        .description = "List running processes",
+        .description = "List processes with CPU time and counters",
         .handler = cmd_ps,
         .usage = "ps"
     },
+    {
+        .name = "top",
+        .description = "Show processes sorted by CPU usage, refreshing",
+        .handler = cmd_top,
+        .usage = "top [interval ms]"
+    },
+    {
+        .name = "kill",
+        .description = "Terminate a process by PID",
+        .handler = cmd_kill,
+        .usage = "kill <pid>"
+    },
+    {
+        .name = "exec",
+        .description = "Run an ELF executable in a new process",
+        .handler = cmd_exec,
+        .usage = "exec <path> [args...]"
+    },
     {
         .name = "uptime",
         .description = "Show system uptime",
@@ -81,6 +117,90 @@ static const shell_command_t commands[] = {
         .handler = cmd_meminfo,
         .usage = "meminfo"
     },
+    {
+        .name = "sysbench",
+        .description = "Compare int 0x80 and sysenter system call cost",
+        .handler = cmd_sysbench,
+        .usage = "sysbench [iterations]"
+    },
+    {
+        .name = "sysstat",
+        .description = "Show system call counts, latency and trace",
+        .handler = cmd_sysstat,
+        .usage = "sysstat [reset | hist nr | trace on|off|show]"
+    },
+    {
+        .name = "softirqs",
+        .description = "Show softirq counters and durations",
+        .handler = cmd_softirqs,
+        .usage = "softirqs"
+    },
+    {
+        .name = "cpus",
+        .description = "Show processors and what they run",
+        .handler = cmd_cpus,
+        .usage = "cpus"
+    },
+    {
+        .name = "cpustat",
+        .description = "Show run queues, utilization and migrations per CPU",
+        .handler = cmd_cpustat,
+        .usage = "cpustat"
+    },
+    {
+        .name = "lockstat",
+        .description = "Show lock contention per lock class",
+        .handler = cmd_lockstat,
+        .usage = "lockstat [on | off | reset]"
+    },
+    {
+        .name = "futexbench",
+        .description = "Measure a contended futex mutex with 2-16 threads",
+        .handler = cmd_futexbench,
+        .usage = "futexbench [threads [iterations]]"
+    },
+    {
+        .name = "latbench",
+        .description = "Measure wakeup latency under load, preemption off and on",
+        .handler = cmd_latbench,
+        .usage = "latbench [samples [load threads]]"
+    },
+    {
+        .name = "shm",
+        .description = "List, create or remove shared memory objects",
+        .handler = cmd_shm,
+        .usage = "shm [create <name> <bytes> | rm <id>]"
+    },
+    {
+        .name = "mkfifo",
+        .description = "Create a named pipe",
+        .handler = cmd_mkfifo,
+        .usage = "mkfifo <path>"
+    },
+    {
+        .name = "pipes",
+        .description = "List open pipes and what they hold",
+        .handler = cmd_pipes,
+        .usage = "pipes"
+    },
+    {
+        .name = "ipc",
+        .description = "List IPC endpoints and their call counts",
+        .handler = cmd_ipc,
+        .usage = "ipc"
+    },
+    {
+        .name = "ipcbench",
+        .description = "Measure IPC call/reply round trips against semaphores",
+        .handler = cmd_ipcbench,
+        .usage = "ipcbench [iterations]"
+    },
+    {
+        .name = "epoll",
+        .description = "List epoll instances and their ready descriptors",
+        .handler = cmd_epoll,
+        .usage = "epoll"
+    },
     {
         .name = NULL,
         .description = NULL,
@@ -361,9 +481,12 @@ shell_status_t cmd_ls(int argc, char** argv) {
         return SHELL_ERROR_INVALID_ARGUMENTS;
     }
     
-    fs_node_t* child = node->children;
     int count = 0;
     
+    // Dizin listesi kilitsiz okunur, çıktı bitene kadar okuma bölümünde kal
+    rcu_read_lock();
+    fs_node_t* child = rcu_dereference(node->children);
+    
     while (child) {
         if (child->type == FS_DIRECTORY) {
             terminal_set_fg_color(VGA_COLOR_LIGHT_BLUE);
@@ -386,9 +509,11 @@ shell_status_t cmd_ls(int argc, char** argv) {
             terminal_writestring("\t");
         }
         
-        child = child->next;
+        child = rcu_dereference(child->next);
     }
     
+    rcu_read_unlock();
+    
     if (count % 5 != 0) {
         terminal_writestring("\n");
     }
@@ -500,47 +625,76 @@ shell_status_t cmd_cat(int argc, char** argv) {
 }
 
 shell_status_t cmd_ps(int argc, char** argv) {
-    extern process_t* process_list;
-    process_t* current = process_list;
-    int count = 0;
+    taskstats_dump();
+    return SHELL_OK;
+}
+
+// top komutu
+shell_status_t cmd_top(int argc, char** argv) {
+    uint32_t interval = 1000;
     
-    terminal_writestring("  PID  |  DURUM  |  AD\n");
-    terminal_writestring("-------|---------|----------------\n");
+    if (argc > 2 || (argc == 2 && (str_to_uint(argv[1], &interval) != 0 || interval == 0))) {
+        return SHELL_ERROR_INVALID_ARGUMENTS;
+    }
     
-    while (current != NULL) {
-        char buffer[64];
-        const char* state_str;
-        
-        switch(current->state) {
-            case PROCESS_READY: state_str = "HAZIR"; break;
-            case PROCESS_RUNNING: state_str = "CALISMA"; break;
-            case PROCESS_BLOCKED: state_str = "BLOKE"; break;
-            case PROCESS_TERMINATED: state_str = "SONLANDI"; break;
-            default: state_str = "BILINMIYOR"; break;
+    // Önceki basılan tuşlar hemen çıkmasın
+    while (keyboard_data_available()) {
+        keyboard_read();
+    }
+    
+    taskstats_top_begin();
+    
+    while (1) {
+        // Tuşa küçük adımlarla bakarak bekle
+        for (uint32_t waited = 0; waited < interval; waited += 50) {
+            if (keyboard_data_available()) {
+                keyboard_read();
+                return SHELL_OK;
+            }
+            sleep_ms(50);
         }
         
-        terminal_printf("  %3d  | %8s | %s\n", 
-                       current->pid, 
-                       state_str, 
-                       current->name);
-        
-        current = current->next;
-        count++;
+        taskstats_top_frame();
+    }
+}
+
+// kill komutu
+shell_status_t cmd_kill(int argc, char** argv) {
+    uint32_t pid;
+    
+    if (argc != 2 || str_to_uint(argv[1], &pid) != 0) {
+        return SHELL_ERROR_INVALID_ARGUMENTS;
     }
     
-    if (count == 0) {
-        terminal_writestring("Aktif islem bulunamadi.\n");
+    if (process_kill(pid) != 0) {
+        return SHELL_ERROR_INTERNAL;
     }
     
     return SHELL_OK;
 }
 
+// exec komutu
+shell_status_t cmd_exec(int argc, char** argv) {
+    if (argc < 2) {
+        return SHELL_ERROR_INVALID_ARGUMENTS;
+    }
+    
+    // argv[0] programın kendi yolu olur
+    process_t* process = exec_spawn(argv[1], &argv[1]);
+    if (!process) {
+        return SHELL_ERROR_INTERNAL;
+    }
+    
+    terminal_writestring("Started PID ");
+    terminal_print_uint(process->pid);
+    terminal_writestring("\n");
+    
+    return SHELL_OK;
+}
+
 // uptime komutu
 shell_status_t cmd_uptime(int argc, char** argv) {
-    extern uint32_t get_tick_count(void);
-    uint32_t ticks = get_tick_count();
-    
-    uint32_t seconds = ticks / 100;
+    uint32_t seconds = (uint32_t)div_u64_u32(get_uptime_ms(), 1000, NULL);
     uint32_t minutes = seconds / 60;
     uint32_t hours = minutes / 60;
     uint32_t days = hours / 24;
@@ -548,16 +702,242 @@ shell_status_t cmd_uptime(int argc, char** argv) {
     minutes %= 60;
     hours %= 24;
     
+    uint32_t loads[3];
+    scheduler_loadavg(loads);
+    
     terminal_writestring("System uptime: ");
-    terminal_printf("%u days, %u hours, %u minutes\n", days, hours, minutes);
+    terminal_print_uint(days);
+    terminal_writestring(" days, ");
+    terminal_print_uint(hours);
+    terminal_writestring(" hours, ");
+    terminal_print_uint(minutes);
+    terminal_writestring(" minutes\n");
+    
+    terminal_writestring("Load average: ");
+    for (int i = 0; i < 3; i++) {
+        uint32_t hundredths = ((loads[i] & ((1 << LOADAVG_SHIFT) - 1)) * 100) >> LOADAVG_SHIFT;
+        
+        terminal_print_uint(loads[i] >> LOADAVG_SHIFT);
+        terminal_writestring(hundredths < 10 ? ".0" : ".");
+        terminal_print_uint(hundredths);
+        terminal_writestring(i < 2 ? ", " : "\n");
+    }
     
     return SHELL_OK;
 }
 
 shell_status_t cmd_meminfo(int argc, char** argv) {
     extern void memory_info(void);
+    extern void kstack_stats_dump(void);
+    extern void vm_stats_dump(void);
     
     memory_info();
+    kstack_stats_dump();
+    vm_stats_dump();
+    
+    return SHELL_OK;
+}
+
+// sysbench komutu
+shell_status_t cmd_sysbench(int argc, char** argv) {
+    uint32_t iterations = SYSCALL_BENCH_DEFAULT;
+    
+    if (argc > 1 && (str_to_uint(argv[1], &iterations) != 0 || iterations == 0)) {
+        terminal_writestring("Usage: sysbench [iterations]\n");
+        return SHELL_ERROR_INVALID_ARGUMENTS;
+    }
+    
+    syscall_bench(iterations);
+    
+    return SHELL_OK;
+}
+
+// sysstat komutu
+shell_status_t cmd_sysstat(int argc, char** argv) {
+    uint32_t nr;
+    
+    if (argc == 1) {
+        syscall_stats_dump();
+        terminal_writestring(syscall_trace_enabled() ? "trace: on\n" : "trace: off\n");
+        return SHELL_OK;
+    }
+    
+    if (str_compare(argv[1], "reset") == 0) {
+        syscall_stats_reset();
+        return SHELL_OK;
+    }
+    
+    if (str_compare(argv[1], "hist") == 0 && argc > 2 && str_to_uint(argv[2], &nr) == 0) {
+        syscall_stats_dump_hist(nr);
+        return SHELL_OK;
+    }
+    
+    if (str_compare(argv[1], "trace") == 0 && argc > 2) {
+        if (str_compare(argv[2], "on") == 0) {
+            syscall_trace_enable(true);
+            return SHELL_OK;
+        }
+        if (str_compare(argv[2], "off") == 0) {
+            syscall_trace_enable(false);
+            return SHELL_OK;
+        }
+        if (str_compare(argv[2], "show") == 0) {
+            syscall_trace_dump();
+            return SHELL_OK;
+        }
+    }
+    
+    terminal_writestring("Usage: sysstat [reset | hist nr | trace on|off|show]\n");
+    return SHELL_ERROR_INVALID_ARGUMENTS;
+}
+
+// softirqs komutu
+shell_status_t cmd_softirqs(int argc, char** argv) {
+    softirq_stats_dump();
+    return SHELL_OK;
+}
+
+// cpus komutu
+shell_status_t cmd_cpus(int argc, char** argv) {
+    smp_dump();
+    return SHELL_OK;
+}
+
+// cpustat komutu
+shell_status_t cmd_cpustat(int argc, char** argv) {
+    scheduler_stats_dump();
+    return SHELL_OK;
+}
+
+// lockstat komutu
+shell_status_t cmd_lockstat(int argc, char** argv) {
+    if (argc == 1) {
+        lockstat_dump();
+        return SHELL_OK;
+    }
+    
+    if (str_compare(argv[1], "on") == 0) {
+        lockstat_enable(true);
+        return SHELL_OK;
+    }
+    if (str_compare(argv[1], "off") == 0) {
+        lockstat_enable(false);
+        return SHELL_OK;
+    }
+    if (str_compare(argv[1], "reset") == 0) {
+        lockstat_reset();
+        return SHELL_OK;
+    }
+    
+    terminal_writestring("Usage: lockstat [on | off | reset]\n");
+    return SHELL_ERROR_INVALID_ARGUMENTS;
+}
+
+// futexbench komutu
+shell_status_t cmd_futexbench(int argc, char** argv) {
+    uint32_t threads = 0;
+    uint32_t iterations = FUTEX_BENCH_DEFAULT;
+    
+    if ((argc > 1 && (str_to_uint(argv[1], &threads) != 0 ||
+                      threads == 0 || threads > FUTEX_BENCH_MAX_THREADS)) ||
+        (argc > 2 && (str_to_uint(argv[2], &iterations) != 0 || iterations == 0))) {
+        terminal_writestring("Usage: futexbench [threads [iterations]]\n");
+        return SHELL_ERROR_INVALID_ARGUMENTS;
+    }
+    
+    futex_bench(threads, iterations);
+    
+    return SHELL_OK;
+}
+
+// latbench komutu
+shell_status_t cmd_latbench(int argc, char** argv) {
+    uint32_t samples = LATBENCH_DEFAULT;
+    uint32_t load = 0;
+    
+    if ((argc > 1 && (str_to_uint(argv[1], &samples) != 0 || samples == 0)) ||
+        (argc > 2 && (str_to_uint(argv[2], &load) != 0 || load > LATBENCH_MAX_LOAD))) {
+        terminal_writestring("Usage: latbench [samples [load threads]]\n");
+        return SHELL_ERROR_INVALID_ARGUMENTS;
+    }
+    
+    latbench(samples, load);
+    
+    return SHELL_OK;
+}
+
+// shm komutu
+shell_status_t cmd_shm(int argc, char** argv) {
+    uint32_t value;
+    
+    if (argc == 1) {
+        shm_dump();
+        return SHELL_OK;
+    }
+    
+    if (argc == 4 && str_compare(argv[1], "create") == 0 &&
+        str_to_uint(argv[3], &value) == 0) {
+        int id = shm_get(argv[2], value, SHM_CREATE | SHM_EXCL);
+        if (id < 0) {
+            return SHELL_ERROR_INTERNAL;
+        }
+        
+        terminal_writestring("Created shared memory object ");
+        terminal_print_uint(id);
+        terminal_writestring("\n");
+        return SHELL_OK;
+    }
+    
+    if (argc == 3 && str_compare(argv[1], "rm") == 0 &&
+        str_to_uint(argv[2], &value) == 0) {
+        return shm_remove((int)value) == 0 ? SHELL_OK : SHELL_ERROR_INTERNAL;
+    }
+    
+    terminal_writestring("Usage: shm [create <name> <bytes> | rm <id>]\n");
+    return SHELL_ERROR_INVALID_ARGUMENTS;
+}
+
+// mkfifo komutu
+shell_status_t cmd_mkfifo(int argc, char** argv) {
+    if (argc != 2) {
+        terminal_writestring("Usage: mkfifo <path>\n");
+        return SHELL_ERROR_INVALID_ARGUMENTS;
+    }
+    
+    return pipe_mkfifo(argv[1]) == 0 ? SHELL_OK : SHELL_ERROR_INTERNAL;
+}
+
+// pipes komutu
+shell_status_t cmd_pipes(int argc, char** argv) {
+    pipe_dump();
+    
+    return SHELL_OK;
+}
+
+// ipc komutu
+shell_status_t cmd_ipc(int argc, char** argv) {
+    ipc_dump();
+    
+    return SHELL_OK;
+}
+
+// ipcbench komutu
+shell_status_t cmd_ipcbench(int argc, char** argv) {
+    uint32_t iterations = IPC_BENCH_DEFAULT;
+    
+    if (argc > 1 && (str_to_uint(argv[1], &iterations) != 0 || iterations == 0)) {
+        terminal_writestring("Usage: ipcbench [iterations]\n");
+        return SHELL_ERROR_INVALID_ARGUMENTS;
+    }
+    
+    ipc_bench(iterations);
+    
+    return SHELL_OK;
+}
+
+// epoll komutu
+shell_status_t cmd_epoll(int argc, char** argv) {
+    epoll_dump();
     
     return SHELL_OK;
 }
@@ -598,3 +978,21 @@ static void str_clear(char* s, size_t len) {
         s[i] = '\0';
     }
 }
+
+static int str_to_uint(const char* s, uint32_t* value) {
+    uint32_t result = 0;
+    
+    if (!s || *s == '\0') {
+        return -1;
+    }
+    
+    for (; *s; s++) {
+        if (*s < '0' || *s > '9') {
+            return -1;
+        }
+        result = result * 10 + (uint32_t)(*s - '0');
+    }
+    
+    *value = result;
+    return 0;
+}